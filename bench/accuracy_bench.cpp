@@ -0,0 +1,449 @@
+// Accuracy regression check for every analysis mode against a double precision DFT.
+// Deterministic test signals (sines on a bin centre and a bin edge, a chirp, white noise,
+// an impulse train) go through each mode, and every mode/signal pair is checked for peak
+// bin, amplitude, leakage and noise floor, with the mode's runtime next to the checks.
+// Exits with 1 if any check is out of tolerance. Headless:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/accuracy_bench.cpp src/dsp/*.cpp -o accuracy_bench
+// --verbose prints every check instead of only the failures and a summary per mode.
+
+#include "dsp/audio_file.h"
+#include "dsp/bin_range_spectrum.h"
+#include "dsp/offline_stft.h"
+#include "dsp/streaming_stft.h"
+#include "dsp/window.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const double kPi = 3.14159265358979323846;
+	const std::size_t kSampleRate = 44100;
+	const std::size_t kFftSize = 4096;
+	//! shorter than the FFT, so the zero padding paths are exercised too
+	const std::size_t kWindowSize = 3000;
+	const std::size_t kHopSize = kSampleRate / 20;
+	const std::size_t kNumSamples = kSampleRate;
+	//! the zoom band, 0..kZoomMaxFreq
+	const float kZoomMaxFreq = kSampleRate / 8.0f;
+	//! frames per mode and signal compared against the reference, spread over the signal
+	const std::size_t kCheckedFrames = 6;
+	//! bins either side of the peak that belong to a Blackman main lobe
+	const std::size_t kMainLobe = 4;
+	const double kSineBin = 300.0;
+
+	struct Signal
+	{
+		std::string			mName;
+		std::vector<float>	mSamples;
+		// sines and the chirp have one peak per frame, noise and impulses don't
+		bool				mTonal;
+		// the peak may land on either neighbour (bin edge sine, chirp)
+		std::size_t			mPeakSlack;
+	};
+
+	//! what a mode may get away with, relative to the double precision reference
+	struct Tolerance
+	{
+		double				mAmplitude;		// relative error of the peak (tonal) or RMS (broadband) magnitude
+		double				mLeakageDb;		// leakage may exceed the reference by this much...
+		double				mFloorDbc;		// ...as may the noise floor, down to this floor relative to the peak
+		double				mFloorDb;
+	};
+
+	//! one analysed frame, magnitudes of bins [firstBin, firstBin + size)
+	struct Frame
+	{
+		std::uint64_t		mSampleIndex;
+		std::vector<float>	mMagnitudes;
+	};
+
+	struct Mode
+	{
+		std::string			mName;
+		std::size_t			mFirstBin;
+		std::size_t			mNumBins;
+		// bins [mFirstBin, mFirstBin + mNumCheckedBins) are compared, the zoom filter rolls off above that
+		std::size_t			mNumCheckedBins;
+		Tolerance			mTolerance;
+		// analyses the signal, returns every frame
+		std::function<std::vector<Frame>(const Signal&)>	mRun;
+	};
+
+	std::vector<Signal> makeSignals()
+	{
+		std::vector<Signal> signals;
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> noise(-0.5f, 0.5f);
+
+		const double binHz = static_cast<double>(kSampleRate) / kFftSize;
+		for (double bin : { kSineBin, kSineBin + 0.5 })
+		{
+			Signal sine{ bin == kSineBin ? "sine bin centre" : "sine bin edge", std::vector<float>(kNumSamples), true, bin == kSineBin ? 0u : 1u };
+			for (std::size_t i = 0; i < kNumSamples; i++)
+				sine.mSamples[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * bin * binHz * i / kSampleRate));
+			signals.push_back(sine);
+		}
+
+		//Linear sweep from 200 Hz to 4 kHz, inside the zoom band
+		Signal chirp{ "chirp", std::vector<float>(kNumSamples), true, 1 };
+		const double duration = static_cast<double>(kNumSamples) / kSampleRate;
+		for (std::size_t i = 0; i < kNumSamples; i++)
+		{
+			const double t = static_cast<double>(i) / kSampleRate;
+			chirp.mSamples[i] = static_cast<float>(0.5 * std::sin(2.0 * kPi * (200.0 * t + 0.5 * (4000.0 - 200.0) / duration * t * t)));
+		}
+		signals.push_back(chirp);
+
+		Signal white{ "white noise", std::vector<float>(kNumSamples), false, 0 };
+		for (auto& sample : white.mSamples)
+			sample = noise(rng);
+		signals.push_back(white);
+
+		Signal impulses{ "impulse train", std::vector<float>(kNumSamples, 0.0f), false, 0 };
+		for (std::size_t i = 0; i < kNumSamples; i += 1237)
+			impulses.mSamples[i] = 1.0f;
+		signals.push_back(impulses);
+		return signals;
+	}
+
+	//! |X[k]| / fftSize of the Blackman windowed frame at sampleIndex, k in [0, fftSize / 2), in doubles
+	class Reference
+	{
+	public:
+		Reference()
+			: mCos(kFftSize)
+			, mSin(kFftSize)
+			, mWindow(kWindowSize)
+		{
+			for (std::size_t i = 0; i < kFftSize; i++)
+			{
+				mCos[i] = std::cos(2.0 * kPi * i / kFftSize);
+				mSin[i] = std::sin(2.0 * kPi * i / kFftSize);
+			}
+			for (std::size_t i = 0; i < kWindowSize; i++)
+			{
+				const double x = static_cast<double>(i) / kWindowSize;
+				mWindow[i] = 0.42 - 0.5 * std::cos(2.0 * kPi * x) + 0.08 * std::cos(4.0 * kPi * x);
+			}
+		}
+
+		const std::vector<double>& get(const Signal& signal, std::uint64_t sampleIndex)
+		{
+			std::vector<double>& spectrum = mCache[signal.mName][sampleIndex];
+			if (!spectrum.empty())
+				return spectrum;
+
+			std::vector<double> frame(kWindowSize, 0.0);
+			for (std::size_t i = 0; i < kWindowSize && sampleIndex + i < signal.mSamples.size(); i++)
+				frame[i] = signal.mSamples[sampleIndex + i] * mWindow[i];
+
+			spectrum.resize(kFftSize / 2);
+			for (std::size_t k = 0; k < kFftSize / 2; k++)
+			{
+				double re = 0.0, im = 0.0;
+				std::size_t phase = 0;
+				for (std::size_t n = 0; n < kWindowSize; n++)
+				{
+					re += frame[n] * mCos[phase];
+					im -= frame[n] * mSin[phase];
+					phase = (phase + k) & (kFftSize - 1);
+				}
+				spectrum[k] = std::sqrt(re * re + im * im) / kFftSize;
+			}
+			return spectrum;
+		}
+
+	private:
+		std::vector<double>	mCos;
+		std::vector<double>	mSin;
+		std::vector<double>	mWindow;
+		std::map<std::string, std::map<std::uint64_t, std::vector<double>>>	mCache;
+	};
+
+	//! the worst value of every check over the compared frames
+	struct Measurement
+	{
+		std::size_t			mPeakError = 0;
+		double				mAmplitudeError = 0.0;
+		// worst output and the reference of the same frame, dB
+		double				mLeakage = -1e30, mLeakageRef = -1e30;
+		double				mFloor = -1e30, mFloorRef = -1e30;
+		double				mSecondsPerFrame = 0.0;
+		// frames whose peak could be checked, tonal signals only
+		std::size_t			mNumPeakFrames = 0;
+	};
+
+	double toDb(double value)
+	{
+		return 20.0 * std::log10(std::max(value, 1e-30));
+	}
+
+	double median(std::vector<double> values)
+	{
+		std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+		return values[values.size() / 2];
+	}
+
+	void compareFrame(const Mode& mode, const Signal& signal, const Frame& frame, const std::vector<double>& reference, Measurement& m)
+	{
+		const std::size_t numBins = std::min(mode.mNumCheckedBins, frame.mMagnitudes.size());
+		const double* ref = reference.data() + mode.mFirstBin;
+		const float* out = frame.mMagnitudes.data();
+
+		std::size_t refPeak = 0, outPeak = 0;
+		double refEnergy = 0.0, outEnergy = 0.0;
+		for (std::size_t i = 0; i < numBins; i++)
+		{
+			if (ref[i] > ref[refPeak])
+				refPeak = i;
+			if (out[i] > out[outPeak])
+				outPeak = i;
+			refEnergy += ref[i] * ref[i];
+			outEnergy += static_cast<double>(out[i]) * out[i];
+		}
+
+		if (!signal.mTonal)
+		{
+			//Broadband: the level over the band and the typical bin have to match
+			const double refRms = std::sqrt(refEnergy / numBins);
+			m.mAmplitudeError = std::max(m.mAmplitudeError, std::abs(std::sqrt(outEnergy / numBins) - refRms) / refRms);
+			std::vector<double> refDb(numBins), outDb(numBins);
+			for (std::size_t i = 0; i < numBins; i++)
+			{
+				refDb[i] = toDb(ref[i]);
+				outDb[i] = toDb(out[i]);
+			}
+			const double floorRef = median(refDb), floor = median(outDb);
+			if (std::abs(floor - floorRef) > std::abs(m.mFloor - m.mFloorRef) || m.mFloor < -1e29)
+			{
+				m.mFloor = floor;
+				m.mFloorRef = floorRef;
+			}
+			return;
+		}
+
+		//Only frames whose reference peak sits well inside the band say anything about the peak
+		const bool peakInBand = refPeak >= kMainLobe && refPeak + kMainLobe < numBins
+			&& ref[refPeak] >= *std::max_element(reference.begin(), reference.end()) * 0.999;
+		if (!peakInBand)
+			return;
+		m.mNumPeakFrames++;
+
+		const std::size_t peakError = outPeak > refPeak ? outPeak - refPeak : refPeak - outPeak;
+		m.mPeakError = std::max(m.mPeakError, peakError > signal.mPeakSlack ? peakError : 0);
+		m.mAmplitudeError = std::max(m.mAmplitudeError, std::abs(out[refPeak] - ref[refPeak]) / ref[refPeak]);
+
+		//Leakage: energy outside the main lobe, relative to all of it
+		double refOutside = 0.0, outOutside = 0.0;
+		std::vector<double> refDbc, outDbc;
+		for (std::size_t i = 0; i < numBins; i++)
+		{
+			if (i + kMainLobe >= refPeak && i <= refPeak + kMainLobe)
+				continue;
+			refOutside += ref[i] * ref[i];
+			outOutside += static_cast<double>(out[i]) * out[i];
+			refDbc.push_back(toDb(ref[i] / ref[refPeak]));
+			outDbc.push_back(toDb(out[i] / ref[refPeak]));
+		}
+		const double leakage = 10.0 * std::log10(std::max(outOutside / outEnergy, 1e-30));
+		if (leakage - m.mLeakage > 0.0)
+		{
+			m.mLeakage = leakage;
+			m.mLeakageRef = 10.0 * std::log10(std::max(refOutside / refEnergy, 1e-30));
+		}
+		const double floor = median(outDbc);
+		if (floor > m.mFloor)
+		{
+			m.mFloor = floor;
+			m.mFloorRef = median(refDbc);
+		}
+	}
+
+	std::vector<Frame> runBinRange(const Signal& signal, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method method)
+	{
+		BinRangeSpectrum spectrum;
+		spectrum.setup(kFftSize, kWindowSize, firstBin, numBins, method);
+		std::vector<float> window(kWindowSize);
+		generateWindow(WindowType::BLACKMAN, window.data(), kWindowSize);
+
+		std::vector<Frame> frames;
+		std::vector<float> input(kWindowSize);
+		for (std::size_t start = 0; start + kWindowSize <= signal.mSamples.size(); start += kHopSize)
+		{
+			for (std::size_t i = 0; i < kWindowSize; i++)
+				input[i] = signal.mSamples[start + i] * window[i];
+			Frame frame{ start, std::vector<float>(spectrum.getNumBins()) };
+			spectrum.computeMagnitudes(input.data(), frame.mMagnitudes.data());
+			frames.push_back(std::move(frame));
+		}
+		return frames;
+	}
+
+	std::vector<Frame> runStreaming(const Signal& signal, float zoomMaxFreq)
+	{
+		StreamingStft stft;
+		stft.setup(kFftSize, kWindowSize, kHopSize, kSampleRate, zoomMaxFreq);
+
+		//Odd sized blocks, so frame boundaries land in the middle of writes
+		std::vector<Frame> frames;
+		std::size_t pos = 0;
+		while (pos < signal.mSamples.size())
+		{
+			pos += stft.write(signal.mSamples.data() + pos, std::min<std::size_t>(333, signal.mSamples.size() - pos));
+			if (stft.isFrameReady())
+			{
+				Frame frame{ stft.getFrameSampleIndex(), std::vector<float>(stft.getNumOutputBins()) };
+				stft.computeFrame(frame.mMagnitudes.data());
+				frames.push_back(std::move(frame));
+			}
+		}
+		return frames;
+	}
+
+	std::vector<Frame> runOffline(const Signal& signal, const std::string& path, float zoomMaxFreq)
+	{
+		//Through a real mapping, the way the batch CLI and the app read files
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return std::vector<Frame>();
+		std::fwrite(signal.mSamples.data(), sizeof(float), signal.mSamples.size(), file);
+		std::fclose(file);
+
+		RawFormat format;
+		format.mSampleFormat = SampleFormat::FLOAT32;
+		format.mSampleRate = kSampleRate;
+		AudioFile audio;
+		if (!audio.openRaw(path, format))
+			return std::vector<Frame>();
+
+		OfflineStft stft;
+		stft.setNumThreads(2);
+		stft.setup(kFftSize, kWindowSize, kHopSize, kSampleRate, zoomMaxFreq);
+		const std::size_t numFrames = stft.getNumFrames(audio.getNumFrames());
+		std::vector<float> magnitudes(numFrames * stft.getNumOutputBins());
+		stft.analyze(audio, 0, numFrames, magnitudes.data());
+
+		std::vector<Frame> frames;
+		for (std::size_t f = 0; f < numFrames; f++)
+		{
+			const float* row = magnitudes.data() + f * stft.getNumOutputBins();
+			frames.push_back(Frame{ stft.getFrameSampleIndex(f), std::vector<float>(row, row + stft.getNumOutputBins()) });
+		}
+		return frames;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const bool verbose = argc > 1 && !std::strcmp(argv[1], "--verbose");
+	const std::string offlinePath = "accuracy_bench.f32";
+
+	//Float transforms sit around -130 dBc, the zoom decimator's stop band around -90 dBc
+	//and its pass band ripples by up to 0.2 dB
+	const Tolerance fullBand = { 1e-4, 0.1, -110.0, 1.0 };
+	const Tolerance zoom = { 0.025, 1.0, -80.0, 3.0 };
+	const std::size_t numZoomBins = static_cast<std::size_t>(kZoomMaxFreq * kFftSize / kSampleRate);
+	const std::size_t goertzelFirst = static_cast<std::size_t>(kSineBin) - 8;
+
+	std::vector<Mode> modes;
+	modes.push_back(Mode{ "pruned FFT", 0, kFftSize / 2, kFftSize / 2, fullBand,
+		[](const Signal& s) { return runBinRange(s, 0, kFftSize / 2, BinRangeSpectrum::Method::PRUNED_FFT); } });
+	modes.push_back(Mode{ "chirp-z", 200, 256, 256, fullBand,
+		[](const Signal& s) { return runBinRange(s, 200, 256, BinRangeSpectrum::Method::CHIRP_Z); } });
+	modes.push_back(Mode{ "goertzel", goertzelFirst, 16, 16, fullBand,
+		[=](const Signal& s) { return runBinRange(s, goertzelFirst, 16, BinRangeSpectrum::Method::GOERTZEL); } });
+	modes.push_back(Mode{ "streaming", 0, kFftSize / 2, kFftSize / 2, fullBand,
+		[](const Signal& s) { return runStreaming(s, 0.0f); } });
+	modes.push_back(Mode{ "streaming zoom", 0, numZoomBins, numZoomBins * 8 / 10, zoom,
+		[](const Signal& s) { return runStreaming(s, kZoomMaxFreq); } });
+	modes.push_back(Mode{ "offline", 0, kFftSize / 2, kFftSize / 2, fullBand,
+		[&](const Signal& s) { return runOffline(s, offlinePath, 0.0f); } });
+	modes.push_back(Mode{ "offline zoom", 0, numZoomBins, numZoomBins * 8 / 10, zoom,
+		[&](const Signal& s) { return runOffline(s, offlinePath, kZoomMaxFreq); } });
+
+	const std::vector<Signal> signals = makeSignals();
+	Reference reference;
+	std::size_t numChecks = 0, numFailures = 0;
+
+	std::printf("%-15s %-16s %-10s %12s %12s %12s %5s %10s\n", "mode", "signal", "check", "value", "reference", "limit", "", "us/frame");
+	for (const Mode& mode : modes)
+	{
+		std::size_t modeChecks = 0, modeFailures = 0;
+		double modeSeconds = 0.0;
+		for (const Signal& signal : signals)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			const std::vector<Frame> frames = mode.mRun(signal);
+			const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			if (frames.empty())
+			{
+				std::printf("%-15s %-16s produced no frames\n", mode.mName.c_str(), signal.mName.c_str());
+				numFailures++;
+				continue;
+			}
+
+			Measurement m;
+			m.mSecondsPerFrame = seconds / frames.size();
+			modeSeconds += m.mSecondsPerFrame;
+			for (std::size_t i = 0; i < kCheckedFrames; i++)
+			{
+				const Frame& frame = frames[i * (frames.size() - 1) / (kCheckedFrames - 1)];
+				compareFrame(mode, signal, frame, reference.get(signal, frame.mSampleIndex), m);
+			}
+
+			const Tolerance& tol = mode.mTolerance;
+			const double floorLimit = std::max(m.mFloorRef, tol.mFloorDbc) + tol.mFloorDb;
+			struct Check { const char* mName; double mValue, mReference, mLimit; bool mPass; };
+			std::vector<Check> checks;
+			if (signal.mTonal && m.mNumPeakFrames == 0)
+			{
+				//e.g. the chirp never crosses a narrow Goertzel band, nothing to compare
+				if (verbose)
+					std::printf("%-15s %-16s %-10s no peak in band, skipped\n", mode.mName.c_str(), signal.mName.c_str(), "");
+				continue;
+			}
+			checks.push_back(Check{ signal.mTonal ? "amplitude" : "rms level", m.mAmplitudeError, 0.0, tol.mAmplitude, m.mAmplitudeError <= tol.mAmplitude });
+			if (signal.mTonal)
+			{
+				checks.push_back(Check{ "peak bin", static_cast<double>(m.mPeakError), 0.0, 0.0, m.mPeakError == 0 });
+				const double leakageLimit = std::max(m.mLeakageRef, tol.mFloorDbc) + tol.mLeakageDb;
+				checks.push_back(Check{ "leakage dB", m.mLeakage, m.mLeakageRef, leakageLimit, m.mLeakage <= leakageLimit });
+				checks.push_back(Check{ "floor dBc", m.mFloor, m.mFloorRef, floorLimit, m.mFloor <= floorLimit });
+			}
+			else
+			{
+				//The median bin is signal here, it has to match rather than just stay low
+				checks.push_back(Check{ "floor dB", m.mFloor, m.mFloorRef, m.mFloorRef + tol.mFloorDb, std::abs(m.mFloor - m.mFloorRef) <= tol.mFloorDb });
+			}
+
+			for (const Check& check : checks)
+			{
+				modeChecks++;
+				if (!check.mPass)
+					modeFailures++;
+				if (verbose || !check.mPass)
+					std::printf("%-15s %-16s %-10s %12.4g %12.4g %12.4g %5s %10.1f\n", mode.mName.c_str(), signal.mName.c_str(), check.mName,
+						check.mValue, check.mReference, check.mLimit, check.mPass ? "ok" : "FAIL", 1e6 * m.mSecondsPerFrame);
+			}
+		}
+		std::printf("%-15s %zu / %zu checks passed, %.1f us/frame\n", mode.mName.c_str(), modeChecks - modeFailures, modeChecks,
+			1e6 * modeSeconds / signals.size());
+		numChecks += modeChecks;
+		numFailures += modeFailures;
+	}
+	std::remove(offlinePath.c_str());
+
+	std::printf("%zu / %zu checks passed\n", numChecks - numFailures, numChecks);
+	return numFailures ? 1 : 0;
+}
@@ -0,0 +1,105 @@
+// Displayed-bin-range spectrum: full real FFT vs. each BinRangeSpectrum method and
+// the one setup() picks. Exits with 1 if the pick is more than kMaxPickSlowdown times slower
+// than the fastest method measured. Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -Iinclude bench/bin_range_bench.cpp src/dsp/*.cpp -o bin_range_bench
+
+#include "dsp/bin_range_spectrum.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 44100;
+	const int kRepetitions = 15;
+	const int kCallsPerRepetition = 5;
+	//! near ties may go either way, anything beyond this means the cost estimates are off
+	const double kMaxPickSlowdown = 1.5;
+
+	//! seconds per computeMagnitudes() call, best of kRepetitions
+	double timeMagnitudes(BinRangeSpectrum& spectrum, const std::vector<float>& input, std::vector<float>& magnitudes)
+	{
+		using clock = std::chrono::steady_clock;
+		double best = 1e30;
+		for (int rep = 0; rep < kRepetitions; rep++)
+		{
+			const auto start = clock::now();
+			for (int call = 0; call < kCallsPerRepetition; call++)
+				spectrum.computeMagnitudes(input.data(), magnitudes.data());
+			best = std::min(best, std::chrono::duration<double>(clock::now() - start).count() / kCallsPerRepetition);
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+	const BinRangeSpectrum::Method methods[] = { BinRangeSpectrum::Method::PRUNED_FFT, BinRangeSpectrum::Method::CHIRP_Z, BinRangeSpectrum::Method::GOERTZEL };
+
+	bool passed = true;
+	std::printf("%8s %8s %8s %8s %10s %10s %10s %10s   %s\n", "fftSize", "win(ms)", "first", "bins",
+		"full(us)", "pruned(us)", "chirpz(us)", "goertz(us)", "picked");
+	for (std::size_t fftSize : { std::size_t(32768), std::size_t(131072) })
+	{
+		for (std::size_t windowMs : { 50, 500 })
+		{
+			const std::size_t windowSize = std::min(fftSize, windowMs * kSampleRate / 1000);
+			std::vector<float> input(windowSize);
+			for (auto& sample : input)
+				sample = noise(rng);
+
+			BinRangeSpectrum full;
+			full.setup(fftSize, windowSize, 0, fftSize / 2, BinRangeSpectrum::Method::PRUNED_FFT);
+			std::vector<float> fullMagnitudes(fftSize / 2);
+			const double fullSeconds = timeMagnitudes(full, input, fullMagnitudes);
+
+			//Ranges from DC like the spectrogram, and narrow bands further up
+			const std::size_t ranges[][2] = { { 0, 4 }, { 0, 64 }, { 0, 512 }, { 0, 1152 }, { 0, 4096 }, { fftSize / 4, 64 }, { fftSize / 4, 1152 } };
+			for (const auto& range : ranges)
+			{
+				std::vector<float> magnitudes(range[1]);
+				double seconds[3];
+				for (int m = 0; m < 3; m++)
+				{
+					//A serial Goertzel over thousands of bins takes forever and never wins, skip it
+					if (methods[m] == BinRangeSpectrum::Method::GOERTZEL && range[1] * windowSize > 4000000)
+					{
+						seconds[m] = 0.0;
+						continue;
+					}
+					BinRangeSpectrum spectrum;
+					spectrum.setup(fftSize, windowSize, range[0], range[1], methods[m]);
+					seconds[m] = timeMagnitudes(spectrum, input, magnitudes);
+				}
+
+				BinRangeSpectrum picked;
+				picked.setup(fftSize, windowSize, range[0], range[1]);
+				//A skipped Goertzel counts as infinitely slow
+				double fastest = 1e30;
+				double pickedSeconds = 1e30;
+				for (int m = 0; m < 3; m++)
+				{
+					if (seconds[m] <= 0.0)
+						continue;
+					fastest = std::min(fastest, seconds[m]);
+					if (methods[m] == picked.getMethod())
+						pickedSeconds = seconds[m];
+				}
+				const bool slow = pickedSeconds > kMaxPickSlowdown * fastest;
+				passed = passed && !slow;
+				std::printf("%8zu %8zu %8zu %8zu %10.1f %10.1f %10.1f %10.1f   %s%s\n", fftSize, windowMs, range[0], range[1],
+					fullSeconds * 1e6, seconds[0] * 1e6, seconds[1] * 1e6, seconds[2] * 1e6,
+					BinRangeSpectrum::getMethodName(picked.getMethod()), slow ? "  TOO SLOW" : "");
+			}
+		}
+	}
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,143 @@
+// Spectrogram row colouring: the per-pixel GetColor / linearToDecibel loop SpectrogramPlot
+// used to run vs. dsp::ColormapLut at each instruction set the CPU supports.
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -Iinclude bench/colormap_bench.cpp src/dsp/*.cpp -o colormap_bench
+
+#include "dsp/colormap.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const int kRepetitions = 15;
+	const int kRowsPerRepetition = 200;
+
+	//! ci::audio::linearToDecibel
+	float linearToDecibel(float gainLinear)
+	{
+		return gainLinear < 1.0e-5f ? 0.0f : 20.0f * std::log10(gainLinear) + 100.0f;
+	}
+
+	//! The jet GetColor from audio_draw.cpp before the colormap moved to the GPU
+	void GetColor(float v, float vmin, float vmax, float* rgb)
+	{
+		rgb[0] = rgb[1] = rgb[2] = 1.0f;
+		float dv;
+
+		if (v < vmin)
+			v = vmin;
+		if (v > vmax)
+			v = vmax;
+		dv = vmax - vmin;
+
+		if (v < (vmin + 0.25f * dv)) {
+			rgb[0] = 0.0f;
+			rgb[1] = 4.0f * (v - vmin) / dv;
+		}
+		else if (v < (vmin + 0.5f * dv)) {
+			rgb[0] = 0.0f;
+			rgb[2] = 1.0f + 4.0f * (vmin + 0.25f * dv - v) / dv;
+		}
+		else if (v < (vmin + 0.75f * dv)) {
+			rgb[0] = 4.0f * (v - vmin - 0.5f * dv) / dv;
+			rgb[2] = 0.0f;
+		}
+		else {
+			rgb[1] = 1.0f + 4.0f * (vmin + 0.75f * dv - v) / dv;
+			rgb[2] = 0.0f;
+		}
+	}
+
+	//! the old writeRow inner loop, RGBA float out like the Surface32f it filled
+	void getColorRow(const float* magnitudes, std::size_t count, float userMaxMag, bool linearDbMode, float* rgba)
+	{
+		for (std::size_t i = 0; i < count; i++)
+		{
+			const float pixelDispMag = linearDbMode ? linearToDecibel(magnitudes[i]) / userMaxMag : userMaxMag * magnitudes[i];
+			GetColor(pixelDispMag, 0.0f, 1.0f, rgba + 4 * i);
+			rgba[4 * i + 3] = 1.0f;
+		}
+	}
+
+	template<typename F>
+	double bestRowSeconds(F&& row)
+	{
+		using clock = std::chrono::steady_clock;
+		double best = 1e30;
+		for (int rep = 0; rep < kRepetitions; rep++)
+		{
+			const auto start = clock::now();
+			for (int r = 0; r < kRowsPerRepetition; r++)
+				row();
+			best = std::min(best, std::chrono::duration<double>(clock::now() - start).count() / kRowsPerRepetition);
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	//Magnitudes spread over 0..-120 dB re full scale, like a real spectrum
+	std::uniform_real_distribution<float> exponent(-6.0f, 0.0f);
+
+	std::vector<SimdLevel> levels = { SimdLevel::SCALAR };
+	if (getSupportedSimdLevel() >= SimdLevel::SSE2)
+		levels.push_back(SimdLevel::SSE2);
+	if (getSupportedSimdLevel() >= SimdLevel::AVX2)
+		levels.push_back(SimdLevel::AVX2);
+
+	std::printf("%8s %6s %14s", "width", "mode", "GetColor(us)");
+	for (SimdLevel level : levels)
+		std::printf(" %10s(us)", getSimdLevelName(level));
+	std::printf(" %8s %14s\n", "speedup", "max diff (/255)");
+
+	for (std::size_t width : { std::size_t(1024), std::size_t(1920), std::size_t(4096) })
+	{
+		std::vector<float> magnitudes(width);
+		for (auto& m : magnitudes)
+			m = std::pow(10.0f, exponent(rng));
+
+		for (bool dbMode : { false, true })
+		{
+			const float maxMag = dbMode ? 65.0f : 20.0f;
+
+			std::vector<float> reference(4 * width);
+			const double referenceSeconds = bestRowSeconds([&] { getColorRow(magnitudes.data(), width, maxMag, dbMode, reference.data()); });
+
+			std::printf("%8zu %6s %14.2f", width, dbMode ? "dB" : "linear", referenceSeconds * 1e6);
+
+			ColormapLut lut;
+			std::vector<std::uint32_t> rgba(width);
+			double bestSeconds = 1e30;
+			int maxDiff = 0;
+			for (SimdLevel level : levels)
+			{
+				lut.setSimdLevel(level);
+				const double seconds = bestRowSeconds([&] { lut.mapRow(magnitudes.data(), width, maxMag, dbMode, rgba.data()); });
+				bestSeconds = std::min(bestSeconds, seconds);
+				std::printf(" %14.2f", seconds * 1e6);
+
+				for (std::size_t i = 0; i < width; i++)
+				{
+					for (int c = 0; c < 3; c++)
+					{
+						const int expected = static_cast<int>(reference[4 * i + c] * 255.0f + 0.5f);
+						const int actual = static_cast<int>((rgba[i] >> (8 * c)) & 0xff);
+						maxDiff = std::max(maxDiff, std::abs(expected - actual));
+					}
+				}
+			}
+			std::printf(" %7.1fx %14d\n", referenceSeconds / bestSeconds, maxDiff);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,71 @@
+// Input-pruned vs. full real FFT over the app's "Window Size (ms)" range.
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -Iinclude bench/fft_prune_bench.cpp src/dsp/*.cpp -o fft_prune_bench
+
+#include "dsp/real_fft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 44100;
+	const int kRepetitions = 25;
+	const int kCallsPerRepetition = 10;
+
+	double timeCalls(RealFft& fft, const std::vector<float>& input, std::size_t numNonZero, std::vector<Complex>& spectrum)
+	{
+		using clock = std::chrono::steady_clock;
+		const auto start = clock::now();
+		for (int call = 0; call < kCallsPerRepetition; call++)
+			fft.forward(input.data(), numNonZero, spectrum.data());
+		return std::chrono::duration<double>(clock::now() - start).count() / kCallsPerRepetition;
+	}
+}
+
+int main()
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+
+	std::printf("%8s %8s %10s %12s %12s %8s %10s\n", "fftSize", "win(ms)", "win(smp)", "full(us)", "pruned(us)", "speedup", "max err");
+	for (std::size_t fftSize : { std::size_t(32768), std::size_t(131072) })
+	{
+		RealFft fft(fftSize);
+		std::vector<float> input(fftSize, 0.0f);
+		std::vector<Complex> full(fftSize / 2);
+		std::vector<Complex> pruned(fftSize / 2);
+
+		for (std::size_t windowMs : { 10, 20, 50, 100, 200, 300, 400, 500 })
+		{
+			const std::size_t windowSize = std::min(fftSize, windowMs * kSampleRate / 1000);
+			std::fill(input.begin(), input.end(), 0.0f);
+			for (std::size_t i = 0; i < windowSize; i++)
+				input[i] = noise(rng);
+
+			//numNonZero == fftSize forces the unpruned transform over the zero padding
+			//Interleaved and best of kRepetitions, so scheduler noise and clock drift hit both alike
+			double fullSeconds = 1e30;
+			double prunedSeconds = 1e30;
+			for (int rep = 0; rep < kRepetitions; rep++)
+			{
+				fullSeconds = std::min(fullSeconds, timeCalls(fft, input, fftSize, full));
+				prunedSeconds = std::min(prunedSeconds, timeCalls(fft, input, windowSize, pruned));
+			}
+
+			float maxError = 0.0f;
+			for (std::size_t k = 0; k < full.size(); k++)
+				maxError = std::max(maxError, std::abs(full[k] - pruned[k]));
+
+			std::printf("%8zu %8zu %10zu %12.1f %12.1f %7.2fx %10.2e\n", fftSize, windowMs, windowSize,
+				fullSeconds * 1e6, prunedSeconds * 1e6, fullSeconds / prunedSeconds, maxError);
+		}
+	}
+	return 0;
+}
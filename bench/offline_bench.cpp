@@ -0,0 +1,130 @@
+// Offline analysis throughput: a synthetic 16 bit stereo WAV run through OfflineStft
+// with 1..N worker threads, reported as multiples of real time. Headless:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/offline_bench.cpp src/dsp/*.cpp -o offline_bench
+// Pass a WAV / AIFF path to measure that file instead.
+
+#include "dsp/audio_file.h"
+#include "dsp/offline_stft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 44100;
+	const std::size_t kSeconds = 60;
+	const int kRepetitions = 3;
+
+	void put(std::string& out, std::uint32_t value, int bytes)
+	{
+		for (int i = 0; i < bytes; i++)
+			out += static_cast<char>((value >> (8 * i)) & 0xff);
+	}
+
+	//! a tone sweep plus noise, 16 bit stereo
+	bool writeTestWav(const std::string& path)
+	{
+		std::mt19937 rng(1);
+		std::uniform_real_distribution<float> noise(-0.05f, 0.05f);
+		const std::uint32_t numFrames = static_cast<std::uint32_t>(kSeconds * kSampleRate);
+
+		std::string wav = "RIFF";
+		put(wav, 36 + numFrames * 4, 4);
+		wav += "WAVEfmt ";
+		put(wav, 16, 4);
+		put(wav, 1, 2);
+		put(wav, 2, 2);
+		put(wav, kSampleRate, 4);
+		put(wav, kSampleRate * 4, 4);
+		put(wav, 4, 2);
+		put(wav, 16, 2);
+		wav += "data";
+		put(wav, numFrames * 4, 4);
+		double phase = 0.0;
+		for (std::uint32_t i = 0; i < numFrames; i++)
+		{
+			phase += 6.283185307179586 * (200.0 + 1800.0 * i / numFrames) / kSampleRate;
+			const float left = 0.5f * static_cast<float>(std::sin(phase)) + noise(rng);
+			const float right = noise(rng);
+			put(wav, static_cast<std::uint16_t>(static_cast<std::int16_t>(left * 32767.0f)), 2);
+			put(wav, static_cast<std::uint16_t>(static_cast<std::int16_t>(right * 32767.0f)), 2);
+		}
+
+		FILE* file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		const bool ok = std::fwrite(wav.data(), 1, wav.size(), file) == wav.size();
+		std::fclose(file);
+		return ok;
+	}
+
+	//! seconds for the whole file, best of kRepetitions
+	double timeAnalysis(OfflineStft& stft, const AudioFile& file, std::vector<float>& magnitudes)
+	{
+		using clock = std::chrono::steady_clock;
+		const std::size_t numFrames = stft.getNumFrames(file.getNumFrames());
+		magnitudes.resize(numFrames * stft.getNumOutputBins());
+		double best = 1e30;
+		for (int rep = 0; rep < kRepetitions; rep++)
+		{
+			const auto start = clock::now();
+			stft.analyze(file, 0, numFrames, magnitudes.data());
+			best = std::min(best, std::chrono::duration<double>(clock::now() - start).count());
+		}
+		return best;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string path = "offline_bench.wav";
+	if (argc > 1)
+		path = argv[1];
+	else if (!writeTestWav(path))
+	{
+		std::printf("can't write %s\n", path.c_str());
+		return 1;
+	}
+
+	AudioFile file;
+	if (!file.open(path))
+	{
+		std::printf("%s\n", file.getError().c_str());
+		return 1;
+	}
+	std::printf("%s: %zu Hz, %zu ch, %.1f s\n", path.c_str(), file.getSampleRate(), file.getNumChannels(), file.getDurationSeconds());
+
+	//The app's defaults: 500 ms window, 20 Hz hop, 2 kHz shown of a 131072 point FFT
+	const std::size_t windowSize = file.getSampleRate() / 2;
+	const std::size_t hopSize = file.getSampleRate() / 20;
+	const std::size_t fftSize = 131072;
+	const std::size_t displayedBins = fftSize * 2000 / file.getSampleRate();
+
+	const std::size_t maxThreads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	std::vector<float> magnitudes;
+	std::printf("%10s %8s %12s %12s\n", "mode", "threads", "time(s)", "x realtime");
+	for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		OfflineStft stft;
+		stft.setNumThreads(threads);
+		stft.setup(fftSize, windowSize, hopSize, file.getSampleRate());
+		stft.setBinRange(0, displayedBins);
+		const double seconds = timeAnalysis(stft, file, magnitudes);
+		std::printf("%10s %8zu %12.3f %12.1f\n", "full-band", threads, seconds, file.getDurationSeconds() / seconds);
+	}
+
+	OfflineStft zoom;
+	zoom.setup(fftSize, windowSize, hopSize, file.getSampleRate(), 2000.0f);
+	const double zoomSeconds = timeAnalysis(zoom, file, magnitudes);
+	std::printf("%10s %8d %12.3f %12.1f\n", "zoom", 1, zoomSeconds, file.getDurationSeconds() / zoomSeconds);
+	return 0;
+}
@@ -0,0 +1,183 @@
+// Spectrogram playback: records an hour of 20 Hz frames, then plays it back through
+// dsp::SpectrogramPlayer the way the app does. Reports what a jump to a random time costs
+// with a full 20 s spectrogram of history (cold), what a mouse drag costs frame to frame,
+// and what real time playback costs per frame. Frames must come out in order, with the
+// newest one at the playhead after every seek.
+// Exits with 1 if the recording can't be played or a frame comes out wrong.
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/playback_bench.cpp src/dsp/*.cpp -o playback_bench
+
+#include "dsp/spectrogram_player.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const double kHopRate = 20.0;
+	const std::size_t kNumFrames = 72000;
+	const std::size_t kNumBins = 1486;
+	// what the app keeps on screen, 20 s at the hop rate
+	const std::size_t kNumHistory = 400;
+	const std::size_t kNumJumps = 200;
+	// a drag across the timeline, one seek per rendered frame
+	const std::size_t kNumDragSteps = 600;
+	const char* const kPath = "playback_bench.cspec";
+
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	bool record()
+	{
+		RecordingFormat format;
+		format.mBits = 8;
+		SpectrogramRecorder recorder;
+		if (!recorder.open(kPath, format))
+		{
+			std::printf("%s\n", recorder.getError().c_str());
+			return false;
+		}
+
+		RecordingGeometry geometry;
+		geometry.mSampleRate = 44100;
+		geometry.mFftSize = 32768;
+		geometry.mNumBins = kNumBins;
+
+		//A drifting tone over a noise floor, enough structure for the delta filter to work on
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> noise(1.0e-4f, 1.0e-3f);
+		std::vector<float> frame(kNumBins);
+		for (std::size_t f = 0; f < kNumFrames; f++)
+		{
+			for (float& value : frame)
+				value = noise(random);
+			frame[(f / 4) % kNumBins] = 0.5f;
+			while (!recorder.push(f / kHopRate, geometry, frame.data()))
+				;
+		}
+		if (!recorder.close())
+		{
+			std::printf("%s\n", recorder.getError().c_str());
+			return false;
+		}
+		return true;
+	}
+
+	// \brief pops everything due, checking order. Returns the number of frames or -1 on a bad frame.
+	long drain(SpectrogramPlayer& player, PlayedFrame& frame)
+	{
+		long count = 0;
+		double previous = -1.0;
+		while (player.popFrame(frame))
+		{
+			if (frame.mTime <= previous || frame.mTime > player.getPosition() || frame.mMagnitudes.size() != kNumBins)
+				return -1;
+			previous = frame.mTime;
+			count++;
+		}
+		//The newest frame popped is the one at the playhead
+		if (count && std::fabs(frame.mTime - std::floor(player.getPosition() * kHopRate) / kHopRate) > 1.0e-9)
+			return -1;
+		return count;
+	}
+}
+
+int main()
+{
+	if (!record())
+		return 1;
+
+	SpectrogramPlayer player;
+	double start = now();
+	if (!player.open(kPath))
+	{
+		std::printf("%s\n", player.getError().c_str());
+		return 1;
+	}
+	std::printf("%zu frames of %zu bins, %.0f s at %.1f Hz, open %.2f ms\n", kNumFrames, kNumBins,
+		player.getEndTime() - player.getStartTime(), player.getFrameRate(), 1000.0 * (now() - start));
+
+	bool passed = true;
+	PlayedFrame frame;
+
+	//Jumps anywhere in the hour, every one fills a whole spectrogram
+	std::mt19937 random(5);
+	std::uniform_real_distribution<double> position(kNumHistory / kHopRate, kNumFrames / kHopRate);
+	double jumpTotal = 0.0;
+	double jumpMax = 0.0;
+	for (std::size_t j = 0; j < kNumJumps; j++)
+	{
+		const double before = now();
+		player.seek(position(random), kNumHistory);
+		const long count = drain(player, frame);
+		const double elapsed = now() - before;
+		jumpTotal += elapsed;
+		jumpMax = std::max(jumpMax, elapsed);
+		//A jump less than the history ahead only pops the frames in between
+		if (count <= 0 || count > static_cast<long>(kNumHistory))
+		{
+			std::printf("jump %zu: %ld frames\n", j, count);
+			passed = false;
+		}
+	}
+	std::printf("jump  %6.2f ms (max %6.2f) for %zu rows of history\n", 1000.0 * jumpTotal / kNumJumps, 1000.0 * jumpMax, kNumHistory);
+
+	//A drag back and forth over two minutes, up to a second per rendered frame
+	const std::uint64_t missesBefore = player.getNumCacheMisses();
+	double dragTotal = 0.0;
+	double dragMax = 0.0;
+	const double dragStart = 1800.0;
+	for (std::size_t s = 0; s < kNumDragSteps; s++)
+	{
+		const double phase = static_cast<double>(s) / kNumDragSteps;
+		const double before = now();
+		player.seek(dragStart + 60.0 * std::sin(6.2831853 * 2.0 * phase), kNumHistory);
+		const long count = drain(player, frame);
+		const double elapsed = now() - before;
+		dragTotal += elapsed;
+		dragMax = std::max(dragMax, elapsed);
+		if (count < 0)
+		{
+			std::printf("drag step %zu: bad frame\n", s);
+			passed = false;
+		}
+	}
+	std::printf("drag  %6.2f ms (max %6.2f) per step, %llu chunks decoded over %zu steps\n", 1000.0 * dragTotal / kNumDragSteps,
+		1000.0 * dragMax, static_cast<unsigned long long>(player.getNumCacheMisses() - missesBefore), kNumDragSteps);
+
+	//Real time playback, one 60 Hz render frame at a time
+	player.seek(600.0, kNumHistory);
+	drain(player, frame);
+	player.setPlaying(true);
+	double playTotal = 0.0;
+	std::size_t played = 0;
+	for (std::size_t r = 0; r < 60 * 60; r++)
+	{
+		const double before = now();
+		player.advance(1.0 / 60.0);
+		const long count = drain(player, frame);
+		playTotal += now() - before;
+		if (count < 0)
+		{
+			std::printf("playback frame %zu: bad frame\n", r);
+			passed = false;
+			break;
+		}
+		played += static_cast<std::size_t>(count);
+	}
+	std::printf("play  %6.2f us per frame, %zu frames in 60 s\n", 1.0e6 * playTotal / std::max<std::size_t>(played, 1), played);
+	if (played < 1199 || played > 1201)
+		passed = false;
+
+	player.close();
+	std::remove(kPath);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,174 @@
+// Spectrogram history pyramid: two hours of 20 Hz rows of 1486 bins appended to a
+// dsp::SpectrogramPyramid with a 64 MB memory budget, as fast as it takes them. Then more rows
+// paced at 1 kHz to time append() on its own (what the render thread pays per row, the flood
+// mostly measures the kernel throttling the spill writes). Reports the memory in use against
+// the budget, how much went to disk and what a 1200 row view costs at zoom levels from 20 s
+// to the whole history, at the newest rows and at random older ones (tiles read back from
+// disk). Pooled rows are checked against max pooling computed from scratch.
+// Exits with 1 if a read fails, a pooled value is off or memory exceeds the budget plus the
+// one tile row per level that is being written (those can't be spilled).
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/pyramid_bench.cpp src/dsp/*.cpp -o pyramid_bench
+
+#include "dsp/spectrogram_pyramid.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const double kHopRate = 20.0;
+	const std::size_t kNumRows = 144000;
+	const std::size_t kNumBins = 1486;
+	const std::size_t kBudget = std::size_t(64) << 20;
+	// what the plot's ring holds at most
+	const std::size_t kViewRows = 1200;
+	const std::size_t kNumViewReads = 20;
+	const std::size_t kNumChecks = 10;
+	const std::size_t kNumPacedRows = 2000;
+	const double kPacedRate = 1000.0;
+
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//Reproducible magnitude of any row and bin, a noise floor with a slow sweep through it
+	float magnitude(std::size_t row, std::size_t bin)
+	{
+		std::uint32_t hash = static_cast<std::uint32_t>(row * 2654435761u) ^ static_cast<std::uint32_t>(bin * 40503u);
+		hash ^= hash >> 15;
+		hash *= 2246822519u;
+		hash ^= hash >> 13;
+		const float noise = 1.0e-3f * static_cast<float>(hash & 0xffff) / 65535.0f;
+		return bin == (row / 8) % kNumBins ? 0.5f : noise;
+	}
+
+	bool check(SpectrogramPyramid& pyramid, std::size_t level, std::mt19937& random)
+	{
+		const std::size_t pooling = pyramid.getBinPooling(level);
+		const std::size_t span = std::size_t(1) << level;
+		const std::size_t numBins = pyramid.getNumBins(level);
+		std::uniform_int_distribution<std::uint64_t> position(0, pyramid.getNumRows(level) - 1);
+		std::vector<float> row(numBins);
+		for (std::size_t c = 0; c < kNumChecks; c++)
+		{
+			const std::uint64_t r = position(random);
+			if (!pyramid.readRows(level, r, 1, row.data()))
+				return false;
+			for (std::size_t b = 0; b < numBins; b++)
+			{
+				float expected = 0.0f;
+				for (std::size_t t = r * span; t < (r + 1) * span; t++)
+				{
+					for (std::size_t k = b * pooling; k < std::min((b + 1) * pooling, kNumBins); k++)
+						expected = std::max(expected, magnitude(t, k));
+				}
+				if (row[b] != expected)
+				{
+					std::printf("level %zu row %llu bin %zu: %g instead of %g\n", level, static_cast<unsigned long long>(r), b, row[b], expected);
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+}
+
+int main()
+{
+	PyramidSettings settings;
+	settings.mMemoryBudget = kBudget;
+	SpectrogramPyramid pyramid;
+	if (!pyramid.setup(kNumBins, settings))
+	{
+		std::printf("%s\n", pyramid.getError().c_str());
+		return 1;
+	}
+
+	bool passed = true;
+	std::vector<float> row(kNumBins);
+	double appendTotal = 0.0;
+	double appendMax = 0.0;
+	std::size_t residentMax = 0;
+	double floodSeconds = 0.0;
+	for (std::size_t r = 0; r < kNumRows + kNumPacedRows; r++)
+	{
+		for (std::size_t b = 0; b < kNumBins; b++)
+			row[b] = magnitude(r, b);
+		if (r >= kNumRows)
+			std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int>(1.0e6 / kPacedRate)));
+
+		const double before = now();
+		pyramid.append(row.data());
+		const double elapsed = now() - before;
+		if (r < kNumRows)
+		{
+			floodSeconds += elapsed;
+		}
+		else
+		{
+			appendTotal += elapsed;
+			appendMax = std::max(appendMax, elapsed);
+		}
+		residentMax = std::max(residentMax, pyramid.getResidentBytes());
+	}
+	//Outside the budget: the tiles being written, one tile row per level, at most a full tile each
+	std::size_t numWriting = 0;
+	for (std::size_t l = 0; l < pyramid.getNumLevels(); l++)
+		numWriting += (pyramid.getNumBins(l) + settings.mTileBins - 1) / settings.mTileBins;
+	const std::size_t residentLimit = kBudget + numWriting * settings.mTileRows * settings.mTileBins * sizeof(float);
+
+	const std::size_t numRows = kNumRows + kNumPacedRows;
+	std::printf("%zu rows of %zu bins, %.0f min at %.0f Hz, %zu levels\n", numRows, kNumBins, numRows / kHopRate / 60.0, kHopRate, pyramid.getNumLevels());
+	std::printf("append %5.2f us (max %6.1f)  flood %6.0fx real time  memory %5.1f MB peak of %zu MB budget (limit %5.1f MB)  spilled %6.1f MB\n",
+		1.0e6 * appendTotal / kNumPacedRows, 1.0e6 * appendMax, (kNumRows / kHopRate) / floodSeconds,
+		residentMax / 1.0e6, kBudget >> 20, residentLimit / 1.0e6, pyramid.getSpilledBytes() / 1.0e6);
+	if (residentMax > residentLimit)
+		passed = false;
+
+	//Views from 20 s to the whole history, each from the first level that fits kViewRows rows
+	std::mt19937 random(9);
+	std::vector<float> view;
+	for (double seconds : { 20.0, 300.0, 1800.0, 7200.0 })
+	{
+		const std::size_t rows = static_cast<std::size_t>(seconds * kHopRate);
+		std::size_t level = 0;
+		while ((rows >> level) > kViewRows && level + 1 < pyramid.getNumLevels())
+			level++;
+		const std::size_t viewRows = std::min<std::uint64_t>(rows >> level, pyramid.getNumRows(level));
+		view.resize(viewRows * pyramid.getNumBins(level));
+
+		const double newestStart = now();
+		passed = pyramid.readRows(level, pyramid.getNumRows(level) - viewRows, viewRows, view.data()) && passed;
+		const double newest = now() - newestStart;
+
+		std::uniform_int_distribution<std::uint64_t> position(0, pyramid.getNumRows(level) - viewRows);
+		const std::uint64_t loadsBefore = pyramid.getNumTileLoads();
+		double olderTotal = 0.0;
+		for (std::size_t v = 0; v < kNumViewReads; v++)
+		{
+			const double before = now();
+			passed = pyramid.readRows(level, position(random), viewRows, view.data()) && passed;
+			olderTotal += now() - before;
+		}
+		std::printf("view %5.0f s  level %2zu  %4zu rows x %4zu bins  newest %6.2f ms  older %6.2f ms (%4.1f tiles from disk)\n",
+			seconds, level, viewRows, pyramid.getNumBins(level), 1000.0 * newest, 1000.0 * olderTotal / kNumViewReads,
+			static_cast<double>(pyramid.getNumTileLoads() - loadsBefore) / kNumViewReads);
+	}
+	if (pyramid.getResidentBytes() > residentLimit)
+		passed = false;
+
+	for (std::size_t level : { 0, 1, 4, 8 })
+		passed = check(pyramid, level, random) && passed;
+
+	if (!passed)
+		std::printf("FAILED %s\n", pyramid.getError().c_str());
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+// Spectrogram recording: an hour of 20 Hz frames streamed through dsp::SpectrogramRecorder at
+// 8 / 16 bit, raw and LZ4, then read back at random times through the index. Reports the
+// cost of push() (what the render thread pays), how much faster than real time the writer runs,
+// file size, read latency for a one second range and the round trip error in dB.
+// Exits with 1 if a recording can't be read back or the error exceeds half a code step.
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/recording_bench.cpp src/dsp/*.cpp -o recording_bench
+
+#include "dsp/spectrogram_recording.h"
+#include "dsp/signal_generator.h"
+#include "dsp/streaming_stft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 44100;
+	const double kHopRate = 20.0;
+	const std::size_t kNumFrames = 72000;
+	const std::size_t kNumDistinctFrames = 400;
+	const std::size_t kNumReads = 200;
+	//the first frames are pushed at kPacedRate to time push() on its own
+	const std::size_t kNumPacedFrames = 2000;
+	const double kPacedRate = 1000.0;
+	const char* const kPath = "recording_bench.cspec";
+
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	float toDecibels(float magnitude)
+	{
+		return 20.0f * std::log10(std::max(magnitude, 1.0e-5f)) + 100.0f;
+	}
+
+	//A sweep over a tone pair and noise through the live STFT, as the app would deliver it
+	std::vector<std::vector<float>> makeFrames(RecordingGeometry& geometry)
+	{
+		GeneratorSettings settings;
+		settings.mType = GeneratorType::SWEEP;
+		settings.mSweepStart = 100.0f;
+		settings.mSweepEnd = 1900.0f;
+		settings.mSweepSeconds = 10.0;
+		SignalGenerator generator;
+		generator.setup(settings);
+
+		StreamingStft stft;
+		stft.setup(32768, kSampleRate / 20, static_cast<std::size_t>(kSampleRate / kHopRate), kSampleRate);
+		stft.setBinRange(0, 32768 * 2000 / kSampleRate);
+		geometry.mSampleRate = kSampleRate;
+		geometry.mFftSize = static_cast<std::uint32_t>(stft.getFftSize());
+		geometry.mFirstBin = 0;
+		geometry.mNumBins = static_cast<std::uint32_t>(stft.getNumOutputBins());
+
+		std::mt19937 random(7);
+		std::normal_distribution<float> noise(0.0f, 0.01f);
+		std::vector<std::vector<float>> frames;
+		std::vector<float> block(512);
+		while (frames.size() < kNumDistinctFrames)
+		{
+			generator.render(block.data(), block.size());
+			for (float& sample : block)
+				sample += noise(random);
+			std::size_t written = 0;
+			while (written < block.size())
+			{
+				written += stft.write(block.data() + written, block.size() - written);
+				if (stft.isFrameReady())
+				{
+					frames.emplace_back(geometry.mNumBins);
+					stft.computeFrame(frames.back().data());
+				}
+			}
+		}
+		return frames;
+	}
+
+	bool run(const std::vector<std::vector<float>>& frames, const RecordingGeometry& geometry, std::size_t bits, bool compress)
+	{
+		RecordingFormat format;
+		format.mBits = bits;
+		format.mCompress = compress;
+		SpectrogramRecorder recorder;
+		if (!recorder.open(kPath, format))
+		{
+			std::printf("%s\n", recorder.getError().c_str());
+			return false;
+		}
+
+		//push() cost is measured paced like a (fast) producer would call it, the writer's
+		//throughput after that with frames pushed as fast as it takes them
+		double pushTotal = 0.0;
+		double pushMax = 0.0;
+		std::size_t retries = 0;
+		double start = now();
+		for (std::size_t f = 0; f < kNumFrames; f++)
+		{
+			if (f == kNumPacedFrames)
+				start = now();
+			else if (f < kNumPacedFrames)
+				std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int>(1.0e6 / kPacedRate)));
+
+			for (;;)
+			{
+				const double before = now();
+				const bool queued = recorder.push(f / kHopRate, geometry, frames[f % frames.size()].data());
+				const double elapsed = now() - before;
+				if (f < kNumPacedFrames)
+				{
+					pushTotal += elapsed;
+					pushMax = std::max(pushMax, elapsed);
+				}
+				if (queued)
+					break;
+				retries++;
+				std::this_thread::yield();
+			}
+		}
+		if (!recorder.close())
+		{
+			std::printf("%s\n", recorder.getError().c_str());
+			return false;
+		}
+		const double writeSeconds = now() - start;
+		const double bytes = static_cast<double>(recorder.getNumBytesWritten());
+
+		SpectrogramRecording recording;
+		double openStart = now();
+		if (!recording.open(kPath) || recording.getNumFrames() != kNumFrames)
+		{
+			std::printf("can't read back: %s\n", recording.getError().c_str());
+			return false;
+		}
+		const double openSeconds = now() - openStart;
+
+		//One second anywhere in the hour, through the index
+		std::mt19937 random(3);
+		std::uniform_real_distribution<double> position(0.0, kNumFrames / kHopRate - 1.0);
+		std::vector<RecordedFrame> read;
+		double readTotal = 0.0;
+		float maxError = 0.0f;
+		const float halfStep = 0.5f * (format.mMaxDb - format.mMinDb) / static_cast<float>((1 << bits) - 1);
+		for (std::size_t r = 0; r < kNumReads; r++)
+		{
+			const double begin = position(random);
+			read.clear();
+			const double before = now();
+			if (!recording.readRange(begin, begin + 1.0, read) || read.size() != static_cast<std::size_t>(kHopRate))
+			{
+				std::printf("range at %.2f s: %zu frames, %s\n", begin, read.size(), recording.getError().c_str());
+				return false;
+			}
+			readTotal += now() - before;
+
+			for (const RecordedFrame& frame : read)
+			{
+				const std::vector<float>& original = frames[static_cast<std::size_t>(frame.mTime * kHopRate + 0.5) % frames.size()];
+				for (std::size_t i = 0; i < original.size(); i++)
+				{
+					const float decibels = std::min(toDecibels(original[i]), format.mMaxDb);
+					maxError = std::max(maxError, std::fabs(decibels - toDecibels(frame.mMagnitudes[i])));
+				}
+			}
+		}
+
+		const double floatBytes = static_cast<double>(kNumFrames) * geometry.mNumBins * sizeof(float);
+		std::printf("%2zu bit %-4s  push %5.2f us (max %6.1f)  writer %6.0fx real time  %7.1f MB/h (%4.1f%% of float)  open %5.2f ms  1 s read %5.2f ms  error %.4f dB%s\n",
+			bits, compress ? "lz4" : "raw", 1.0e6 * pushTotal / kNumPacedFrames, 1.0e6 * pushMax,
+			((kNumFrames - kNumPacedFrames) / kHopRate) / writeSeconds, bytes / 1.0e6, 100.0 * bytes / floatBytes,
+			1000.0 * openSeconds, 1000.0 * readTotal / kNumReads, maxError, retries ? " (queue full at full speed)" : "");
+		return maxError <= halfStep * 1.01f;
+	}
+}
+
+int main()
+{
+	RecordingGeometry geometry;
+	const std::vector<std::vector<float>> frames = makeFrames(geometry);
+	std::printf("%zu frames of %u bins, %.0f s at %.0f Hz\n", kNumFrames, geometry.mNumBins, kNumFrames / kHopRate, kHopRate);
+
+	bool passed = true;
+	for (std::size_t bits : { 8, 16 })
+	{
+		for (bool compress : { false, true })
+			passed = run(frames, geometry, bits, compress) && passed;
+	}
+	std::remove(kPath);
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+// Retroactive region analysis: a writer thread streams two tones 3 Hz apart, gated on and off
+// every second, into a two minute dsp::PcmHistory at ten times real time. Meanwhile
+// regions of the past are re-analysed through dsp::RegionAnalyzer with a 1 s window and a
+// 10 ms hop, fine enough to split the tones that the live 100 ms window shows as one.
+// Reports what write() costs the writer (it must never wait on the readers), how long a
+// region takes and whether regions at the overwritten edge fail cleanly instead of
+// returning garbage. Every result is checked for the gating (time alignment) and the
+// dip between the tones (frequency resolution).
+// Exits with 1 if a region comes out wrong or an edge region doesn't fail.
+// Headless, only needs the dsp sources:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/region_bench.cpp src/dsp/*.cpp -o region_bench
+
+#include "dsp/pcm_history.h"
+#include "dsp/region_analysis.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 48000;
+	const std::size_t kHistorySeconds = 120;
+	const std::size_t kBlockSize = 512;
+	const double kSpeedup = 10.0;
+	const double kToneA = 1000.0;
+	const double kToneB = 1003.0;
+	// the tones are on for the first half of every gating period
+	const std::size_t kGatePeriod = 2 * kSampleRate;
+	const std::size_t kNumRegions = 5;
+
+	double now()
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	float sample(std::uint64_t index)
+	{
+		if (index % kGatePeriod >= kGatePeriod / 2)
+			return 0.0f;
+		const double t = static_cast<double>(index) / kSampleRate;
+		return static_cast<float>(0.5 * std::sin(6.283185307179586 * kToneA * t) + 0.5 * std::sin(6.283185307179586 * kToneB * t));
+	}
+
+	float magnitudeAt(const RegionResult& result, std::size_t row, double freq)
+	{
+		const double binHz = static_cast<double>(kSampleRate) / result.mFftSize;
+		const std::size_t bin = static_cast<std::size_t>(std::floor(freq / binHz + 0.5)) - result.mFirstBin;
+		return result.mMagnitudes[row * result.mNumBins + bin];
+	}
+
+	// \brief rows centred well inside an "on" half show both tones with a dip between, rows
+	// well inside an "off" half show nothing
+	bool check(const RegionResult& result)
+	{
+		const RegionRequest& request = result.mRequest;
+		std::size_t numOn = 0;
+		std::size_t numOff = 0;
+		for (std::size_t r = 0; r < result.mNumRows; r++)
+		{
+			const std::uint64_t centre = request.mFirstSample + r * request.mHopSize;
+			const std::uint64_t phase = centre % kGatePeriod;
+			const float a = magnitudeAt(result, r, kToneA);
+			const float b = magnitudeAt(result, r, kToneB);
+			const float middle = magnitudeAt(result, r, 0.5 * (kToneA + kToneB));
+			//A 1 s window only sits entirely in a 1 s half when centred on it
+			if (phase == kGatePeriod / 4)
+			{
+				numOn++;
+				if (a <= 2.0f * middle || b <= 2.0f * middle)
+				{
+					std::printf("row %zu: tones %g %g not split (%g between)\n", r, a, b, middle);
+					return false;
+				}
+			}
+			else if (phase == 3 * kGatePeriod / 4)
+			{
+				numOff++;
+				if (std::max(a, b) * 10.0f > magnitudeAt(result, r - kGatePeriod / 2 / request.mHopSize, kToneA))
+				{
+					std::printf("row %zu: %g in a silent half\n", r, std::max(a, b));
+					return false;
+				}
+			}
+		}
+		return numOn > 0 && numOff > 0;
+	}
+}
+
+int main()
+{
+	PcmHistory history;
+	history.setup(kHistorySeconds * kSampleRate);
+
+	//The writer, ten times faster than a sound card would deliver
+	std::atomic<bool> running(true);
+	std::atomic<double> writeMax(0.0);
+	std::atomic<std::uint64_t> numWrites(0);
+	double writeTotal = 0.0;
+	std::thread writer([&] {
+		std::vector<float> block(kBlockSize);
+		std::uint64_t index = 0;
+		const double start = now();
+		double total = 0.0;
+		while (running)
+		{
+			for (std::size_t i = 0; i < kBlockSize; i++)
+				block[i] = sample(index + i);
+			const double before = now();
+			history.write(block.data(), kBlockSize);
+			const double elapsed = now() - before;
+			total += elapsed;
+			if (elapsed > writeMax.load())
+				writeMax = elapsed;
+			index += kBlockSize;
+			numWrites++;
+
+			const double due = start + static_cast<double>(index) / kSampleRate / kSpeedup;
+			const double wait = due - now();
+			if (wait > 0.0)
+				std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+		}
+		writeTotal = total;
+	});
+
+	//Fill most of the history first, 100 s of stream in 10 s
+	while (history.getEnd() < 100 * kSampleRate)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	bool passed = true;
+	RegionAnalyzer analyzer;
+	RegionRequest request;
+	request.mMinFreq = 950.0f;
+	request.mMaxFreq = 1050.0f;
+	request.mSampleRate = kSampleRate;
+	request.mFftSize = 65536;
+	request.mWindowSize = kSampleRate;
+	request.mHopSize = kSampleRate / 100;
+
+	//Four seconds that are a few seconds old, well clear of the overwritten edge
+	double regionTotal = 0.0;
+	std::size_t numRows = 0;
+	std::size_t numBins = 0;
+	for (std::size_t r = 0; r < kNumRegions; r++)
+	{
+		const std::uint64_t end = history.getEnd();
+		request.mFirstSample = (end - 10 * kSampleRate) / kGatePeriod * kGatePeriod;
+		request.mLastSample = request.mFirstSample + 4 * kSampleRate;
+
+		const double before = now();
+		const std::uint32_t id = analyzer.analyze(history, request);
+		RegionResult result;
+		while (!analyzer.popResult(result))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		regionTotal += now() - before;
+
+		if (result.mId != id || !result.mError.empty() || !check(result))
+		{
+			std::printf("region %zu failed: %s\n", r, result.mError.c_str());
+			passed = false;
+		}
+		numRows = result.mNumRows;
+		numBins = result.mNumBins;
+	}
+	std::printf("region  %zu rows x %zu bins (1 s window, 10 ms hop)  %7.1f ms each, alongside the writer\n",
+		numRows, numBins, 1000.0 * regionTotal / kNumRegions);
+
+	//At the oldest edge the writer overwrites the region while it's read
+	std::size_t numFailed = 0;
+	for (std::size_t r = 0; r < kNumRegions; r++)
+	{
+		request.mFirstSample = history.getBegin() + request.mWindowSize / 2;
+		request.mLastSample = request.mFirstSample + 4 * kSampleRate;
+		analyzer.analyze(history, request);
+		RegionResult result;
+		while (!analyzer.popResult(result))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		if (!result.mError.empty())
+			numFailed++;
+		else if (!check(result))
+			passed = false;
+	}
+	std::printf("edge    %zu of %zu regions at the overwritten edge failed cleanly\n", numFailed, kNumRegions);
+	if (numFailed == 0)
+		passed = false;
+
+	//A request replaced right away never shows up
+	request.mFirstSample = history.getEnd() - 20 * kSampleRate;
+	request.mLastSample = request.mFirstSample + 4 * kSampleRate;
+	analyzer.analyze(history, request);
+	const std::uint32_t last = analyzer.analyze(history, request);
+	RegionResult result;
+	while (!analyzer.popResult(result))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	if (result.mId != last)
+		passed = false;
+
+	running = false;
+	writer.join();
+	std::printf("write   %5.2f us per %zu samples (max %6.1f) over %llu writes\n", 1.0e6 * writeTotal / numWrites.load(), kBlockSize,
+		1.0e6 * writeMax.load(), static_cast<unsigned long long>(numWrites.load()));
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+// Per-frame cost of the live analysis path: dsp::StreamingStft (history, window,
+// magnitudes) plus staging the row with dsp::SpectrogramRow / ColormapLut, swept over
+// fftSize 1024..131072, window 10..500 ms and hop 10..60 Hz. Headless, only needs the
+// dsp sources:
+//   g++ -O2 -std=c++14 -pthread -Iinclude bench/stft_bench.cpp src/dsp/*.cpp -o stft_bench
+// --csv <file> keeps the results, --baseline <file> compares against an earlier --csv
+// and exits with 1 if any configuration got slower than --tolerance <percent> (15).
+// --zoom <Hz> measures the zoom front end for 0..Hz instead of the full band.
+
+#include "dsp/colormap.h"
+#include "dsp/spectrogram_row.h"
+#include "dsp/streaming_stft.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using namespace cieq::dsp;
+
+namespace
+{
+	const std::size_t kSampleRate = 44100;
+	//! samples handed over per write(), a typical audio block
+	const std::size_t kBlockSize = 512;
+	const int kRepetitions = 3;
+	//! each repetition runs at least this long and at least kMinFrames frames
+	const double kMinSeconds = 0.05;
+	const std::size_t kMinFrames = 8;
+
+	typedef std::tuple<std::size_t, std::size_t, std::size_t> Configuration;
+
+	struct Result
+	{
+		double		mStftNs;
+		double		mRowNs;
+	};
+
+	//! keeps feeding blocks of input, computing every frame that falls due
+	class Runner
+	{
+	public:
+		Runner(const std::vector<float>& input)
+			: mInput(input)
+			, mPos(0)
+		{}
+
+		//! best of kRepetitions, in ns per frame for the transform and for the row
+		Result run(StreamingStft& stft, SpectrogramRow& row, const ColormapLut& colormap)
+		{
+			std::vector<float> magnitudes(stft.getNumOutputBins());
+			Result best = { 1e30, 1e30 };
+			for (int rep = 0; rep < kRepetitions; rep++)
+			{
+				using clock = std::chrono::steady_clock;
+				double stftSeconds = 0.0;
+				double rowSeconds = 0.0;
+				std::size_t frames = 0;
+				while (frames < kMinFrames || stftSeconds + rowSeconds < kMinSeconds)
+				{
+					//The input is replayed, so frames see the same signal in every configuration
+					const auto start = clock::now();
+					while (!stft.isFrameReady())
+					{
+						const std::size_t count = std::min(kBlockSize, mInput.size() - mPos);
+						const std::size_t written = stft.write(mInput.data() + mPos, count);
+						mPos += written;
+						if (mPos == mInput.size())
+							mPos = 0;
+					}
+					stft.computeFrame(magnitudes.data());
+					const auto transformed = clock::now();
+					row.stagePixels(colormap, magnitudes.data(), magnitudes.size(), 50.0f, true);
+					const auto staged = clock::now();
+
+					stftSeconds += std::chrono::duration<double>(transformed - start).count();
+					rowSeconds += std::chrono::duration<double>(staged - transformed).count();
+					frames++;
+				}
+				best.mStftNs = std::min(best.mStftNs, stftSeconds * 1e9 / frames);
+				best.mRowNs = std::min(best.mRowNs, rowSeconds * 1e9 / frames);
+			}
+			return best;
+		}
+
+	private:
+		const std::vector<float>&	mInput;
+		std::size_t			mPos;
+	};
+
+	bool readBaseline(const std::string& path, std::map<Configuration, double>& baseline)
+	{
+		std::FILE* file = std::fopen(path.c_str(), "r");
+		if (!file)
+			return false;
+
+		char line[256];
+		//Header first, then fft,window_ms,hop_hz,... with the total ns per frame in column 7
+		while (std::fgets(line, sizeof(line), file))
+		{
+			unsigned long fftSize, windowMs, hopHz;
+			double stftNs, rowNs, totalNs;
+			unsigned long windowSize;
+			if (std::sscanf(line, "%lu,%lu,%lu,%lu,%lf,%lf,%lf", &fftSize, &windowMs, &hopHz, &windowSize, &stftNs, &rowNs, &totalNs) == 7)
+				baseline[Configuration(fftSize, windowMs, hopHz)] = totalNs;
+		}
+		std::fclose(file);
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string csvPath;
+	std::string baselinePath;
+	double tolerance = 15.0;
+	float zoomMaxFreq = 0.0f;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (!std::strcmp(argv[i], "--csv") && hasValue)
+			csvPath = argv[++i];
+		else if (!std::strcmp(argv[i], "--baseline") && hasValue)
+			baselinePath = argv[++i];
+		else if (!std::strcmp(argv[i], "--tolerance") && hasValue)
+			tolerance = std::atof(argv[++i]);
+		else if (!std::strcmp(argv[i], "--zoom") && hasValue)
+			zoomMaxFreq = static_cast<float>(std::atof(argv[++i]));
+		else
+		{
+			std::fprintf(stderr, "usage: %s [--csv <file>] [--baseline <file>] [--tolerance <percent>] [--zoom <Hz>]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	std::map<Configuration, double> baseline;
+	if (!baselinePath.empty() && !readBaseline(baselinePath, baseline))
+	{
+		std::fprintf(stderr, "can't read baseline %s\n", baselinePath.c_str());
+		return 2;
+	}
+
+	std::FILE* csv = nullptr;
+	if (!csvPath.empty())
+	{
+		csv = std::fopen(csvPath.c_str(), "w");
+		if (!csv)
+		{
+			std::fprintf(stderr, "can't write %s\n", csvPath.c_str());
+			return 2;
+		}
+		std::fputs("fft,window_ms,hop_hz,window_samples,stft_ns_per_frame,row_ns_per_frame,total_ns_per_frame,frames_per_s,realtime_load\n", csv);
+	}
+
+	//Ten seconds of noise, replayed
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+	std::vector<float> input(10 * kSampleRate);
+	for (auto& sample : input)
+		sample = noise(rng);
+
+	ColormapLut colormap;
+	colormap.setup(Palette::JET);
+	Runner runner(input);
+
+	std::printf("%7s %7s %6s %8s %-10s %11s %10s %11s %12s %9s", "fftSize", "win(ms)", "hop", "win(smp)", "method",
+		"stft(ns)", "row(ns)", "total(ns)", "frames/s", "rt load");
+	std::printf(baseline.empty() ? "\n" : " %9s\n", "vs base");
+
+	bool regressed = false;
+	for (std::size_t fftSize = 1024; fftSize <= 131072; fftSize *= 2)
+	{
+		for (std::size_t windowMs : { 10, 20, 50, 100, 200, 500 })
+		{
+			//Longer windows round the FFT up, that configuration is measured at its own size
+			const std::size_t windowSize = windowMs * kSampleRate / 1000;
+			if (windowSize > fftSize)
+				continue;
+
+			for (std::size_t hopHz : { 10, 20, 30, 40, 50, 60 })
+			{
+				StreamingStft stft;
+				stft.setup(fftSize, windowSize, kSampleRate / hopHz, kSampleRate, zoomMaxFreq);
+				SpectrogramRow row;
+				row.setup(stft.getNumOutputBins());
+
+				const Result result = runner.run(stft, row, colormap);
+				const double totalNs = result.mStftNs + result.mRowNs;
+				//Share of one core the configuration needs to keep up with live input
+				const double load = totalNs * 1e-9 * hopHz;
+				std::printf("%7zu %7zu %6zu %8zu %-10s %11.0f %10.0f %11.0f %12.0f %8.2f%%", fftSize, windowMs, hopHz, windowSize,
+					stft.getBinRangeMethodName(), result.mStftNs, result.mRowNs, totalNs, 1e9 / totalNs, 100.0 * load);
+
+				const auto previous = baseline.find(Configuration(fftSize, windowMs, hopHz));
+				if (previous != baseline.end())
+				{
+					const double change = 100.0 * (totalNs / previous->second - 1.0);
+					std::printf(" %+8.1f%%%s", change, change > tolerance ? "  REGRESSION" : "");
+					regressed = regressed || change > tolerance;
+				}
+				std::printf("\n");
+
+				if (csv)
+					std::fprintf(csv, "%zu,%zu,%zu,%zu,%.1f,%.1f,%.1f,%.1f,%.6f\n", fftSize, windowMs, hopHz, windowSize,
+						result.mStftNs, result.mRowNs, totalNs, 1e9 / totalNs, load);
+			}
+		}
+	}
+
+	if (csv)
+		std::fclose(csv);
+	return regressed ? 1 : 0;
+}
@@ -10,8 +10,11 @@
 #include "cinder/params/Params.h"
 #include "app_globals.h"
 #include "app_event.h"
+#include "app_stats.h"
 #include "audio_nodes.h"
 #include "audio_draw.h"
+#include "dsp/profiler.h"
+#include "dsp/region_analysis.h"
 
 namespace cieq
 {
@@ -36,21 +39,59 @@ public:
     void		draw() override final;
     //! application window resize callback.
     void		resize() override final;
-    //! draws the current refresh rate of the render loop.
-    void		drawFps();
+    //! draws the settings, pipeline counters and latency below the plot.
+    void		drawStats();
 
 	void		shutdown() override final;
 
     //! gets fired on mouse click
     void		mouseDown(ci::app::MouseEvent event) override final;
-    //! gets fired on mouse drag
-    //void		mouseDrag(ci::app::MouseEvent event) override final;
+    //! gets fired on mouse drag, scrubs the playback while the timeline is held
+    void		mouseDrag(ci::app::MouseEvent event) override final;
+    //! gets fired on mouse release
+    void		mouseUp(ci::app::MouseEvent event) override final;
     //! gets fired on keyboard click
 	void		keyDown(ci::app::KeyEvent event) override final;
     // Toggles boolean flag used to pause display updating
     void        togglePauseDrawing();
     // Gets fired on press of Linear / dB Mode button in parameter menu
     void        linearDBModeButton();
+    // Gets fired on press of Full / Zoom FFT Mode button in parameter menu
+    void        zoomFftModeButton();
+    // Writes the profiling zones of all threads as a Chrome trace, fired by the 't' key
+    void        writeProfileTrace();
+    // Prints capture to screen latency percentiles with the settings they were measured with
+    void        logLatency();
+    // Writes the per second pipeline statistics as CSV, fired by the 'c' key
+    void        writeStatsCsv();
+    // Starts streaming every analysis frame to disk or finishes the recording, fired by the 'r' key
+    void        toggleRecording();
+
+private:
+    //! re-renders the text drawStats() blits
+    void        renderStats();
+    //! the settings statistics are attributed to, e.g. in the CSV
+    std::string describeConfiguration();
+    //! starts counting statistics for the current settings, after every mAudioNodes.setup() or reconfigure()
+    void        resetStats();
+    //! applies the window, hop and frequency settings without stopping capture or losing the history
+    void        reconfigureAnalysis();
+    //! the playback timeline along the top of the window
+    ci::Rectf   getPlaybackBarBounds();
+    //! draws the timeline with the playhead, playback only
+    void        drawPlaybackBar();
+    //! moves the playhead to where x is on the timeline, from the next update() on
+    void        scrubPlayback(float x);
+    //! re-analyses the part of the paused spectrogram under the selection with the detail settings
+    void        analyzeSelection();
+    //! the rectangle dragged so far, outlined over the paused spectrogram
+    void        drawSelection();
+    //! where the FFT wisdom lives, in the user's config directory
+    ci::fs::path getFftWisdomPath();
+    //! loads the FFT wisdom of earlier runs and measures geometries it doesn't know from now on
+    void        loadFftWisdom();
+    //! writes the FFT wisdom back if anything new got measured
+    void        saveFftWisdom();
 
 	AppGlobals&	getGlobals() { return mGlobals; }
 
@@ -67,9 +108,15 @@ private:
     WaveformPlot                            	mWaveformPlot, mWaveformPlotShifted;
     //! running spectrogram plot audio signal
     SpectrogramPlot	                            mSpectrogramPlot;
+    //! hop, frame and xrun counters of the current settings
+    AppStats                                    mStats;
+    //! drawStats() text, re-rendered every mStatsTextTime + 0.25 s
+    ci::gl::Texture                             mStatsTexture;
+    double                                      mStatsTextTime;
     //! cinder's param ref, for tweaking variables during runtime
     ci::params::InterfaceGlRef                  mParams;
     bool                                        linearDbMode;
+    bool                                        zoomFftMode;
     bool                                        pauseDrawing;
     size_t                                      userWinSize;
     size_t                                      userWinSizePrev;
@@ -83,7 +130,8 @@ private:
     size_t                                      dispBins;
     size_t                                      actualMaxFreq;
     size_t                                      nearestFft;
-    size_t                                      numDispParams;
+    int                                         userPalette;
+    int                                         userPalettePrev;
     float                                       hSR;
     float                                       numBins;
     float                                       shift;
@@ -96,20 +144,29 @@ private:
     double                                      timeEnterPrev;
     double                                      timeReturn;
     double                                      timeExit;
-    double                                      timeSec1Enter;
-    double                                      timeSec1Exit;
-    double                                      timeSec1Process;
-    double                                      timeSec2Enter;
-    double                                      timeSec2Exit;
-    double                                      timeSec2Process;
-    double                                      timeSec3Enter;
-    double                                      timeSec3Exit;
-    double                                      timeSec3Process;
-    double                                      timeSec4Enter;
-    double                                      timeSec4Exit;
-    double                                      timeSec4Process;
     double                                      nearestPow2;
     double                                      userWinSizeMs;
+    // seconds on mTimer the latency was last written to the console
+    double                                      mLatencyLogTime;
+    //! what toggleRecording() records with, "--record-format" on the command line
+    dsp::RecordingFormat                        mRecordingFormat;
+    //! the timeline is held, and where it was dragged to since the last update()
+    bool                                        mScrubbing;
+    bool                                        mScrubPending;
+    double                                      mScrubTime;
+    //! geometry of the recording the plot was last retuned for
+    std::uint32_t                               mPlaybackGeneration;
+    //! analyses selected regions of the raw input history in the background
+    dsp::RegionAnalyzer                         mRegionAnalyzer;
+    //! a region of the paused spectrogram is being dragged out, from mSelectStart to mSelectEnd
+    bool                                        mSelecting;
+    ci::Vec2f                                   mSelectStart;
+    ci::Vec2f                                   mSelectEnd;
+    //! window and hop the selection gets re-analysed with
+    size_t                                      userDetailWinSize;
+    float                                       userDetailHopMs;
+    //! what the last region came out as, shown in the stats
+    std::string                                 mDetailStatus;
 };
 
 } //!cieq
@@ -0,0 +1,114 @@
+#ifndef CIEQ_INCLUDE_APP_STATS_H_
+#define CIEQ_INCLUDE_APP_STATS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+
+namespace cieq
+{
+
+class AudioNodes;
+
+/*!
+ * \struct PipelineCounters
+ * \brief health of the capture -> analysis -> display pipeline, all counted
+ * since the current configuration was set up.
+ */
+struct PipelineCounters
+{
+    // hops the captured input should have produced, and frames the analysis computed
+    std::uint64_t                       mHopsExpected = 0;
+    std::uint64_t                       mHopsProduced = 0;
+    // computed frames dropped because nobody drained the frame queue
+    std::uint64_t                       mRowsSkipped = 0;
+    std::uint64_t                       mRowsDrawn = 0;
+    std::uint64_t                       mRenderFrames = 0;
+    // refresh intervals that passed without a draw
+    std::uint64_t                       mRenderFramesMissed = 0;
+    // overruns the audio driver reported, and samples lost because the capture ring was full
+    std::uint64_t                       mInputOverruns = 0;
+    std::uint64_t                       mCaptureSamplesDropped = 0;
+    std::size_t                         mFrameQueueHighWater = 0;
+    std::size_t                         mFrameQueueCapacity = 0;
+    std::size_t                         mCaptureRingHighWater = 0;
+    std::size_t                         mCaptureRingSize = 0;
+};
+
+/*!
+ * \class AppStats
+ * \brief collects PipelineCounters once per update, keeps a per second
+ * history for CSV export and raises an alert as soon as a configuration
+ * can't keep up (hops missing, rows skipped, input lost).
+ */
+class AppStats
+{
+public:
+    AppStats();
+
+    // \brief starts counting for a new configuration, its description goes into every CSV row
+    void                                reset(const std::string& configuration, double now);
+    // \brief once per draw, targetInterval is the refresh interval the app is paced at
+    void                                onRenderFrame(double now, double targetInterval);
+    // \brief pulls the analysis counters, once per update
+    void                                update(AudioNodes& nodes, std::uint64_t rowsDrawn, double now);
+    // \brief while paused by the user nothing is drawn on purpose, the counters keep being
+    // followed but no period is judged or added to the history
+    void                                setPaused(bool paused) { mPaused = paused; }
+    bool                                isPaused() const { return mPaused; }
+    // \brief writes one row per second of history, returns false if the file can't be written
+    bool                                writeCsv(const std::string& path) const;
+
+    const PipelineCounters&             getCounters() const { return mCounters; }
+    // \brief produced / expected hops over the last second, 1 when nothing was expected
+    double                              getHopRatio() const { return mHopRatio; }
+    // \brief mean and standard deviation of the time between rows reaching the screen over the last second
+    double                              getRowIntervalMs() const { return mRowIntervalMs; }
+    double                              getRowJitterMs() const { return mRowJitterMs; }
+    bool                                isFallingBehind() const { return !mAlert.empty(); }
+    // \brief what went wrong in the last few seconds, empty while everything keeps up
+    const std::string&                  getAlert() const { return mAlert; }
+
+private:
+    struct HistoryRow
+    {
+        double                          mTime;
+        double                          mSecondsInConfiguration;
+        std::size_t                     mConfiguration;
+        PipelineCounters                mCounters;
+        double                          mRowIntervalMs;
+        double                          mRowJitterMs;
+        bool                            mFallingBehind;
+    };
+
+    void                                closePeriod(double now);
+
+private:
+    PipelineCounters                    mCounters;
+    // counters at the start of the current one second period
+    PipelineCounters                    mPeriodStart;
+    double                              mPeriodStartTime;
+    double                              mConfigurationStartTime;
+    double                              mLastRenderTime;
+    // rows reaching the screen: time of the last draw that had any, and running interval moments
+    double                              mLastRowTime;
+    // the plot's running row count at the last update, it isn't reset with the configuration
+    std::uint64_t                       mLastRowsDrawn;
+    std::size_t                         mRowIntervalCount;
+    double                              mRowIntervalSum;
+    double                              mRowIntervalSumSquares;
+    double                              mRowIntervalMs;
+    double                              mRowJitterMs;
+    double                              mHopRatio;
+    std::string                         mAlert;
+    double                              mAlertUntil;
+    std::deque<std::string>             mConfigurations;
+    std::size_t                         mFirstConfiguration;
+    std::deque<HistoryRow>              mHistory;
+    bool                                mPaused;
+};
+
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_APP_STATS_H_
@@ -7,14 +7,27 @@
 #include <cinder/Surface.h>
 #include <cinder/Font.h>
 #include <cinder/gl/Texture.h>
+#include <cinder/gl/GlslProg.h>
+#include <cinder/gl/Fbo.h>
+#include <cinder/gl/Vbo.h>
 #include <cinder/PolyLine.h>
 #include <cinder/Timer.h>
 
 
 #include <vector>
 #include <array>
+#include <deque>
 #include <sstream>
 
+#include "audio_stft.h"
+#include "dsp/colormap.h"
+#include "dsp/latency_histogram.h"
+#include "dsp/minmax_pyramid.h"
+#include "dsp/profiler.h"
+#include "dsp/region_analysis.h"
+#include "dsp/spectrogram_pyramid.h"
+#include "dsp/spectrogram_row.h"
+
 using namespace ci;
 using namespace std;
 
@@ -42,11 +55,14 @@ public:
 	Plot&			setVertAxisTitle(const std::string& title)	{ mVertTitle = title; onVertAxisTextChange(); return *this; }
 	Plot&			setVertAxisUnit(const std::string& unit)	{ mVertUnit = unit; onVertAxisTextChange(); return *this; }
 	Plot&			setHorzAxisUnit(const std::string& unit)	{ mHorzUnit = unit; onHorzAxisTextChange(); return *this; }
-	Plot&			setPlotTitle(const std::string& title)		{ mPlotTitle = title; return *this; }
-	Plot&			setBounds(const ci::Rectf& bounds)			{ mBounds = bounds; return *this; }
-	Plot&			setBoundsColor(const ci::ColorA& color)		{ mBoundsColor = color; return *this; }
-	Plot&			setDrawBounds(bool on = true)				{ mDrawBounds = on; return *this; }
-	Plot&			setDrawLabels(bool on = true)				{ mDrawLabels = on; return *this; }
+	Plot&			setPlotTitle(const std::string& title)		{ mPlotTitle = title; invalidateOverlay(); return *this; }
+	Plot&			setBounds(const ci::Rectf& bounds)			{ mBounds = bounds; invalidateOverlay(); return *this; }
+	Plot&			setBoundsColor(const ci::ColorA& color)		{ mBoundsColor = color; invalidateOverlay(); return *this; }
+	Plot&			setDrawBounds(bool on = true)				{ mDrawBounds = on; invalidateOverlay(); return *this; }
+	Plot&			setDrawLabels(bool on = true)				{ mDrawLabels = on; invalidateOverlay(); return *this; }
+	const ci::Rectf&	getBounds() const						{ return mBounds; }
+	// \brief makes the next draw() re-render bounds, labels and axes into the overlay
+	void			invalidateOverlay()							{ mOverlayDirty = true; }
 
     virtual	void	drawLocal(double winSizeMs, float shift, float shiftLength, float maxDB, bool linearDbMode) = 0;
     //Added float shift and float shiftLength parameters to allow for window shifting:
@@ -54,6 +70,11 @@ public:
 	void			drawBounds();
 	void			drawLabels();
 
+protected:
+	// \brief plot specific ticks and tick labels, rendered into the overlay together with
+	// bounds and labels. Only called when the overlay was invalidated.
+	virtual void	drawAxes() {}
+
 protected:
 	std::string	mHorzTitle, mVertTitle;
 	std::string	mHorzUnit, mVertUnit;
@@ -67,6 +88,14 @@ protected:
 private:
 	void			onHorzAxisTextChange();
     void			onVertAxisTextChange();
+	// \brief re-renders the overlay if needed and composites it over the plot
+	void			drawOverlay();
+	void			renderOverlay();
+
+private:
+	// window sized, transparent layer holding everything that only changes with the layout
+	ci::gl::Fbo		mOverlay;
+	bool			mOverlayDirty;
 };
 
 class WaveformPlot final : public Plot
@@ -78,9 +107,23 @@ public:
     //Added float shift and float shiftLength parameters to allow for window shifting:
     void					drawLocal(double winSizeMs, float shift, float shiftLength, float maxDB, bool linearDbMode);
 
+private:
+	// \brief appends the vertices of one channel's trace to mVertices: the samples themselves
+	// when zoomed in far enough, otherwise a min and a max per pixel column
+	void					appendTrace(std::size_t first, std::size_t length, float yOffset, float waveHeight);
+
 private:
 	ci::ColorA				mGraphColor;
 	AudioNodes&				mAudioNodes;
+	// rebuilt for every channel of every new buffer, queried once per column
+	dsp::MinMaxPyramid		mPyramid;
+	std::vector<float>		mColumnMins;
+	std::vector<float>		mColumnMaxs;
+	// interleaved x, y for all channels, uploaded into a VBO that is only reallocated when it has to grow
+	std::vector<GLfloat>	mVertices;
+	std::vector<std::size_t>	mTraceStarts;
+	ci::gl::Vbo				mVertexBuffer;
+	std::size_t				mVertexBufferCapacity;
 };
 
 class SpectrumPlot final : public Plot
@@ -94,6 +137,7 @@ public:
 
 private:
 	bool					mScaleDecibels;
+	std::vector<float>		mSpectrum;
 	std::vector<ci::Vec2f>	mVerts;
 	std::vector<ci::ColorA>	mColors;
 	AudioNodes&				mAudioNodes;
@@ -105,35 +149,181 @@ public:
     SpectrogramPlot(AudioNodes& nodes);
 
     void							drawLocal(double winSizeMs, float shift, float shiftLength, float maxDB, bool linearDBMode) override;
+    // \brief duration is in analysis rows and may span hours: every row also goes into a
+    // history pyramid, and the ring shows the first level with at most kMaxRingRows rows for it.
+    // Retunes still waiting for their generation stay queued.
     void							setup(int duration, size_t width);
+    // \brief like setup() but keeps the history. While the bin spacing stays the same the new
+    // ring is refilled exactly from the history pyramid, only a new bin spacing has the old
+    // ring stretched on the GPU to the new size, spacing and hop rate. Applied with the first
+    // row of the given engine generation, rows of the analysis still running until then keep
+    // their old geometry.
+    void                            retune(int duration, size_t width, float rowsPerSecond, std::uint32_t generation);
+    // \brief colormap used from the next draw on, applies to the whole history
+    void                            setPalette(dsp::Palette palette);
+    // \brief memory the history keeps before spilling to disk, applies from the next analysis geometry on
+    void                            setHistoryBudget(std::size_t bytes) { mHistorySettings.mMemoryBudget = bytes; }
+    // \brief longest duration setup() and retune() will be asked for, in analysis rows. The
+    // history only builds the levels views up to it need, applies from the next analysis geometry on.
+    void                            setHistoryMaxRows(std::size_t rows);
+    const dsp::SpectrogramPyramid&  getHistory() const { return mHistory; }
+    // \brief pyramid level on screen, a ring row pools 2^level analysis rows
+    std::size_t                     getViewLevel() const { return mViewLevel; }
+    // \brief a frozen plot keeps taking rows into its history but the view stays as it is,
+    // for a closer look. Unfrozen, the ring catches up with the history.
+    void                            setFrozen(bool frozen) { mFrozen = frozen; }
+    // \brief the part of the plot under rect as window centres in stream samples (see
+    // SpectralFrame::mSampleIndex) and frequencies: mFirstSample, mLastSample, mMinFreq and
+    // mMaxFreq of region. False if rect misses the plot or no rows were drawn yet.
+    bool                            getRegion(const ci::Rectf& rect, dsp::RegionRequest& region) const;
+    // \brief draws a re-analysed region over the rows and frequencies it covers, until clearDetail()
+    void                            setDetail(dsp::RegionResult result);
+    void                            clearDetail();
     size_t                          getMaxDispBins();
     double                          getActualHopRate();
+    // \brief analysis rows drawn since the plot was created, a zoomed out ring row pools several
+    std::uint64_t                   getNumRowsDrawn() const { return mNumRowsDrawn; }
     size_t                          getPlotWidth();
+    // \brief call once the frame drawn last is on screen, i.e. after its buffer swap,
+    // to measure how stale the newest row was by then
+    void                            onFramePresented();
+    // \brief capture to glTexSubImage2D of every row, and capture of the newest row to
+    // the swap that showed it
+    const dsp::LatencyHistogram&    getUploadLatency() const { return mUploadLatency; }
+    const dsp::LatencyHistogram&    getPresentLatency() const { return mPresentLatency; }
+
+protected:
+    void                            drawAxes() override;
+
+private:
+    // rows the ring holds at most, 20 s at 60 hops per second. Longer durations zoom out a level.
+    static const std::size_t        kMaxRingRows = 1200;
+
+    // \brief uploads one spectrum into row mFrameCounter of the ring texture, raw magnitudes
+    // for the shader or, without shaders, pixels coloured by mColormapLut
+    void                            writeRow(const float* spectrum, std::size_t size, float maxDB, bool linearDbMode);
+    // \brief draws the ring newest row first, scrolled by a texture coordinate offset. Scaling
+    // and colouring happen in the fragment shader, so they apply to every row already on screen.
+    void                            drawRing(float maxDB, bool linearDbMode);
+    // \brief draws texture into a quad through the colormap shader, as it is on the CPU fallback
+    void                            drawColormapped(const gl::Texture& texture, const GLfloat* vertices, const GLfloat* texCoords, float maxDB, bool linearDbMode);
+    // \brief draws mDetail where its rows and bins are in the ring, clipped to the plot
+    void                            drawDetail(float maxDB, bool linearDbMode);
+    // \brief window centre of the newest row on screen, in stream samples
+    double                          getNewestCentre() const;
+    // \brief stream samples per ring row
+    double                          getRowSamples() const;
+    // \brief rows of level the ring shows or will show, fewer than the history holds while frozen
+    std::uint64_t                   getViewRows(std::size_t level) const;
+    void                            uploadPalette();
+
+    struct RingRetune
+    {
+        int                         mDuration;
+        std::size_t                 mWidth;
+        float                       mRowsPerSecond;
+        // spacing of the new columns, sample rate over FFT size
+        float                       mBinHz;
+        std::uint32_t               mGeneration;
+    };
+
+    // \brief an empty ring of the current format, a render target so it can be resampled into
+    gl::Fbo                         createRing(std::size_t width, std::size_t height);
+    // \brief applies the newest retune() the given generation's rows are meant for
+    void                            applyRetunes(std::uint32_t generation);
+    // \brief draws the current ring, newest row on top, into a new one laid out for retune
+    void                            resampleRing(const RingRetune& retune);
+    float                           getEngineBinHz();
+    // \brief frequency of a ring column, the frequency axis follows the rows on screen
+    std::size_t                     getRingFreq(std::size_t column) const;
+    // \brief first pyramid level that shows duration analysis rows in at most kMaxRingRows
+    std::size_t                     chooseLevel(int duration) const;
+    // \brief analysis bins pooled into one ring column at level, for rows width bins wide
+    std::size_t                     getLevelBinPooling(std::size_t width, std::size_t level) const;
+    // \brief starts the history over for frames of the size and geometry of frame
+    void                            resetHistory(const SpectralFrame& frame);
+    // \brief writes the rows of the view level the ring hasn't shown yet, after a refill
+    // the newest mTexH of them
+    void                            writeHistoryRows(float maxDB, bool linearDbMode);
 
 private:
     AudioNodes&						mAudioNodes;
-    std::vector<float>              spectrum;
-    std::array<Surface32f, 2>   	mSpectrals;
-    gl::Texture					    mTexCache;
+    SpectralFrame                   mFrame;
+    // mTexH rows of raw magnitudes (R32F, RGBA8 on the CPU fallback) on the GPU, rows are
+    // overwritten in place and the texture wraps vertically (GL_REPEAT), mFrameCounter is
+    // the next row to write
+    gl::Texture					    mRingTexture;
+    gl::Fbo                         mRingFbo;
+    // geometry the rows in the ring were computed with, rows per second is 0 until a retune() tells
+    float                           mRingBinHz;
+    float                           mRingRowsPerSecond;
+    // engine generation of the newest row, and retunes waiting for their first row
+    std::uint32_t                   mRowGeneration;
+    std::deque<RingRetune>          mRetunes;
+    // one row staged for glTexSubImage2D
+    dsp::SpectrogramRow             mRow;
+    // every row drawn since the analysis geometry last changed, pooled into levels
+    dsp::SpectrogramPyramid         mHistory;
+    dsp::PyramidSettings            mHistorySettings;
+    // bin spacing and newest sample index of the rows in mHistory
+    float                           mHistoryBinHz;
+    std::uint64_t                   mHistorySampleIndex;
+    // level and bin pooling of the ring, and the rows of that level written into it so far
+    std::size_t                     mViewLevel;
+    std::size_t                     mViewBinPool;
+    std::uint64_t                   mViewRowsWritten;
+    // the ring was laid out anew and gets its rows from the history instead of the GPU
+    bool                            mRefillPending;
+    std::vector<float>              mViewRows;
+    // silent row that pads a gap in the frames
+    std::vector<float>              mGapRow;
+    // hop and window of the rows in mHistory, in samples, and how far the sample index of
+    // consecutive rows is apart (a hop, or one for played back frames)
+    std::size_t                     mHistoryHopSize;
+    std::size_t                     mHistoryWindowSize;
+    std::size_t                     mHistoryIndexStep;
+    // level 0 rows of the history the ring is up to and the sample index of the newest of
+    // them, behind the history while frozen
+    std::uint64_t                   mViewAppends;
+    std::uint64_t                   mViewSampleIndex;
+    bool                            mFrozen;
+    // re-analysed region over the ring, the colouring its CPU fallback pixels were made with
+    dsp::RegionResult               mDetail;
+    gl::Texture                     mDetailTexture;
+    dsp::SpectrogramRow             mDetailRow;
+    float                           mDetailMaxDB;
+    bool                            mDetailDbMode;
+    // N x 1 palette the shader looks the scaled magnitude up in
+    gl::Texture                     mPaletteTexture;
+    gl::GlslProg                    mColormapShader;
+    // colours rows on the CPU if the shader can't be compiled, new rows only
+    dsp::ColormapLut                mColormapLut;
+    bool                            mCpuColormap;
+    dsp::Palette                    mPalette;
+    dsp::LatencyHistogram           mUploadLatency;
+    dsp::LatencyHistogram           mPresentLatency;
+    // capture time of the newest row written since the last onFramePresented()
+    std::chrono::steady_clock::time_point   mNewestRowCaptureTime;
+    bool                            mRowsPendingPresent;
     std::string                     tickLabelYOriginString;
     std::string                     tickLabelYCenterString;
     std::string                     tickLabelYEndString;
     std::size_t						mTexW, mTexH;
     std::size_t						mFrameCounter;
-    std::size_t						nodeNumber;
+    std::size_t						mRowsSinceRateUpdate;
+    std::uint64_t                   mNumRowsDrawn;
     std::size_t						maxDispBins;
     std::size_t						maxFreqDisp;
-    std::size_t                     flag;
     std::size_t                     pixelsPerBin;
     std::size_t                     binSkipMult;
     std::size_t                     plotWidth;
     std::size_t                     fftSize;
     std::size_t                     numBins;
     std::size_t                     hardwareSampleRate;
-    int								mActiveSurface;
-    int								mBackBufferSurface;
-    float                           pixelSpecMag;
-    float                           pixelDispMag;
+    // what the cached axes were rendered for, a change invalidates the overlay
+    std::size_t                     mAxesMaxFreq;
+    float                           mAxesShift;
+    std::size_t                     mAxesLevel;
     float                           tickLabelYOrigin;
     float                           tickLabelYCenter;
     float                           tickLabelYEnd;
@@ -142,24 +332,6 @@ private:
     double                          timeEnterPrev;
     double                          timeReturn;
     double                          timeExit;
-    double                          timeProcess;
-    double                          timeHop;
-    double                          timeSec1Enter;
-    double                          timeSec1Exit;
-    double                          timeSec1Process;
-    double                          timeSec2Enter;
-    double                          timeSec2Exit;
-    double                          timeSec2Process;
-    double                          timeSec3Enter;
-    double                          timeSec3Exit;
-    double                          timeSec3Process;
-    double                          timeLine;
-    double                          timeNode1Start;
-    double                          timeNode1StartPrev;
-    double                          timeCurrentNodeStart;
-    double                          timeCurrentNodeCall;
-    double                          timeCurrentNodeQuo;
-    double                          timeCurrentNodeRem;
     double                          actualHopRate;
 };
 
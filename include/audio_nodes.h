@@ -1,16 +1,24 @@
 #ifndef CIEQ_INCLUDE_AUDIO_NODES_H_
 #define CIEQ_INCLUDE_AUDIO_NODES_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 #include <cinder/Timer.h>
 
+#include "app_stats.h"
+#include "audio_stft.h"
+#include "generator_source.h"
+#include "dsp/spectrogram_player.h"
+#include "dsp/spectrogram_recording.h"
+
 namespace cinder 
 {
 namespace audio 
 {
     class InputDeviceNode;
     class MonitorNode;
-    class MonitorSpectralNode;
 }
 } //!ci::audio
 
@@ -26,16 +34,50 @@ class AppGlobals;
  * \note from my understanding, node in Cinder is a unit of audio
  * processing. For each operation (regardless of being input / output)
  * a node is required. I have three nodes here, one monitoring the raw
- * input and the other one performing FFT on it. The third is reading
- * the input.
+ * input and the other one capturing it for the STFT engine. The third is
+ * reading the input.
  */
 class AudioNodes
 {
 public:
 	AudioNodes(AppGlobals&);
 
-	// \brief initializes all nodes and connect them together
-    void												setup(double userHopSize, size_t userWinSize, size_t fftSize, bool auto_enable = true);
+	// \brief initializes all nodes and connect them together. A non-zero zoomMaxFreq
+	// analyses only 0..zoomMaxFreq through the decimating zoom FFT.
+    void												setup(double userHopSize, size_t userWinSize, size_t fftSize, size_t zoomMaxFreq = 0, bool auto_enable = true);
+	// \brief changes the analysis after setup() without touching the audio graph: capture keeps
+	// running and the STFT engine swaps the new transform in at a hop boundary, see
+	// StftEngine::reconfigure(). Bins up to displayMaxFreq get computed. Returns the
+	// generation frames of the new analysis carry. A file restarts its analysis instead.
+	std::uint32_t										reconfigure(double userHopSize, size_t userWinSize, size_t fftSize, size_t zoomMaxFreq, size_t displayMaxFreq);
+	// \brief plans the analysis once for each of fftSizes with the given settings, so the
+	// FFT wisdom gets measured and the plan cache holds their tables before the user
+	// switches to one of them. Call after setup(), the sample rate must be known.
+	void												prewarmFft(const std::vector<size_t>& fftSizes, double userHopSize, size_t userWinSize, size_t zoomMaxFreq, size_t displayMaxFreq);
+	// \brief analyses a WAV / AIFF file instead of the input device from the next setup() on,
+	// as fast as the cores allow. Returns false, and stays on live input, if it can't be read.
+	bool												openFile(const std::string& path);
+	// \brief true once openFile() succeeded, there are no input or monitor nodes then
+	bool												isOffline() const { return mOfflineFile != nullptr; }
+	// \brief feeds a synthetic signal instead of the input device from the next setup() on,
+	// see dsp::parseGeneratorSettings() for the spec. Returns false, and stays on live
+	// input, if the spec or the generator settings are bad.
+	bool												openGenerator(const std::string& spec);
+	// \brief true once openGenerator() succeeded, there are no input or monitor nodes then
+	bool												isGenerated() const { return mGenerator != nullptr; }
+	// \brief plays a file written by startRecording() back instead of analysing anything, from
+	// the next setup() on. Frames come out of popSpectralFrame() in real time, already
+	// transformed. Returns false, and stays on live input, if it can't be read.
+	bool												openPlayback(const std::string& path);
+	// \brief true once openPlayback() succeeded, there are no audio nodes and no STFT then
+	bool												isPlayback() const { return mPlayer != nullptr; }
+	// \brief moves the playback to time seconds into the recording. The numHistory frames up to
+	// it are popped first, enough to fill a spectrogram that many rows high.
+	void												seekPlayback(double time, size_t numHistory);
+	// \brief the recording being played, only valid if isPlayback()
+	const dsp::SpectrogramPlayer&						getPlayer() const { return *mPlayer; }
+	// \brief fraction of the file analysed so far
+	double												getOfflineProgress();
 	// \brief enables reading from input
 	void												enableInput();
 	// \brief disables reading from input
@@ -44,77 +86,78 @@ public:
     void												disconnectAll();
 	// \brief toggles reading from input
 	void												toggleInput();
-    //Get the number of frequency bins in the current monitorSpectralNode
+    // \brief pops the oldest finished spectral frame, returns false if none are ready
+    bool                                                popSpectralFrame(SpectralFrame& frame);
+    // \brief copies the magnitude spectrum of the most recent frame
+    void                                                copyLatestSpectrum(std::vector<float>& dest);
+    // \brief streams every frame popped from now on to path, timed from now and labelled with
+    // the geometry it was computed with. Returns false if the file can't be created.
+    bool                                                startRecording(const std::string& path, const dsp::RecordingFormat& format);
+    // \brief writes the index and closes the recording, returns false if any write failed
+    bool                                                stopRecording();
+    bool                                                isRecording() const { return mRecorder.isOpen(); }
+    const dsp::SpectrogramRecorder&                     getRecorder() const { return mRecorder; }
+    // \brief only the first numBins bins get computed from now on, call again after every setup()
+    void                                                setDisplayedBins(size_t numBins);
+    // \brief the engine configuration frames are computed with after the latest setup() or reconfigure()
+    std::uint32_t                                       getGeneration() const;
+    //Get the number of frequency bins of the STFT engine
     size_t                                              getNumBins();
-    //Get the FFT Size of the current monitorSpectralNode
+    //Get the name of the method computing the displayed bins
+    const char*                                         getBinRangeMethodName();
+    //Get the FFT Size of the STFT engine (sets the bin spacing)
     size_t                                              getFftSize();
-    //Get the frequency of the last frequency bin in the current monitorSpectralNode
+    //Get the size of the transform actually computed, smaller than getFftSize() in zoom mode
+    size_t                                              getTransformSize();
+    //Get the frequency of the given frequency bin
     size_t                                              getMaxFreqDisp(size_t binNumber);
     //Get the sample rate of the audio input device hardware on this machine
     size_t                                              getHardwareSampleRate();
-    //Get the time stamp for when a given node was established and connected
-    double                                              getTimeOfNode(size_t nodeNumber);
+    // \brief window and hop of the live analysis in samples
+    size_t                                              getWindowSize() { return mStftEngine.getWindowSize(); }
+    size_t                                              getHopSize() { return mStftEngine.getHopSize(); }
+    // \brief seconds of raw input kept for re-analysis, applies from the next setup() on
+    void                                                setPcmHistorySeconds(double seconds) { mStftEngine.setPcmHistorySeconds(seconds); }
+    // \brief the raw input frames were computed from, indexed like SpectralFrame::mSampleIndex
+    const dsp::PcmHistory&                              getPcmHistory() const { return mStftEngine.getPcmHistory(); }
+    // \brief live and generated input keep a PCM history, files and recordings don't
+    bool                                                hasPcmHistory() const { return !isOffline() && !isPlayback(); }
+    // \brief fills the capture and analysis side of counters. Device overruns are only
+    // reported once by the driver, those are added to counters.mInputOverruns.
+    void                                                readCounters(PipelineCounters& counters);
 
 	// \brief returns a pointer to the node which is reading data from input
 	cinder::audio::InputDeviceNode* const				getInputDeviceNode();
 	// \brief returns a pointer to the node which is having raw data in it
 	cinder::audio::MonitorNode* const					getMonitorNode();
-	// \brief returns a pointer to the node which is performing FFT on data
-    cinder::audio::MonitorSpectralNode* const			getMonitorSpectralNode(size_t nodeNumber);
-    // Returns a pointer to the timer being used to track node start times (I hope)
-    ci::Timer* const			                        getTimer();
 
 private:
     std::shared_ptr<cinder::audio::InputDeviceNode>		mInputDeviceNode;
 	std::shared_ptr<cinder::audio::MonitorNode>			mMonitorNode;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode2;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode3;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode4;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode5;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode6;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode7;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode8;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode9;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode10;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode11;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode12;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode13;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode14;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode15;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode16;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode17;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode18;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode19;
-    std::shared_ptr<cinder::audio::MonitorSpectralNode>	mMonitorSpectralNode20;
-    ci::Timer                                           mTimer;
-    double                                              time;
-    double                                              timeNode1;
-    double                                              timeNode2;
-    double                                              timeNode3;
-    double                                              timeNode4;
-    double                                              timeNode5;
-    double                                              timeNode6;
-    double                                              timeNode7;
-    double                                              timeNode8;
-    double                                              timeNode9;
-    double                                              timeNode10;
-    double                                              timeNode11;
-    double                                              timeNode12;
-    double                                              timeNode13;
-    double                                              timeNode14;
-    double                                              timeNode15;
-    double                                              timeNode16;
-    double                                              timeNode17;
-    double                                              timeNode18;
-    double                                              timeNode19;
-    double                                              timeNode20;
-    double                                              timeSec1Enter;
-    double                                              timeSec1Exit;
-    double                                              timeSec1Process;
+    std::shared_ptr<CaptureNode>                        mCaptureNode;
+    std::shared_ptr<dsp::AudioFile>                     mOfflineFile;
+    std::unique_ptr<GeneratorSource>                    mGenerator;
+    std::unique_ptr<dsp::SpectrogramPlayer>             mPlayer;
+    dsp::PlayedFrame                                    mPlayedFrame;
+    // wall clock the playhead was last advanced to, and frames played since setup()
+    std::chrono::steady_clock::time_point               mPlaybackClock;
+    std::uint64_t                                       mNumPlayedFrames;
+    StftEngine                                          mStftEngine;
+    dsp::SpectrogramRecorder                            mRecorder;
+    // recorded frames of mRecordedGeneration have mRecordedGeometry, older ones keep the previous one
+    dsp::RecordingGeometry                              mRecordedGeometry;
+    std::uint32_t                                       mRecordedGeneration;
+    std::chrono::steady_clock::time_point               mRecordStart;
     //double                                              userHopSizeMs;
     size_t                                              hardwareSampleRate;
 
+private:
+    // \brief advances the playhead to now and pops the next frame due
+    bool                                                popPlayedFrame(SpectralFrame& frame);
+    // \brief hands a popped frame to the recorder
+    void                                                recordFrame(const SpectralFrame& frame);
+    dsp::RecordingGeometry                              getRecordingGeometry();
+
 private:
 	AppGlobals&											mGlobals;
 	bool												mIsEnabled;
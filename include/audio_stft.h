@@ -0,0 +1,306 @@
+#ifndef CIEQ_INCLUDE_AUDIO_STFT_H_
+#define CIEQ_INCLUDE_AUDIO_STFT_H_
+
+#include <cinder/audio/Node.h>
+#include <cinder/audio/dsp/RingBuffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "spsc_queue.h"
+#include "dsp/audio_file.h"
+#include "dsp/offline_stft.h"
+#include "dsp/pcm_history.h"
+#include "dsp/streaming_stft.h"
+
+namespace cinder
+{
+namespace audio
+{
+    class Buffer;
+}
+} //!ci::audio
+
+namespace cieq
+{
+
+/*!
+ * \class CaptureNode
+ * \brief taps the input device and copies every incoming sample into a
+ * lock-free ring buffer. Multi-channel input is averaged down to mono,
+ * the same way MonitorSpectralNode used to do it. Every block is also
+ * stamped with the time it arrived, for measuring latency downstream.
+ * \note process() runs on the audio thread, read() and getCaptureTime()
+ * on the analysis side. Sources outside the audio graph (GeneratorSource)
+ * call prepare() once and then write() from their own thread instead.
+ */
+class CaptureNode final : public ci::audio::NodeAutoPullable
+{
+public:
+    CaptureNode(size_t ringSize, const Format& format = Format());
+
+    // \brief allocates the ring and mix buffer without an audio graph, for blocks of up to maxFramesPerBlock
+    void                                                prepare(size_t maxFramesPerBlock);
+    // \brief what process() does with a block, numFrames frames per channel, channel c at
+    // channels + c * numFrames. Only ever call from one thread.
+    void                                                write(const float* channels, size_t numChannels, size_t numFrames);
+
+    // \brief copies up to count samples out of the ring, returns how many were read
+    size_t                                              read(float* dest, size_t count);
+    // \brief number of samples waiting in the ring
+    size_t                                              getAvailableSamples() const;
+    // \brief total number of samples dropped because the ring was full
+    std::uint64_t                                       getNumDroppedSamples() const;
+    // \brief every sample that reached process(), dropped ones included
+    std::uint64_t                                       getNumReceivedSamples() const;
+    // \brief most samples ever waiting in the ring, out of getRingSize()
+    size_t                                              getRingHighWater() const;
+    size_t                                              getRingSize() const { return mRingSize; }
+    // \brief when the block holding sample sampleIndex (counted over every sample that
+    // made it into the ring) reached process(). Indices have to be asked for in
+    // increasing order, older stamps are discarded.
+    std::chrono::steady_clock::time_point               getCaptureTime(std::uint64_t sampleIndex);
+
+protected:
+    void                                                initialize() override;
+    void                                                process(ci::audio::Buffer* buffer) override;
+
+private:
+    // \brief queues numFrames mono samples that arrived at arrival, or counts them dropped
+    void                                                writeMono(const float* samples, size_t numFrames, std::chrono::steady_clock::time_point arrival);
+
+private:
+    struct CaptureStamp
+    {
+        // one past the last sample of the block, and when the block arrived
+        std::uint64_t                                   mEndSample;
+        std::chrono::steady_clock::time_point           mTime;
+    };
+
+    ci::audio::dsp::RingBuffer                          mRingBuffer;
+    std::vector<float>                                  mMixBuffer;
+    SpscQueue<CaptureStamp>                             mStamps;
+    std::atomic<std::uint64_t>                          mNumDroppedSamples;
+    std::atomic<std::uint64_t>                          mNumWrittenSamples;
+    std::atomic<size_t>                                 mRingHighWater;
+    size_t                                              mRingSize;
+};
+
+/*!
+ * \struct SpectralFrame
+ * \brief one STFT analysis frame. The frame covers input samples
+ * [mSampleIndex, mSampleIndex + window size) counted from the moment
+ * the engine was set up. mMagnitudes[i] is the magnitude of bin
+ * StftEngine::getFirstBin() + i. mCaptureTime is when the newest sample
+ * the frame needed was captured (queued, for offline analysis), the
+ * start of its capture to screen latency. mGeneration is the engine
+ * configuration that computed the frame, see StftEngine::getGeneration().
+ * mWindowSize and mHopSize are that configuration's, in samples, which may
+ * already differ from getGeometry() while a reconfigure is on its way.
+ * mIndexStep is how far mSampleIndex advances from one frame to the next.
+ */
+struct SpectralFrame
+{
+    std::vector<float>                                  mMagnitudes;
+    std::uint64_t                                       mSampleIndex;
+    std::chrono::steady_clock::time_point               mCaptureTime;
+    std::uint32_t                                       mGeneration;
+    std::size_t                                         mWindowSize;
+    std::size_t                                         mHopSize;
+    std::size_t                                         mIndexStep;
+};
+
+/*!
+ * \class StftEngine
+ * \brief a single short-time Fourier transform over a shared input ring.
+ * Frames are emitted every hopSize samples, so overlap is sample accurate
+ * regardless of how often process() gets called. The transform itself is
+ * a dsp::StreamingStft, this class adds the thread, queue and sources.
+ * \note after start() all FFT work happens on a dedicated analysis thread
+ * which pushes finished frames into a lock-free queue. The render thread
+ * only ever calls popFrame(). reconfigure() plans a new transform on a
+ * second, planner thread and the analysis thread swaps it in between two
+ * frames, so live input never stops for a parameter change.
+ */
+class StftEngine
+{
+public:
+    StftEngine();
+    ~StftEngine();
+
+    // \brief (re)allocates FFT, window and history for the given geometry. fftSize
+    // is rounded up to a power of two that is at least windowSize. A non-zero
+    // zoomMaxFreq switches to the decimating zoom front end for 0..zoomMaxFreq,
+    // keeping the bin spacing of fftSize while transforming far fewer points.
+    void                                                setup(size_t fftSize, size_t windowSize, size_t hopSize, size_t sampleRate, float zoomMaxFreq = 0.0f);
+    // \brief restricts frames to bins [firstBin, firstBin + numBins), the rest of the
+    // spectrum is not computed at all. setup() resets this to every bin. Restarts the
+    // analysis thread if it was running.
+    void                                                setBinRange(size_t firstBin, size_t numBins);
+    // \brief setup() plus setBinRange() without stopping a running live analysis: the new
+    // transform is planned off-thread and replaces the old one at its next hop boundary,
+    // primed with the most recent input so the first new frame has a full window. Returns
+    // right away with the generation the new frames will carry. The getters report the
+    // requested geometry at once, isZoomed() and the method name once it's planned.
+    // Without live analysis running this is setup() plus setBinRange().
+    std::uint32_t                                       reconfigure(size_t fftSize, size_t windowSize, size_t hopSize, float zoomMaxFreq, size_t firstBin, size_t numBins);
+    // \brief the configuration the latest setup(), setBinRange() or reconfigure() asked for
+    std::uint32_t                                       getGeneration() const { return mGeneration.load(); }
+    // \brief starts the analysis thread reading from source. Call setup() first.
+    void                                                start(const std::shared_ptr<CaptureNode>& source);
+    // \brief starts the analysis thread on a whole file instead of live input, as fast as
+    // dsp::OfflineStft gets through it. Frames are never dropped, the thread waits for room
+    // in the queue instead. Call setup() with the file's sample rate first.
+    void                                                startOffline(const std::shared_ptr<dsp::AudioFile>& file);
+    // \brief stops and joins the analysis thread, queued frames are kept
+    void                                                stop();
+    // \brief drains the capture ring and queues every frame whose hop boundary got crossed
+    void                                                process(CaptureNode& source);
+    // \brief pops the oldest finished frame, returns false when the queue is empty
+    bool                                                popFrame(SpectralFrame& frame);
+    // \brief number of frames dropped because the queue was full
+    std::uint64_t                                       getNumDroppedFrames() const;
+    // \brief frames computed since setup(), dropped ones included
+    std::uint64_t                                       getNumProducedFrames() const;
+    // \brief frames live input should have produced by the time source received numReceived
+    // samples, reconfigure() included
+    std::uint64_t                                       getNumExpectedFrames(std::uint64_t numReceived) const;
+    // \brief most frames ever waiting in the queue since setup(), out of getFrameQueueCapacity()
+    size_t                                              getFrameQueueHighWater() const;
+    size_t                                              getFrameQueueCapacity() const { return mFrames.capacity(); }
+    // \brief copies the magnitudes of the most recently computed frame
+    void                                                copyLatestMagnitudes(std::vector<float>& dest) const;
+
+    // \brief the FFT size that sets the bin spacing, sampleRate / getFftSize() Hz per bin
+    size_t                                              getFftSize() const { return getGeometry().mFftSize; }
+    // \brief the size of the transform actually computed per frame
+    size_t                                              getTransformSize() const { return getGeometry().mTransformSize; }
+    size_t                                              getNumBins() const { return getGeometry().mNumBins; }
+    // \brief bins per emitted frame, frame bin i is spectrum bin getFirstBin() + i
+    size_t                                              getNumOutputBins() const { return getGeometry().mNumOutputBins; }
+    size_t                                              getFirstBin() const { return getGeometry().mFirstBin; }
+    // \brief name of the method computing the requested bins, for display
+    const char*                                         getBinRangeMethodName() const { return getGeometry().mMethodName; }
+    bool                                                isZoomed() const { return getGeometry().mZoomed; }
+    // \brief fraction of the offline file queued so far, 0 for live input
+    double                                              getOfflineProgress() const;
+    size_t                                              getWindowSize() const { return getGeometry().mWindowSize; }
+    size_t                                              getHopSize() const { return getGeometry().mHopSize; }
+    size_t                                              getSampleRate() const { return getGeometry().mSampleRate; }
+    // \brief seconds of live input the PCM history keeps, applies from the next setup() on
+    void                                                setPcmHistorySeconds(double seconds) { mPcmHistorySeconds = seconds; }
+    // \brief every live sample read since setup(), indexed like SpectralFrame::mSampleIndex,
+    // as far back as the history reaches. process() writes it on the analysis thread as it
+    // reads the capture ring, so samples the capture ring dropped never get here, the stream
+    // just continues without them. Offline analysis doesn't write it.
+    const dsp::PcmHistory&                              getPcmHistory() const { return mPcmHistory; }
+
+private:
+    /*!
+     * \struct Geometry
+     * \brief what the getters report. The analysis thread owns mStft, so the
+     * main thread reads this copy instead, published under mGeometryMutex.
+     */
+    struct Geometry
+    {
+        size_t                                          mFftSize = 0;
+        size_t                                          mTransformSize = 0;
+        size_t                                          mNumBins = 0;
+        size_t                                          mNumOutputBins = 0;
+        size_t                                          mFirstBin = 0;
+        size_t                                          mWindowSize = 0;
+        size_t                                          mHopSize = 0;
+        size_t                                          mSampleRate = 0;
+        bool                                            mZoomed = false;
+        const char*                                     mMethodName = "";
+        // frames produced before the current transform, the stream sample its first frame ends
+        // at and its hop, what getNumExpectedFrames() counts from
+        std::uint64_t                                   mExpectedBase = 0;
+        std::uint64_t                                   mFirstFrameEnd = 0;
+        size_t                                          mFrameSpacing = 0;
+    };
+
+    struct PlanRequest
+    {
+        size_t                                          mFftSize;
+        size_t                                          mWindowSize;
+        size_t                                          mHopSize;
+        size_t                                          mSampleRate;
+        float                                           mZoomMaxFreq;
+        size_t                                          mFirstBin;
+        size_t                                          mNumBins;
+        std::uint32_t                                   mGeneration;
+    };
+
+    Geometry                                            getGeometry() const;
+    // \brief copies the transform's geometry into mGeometry, leaving the frame counting fields.
+    // Call with mGeometryMutex held.
+    void                                                publishGeometry(const dsp::StreamingStft& stft);
+    void                                                computeFrame(std::chrono::steady_clock::time_point captureTime);
+    // \brief publishes the frame from mFrames.beginWrite() and updates the counters
+    void                                                commitFrame();
+    void                                                run();
+    void                                                runOffline();
+    // \brief plans the latest reconfigure() request, older ones still waiting are skipped
+    void                                                runPlanner();
+    void                                                stopPlanner();
+    // \brief drops a planned transform, or a request for one, that setup() made obsolete
+    void                                                discardPlan();
+    // \brief on the analysis thread between two frames: takes over a planned transform
+    void                                                swapPlanned();
+    // \brief keeps the last mRecent.size() samples read from the source
+    void                                                rememberSamples(const float* samples, size_t count);
+
+private:
+    // owned by the analysis thread while it runs
+    dsp::StreamingStft                                  mStft;
+    std::uint32_t                                       mStftGeneration;
+    // samples read before mStft started counting, mStft sample indices plus this are stream indices
+    std::uint64_t                                       mStreamOffset;
+    // the last second of input, what a swapped in transform gets primed with
+    std::vector<float>                                  mRecent;
+    size_t                                              mRecentPos;
+    size_t                                              mRecentFill;
+    // the last minutes of input as the analysis thread read it, preallocated so it never waits on readers
+    dsp::PcmHistory                                     mPcmHistory;
+    double                                              mPcmHistorySeconds;
+    std::vector<float>                                  mReadBuffer;
+    std::vector<float>                                  mLatestMagnitudes;
+    mutable std::mutex                                  mLatestMutex;
+    SpscQueue<SpectralFrame>                            mFrames;
+    std::shared_ptr<CaptureNode>                        mSource;
+    // offline source, the analyzer is planned from this engine's geometry on start
+    std::shared_ptr<dsp::AudioFile>                     mOfflineFile;
+    std::unique_ptr<dsp::OfflineStft>                   mOffline;
+    std::vector<float>                                  mOfflineBlock;
+    std::atomic<std::size_t>                            mOfflineNextFrame;
+    std::size_t                                         mOfflineNumFrames;
+    std::thread                                         mThread;
+    std::atomic<bool>                                   mRunning;
+    std::atomic<std::uint64_t>                          mNumDroppedFrames;
+    std::atomic<std::uint64_t>                          mNumProducedFrames;
+    std::atomic<size_t>                                 mFrameQueueHighWater;
+    std::atomic<std::uint32_t>                          mGeneration;
+    mutable std::mutex                                  mGeometryMutex;
+    Geometry                                            mGeometry;
+    // reconfigure() hands requests to the planner thread, which hands back a ready transform
+    std::thread                                         mPlanner;
+    std::mutex                                          mPlanMutex;
+    std::condition_variable                             mPlanCondition;
+    bool                                                mPlannerRunning;
+    bool                                                mPlanRequested;
+    PlanRequest                                         mPlanRequest;
+    std::unique_ptr<dsp::StreamingStft>                 mPlanned;
+    std::uint32_t                                       mPlannedGeneration;
+    std::atomic<bool>                                   mHasPlanned;
+};
+
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_AUDIO_STFT_H_
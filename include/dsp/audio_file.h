@@ -0,0 +1,118 @@
+#ifndef CIEQ_INCLUDE_DSP_AUDIO_FILE_H_
+#define CIEQ_INCLUDE_DSP_AUDIO_FILE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class MappedFile
+ * \brief read-only memory mapping of a whole file. Pages are only read in
+ * when touched, so opening a long recording costs nothing up front.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// \brief maps path, unmapping whatever was mapped before. Returns false on failure.
+	bool				open(const std::string& path);
+	void				close();
+
+	const std::uint8_t*	getData() const { return mData; }
+	std::size_t			getSize() const { return mSize; }
+	bool				isOpen() const { return mData != nullptr; }
+
+private:
+	const std::uint8_t*	mData;
+	std::size_t			mSize;
+#if defined(_WIN32)
+	void*				mFileHandle;
+	void*				mMappingHandle;
+#endif
+};
+
+enum class SampleFormat
+{
+	UINT8,
+	INT8,
+	INT16,
+	INT24,
+	INT32,
+	FLOAT32,
+	FLOAT64
+};
+
+/*!
+ * \struct RawFormat
+ * \brief layout of headerless PCM, interleaved frames of numChannels samples
+ * starting headerBytes into the file.
+ */
+struct RawFormat
+{
+	SampleFormat		mSampleFormat = SampleFormat::INT16;
+	std::size_t			mNumChannels = 1;
+	std::size_t			mSampleRate = 44100;
+	std::size_t			mHeaderBytes = 0;
+	bool				mBigEndian = false;
+};
+
+/*!
+ * \class AudioFile
+ * \brief interleaved PCM straight out of a memory-mapped WAV, AIFF / AIFF-C
+ * or raw file. Samples are decoded on demand, nothing is copied at open.
+ * \note readMono() is const and keeps no state, any number of threads can
+ * read different parts of the same file at once.
+ */
+class AudioFile
+{
+public:
+	AudioFile();
+
+	// \brief opens a WAV (PCM, float, extensible) or AIFF / AIFF-C (NONE, twos,
+	// sowt, fl32, fl64) file, telling them apart by their header
+	bool				open(const std::string& path);
+	// \brief opens headerless PCM laid out as described by format
+	bool				openRaw(const std::string& path, const RawFormat& format);
+	// \brief reason the last open() / openRaw() failed
+	const std::string&	getError() const { return mError; }
+
+	// \brief decodes frames [firstFrame, firstFrame + count) into dest, averaging all
+	// channels down to mono the same way CaptureNode does for live input. Frames
+	// past the end of the file are written as zeros. Returns the number of real frames.
+	std::size_t			readMono(std::size_t firstFrame, std::size_t count, float* dest) const;
+
+	std::size_t			getSampleRate() const { return mFormat.mSampleRate; }
+	std::size_t			getNumChannels() const { return mFormat.mNumChannels; }
+	std::size_t			getNumFrames() const { return mNumFrames; }
+	SampleFormat		getSampleFormat() const { return mFormat.mSampleFormat; }
+	double				getDurationSeconds() const;
+	bool				isOpen() const { return mSamples != nullptr; }
+
+private:
+	bool				parseWav();
+	bool				parseAiff();
+	bool				fail(const std::string& error);
+
+private:
+	MappedFile			mFile;
+	RawFormat			mFormat;
+	const std::uint8_t*	mSamples;
+	std::size_t			mBytesPerSample;
+	std::size_t			mNumFrames;
+	std::string			mError;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_AUDIO_FILE_H_
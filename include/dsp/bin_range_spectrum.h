@@ -0,0 +1,88 @@
+#ifndef CIEQ_INCLUDE_DSP_BIN_RANGE_SPECTRUM_H_
+#define CIEQ_INCLUDE_DSP_BIN_RANGE_SPECTRUM_H_
+
+#include "dsp/fft.h"
+#include "dsp/plan_cache.h"
+#include "dsp/real_fft.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class BinRangeSpectrum
+ * \brief magnitudes of a contiguous range of bins of an fftSize-point DFT of a
+ * windowed, zero padded frame, without computing the rest of the spectrum.
+ * \note three ways to get there, setup() picks the cheapest for the range:
+ * - PRUNED_FFT: the real FFT with both the zero padding and every butterfly
+ *   feeding an unused bin pruned away. Best when the range starts near DC.
+ * - CHIRP_Z: Bluestein's chirp-z transform over just the requested bins, a
+ *   convolution of length window + numBins. Best for a narrow band far from DC.
+ * - GOERTZEL: one second-order recursion per bin over the window. Best when
+ *   only a handful of bins are needed.
+ */
+class BinRangeSpectrum
+{
+public:
+	enum class Method { PRUNED_FFT, CHIRP_Z, GOERTZEL };
+
+	BinRangeSpectrum();
+
+	// \brief plans for bins [firstBin, firstBin + numBins) of an fftSize-point transform
+	// over windowSize non-zero samples, picking the method FftWisdom has measured fastest
+	// or else whichever is estimated cheapest. fftSize must be a power of two, numBins is
+	// clamped to fftSize / 2 - firstBin.
+	void				setup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins);
+	// \brief same, with the method forced (benchmarks and cross-checking)
+	void				setup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, Method method);
+	// \brief windowed holds windowSize samples. Writes getNumBins() magnitudes
+	// |X[k]| / fftSize, the same scaling the full spectrum used.
+	void				computeMagnitudes(const float* windowed, float* magnitudes);
+
+	Method				getMethod() const { return mMethod; }
+	std::size_t			getFftSize() const { return mFftSize; }
+	std::size_t			getWindowSize() const { return mWindowSize; }
+	std::size_t			getFirstBin() const { return mFirstBin; }
+	std::size_t			getNumBins() const { return mNumBins; }
+
+	static const char*	getMethodName(Method method);
+
+private:
+	void				setupPrunedFft();
+	void				setupChirpZ();
+	void				setupGoertzel();
+	// \brief rough real flop counts, only their ratios matter
+	std::size_t			estimateChirpZCost() const;
+	std::size_t			estimateGoertzelCost() const;
+	void				computePrunedFft(const float* windowed, float* magnitudes);
+	void				computeChirpZ(const float* windowed, float* magnitudes);
+	void				computeGoertzel(const float* windowed, float* magnitudes);
+
+private:
+	Method				mMethod;
+	std::size_t			mFftSize;
+	std::size_t			mWindowSize;
+	std::size_t			mFirstBin;
+	std::size_t			mNumBins;
+	// pruned FFT
+	std::unique_ptr<RealFft>	mRealFft;
+	std::vector<Complex>	mSpectrum;
+	// chirp-z, mChirpSize point convolution of the pre-chirped input with the kernel's response
+	std::size_t			mChirpSize;
+	std::shared_ptr<const ChirpZKernel>	mChirpKernel;
+	std::vector<Complex>	mChirpBuffer;
+	std::unique_ptr<ComplexFft>	mChirpForward;
+	std::unique_ptr<ComplexFft>	mChirpInverse;
+	// goertzel, 2 cos(2 pi k / fftSize) per bin
+	std::vector<double>	mCoefficients;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_BIN_RANGE_SPECTRUM_H_
@@ -0,0 +1,77 @@
+#ifndef CIEQ_INCLUDE_DSP_COLORMAP_H_
+#define CIEQ_INCLUDE_DSP_COLORMAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+enum class Palette
+{
+	JET,
+	VIRIDIS,
+	GRAYSCALE
+};
+
+const std::size_t kNumPalettes = 3;
+
+//! \brief fills rgb[0..3 * numEntries) with RGB triples in [0, 1], entry i is the colour of v = i / (numEntries - 1)
+void			generatePalette(Palette palette, float* rgb, std::size_t numEntries);
+//! \brief the colour of a single v in [0, 1] (clamped)
+void			paletteColor(Palette palette, float v, float* rgb);
+//! \brief display name, e.g. for a params enum
+const char*		getPaletteName(Palette palette);
+
+enum class SimdLevel
+{
+	SCALAR,
+	SSE2,
+	AVX2
+};
+
+//! \brief the widest instruction set both this build and the running CPU support
+SimdLevel		getSupportedSimdLevel();
+const char*		getSimdLevelName(SimdLevel level);
+
+/*!
+ * \class ColormapLut
+ * \brief turns rows of spectral magnitudes into packed RGBA8 pixels on the CPU,
+ * for when there is no shader to do it (headless export, old GL drivers).
+ * \note per pixel: linear gain or dB (the curve of ci::audio::linearToDecibel,
+ * through a polynomial log2 good to ~0.001 dB), clamp to [0, 1], quantize
+ * into a precomputed palette table and gather. No branches, 8 pixels per
+ * step with AVX2, 4 with SSE2, and a scalar loop computing the same thing.
+ */
+class ColormapLut
+{
+public:
+	static const std::size_t kDefaultSize = 4096;
+
+	ColormapLut();
+
+	// \brief (re)builds the table, entry i is the colour of v = i / (numEntries - 1)
+	void				setup(Palette palette, std::size_t numEntries = kDefaultSize);
+	// \brief forces a narrower code path (benchmarks), clamped to getSupportedSimdLevel()
+	void				setSimdLevel(SimdLevel level);
+	// \brief linear mode: v = maxMag * m. dB mode: v = linearToDecibel(m) / maxMag.
+	// Writes count pixels as 0xAABBGGRR, i.e. R, G, B, A in memory (GL_RGBA / GL_UNSIGNED_BYTE).
+	void				mapRow(const float* magnitudes, std::size_t count, float maxMag, bool dbMode, std::uint32_t* rgba) const;
+
+	Palette				getPalette() const { return mPalette; }
+	std::size_t			getNumEntries() const { return mEntries.size(); }
+	SimdLevel			getSimdLevel() const { return mSimdLevel; }
+
+private:
+	std::vector<std::uint32_t>	mEntries;
+	Palette				mPalette;
+	SimdLevel			mSimdLevel;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_COLORMAP_H_
@@ -0,0 +1,67 @@
+#ifndef CIEQ_INCLUDE_DSP_FFT_H_
+#define CIEQ_INCLUDE_DSP_FFT_H_
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+using Complex = std::complex<float>;
+
+/*!
+ * \class ComplexFft
+ * \brief in-place radix-2 decimation-in-frequency FFT over complex samples.
+ * Twiddles and the bit-reversal permutation come from the PlanCache, shared
+ * with every other transform of the same size, so forward() does no allocation.
+ * \note both ends can be pruned: a zero tail of the input skips the early
+ * butterflies, an output mask skips the late ones whose results nobody reads.
+ */
+class ComplexFft
+{
+public:
+	// \brief size must be a power of two
+	explicit ComplexFft(std::size_t size);
+
+	// \brief computes X[k] = sum x[n] e^(-j 2 pi n k / N) in place. If the caller
+	// guarantees data[numNonZero..N) is zero, the butterflies that would only
+	// combine zeros are skipped (input pruning).
+	void				forward(Complex* data, std::size_t numNonZero = static_cast<std::size_t>(-1)) const;
+	// \brief same as forward() but leaves X[k] at data[getBitReverse(k)], saving the
+	// reordering pass for callers that gather the bins they need anyway
+	void				forwardBitReversed(Complex* data, std::size_t numNonZero = static_cast<std::size_t>(-1)) const;
+	std::size_t			getBitReverse(std::size_t index) const { return (*mBitReverse)[index]; }
+	// \brief restricts the outputs forward() has to get right to the bins k with
+	// neededBins[k] != 0 (output pruning), everything else is left undefined.
+	// An empty vector computes all of them again.
+	void				setOutputMask(const std::vector<std::uint8_t>& neededBins);
+	// \brief number of butterfly points forward() evaluates for this input length and
+	// the current output mask, for comparing against other ways to get the same bins
+	std::size_t			countOperations(std::size_t numNonZero) const;
+
+	std::size_t			getSize() const { return mSize; }
+
+private:
+	std::size_t				mSize;
+	std::shared_ptr<const std::vector<Complex>>	mTwiddles;
+	std::shared_ptr<const std::vector<std::size_t>>	mBitReverse;
+	// implicit binary tree over the bit-reversed output positions, leaves at
+	// [size, 2 size), node size / h + i is non-zero if the aligned block of h
+	// positions starting at i * h holds a needed output. Empty when unpruned.
+	std::vector<std::uint8_t>	mNeeded;
+};
+
+//! \brief true if value is a non-zero power of two
+bool			isPowerOf2(std::size_t value);
+//! \brief smallest power of two that is >= value
+std::size_t		nextPowerOf2(std::size_t value);
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_FFT_H_
@@ -0,0 +1,64 @@
+#ifndef CIEQ_INCLUDE_DSP_FFT_WISDOM_H_
+#define CIEQ_INCLUDE_DSP_FFT_WISDOM_H_
+
+#include "dsp/bin_range_spectrum.h"
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class FftWisdom
+ * \brief which BinRangeSpectrum method measured fastest on this machine, per
+ * transform geometry, kept in a file between runs. The timing and the
+ * planning of the losing methods then happen once, not on every launch.
+ * \note thread safe. Measuring is off by default: geometries not known yet
+ * fall back to BinRangeSpectrum's operation count estimates, unrecorded.
+ */
+class FftWisdom
+{
+public:
+	static FftWisdom&	get();
+
+	// \brief merges the entries of a file written by save(). A missing file, or one of
+	// another format version, just means nothing is known yet. Returns false on a
+	// malformed file, see getError().
+	bool				load(const std::string& path);
+	// \brief writes every entry, the directory has to exist
+	bool				save(const std::string& path);
+	std::string			getError() const;
+
+	bool				lookup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method& method) const;
+	void				record(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method method);
+	// \brief BinRangeSpectrum times the methods worth trying on geometries not known yet
+	// and records the fastest from now on
+	void				setMeasuring(bool measuring);
+	bool				isMeasuring() const;
+	// \brief true if record() added something since the last load() or save()
+	bool				isDirty() const;
+	std::size_t			getNumEntries() const;
+
+private:
+	using Key = std::tuple<std::size_t, std::size_t, std::size_t, std::size_t>;
+
+	FftWisdom();
+
+private:
+	mutable std::mutex	mMutex;
+	std::map<Key, BinRangeSpectrum::Method>	mEntries;
+	std::string			mError;
+	bool				mMeasuring;
+	bool				mDirty;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_FFT_WISDOM_H_
@@ -0,0 +1,51 @@
+#ifndef CIEQ_INCLUDE_DSP_LATENCY_HISTOGRAM_H_
+#define CIEQ_INCLUDE_DSP_LATENCY_HISTOGRAM_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class LatencyHistogram
+ * \brief rolling histogram of the last getWindow() latencies, for percentiles
+ * that follow the current configuration instead of averaging over all of it.
+ * \note buckets are log spaced, kBucketsPerDecade per decade from 10 us to
+ * 100 s, so a percentile is good to about 3% of its value. Adding is O(1),
+ * a percentile walks the buckets once.
+ */
+class LatencyHistogram
+{
+public:
+	static const std::size_t kBucketsPerDecade = 40;
+
+	explicit LatencyHistogram(std::size_t window = 512);
+
+	void				add(double seconds);
+	void				clear();
+	// \brief latency in seconds that fraction p in [0, 1] of the window is at or below, 0 when empty
+	double				getPercentile(double p) const;
+	// \brief latencies currently in the window
+	std::size_t			getCount() const { return mCount; }
+	std::size_t			getWindow() const { return mHistory.size(); }
+
+private:
+	static std::size_t	getBucket(double seconds);
+	static double		getBucketValue(std::size_t bucket);
+
+private:
+	std::vector<std::uint32_t>	mCounts;
+	// bucket of every latency in the window, oldest at mNext once full
+	std::vector<std::uint16_t>	mHistory;
+	std::size_t			mNext;
+	std::size_t			mCount;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_LATENCY_HISTOGRAM_H_
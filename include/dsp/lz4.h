@@ -0,0 +1,24 @@
+#ifndef CIEQ_INCLUDE_DSP_LZ4_H_
+#define CIEQ_INCLUDE_DSP_LZ4_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+//! \brief compresses size bytes into an LZ4 block (the raw block format, no frame
+//! header), readable by LZ4_decompress_safe(). Greedy single-probe matching: fast
+//! rather than small, it runs next to live analysis. Replaces the contents of dest.
+void			lz4Compress(const std::uint8_t* source, std::size_t size, std::vector<std::uint8_t>& dest);
+//! \brief decodes an LZ4 block into exactly destSize bytes. Returns false on a corrupt
+//! block or a size mismatch, never reads or writes out of bounds.
+bool			lz4Decompress(const std::uint8_t* source, std::size_t sourceSize, std::uint8_t* dest, std::size_t destSize);
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_LZ4_H_
@@ -0,0 +1,52 @@
+#ifndef CIEQ_INCLUDE_DSP_MINMAX_PYRAMID_H_
+#define CIEQ_INCLUDE_DSP_MINMAX_PYRAMID_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class MinMaxPyramid
+ * \brief min/max decimation pyramid over a block of samples, for drawing a
+ * waveform at any zoom with a bounded number of vertices.
+ * \note level k holds the min and max of each aligned block of 2^k samples,
+ * level 0 is the samples themselves. Building is one pass over the input plus
+ * half a pass per level above it (about 2 count comparisons in total), and an
+ * envelope query reads at most three blocks per column whatever the range.
+ */
+class MinMaxPyramid
+{
+public:
+	MinMaxPyramid();
+
+	// \brief rebuilds every level from samples[0..count). Storage is kept between
+	// calls, so rebuilding for a block of the same size does no allocation.
+	void				build(const float* samples, std::size_t count);
+	// \brief splits [first, first + length) into numColumns equal columns and writes
+	// the min and max sample of each to mins / maxs. The range is clamped to the
+	// samples passed to build(). Returns the level the envelope was read from.
+	std::size_t			envelope(std::size_t first, std::size_t length, std::size_t numColumns, float* mins, float* maxs) const;
+
+	// \brief coarsest level whose blocks are no longer than a column of
+	// length / numColumns samples, the one envelope() reads
+	std::size_t			selectLevel(std::size_t length, std::size_t numColumns) const;
+	std::size_t			getNumLevels() const { return mLevelOffsets.size(); }
+	std::size_t			getSize() const { return mSize; }
+
+private:
+	std::size_t			mSize;
+	// all levels back to back, level k starts at mLevelOffsets[k] and has
+	// ceil(mSize / 2^k) entries
+	std::vector<float>	mMins;
+	std::vector<float>	mMaxs;
+	std::vector<std::size_t>	mLevelOffsets;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_MINMAX_PYRAMID_H_
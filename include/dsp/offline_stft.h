@@ -0,0 +1,95 @@
+#ifndef CIEQ_INCLUDE_DSP_OFFLINE_STFT_H_
+#define CIEQ_INCLUDE_DSP_OFFLINE_STFT_H_
+
+#include "dsp/audio_file.h"
+#include "dsp/bin_range_spectrum.h"
+#include "dsp/zoom_fft.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class OfflineStft
+ * \brief the STFT of a whole file, as fast as the machine allows.
+ * Geometry, window, bin range and frame timing follow StftEngine exactly:
+ * frame f covers samples [f * hop, f * hop + window) and the magnitudes
+ * come from the same BinRangeSpectrum / ZoomFft code, so a file analysed
+ * here gives the same spectrogram it would give played into the app.
+ * \note full-band frames only depend on their own window of the file, so
+ * they are split across worker threads, each with its own plan. Zoom mode
+ * carries decimation state from frame to frame and runs on one thread.
+ */
+class OfflineStft
+{
+public:
+	OfflineStft();
+
+	// \brief same arguments and rounding rules as StftEngine::setup()
+	void				setup(std::size_t fftSize, std::size_t windowSize, std::size_t hopSize, std::size_t sampleRate, float zoomMaxFreq = 0.0f);
+	// \brief restricts frames to bins [firstBin, firstBin + numBins), like StftEngine::setBinRange()
+	void				setBinRange(std::size_t firstBin, std::size_t numBins);
+	// \brief number of worker threads for full-band analysis, 0 picks one per hardware thread
+	void				setNumThreads(std::size_t numThreads);
+
+	// \brief frames whose window lies completely inside numSamples input samples
+	std::size_t			getNumFrames(std::size_t numSamples) const;
+	// \brief writes frames [firstFrame, firstFrame + numFrames) of file as rows of
+	// getNumOutputBins() magnitudes. Zoom mode is fastest when consecutive calls
+	// continue where the previous one stopped, anything else restarts it from 0.
+	void				analyze(const AudioFile& file, std::size_t firstFrame, std::size_t numFrames, float* magnitudes);
+	// \brief first input sample of frame f, matches SpectralFrame::mSampleIndex
+	std::uint64_t		getFrameSampleIndex(std::size_t frame) const;
+
+	std::size_t			getFftSize() const { return mFftSize; }
+	std::size_t			getWindowSize() const { return mWindowSize; }
+	std::size_t			getHopSize() const { return mHopSize; }
+	std::size_t			getSampleRate() const { return mSampleRate; }
+	std::size_t			getNumBins() const { return mZoom ? mZoom->getNumBins() : mFftSize / 2; }
+	std::size_t			getNumOutputBins() const { return mNumOutputBins; }
+	std::size_t			getFirstBin() const { return mFirstBin; }
+	std::size_t			getNumThreads() const { return mNumThreads; }
+	bool				isZoomed() const { return mZoom != nullptr; }
+
+private:
+	void				planWorkers();
+	void				analyzeFullBand(const AudioFile& file, std::size_t worker, std::size_t firstFrame, std::size_t numFrames, float* magnitudes);
+	void				analyzeZoom(const AudioFile& file, std::size_t firstFrame, std::size_t numFrames, float* magnitudes);
+	void				resetZoom();
+
+private:
+	// one plan and scratch buffer per worker, BinRangeSpectrum keeps state while computing
+	struct Worker
+	{
+		std::unique_ptr<BinRangeSpectrum>	mBinRange;
+		std::vector<float>	mInput;
+	};
+
+	std::vector<Worker>	mWorkers;
+	std::shared_ptr<const std::vector<float>>	mWindow;
+	std::unique_ptr<ZoomFft>	mZoom;
+	std::vector<float>	mZoomInput;
+	std::vector<float>	mZoomMagnitudes;
+	// zoom progress, in input samples and in frames
+	std::uint64_t		mZoomSamplesConsumed;
+	std::size_t			mZoomNextFrame;
+	float				mZoomMaxFreq;
+	std::size_t			mFftSize;
+	std::size_t			mWindowSize;
+	std::size_t			mHopSize;
+	std::size_t			mSampleRate;
+	std::size_t			mFirstBin;
+	std::size_t			mNumOutputBins;
+	std::size_t			mNumThreads;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_OFFLINE_STFT_H_
@@ -0,0 +1,62 @@
+#ifndef CIEQ_INCLUDE_DSP_PCM_HISTORY_H_
+#define CIEQ_INCLUDE_DSP_PCM_HISTORY_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class PcmHistory
+ * \brief the last getCapacity() samples of a mono stream, addressed by their
+ * index in the stream. One thread appends with write() and never waits, any
+ * number of others copy ranges out with read() at the same time, e.g. to
+ * analyse a stretch of the past again at another resolution.
+ * \note the storage is allocated by setup() only. Readers never block the
+ * writer: a read that the writer overtook while copying is detected and
+ * fails instead, there is no lock anywhere.
+ */
+class PcmHistory
+{
+public:
+	PcmHistory();
+
+	PcmHistory(const PcmHistory&) = delete;
+	PcmHistory& operator=(const PcmHistory&) = delete;
+
+	// \brief allocates room for capacity samples and starts the stream over. Not thread
+	// safe, only call while nobody reads.
+	void				setup(std::size_t capacity);
+	// \brief writer side: the next sample written is stream sample 0 again. Reads already
+	// running finish on the samples they started with.
+	void				restart();
+	// \brief writer side: appends count samples, overwriting the oldest ones
+	void				write(const float* samples, std::size_t count);
+	// \brief any thread: copies stream samples [first, first + count) into dest. Returns
+	// false if any of them isn't written yet or was overwritten before the copy finished.
+	bool				read(std::uint64_t first, std::size_t count, float* dest) const;
+
+	std::size_t			getCapacity() const { return mSamples.size(); }
+	// \brief oldest stream sample still held, and one past the newest
+	std::uint64_t		getBegin() const;
+	std::uint64_t		getEnd() const;
+
+private:
+	std::vector<float>	mSamples;
+	// samples ever written, and how far the writer may be into overwriting (ahead of mWritten
+	// while a write() copies). Never reset, so an overtaken read always shows.
+	std::atomic<std::uint64_t>	mWritten;
+	std::atomic<std::uint64_t>	mReserved;
+	// mWritten when the stream last started over, stream sample 0
+	std::atomic<std::uint64_t>	mBase;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_PCM_HISTORY_H_
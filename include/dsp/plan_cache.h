@@ -0,0 +1,127 @@
+#ifndef CIEQ_INCLUDE_DSP_PLAN_CACHE_H_
+#define CIEQ_INCLUDE_DSP_PLAN_CACHE_H_
+
+#include "dsp/fft.h"
+#include "dsp/window.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \struct ChirpZKernel
+ * \brief the input independent half of Bluestein's chirp-z transform over
+ * bins [firstBin, firstBin + numBins) of an fftSize-point DFT, see
+ * BinRangeSpectrum.
+ */
+struct ChirpZKernel
+{
+	// convolution length, a power of two >= windowSize + numBins - 1
+	std::size_t			mChirpSize;
+	// W^(firstBin n + n^2 / 2) per input sample, W = e^(-j 2 pi / fftSize)
+	std::vector<Complex>	mPreChirp;
+	// FFT of the impulse response W^(-j^2 / 2), in bit-reversed order
+	std::vector<Complex>	mResponse;
+};
+
+/*!
+ * \class PlanCache
+ * \brief process-wide store of the read-only tables transforms are planned
+ * from: twiddles, bit-reversal permutations, window coefficients and chirp-z
+ * kernels, keyed by everything they depend on. Every ComplexFft, RealFft and
+ * analyzer of the same geometry shares one copy, and switching back to a
+ * recent configuration finds its tables already built.
+ * \note thread safe, tables are built outside the lock. Tables nobody holds
+ * any more stay cached up to the budget, least recently used ones go first.
+ */
+class PlanCache
+{
+public:
+	static const std::size_t kDefaultBudget = std::size_t(64) << 20;
+
+	static PlanCache&	get();
+
+	// \brief e^(-j 2 pi k / size) for k < size / 2
+	std::shared_ptr<const std::vector<Complex>>		getTwiddles(std::size_t size);
+	// \brief the bit-reversed index of every position of a size point FFT, size a power of two
+	std::shared_ptr<const std::vector<std::size_t>>	getBitReverse(std::size_t size);
+	// \brief length coefficients of the given window, see generateWindow()
+	std::shared_ptr<const std::vector<float>>		getWindow(WindowType type, std::size_t length);
+	std::shared_ptr<const ChirpZKernel>				getChirpZKernel(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins);
+
+	// \brief bytes the cache tries to stay under. Tables in use are never evicted, dropping
+	// them wouldn't free anything, so only idle ones go, least recently used first.
+	void				setBudget(std::size_t numBytes);
+	std::size_t			getBudget() const;
+	// \brief bytes of every cached table, in use or not
+	std::size_t			getNumBytes() const;
+	std::uint64_t		getNumHits() const;
+	std::uint64_t		getNumMisses() const;
+	// \brief forgets every table, whoever holds one keeps it
+	void				clear();
+
+private:
+	enum class TableType
+	{
+		TWIDDLES,
+		BIT_REVERSE,
+		WINDOW,
+		CHIRP_Z
+	};
+
+	// fields a table type doesn't depend on stay 0
+	struct Key
+	{
+		TableType		mTable;
+		std::size_t		mSize;
+		std::size_t		mLength;
+		std::size_t		mFirstBin;
+		std::size_t		mNumBins;
+		WindowType		mWindow;
+
+		explicit Key(TableType table);
+		bool operator<(const Key& other) const;
+	};
+
+	struct Entry
+	{
+		// the key's table type says what this points to
+		std::shared_ptr<const void>	mTable;
+		std::size_t		mNumBytes;
+		std::list<Key>::iterator	mRecent;
+	};
+
+	PlanCache();
+	// \brief the cached table for key marked most recently used, or nullptr
+	template <typename Table>
+	std::shared_ptr<const Table>	find(const Key& key);
+	// \brief caches table unless another thread got there first, returns the cached one
+	template <typename Table>
+	std::shared_ptr<const Table>	insert(const Key& key, const std::shared_ptr<const Table>& table, std::size_t numBytes);
+	// \brief drops least recently used tables nobody holds until the budget is met. Call with mMutex held.
+	void				evict();
+
+private:
+	mutable std::mutex	mMutex;
+	std::map<Key, Entry>	mEntries;
+	// most recently used first
+	std::list<Key>		mRecent;
+	std::size_t			mBudget;
+	std::size_t			mNumBytes;
+	std::uint64_t		mNumHits;
+	std::uint64_t		mNumMisses;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_PLAN_CACHE_H_
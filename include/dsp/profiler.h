@@ -0,0 +1,110 @@
+#ifndef CIEQ_INCLUDE_DSP_PROFILER_H_
+#define CIEQ_INCLUDE_DSP_PROFILER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//! build with -DCIEQ_ENABLE_PROFILING=0 and every zone compiles to nothing
+#ifndef CIEQ_ENABLE_PROFILING
+#define CIEQ_ENABLE_PROFILING 1
+#endif
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class Profiler
+ * \brief collects timed zones from any thread and exports them as a Chrome
+ * trace (chrome://tracing, ui.perfetto.dev).
+ * \note every thread records into a ring of its own, allocated the first
+ * time it records: no locks and no allocation on the hot path, and only
+ * the newest kEventsPerThread zones of each thread are kept.
+ */
+class Profiler
+{
+public:
+	static const std::size_t kEventsPerThread = 1 << 16;
+
+	static Profiler&	get();
+	// \brief steady clock in nanoseconds, the timebase of record()
+	static std::uint64_t now();
+
+	// \brief name must outlive the profiler, i.e. be a string literal
+	void				record(const char* name, std::uint64_t start, std::uint64_t end);
+	// \brief names the calling thread in the trace, cheap enough to call on every callback
+	void				setThreadName(const char* name);
+	// \brief writes every zone still in the rings, returns false if the file can't be written
+	bool				writeChromeTrace(const std::string& path) const;
+
+private:
+	struct Event
+	{
+		std::atomic<const char*>	mName;
+		std::atomic<std::uint64_t>	mStart;
+		std::atomic<std::uint64_t>	mDuration;
+	};
+
+	struct ThreadBuffer
+	{
+		std::unique_ptr<Event[]>	mEvents;
+		//! events recorded so far, slot = index % kEventsPerThread
+		std::atomic<std::uint64_t>	mHead;
+		std::atomic<const char*>	mName;
+		std::size_t		mId;
+	};
+
+	Profiler() = default;
+	ThreadBuffer&		getThreadBuffer();
+
+private:
+	// the calling thread's ring, set on its first record()
+	static thread_local ThreadBuffer*	sThreadBuffer;
+	mutable std::mutex	mBuffersMutex;
+	// never shrinks, so a thread's zones can be exported after it exits
+	std::vector<std::unique_ptr<ThreadBuffer>>	mBuffers;
+};
+
+/*!
+ * \class ProfileZone
+ * \brief records the time between its construction and destruction, use
+ * through CIEQ_PROFILE_ZONE("name").
+ */
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name)
+		: mName(name)
+		, mStart(Profiler::now())
+	{}
+	~ProfileZone() { Profiler::get().record(mName, mStart, Profiler::now()); }
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char*			mName;
+	std::uint64_t		mStart;
+};
+
+} //!dsp
+} //!cieq
+
+#if CIEQ_ENABLE_PROFILING
+#define CIEQ_PROFILE_CONCAT_IMPL(a, b) a##b
+#define CIEQ_PROFILE_CONCAT(a, b) CIEQ_PROFILE_CONCAT_IMPL(a, b)
+//! times the rest of the enclosing scope
+#define CIEQ_PROFILE_ZONE(name) ::cieq::dsp::ProfileZone CIEQ_PROFILE_CONCAT(cieqProfileZone, __LINE__)(name)
+#define CIEQ_PROFILE_THREAD(name) ::cieq::dsp::Profiler::get().setThreadName(name)
+#else
+#define CIEQ_PROFILE_ZONE(name) do {} while (0)
+#define CIEQ_PROFILE_THREAD(name) do {} while (0)
+#endif
+
+#endif //!CIEQ_INCLUDE_DSP_PROFILER_H_
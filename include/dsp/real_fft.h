@@ -0,0 +1,61 @@
+#ifndef CIEQ_INCLUDE_DSP_REAL_FFT_H_
+#define CIEQ_INCLUDE_DSP_REAL_FFT_H_
+
+#include "dsp/fft.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class RealFft
+ * \brief forward FFT of a real signal of which only the first numNonZero
+ * samples can be non-zero (a window followed by zero padding).
+ * \note the real input is packed into a half-size complex sequence whose
+ * FFT skips every butterfly that would only ever see zeros (input pruning).
+ * With L non-zero points the first log2(N / L) stages reduce to a single
+ * multiply per non-zero point, so the cost is about O(N log L) instead of
+ * O(N log N). Restricting the output bins prunes the last stages the
+ * same way from the other end.
+ */
+class RealFft
+{
+public:
+	// \brief size must be a power of two, >= 4
+	explicit RealFft(std::size_t size);
+
+	// \brief input holds size samples of which only input[0..numNonZero) are read,
+	// the rest is treated as zero. Writes getNumOutputBins() bins starting at
+	// getFirstBin() to spectrum, by default bins 0..size/2 - 1 (the nyquist bin
+	// is dropped).
+	void				forward(const float* input, std::size_t numNonZero, Complex* spectrum);
+	// \brief only bins [firstBin, firstBin + numBins) are computed from now on,
+	// butterflies that feed none of them are skipped (output pruning)
+	void				setOutputBins(std::size_t firstBin, std::size_t numBins);
+	// \brief rough real flop count of forward() for this input length and output range
+	std::size_t			estimateCost(std::size_t numNonZero) const;
+
+	std::size_t			getSize() const { return mSize; }
+	std::size_t			getFirstBin() const { return mFirstBin; }
+	std::size_t			getNumOutputBins() const { return mNumOutputBins; }
+
+private:
+	std::size_t			mSize;
+	std::size_t			mHalfSize;
+	std::size_t			mFirstBin;
+	std::size_t			mNumOutputBins;
+	// e^(-j 2 pi k / size) for k < size / 2
+	std::shared_ptr<const std::vector<Complex>>	mTwiddles;
+	std::vector<Complex>	mPacked;
+	std::unique_ptr<ComplexFft>	mFft;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_REAL_FFT_H_
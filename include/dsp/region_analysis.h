@@ -0,0 +1,119 @@
+#ifndef CIEQ_INCLUDE_DSP_REGION_ANALYSIS_H_
+#define CIEQ_INCLUDE_DSP_REGION_ANALYSIS_H_
+
+#include "dsp/pcm_history.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \struct RegionRequest
+ * \brief a stretch of time and band of frequencies to analyse again, and the
+ * STFT geometry to do it with
+ */
+struct RegionRequest
+{
+	// window centres of the first and the last row, in stream samples of the PcmHistory
+	std::uint64_t		mFirstSample = 0;
+	std::uint64_t		mLastSample = 0;
+	// only the bins covering this band are computed
+	float				mMinFreq = 0.0f;
+	float				mMaxFreq = 0.0f;
+	std::size_t			mSampleRate = 0;
+	// rounded up like StreamingStft::setup() does
+	std::size_t			mFftSize = 0;
+	std::size_t			mWindowSize = 0;
+	std::size_t			mHopSize = 0;
+};
+
+/*!
+ * \struct RegionResult
+ * \brief magnitudes of a RegionRequest, or why there are none
+ */
+struct RegionResult
+{
+	RegionRequest		mRequest;
+	// what RegionAnalyzer::analyze() returned for the request
+	std::uint32_t		mId = 0;
+	// bins [mFirstBin, mFirstBin + mNumBins) of an mFftSize point transform
+	std::size_t			mFftSize = 0;
+	std::size_t			mFirstBin = 0;
+	std::size_t			mNumBins = 0;
+	// row r is centred on mRequest.mFirstSample + r * mRequest.mHopSize, oldest first
+	std::size_t			mNumRows = 0;
+	std::vector<float>	mMagnitudes;
+	// empty if the region got analysed
+	std::string			mError;
+};
+
+/*!
+ * \class RegionAnalyzer
+ * \brief analyses regions of a PcmHistory on a worker thread of its own, so
+ * a detailed look at a few seconds doesn't cost the live analysis anything.
+ * \note only the newest request counts: a new one replaces the one waiting
+ * and cancels the one running. The worker starts with the first request.
+ */
+class RegionAnalyzer
+{
+public:
+	// \brief rows times bins a result may hold, 64 MB of magnitudes
+	static const std::size_t	kMaxResultValues = std::size_t(16) << 20;
+
+	RegionAnalyzer();
+	~RegionAnalyzer();
+
+	RegionAnalyzer(const RegionAnalyzer&) = delete;
+	RegionAnalyzer& operator=(const RegionAnalyzer&) = delete;
+
+	// \brief queues request, history has to stay set up until the result is out. Returns
+	// the id the result will carry.
+	std::uint32_t		analyze(const PcmHistory& history, const RegionRequest& request);
+	// \brief drops the waiting request and stops the running one, returns once the worker is idle
+	void				cancel();
+	// \brief moves the result of the newest request into result once it's done
+	bool				popResult(RegionResult& result);
+	bool				isBusy() const;
+	// \brief fraction of the running request's rows computed so far
+	float				getProgress() const { return mProgress.load(std::memory_order_relaxed); }
+
+private:
+	void				run();
+	// \brief computes request into result on the calling thread, false if it failed or got cancelled
+	bool				compute(const PcmHistory& history, const RegionRequest& request, RegionResult& result);
+	void				stopWorker();
+
+private:
+	std::thread			mWorker;
+	mutable std::mutex	mMutex;
+	std::condition_variable	mCondition;
+	bool				mWorkerRunning;
+	bool				mRequested;
+	bool				mComputing;
+	bool				mHasResult;
+	const PcmHistory*	mHistory;
+	RegionRequest		mRequest;
+	std::uint32_t		mRequestId;
+	std::uint32_t		mNextId;
+	RegionResult		mResult;
+	// set by a newer request or cancel(), checked between frames
+	std::atomic<bool>	mCancelled;
+	std::atomic<float>	mProgress;
+	// the running request's scratch, reused from one request to the next
+	std::vector<float>	mSamples;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_REGION_ANALYSIS_H_
@@ -0,0 +1,97 @@
+#ifndef CIEQ_INCLUDE_DSP_SIGNAL_GENERATOR_H_
+#define CIEQ_INCLUDE_DSP_SIGNAL_GENERATOR_H_
+
+#include "dsp/audio_file.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+enum class GeneratorType
+{
+	TONE,
+	MULTI_TONE,
+	SWEEP,
+	NOISE,
+	FILE_LOOP
+};
+
+/*!
+ * \struct GeneratorSettings
+ * \brief what a SignalGenerator produces. Every channel carries the same
+ * signal, except noise which is independent per channel.
+ */
+struct GeneratorSettings
+{
+	GeneratorType		mType = GeneratorType::TONE;
+	std::size_t			mSampleRate = 44100;
+	std::size_t			mNumChannels = 1;
+	// frames per rendered block, the size an audio device would deliver
+	std::size_t			mBlockSize = 512;
+	// peak amplitude, multi-tone splits it evenly over the tones
+	float				mAmplitude = 0.5f;
+	// tone: the first one, multi-tone: all of them
+	std::vector<float>	mFrequencies = std::vector<float>(1, 1000.0f);
+	// exponential sweep from mSweepStart to mSweepEnd Hz, restarting every mSweepSeconds
+	float				mSweepStart = 20.0f;
+	float				mSweepEnd = 20000.0f;
+	double				mSweepSeconds = 10.0;
+	std::uint32_t		mSeed = 1;
+	// file loop: a WAV / AIFF file played mono on every channel, its sample rate wins
+	std::string			mPath;
+	// paced like a sound card, otherwise as fast as the consumer takes the samples
+	bool				mRealTime = true;
+};
+
+//! \brief parses "type=sweep,from=20,to=20000,seconds=10,rate=48000,channels=2,clock=free".
+//! Types are tone, multitone, sweep, noise and file. Frequencies are given as freq=440+1000+5000,
+//! other keys: amp, block, seed, path. Returns false and describes the problem in error.
+bool			parseGeneratorSettings(const std::string& spec, GeneratorSettings& settings, std::string& error);
+const char*		getGeneratorTypeName(GeneratorType type);
+
+/*!
+ * \class SignalGenerator
+ * \brief deterministic test input: the same settings always give the same
+ * samples, block after block, so load scenarios can be replayed exactly.
+ */
+class SignalGenerator
+{
+public:
+	SignalGenerator();
+
+	// \brief returns false if the settings can't be used (e.g. the file can't be read), see getError()
+	bool				setup(const GeneratorSettings& settings);
+	// \brief writes numFrames frames for every channel, channel c at channels + c * numFrames
+	void				render(float* channels, std::size_t numFrames);
+
+	const GeneratorSettings&	getSettings() const { return mSettings; }
+	std::size_t			getSampleRate() const { return mSettings.mSampleRate; }
+	std::size_t			getNumChannels() const { return mSettings.mNumChannels; }
+	const std::string&	getError() const { return mError; }
+
+private:
+	void				renderMono(float* dest, std::size_t numFrames);
+
+private:
+	GeneratorSettings	mSettings;
+	std::string			mError;
+	// one phase per tone, in cycles, kept in [0, 1)
+	std::vector<double>	mPhases;
+	// time into the current sweep, in samples
+	std::uint64_t		mSweepPosition;
+	std::vector<std::mt19937>	mNoise;
+	AudioFile			mFile;
+	std::size_t			mFilePosition;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SIGNAL_GENERATOR_H_
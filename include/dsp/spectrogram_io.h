@@ -0,0 +1,94 @@
+#ifndef CIEQ_INCLUDE_DSP_SPECTROGRAM_IO_H_
+#define CIEQ_INCLUDE_DSP_SPECTROGRAM_IO_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class PngWriter
+ * \brief streams an RGBA8 image into a PNG file a few rows at a time, so a
+ * spectrogram of any length never has to be held in memory as a whole.
+ * \note no zlib needed: rows are "Up" filtered (spectrogram columns change
+ * slowly) and compressed with a small fixed-Huffman LZ77 encoder, one
+ * deflate block per appendRows() call.
+ */
+class PngWriter
+{
+public:
+	PngWriter();
+	~PngWriter();
+
+	PngWriter(const PngWriter&) = delete;
+	PngWriter& operator=(const PngWriter&) = delete;
+
+	// \brief writes the header for a width x height image, returns false if the file can't be created
+	bool				open(const std::string& path, std::size_t width, std::size_t height);
+	// \brief appends numRows rows of width pixels, 0xAABBGGRR as ColormapLut::mapRow() writes them
+	bool				appendRows(const std::uint32_t* rgba, std::size_t numRows);
+	// \brief pads missing rows with black and writes the trailer, returns false if anything failed
+	bool				close();
+
+private:
+	void				putBits(std::uint32_t bits, std::size_t count);
+	void				putHuffman(std::uint32_t code, std::size_t length);
+	void				putLiteral(std::uint8_t value);
+	void				putMatch(std::size_t length, std::size_t distance);
+	void				deflate(const std::uint8_t* data, std::size_t size, bool last);
+	void				flushIdat();
+	void				writeChunk(const char* type, const std::uint8_t* data, std::size_t size);
+
+private:
+	std::FILE*			mFile;
+	std::size_t			mWidth;
+	std::size_t			mHeight;
+	std::size_t			mRowsWritten;
+	bool				mFailed;
+	std::vector<std::uint8_t>	mPreviousRow;
+	std::vector<std::uint8_t>	mFiltered;
+	std::vector<std::int32_t>	mHashHeads;
+	std::vector<std::uint8_t>	mIdat;
+	std::uint32_t		mBitBuffer;
+	std::size_t			mBitCount;
+	std::uint32_t		mAdlerA;
+	std::uint32_t		mAdlerB;
+};
+
+/*!
+ * \class NpyWriter
+ * \brief streams a rows x columns float32 matrix into a NumPy .npy file,
+ * readable with numpy.load() or numpy.memmap().
+ */
+class NpyWriter
+{
+public:
+	NpyWriter();
+	~NpyWriter();
+
+	NpyWriter(const NpyWriter&) = delete;
+	NpyWriter& operator=(const NpyWriter&) = delete;
+
+	bool				open(const std::string& path, std::size_t rows, std::size_t columns);
+	bool				appendRows(const float* data, std::size_t numRows);
+	// \brief pads missing rows with zeros so the shape in the header holds
+	bool				close();
+
+private:
+	std::FILE*			mFile;
+	std::size_t			mRows;
+	std::size_t			mColumns;
+	std::size_t			mRowsWritten;
+	bool				mFailed;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SPECTROGRAM_IO_H_
@@ -0,0 +1,118 @@
+#ifndef CIEQ_INCLUDE_DSP_SPECTROGRAM_PLAYER_H_
+#define CIEQ_INCLUDE_DSP_SPECTROGRAM_PLAYER_H_
+
+#include "dsp/spectrogram_recording.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \struct PlayedFrame
+ * \brief one frame handed out by SpectrogramPlayer. mGeneration numbers the
+ * distinct geometries of the recording, frames that share one share it.
+ */
+struct PlayedFrame
+{
+	// position of the frame in the recording
+	std::uint64_t		mIndex;
+	// seconds since the recording started
+	double				mTime;
+	RecordingGeometry	mGeometry;
+	std::uint32_t		mGeneration;
+	std::vector<float>	mMagnitudes;
+};
+
+/*!
+ * \class SpectrogramPlayer
+ * \brief plays a file written by SpectrogramRecorder back in real time, with
+ * a playhead that can jump anywhere. Frames come out already analysed, so a
+ * consumer only has to draw them.
+ * \note a seek costs one binary search over the index plus decoding the few
+ * chunks around the new position. Decoded chunks are kept in a small LRU
+ * cache, so scrubbing back and forth over a region only decodes it once,
+ * however large the file is.
+ */
+class SpectrogramPlayer
+{
+public:
+	// decoded chunks kept around, a seek with a full spectrogram of history touches two or three
+	static const std::size_t kNumCachedChunks = 8;
+
+	SpectrogramPlayer();
+
+	SpectrogramPlayer(const SpectrogramPlayer&) = delete;
+	SpectrogramPlayer& operator=(const SpectrogramPlayer&) = delete;
+
+	// \brief maps the recording and puts the playhead at its start, paused. Returns
+	// false if the file can't be read or holds no frames, see getError().
+	bool				open(const std::string& path);
+	void				close();
+	bool				isOpen() const { return mRecording.getNumFrames() != 0; }
+
+	void				setPlaying(bool playing);
+	bool				isPlaying() const { return mPlaying; }
+	// \brief moves the playhead by seconds of wall clock while playing, it stops at the end
+	void				advance(double seconds);
+	// \brief moves the playhead to time. The numHistory frames up to it are popped
+	// first, so a view showing that many rows is complete right away. A step of at
+	// most numHistory frames forward only pops the frames in between.
+	void				seek(double time, std::size_t numHistory);
+	// \brief the next frame at or before the playhead, false if none is due
+	bool				popFrame(PlayedFrame& frame);
+
+	// \brief geometry and generation of the next frame popFrame() returns, the last frame's at the end
+	const RecordingGeometry&	getGeometry() const { return mNextGeometry; }
+	std::uint32_t		getGeneration() const { return mNextGeneration; }
+	double				getPosition() const { return mPosition; }
+	double				getStartTime() const { return mRecording.getStartTime(); }
+	double				getEndTime() const { return mRecording.getEndTime(); }
+	// \brief average frames per second over the whole recording
+	double				getFrameRate() const;
+	const SpectrogramRecording&	getRecording() const { return mRecording; }
+	std::uint64_t		getNumCacheMisses() const { return mNumCacheMisses; }
+	const std::string&	getError() const { return mError; }
+
+private:
+	// \brief chunk index decoded, from the cache if it's there, nullptr if it can't be read
+	const DecodedChunk*	getChunk(std::size_t index);
+	std::size_t			findChunkOfFrame(std::uint64_t frame) const;
+	// \brief frames with a time at or before time
+	std::uint64_t		countFramesUntil(double time);
+	// \brief refreshes the geometry of the next frame after the playhead moved
+	void				locateNextFrame();
+	std::uint32_t		getGeometryGeneration(const RecordingGeometry& geometry);
+
+private:
+	struct CachedChunk
+	{
+		DecodedChunk		mChunk;
+		// mUseCounter at the last lookup, the smallest one gets replaced
+		std::uint64_t		mLastUse = 0;
+		bool				mValid = false;
+	};
+
+	SpectrogramRecording	mRecording;
+	std::vector<CachedChunk>	mCache;
+	std::uint64_t		mUseCounter;
+	std::uint64_t		mNumCacheMisses;
+	// every geometry seen so far, a frame's generation is its position in here
+	std::vector<RecordingGeometry>	mGeometries;
+	double				mPosition;
+	std::uint64_t		mNextFrame;
+	RecordingGeometry	mNextGeometry;
+	std::uint32_t		mNextGeneration;
+	bool				mPlaying;
+	std::string			mError;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SPECTROGRAM_PLAYER_H_
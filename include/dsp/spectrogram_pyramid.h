@@ -0,0 +1,161 @@
+#ifndef CIEQ_INCLUDE_DSP_SPECTROGRAM_PYRAMID_H_
+#define CIEQ_INCLUDE_DSP_SPECTROGRAM_PYRAMID_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <list>
+#include <string>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \enum PyramidPooling
+ * \brief how a SpectrogramPyramid level combines the magnitudes of the level
+ * below. MAX keeps short tones and clicks visible however far out the view
+ * is, MEAN keeps the average level.
+ */
+enum class PyramidPooling
+{
+	MAX,
+	MEAN
+};
+
+/*!
+ * \struct PyramidSettings
+ * \brief layout and memory limits of a SpectrogramPyramid
+ */
+struct PyramidSettings
+{
+	// rows and bins of one tile, the unit of memory management and disk traffic
+	std::size_t			mTileRows = 256;
+	std::size_t			mTileBins = 256;
+	// level n holds rows pooled over 2^n analysis rows, enough levels for the longest view
+	// (see SpectrogramPlot::setHistoryMaxRows())
+	std::size_t			mNumLevels = 16;
+	// a level also halves the bins of the one below, as long as that leaves at least this many
+	std::size_t			mMinLevelBins = 512;
+	PyramidPooling		mPooling = PyramidPooling::MAX;
+	// bytes of tiles kept in memory, complete tiles beyond it are written to disk
+	std::size_t			mMemoryBudget = std::size_t(256) << 20;
+	// where spilled tiles go, empty for a temporary file that is deleted with the pyramid
+	std::string			mSpillPath;
+};
+
+/*!
+ * \class SpectrogramPyramid
+ * \brief history of every spectrogram row appended, plus coarser levels built
+ * as the rows arrive: each level pools pairs of rows of the level below (and
+ * pairs of bins, down to PyramidSettings::mMinLevelBins). A view of any length
+ * is drawn from the first level that has few enough rows for it.
+ * \note levels are stored as fixed size tiles. Complete tiles that weren't
+ * used for a while are written to a spill file once the memory budget is
+ * reached and read back when a view needs them again, so memory stays bounded
+ * however long the history grows. Not thread safe, all calls from one thread.
+ */
+class SpectrogramPyramid
+{
+public:
+	SpectrogramPyramid();
+	~SpectrogramPyramid();
+
+	SpectrogramPyramid(const SpectrogramPyramid&) = delete;
+	SpectrogramPyramid& operator=(const SpectrogramPyramid&) = delete;
+
+	// \brief drops every row and starts over with rows of numBins magnitudes. Returns false
+	// if the spill file can't be created, every tile then stays in memory, see getError().
+	bool				setup(std::size_t numBins, const PyramidSettings& settings = PyramidSettings());
+	void				clear();
+	// \brief appends one row of getNumBins(0) magnitudes, levels above pool it in as their rows complete
+	void				append(const float* magnitudes);
+	// \brief copies rows [firstRow, firstRow + numRows) of level into dest, getNumBins(level)
+	// magnitudes each. Only the tiles covering them are touched. Returns false if the
+	// rows don't exist (yet) or a spilled tile can't be read back.
+	bool				readRows(std::size_t level, std::uint64_t firstRow, std::size_t numRows, float* dest);
+
+	bool				isSetup() const { return !mLevels.empty(); }
+	std::size_t			getNumLevels() const { return mLevels.size(); }
+	std::uint64_t		getNumRows(std::size_t level) const { return mLevels[level].mNumRows; }
+	std::size_t			getNumBins(std::size_t level) const { return mLevels[level].mNumBins; }
+	// \brief bins of level 0 pooled into one bin of level
+	std::size_t			getBinPooling(std::size_t level) const { return mLevels[level].mBinPooling; }
+	// \brief getBinPooling() of a pyramid set up with numBins and settings
+	static std::size_t	getBinPooling(std::size_t numBins, std::size_t level, const PyramidSettings& settings);
+	const PyramidSettings&	getSettings() const { return mSettings; }
+	// \brief bytes of tiles in memory. At most the budget plus the tiles being written, which
+	// aren't counted against it: the current tile row of every level, up to
+	// ceil(getNumBins(level) / mTileBins) tiles per level. A tile row that just completed
+	// takes its place until append() has spilled it, one tile per call.
+	std::size_t			getResidentBytes() const { return mResidentBytes; }
+	// \brief bytes written to the spill file
+	std::uint64_t		getSpilledBytes() const { return mSpillSize; }
+	// \brief tiles read back from the spill file since setup()
+	std::uint64_t		getNumTileLoads() const { return mNumTileLoads; }
+	const std::string&	getError() const { return mError; }
+
+private:
+	struct Tile
+	{
+		// mTileRows x mTileBins magnitudes, empty while the tile is only on disk. A tile being
+		// written only holds the rows written so far.
+		std::vector<float>	mData;
+		std::uint64_t		mSpillOffset = 0;
+		bool				mSpilled = false;
+		// every row written, it won't change any more and may be spilled
+		bool				mComplete = false;
+		// position in mRecent while in memory
+		std::list<std::size_t>::iterator	mRecent;
+	};
+
+	struct Level
+	{
+		std::size_t			mNumBins;
+		// bins of the level below pooled into one of this level (1 or 2), and of level 0
+		std::size_t			mBinPool;
+		std::size_t			mBinPooling;
+		std::size_t			mNumColumns;
+		std::uint64_t		mNumRows;
+		// tile row r, column c is mTiles[mTileIndices[r * mNumColumns + c]]
+		std::vector<std::size_t>	mTileIndices;
+		// first row of a pair from the level below, already pooled over bins
+		std::vector<float>	mHalf;
+		bool				mHasHalf;
+		std::vector<float>	mRow;
+	};
+
+	void				writeRow(std::size_t level, const float* row);
+	void				poolBins(const float* source, std::size_t numBins, std::size_t pool, float* dest) const;
+	std::size_t			createTile();
+	// \brief makes room for size magnitudes in a tile being written, counting what it allocates
+	void				growTile(Tile& tile, std::size_t size);
+	// \brief the tile with its data in memory, read back from disk if it was spilled. nullptr if that fails.
+	Tile*				getResidentTile(std::size_t index);
+	// \brief releases the least recently used complete tiles until the budget holds, writing
+	// at most maxSpills of them that aren't on disk yet and skipping the others
+	void				enforceBudget(std::size_t maxSpills);
+	bool				spill(Tile& tile);
+	bool				fail(const std::string& error);
+
+private:
+	PyramidSettings		mSettings;
+	std::vector<Level>	mLevels;
+	std::deque<Tile>	mTiles;
+	// indices of the tiles in memory, most recently used first
+	std::list<std::size_t>	mRecent;
+	std::size_t			mTileBytes;
+	std::size_t			mResidentBytes;
+	std::FILE*			mSpillFile;
+	std::uint64_t		mSpillSize;
+	std::uint64_t		mNumTileLoads;
+	std::string			mError;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SPECTROGRAM_PYRAMID_H_
@@ -0,0 +1,244 @@
+#ifndef CIEQ_INCLUDE_DSP_SPECTROGRAM_RECORDING_H_
+#define CIEQ_INCLUDE_DSP_SPECTROGRAM_RECORDING_H_
+
+#include "dsp/audio_file.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \struct RecordingFormat
+ * \brief how a SpectrogramRecorder stores frames. Magnitudes are kept on the
+ * dB scale the colormap uses (0 dB at 1e-5, 100 dB at 1.0), clamped to
+ * [mMinDb, mMaxDb] and quantized to mBits bits.
+ */
+struct RecordingFormat
+{
+	// 8 (about 0.5 dB steps over the default range) or 16
+	std::size_t			mBits = 16;
+	bool				mCompress = true;
+	float				mMinDb = 0.0f;
+	float				mMaxDb = 120.0f;
+	// frames per chunk, the unit of compression and of random access
+	std::size_t			mFramesPerChunk = 256;
+	// frames queued for the writer before push() starts dropping them
+	std::size_t			mMaxPendingFrames = 1024;
+};
+
+/*!
+ * \struct RecordingGeometry
+ * \brief which bins a recorded frame holds: bins [mFirstBin, mFirstBin + mNumBins)
+ * of an mFftSize point transform at mSampleRate, so bin k is at
+ * k * mSampleRate / mFftSize Hz. A chunk never mixes geometries.
+ */
+struct RecordingGeometry
+{
+	std::uint32_t		mSampleRate = 0;
+	std::uint32_t		mFftSize = 0;
+	std::uint32_t		mFirstBin = 0;
+	std::uint32_t		mNumBins = 0;
+
+	bool operator==(const RecordingGeometry& other) const;
+	bool operator!=(const RecordingGeometry& other) const { return !(*this == other); }
+};
+
+/*!
+ * \struct RecordedFrame
+ * \brief one frame read back, magnitudes linear again (quantized, and floored at 1e-5)
+ */
+struct RecordedFrame
+{
+	// seconds since the recording started
+	double				mTime;
+	RecordingGeometry	mGeometry;
+	std::vector<float>	mMagnitudes;
+};
+
+/*!
+ * \struct RecordedChunk
+ * \brief index entry of one chunk: where its header starts in the file and
+ * which frames it holds, counted over the whole recording
+ */
+struct RecordedChunk
+{
+	std::uint64_t		mOffset;
+	std::uint64_t		mFirstFrame;
+	double				mFirstTime;
+	double				mLastTime;
+	std::uint32_t		mNumFrames;
+};
+
+/*!
+ * \struct DecodedChunk
+ * \brief every frame of one chunk decoded at once: mTimes.size() rows of
+ * mGeometry.mNumBins linear magnitudes, back to back in mMagnitudes
+ */
+struct DecodedChunk
+{
+	// position of the chunk in the index
+	std::size_t			mIndex;
+	RecordingGeometry	mGeometry;
+	std::vector<double>	mTimes;
+	std::vector<float>	mMagnitudes;
+};
+
+/*!
+ * \class SpectrogramRecorder
+ * \brief streams analysis frames to disk as quantized, optionally LZ4
+ * compressed chunks, followed by a time to offset index once closed.
+ * \note push() only copies the frame into a preallocated queue, a writer
+ * thread of its own quantizes, compresses and writes. If the disk can't keep
+ * up, frames are dropped (and counted) instead of blocking the caller.
+ * Every chunk header also says where the chunk ends, so a recording that was
+ * never closed can still be read, see SpectrogramRecording::open().
+ */
+class SpectrogramRecorder
+{
+public:
+	SpectrogramRecorder();
+	~SpectrogramRecorder();
+
+	SpectrogramRecorder(const SpectrogramRecorder&) = delete;
+	SpectrogramRecorder& operator=(const SpectrogramRecorder&) = delete;
+
+	// \brief creates the file and starts the writer thread, returns false if the
+	// file can't be created or the format is not supported, see getError()
+	bool				open(const std::string& path, const RecordingFormat& format = RecordingFormat());
+	// \brief queues geometry.mNumBins magnitudes taken at time seconds (non-decreasing).
+	// Never blocks, returns false if the frame was dropped.
+	bool				push(double time, const RecordingGeometry& geometry, const float* magnitudes);
+	// \brief writes what is queued, the index and the trailer, and joins the writer.
+	// Returns false if any write failed.
+	bool				close();
+
+	bool				isOpen() const { return mThread.joinable(); }
+	std::uint64_t		getNumFramesWritten() const;
+	std::uint64_t		getNumDroppedFrames() const;
+	// \brief bytes written to the file so far
+	std::uint64_t		getNumBytesWritten() const;
+	std::string			getError() const;
+
+private:
+	struct PendingFrame
+	{
+		double				mTime;
+		RecordingGeometry	mGeometry;
+		std::vector<float>	mMagnitudes;
+	};
+
+	void				run();
+	// \brief quantizes one frame into the open chunk, flushing it first if it's full or of another geometry
+	void				appendFrame(const PendingFrame& frame);
+	void				flushChunk();
+	void				writeIndex();
+	void				write(const std::uint8_t* data, std::size_t size);
+
+private:
+	RecordingFormat		mFormat;
+	std::FILE*			mFile;
+	std::thread			mThread;
+
+	// producer side, guarded by mMutex. Slots keep their capacity, so steady state push() never allocates.
+	mutable std::mutex	mMutex;
+	std::condition_variable	mWake;
+	std::vector<PendingFrame>	mPending;
+	std::size_t			mNumPending;
+	bool				mClosing;
+	std::uint64_t		mNumDropped;
+	std::uint64_t		mNumWritten;
+	std::uint64_t		mNumBytes;
+	std::string			mError;
+
+	// writer thread only
+	std::vector<PendingFrame>	mWriting;
+	RecordingGeometry	mChunkGeometry;
+	std::vector<double>	mChunkTimes;
+	// quantized rows, each one stored as its difference to the previous row
+	std::vector<std::uint8_t>	mChunkRows;
+	std::vector<std::uint16_t>	mPreviousRow;
+	std::vector<std::uint8_t>	mRaw;
+	std::vector<std::uint8_t>	mCompressed;
+	std::vector<RecordedChunk>	mIndex;
+	std::uint64_t		mOffset;
+	std::uint64_t		mNumChunkedFrames;
+	double				mLastTime;
+	bool				mFailed;
+};
+
+/*!
+ * \class SpectrogramRecording
+ * \brief reads a file written by SpectrogramRecorder through a memory
+ * mapping. Only the index is parsed up front, a time range is found by
+ * binary search and only the chunks overlapping it are touched and decoded.
+ */
+class SpectrogramRecording
+{
+public:
+	SpectrogramRecording();
+	~SpectrogramRecording();
+
+	SpectrogramRecording(const SpectrogramRecording&) = delete;
+	SpectrogramRecording& operator=(const SpectrogramRecording&) = delete;
+
+	// \brief loads the header and index. A recording that was never closed has no
+	// index, it is rebuilt by walking the chunk headers. Returns false if the file
+	// isn't a recording, see getError().
+	bool				open(const std::string& path);
+	void				close();
+
+	// \brief appends every frame with begin <= time < end to frames, in time order
+	bool				readRange(double begin, double end, std::vector<RecordedFrame>& frames);
+	// \brief decodes every frame of chunk index into chunk, reusing its storage
+	bool				decodeChunk(std::size_t index, DecodedChunk& chunk);
+	// \brief the chunk holding the last frame at or before time, the first one if
+	// time is before the recording. Binary search over the index, nothing is read.
+	std::size_t			findChunk(double time) const;
+
+	const RecordingFormat&	getFormat() const { return mFormat; }
+	std::uint64_t		getNumFrames() const { return mNumFrames; }
+	std::size_t			getNumChunks() const { return mIndex.size(); }
+	const RecordedChunk&	getChunk(std::size_t index) const { return mIndex[index]; }
+	double				getStartTime() const;
+	double				getEndTime() const;
+	// \brief true if the index had to be rebuilt, the recorder never closed the file
+	bool				isRecovered() const { return mRecovered; }
+	const std::string&	getError() const { return mError; }
+
+private:
+	bool				readIndex();
+	void				rebuildIndex();
+	// \brief decodes the frames of chunk with begin <= time < end into decoded
+	bool				decodeRange(std::size_t index, double begin, double end, DecodedChunk& decoded);
+	bool				fail(const std::string& error);
+	// \brief fail() that also unmaps the file
+	bool				failOpen(const std::string& error);
+
+private:
+	MappedFile			mFile;
+	RecordingFormat		mFormat;
+	std::vector<RecordedChunk>	mIndex;
+	std::uint64_t		mNumFrames;
+	bool				mRecovered;
+	std::string			mError;
+	// linear magnitude of every quantized code
+	std::vector<float>	mMagnitudes;
+	std::vector<std::uint8_t>	mRaw;
+	std::vector<std::uint16_t>	mCodes;
+	DecodedChunk		mDecoded;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SPECTROGRAM_RECORDING_H_
@@ -0,0 +1,46 @@
+#ifndef CIEQ_INCLUDE_DSP_SPECTROGRAM_ROW_H_
+#define CIEQ_INCLUDE_DSP_SPECTROGRAM_ROW_H_
+
+#include "dsp/colormap.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class SpectrogramRow
+ * \brief stages one spectrogram row of a fixed width for upload: the raw
+ * magnitudes for a shader to colour, or pixels coloured by a ColormapLut.
+ * Columns past the delivered bins are black.
+ * \note this is everything SpectrogramPlot does to a row short of the GL
+ * call, kept apart so it can be measured without a context.
+ */
+class SpectrogramRow
+{
+public:
+	SpectrogramRow();
+
+	// \brief allocates both staging rows, width columns each
+	void				setup(std::size_t width);
+	// \brief copies min(count, getWidth()) magnitudes, returns getWidth() floats
+	const float*		stageMagnitudes(const float* magnitudes, std::size_t count);
+	// \brief colours min(count, getWidth()) magnitudes, returns getWidth() RGBA8 pixels as
+	// ColormapLut::mapRow() writes them
+	const std::uint32_t*	stagePixels(const ColormapLut& colormap, const float* magnitudes, std::size_t count, float maxMag, bool dbMode);
+
+	std::size_t			getWidth() const { return mMagnitudes.size(); }
+
+private:
+	std::vector<float>	mMagnitudes;
+	std::vector<std::uint32_t>	mPixels;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_SPECTROGRAM_ROW_H_
@@ -0,0 +1,97 @@
+#ifndef CIEQ_INCLUDE_DSP_STREAMING_STFT_H_
+#define CIEQ_INCLUDE_DSP_STREAMING_STFT_H_
+
+#include "dsp/bin_range_spectrum.h"
+#include "dsp/zoom_fft.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class StreamingStft
+ * \brief the STFT of an endless stream of samples: windowing, history and
+ * magnitudes without any threads, queues or audio devices attached.
+ * Frames are due every hop size samples, write() never consumes past the
+ * next one, so overlap is sample accurate however the input is chunked.
+ * \note StftEngine runs one of these on its analysis thread, benchmarks
+ * and tests can drive it directly.
+ */
+class StreamingStft
+{
+public:
+	StreamingStft();
+
+	// \brief (re)allocates FFT, window and history. fftSize is rounded up to a power of two
+	// that is at least windowSize. A non-zero zoomMaxFreq switches to the decimating zoom
+	// front end for 0..zoomMaxFreq if the geometry allows it, see isZoomed().
+	void				setup(std::size_t fftSize, std::size_t windowSize, std::size_t hopSize, std::size_t sampleRate, float zoomMaxFreq = 0.0f);
+	// \brief restricts frames to bins [firstBin, firstBin + numBins), setup() resets this to every bin
+	void				setBinRange(std::size_t firstBin, std::size_t numBins);
+	// \brief the FFT size setup() ends up with for the given request
+	static std::size_t	roundFftSize(std::size_t fftSize, std::size_t windowSize);
+
+	// \brief consumes up to count samples but never past the next frame boundary,
+	// returns how many were taken
+	std::size_t			write(const float* samples, std::size_t count);
+	// \brief samples write() still has to take before the next frame is due
+	std::size_t			getSamplesToNextFrame() const;
+	bool				isFrameReady() const;
+	// \brief writes the due frame as getNumOutputBins() magnitudes and moves on to the next hop
+	void				computeFrame(float* magnitudes);
+	// \brief moves on to the next hop without transforming the due frame
+	void				skipFrame();
+	// \brief first input sample the due frame covers, counted from setup()
+	std::uint64_t		getFrameSampleIndex() const;
+	std::uint64_t		getSamplesConsumed() const { return mSamplesConsumed; }
+	// \brief input a fresh setup() has to be fed before its frames hold no more start-up
+	// silence: the window, plus the filter delay in zoom mode
+	std::size_t			getSettleSamples() const;
+
+	bool				isSetup() const { return mBinRange || mZoom; }
+	// \brief the FFT size that sets the bin spacing, sampleRate / getFftSize() Hz per bin
+	std::size_t			getFftSize() const { return mFftSize; }
+	// \brief the size of the transform actually computed per frame
+	std::size_t			getTransformSize() const { return mZoom ? mZoom->getTransformSize() : mFftSize; }
+	std::size_t			getNumBins() const { return mZoom ? mZoom->getNumBins() : mFftSize / 2; }
+	std::size_t			getNumOutputBins() const { return mNumOutputBins; }
+	std::size_t			getFirstBin() const { return mFirstBin; }
+	// \brief name of the method computing the requested bins, for display
+	const char*			getBinRangeMethodName() const;
+	bool				isZoomed() const { return mZoom != nullptr; }
+	float				getZoomMaxFreq() const { return mZoom ? mZoomMaxFreq : 0.0f; }
+	std::size_t			getWindowSize() const { return mWindowSize; }
+	std::size_t			getHopSize() const { return mHopSize; }
+	std::size_t			getSampleRate() const { return mSampleRate; }
+
+private:
+	// only the requested bins of the full-band spectrum are ever computed
+	std::unique_ptr<BinRangeSpectrum>	mBinRange;
+	std::vector<float>	mFftInput;
+	std::unique_ptr<ZoomFft>	mZoom;
+	std::vector<float>	mZoomMagnitudes;
+	std::shared_ptr<const std::vector<float>>	mWindow;
+	// circular history holding the last mWindowSize samples, oldest at mHistoryPos
+	std::vector<float>	mHistory;
+	std::size_t			mHistoryPos;
+	std::uint64_t		mSamplesConsumed;
+	std::uint64_t		mNextFrameEnd;
+	float				mZoomMaxFreq;
+	std::size_t			mFftSize;
+	std::size_t			mWindowSize;
+	std::size_t			mHopSize;
+	std::size_t			mSampleRate;
+	std::size_t			mFirstBin;
+	std::size_t			mNumOutputBins;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_STREAMING_STFT_H_
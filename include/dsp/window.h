@@ -0,0 +1,24 @@
+#ifndef CIEQ_INCLUDE_DSP_WINDOW_H_
+#define CIEQ_INCLUDE_DSP_WINDOW_H_
+
+#include <cstddef>
+
+namespace cieq
+{
+namespace dsp
+{
+
+enum class WindowType
+{
+	BLACKMAN,
+	HANN,
+	RECT
+};
+
+//! \brief fills window[0..length) with the given (periodic) window, same shapes as Cinder's generateWindow
+void			generateWindow(WindowType type, float* window, std::size_t length);
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_WINDOW_H_
@@ -0,0 +1,76 @@
+#ifndef CIEQ_INCLUDE_DSP_WORK_STEALING_POOL_H_
+#define CIEQ_INCLUDE_DSP_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class WorkStealingPool
+ * \brief fixed set of worker threads, each with its own task queue.
+ * A worker runs its own queue oldest first and, once that is empty, steals
+ * the newest task of another worker, so a few long tasks dealt to one
+ * worker don't leave the others idle.
+ * \note tasks may submit more tasks, those go to the submitting worker's
+ * own queue. Submissions from outside are dealt round-robin.
+ */
+class WorkStealingPool
+{
+public:
+	using Task = std::function<void()>;
+
+	// \brief 0 starts one worker per hardware thread
+	explicit WorkStealingPool(std::size_t numThreads = 0);
+	// \brief finishes every queued task, then joins the workers
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	void				submit(Task task);
+	// \brief blocks until every task submitted so far, and everything they submitted, has run
+	void				wait();
+
+	std::size_t			getNumThreads() const { return mThreads.size(); }
+	// \brief index of the calling worker in [0, getNumThreads()), or getNumThreads()
+	// when called from a thread that isn't one of this pool's workers
+	std::size_t			getCurrentWorker() const;
+
+private:
+	struct Queue
+	{
+		std::mutex		mMutex;
+		std::deque<Task>	mTasks;
+	};
+
+	void				run(std::size_t worker);
+	bool				take(std::size_t worker, Task& task);
+
+private:
+	std::vector<std::unique_ptr<Queue>>	mQueues;
+	std::vector<std::thread>	mThreads;
+	std::atomic<std::size_t>	mNextQueue;
+	// tasks queued but not started, and submitted but not finished
+	std::size_t			mQueued;
+	std::size_t			mUnfinished;
+	bool				mStopping;
+	std::mutex			mStateMutex;
+	std::condition_variable	mWorkAvailable;
+	std::condition_variable	mAllDone;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_WORK_STEALING_POOL_H_
@@ -0,0 +1,70 @@
+#ifndef CIEQ_INCLUDE_DSP_ZOOM_FFT_H_
+#define CIEQ_INCLUDE_DSP_ZOOM_FFT_H_
+
+#include "dsp/fft.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace cieq
+{
+namespace dsp
+{
+
+/*!
+ * \class ZoomFft
+ * \brief band-limited spectrum front end for 0..maxFreq.
+ * The input is mixed down so the band is centred on DC, low-pass filtered
+ * and decimated by a power of two with a polyphase FIR, then transformed
+ * with a complex FFT that is decimation times shorter than the full-band
+ * one. Bin spacing stays sampleRate / fftSize, so bin i still sits at
+ * i * sampleRate / fftSize Hz, and magnitudes are scaled to match the
+ * full-band real FFT.
+ */
+class ZoomFft
+{
+public:
+	ZoomFft();
+
+	// \brief fftSize is the full-band size that sets the bin spacing. Returns false
+	// (and leaves the object unusable) if the band is too wide to decimate by at least 2.
+	bool				setup(std::size_t sampleRate, std::size_t fftSize, std::size_t windowSize, float maxFreq);
+	// \brief mixes, filters and decimates a block of input samples into the history
+	void				process(const float* samples, std::size_t count);
+	// \brief transforms the newest window, writes getNumBins() magnitudes starting at 0 Hz
+	void				computeMagnitudes(float* magnitudes);
+
+	std::size_t			getDecimation() const { return mDecimation; }
+	// \brief size of the complex FFT actually computed
+	std::size_t			getTransformSize() const { return mTransformSize; }
+	std::size_t			getNumBins() const { return mNumBins; }
+	// \brief delay of the decimated history behind the newest input sample, in input samples
+	std::size_t			getLatencySamples() const;
+
+private:
+	// mixer, a recursive oscillator at -centre frequency
+	double				mOscRe, mOscIm;
+	double				mStepRe, mStepIm;
+	std::size_t			mRenormCounter;
+	// decimating low-pass, the delay line is mirrored so the newest taps are always contiguous
+	std::vector<float>	mTaps;
+	std::vector<Complex>	mDelayLine;
+	std::size_t			mDelayPos;
+	std::size_t			mDecimationPhase;
+	// decimated history and transform
+	std::vector<Complex>	mHistory;
+	std::size_t			mHistoryPos;
+	std::shared_ptr<const std::vector<float>>	mWindow;
+	std::vector<Complex>	mFftBuffer;
+	std::unique_ptr<ComplexFft>	mFft;
+	std::size_t			mDecimation;
+	std::size_t			mTransformSize;
+	std::size_t			mNumBins;
+	std::size_t			mCentreBin;
+};
+
+} //!dsp
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_DSP_ZOOM_FFT_H_
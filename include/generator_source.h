@@ -0,0 +1,61 @@
+#ifndef CIEQ_INCLUDE_GENERATOR_SOURCE_H_
+#define CIEQ_INCLUDE_GENERATOR_SOURCE_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "dsp/signal_generator.h"
+
+namespace cieq
+{
+
+class CaptureNode;
+
+/*!
+ * \class GeneratorSource
+ * \brief stands in for the input device: renders a dsp::SignalGenerator block
+ * by block on its own thread and writes it into a CaptureNode, the way the
+ * audio thread would. Needs no sound card and no running audio context.
+ * \note clocked in real time it delivers a block every blockSize / sampleRate
+ * seconds, like a device. Free-running it delivers as fast as the analysis
+ * drains the capture ring, so nothing is dropped and the analysis is the limit.
+ */
+class GeneratorSource
+{
+public:
+    GeneratorSource();
+    ~GeneratorSource();
+
+    // \brief returns false if the generator can't produce these settings, see getError()
+    bool                                setup(const dsp::GeneratorSettings& settings);
+    // \brief starts writing into sink, sink has to be prepare()d for getBlockSize() frames
+    void                                start(const std::shared_ptr<CaptureNode>& sink);
+    // \brief stops and joins the generator thread, the signal picks up where it stopped
+    void                                stop();
+
+    bool                                isRunning() const { return mThread.joinable(); }
+    size_t                              getSampleRate() const { return mGenerator.getSampleRate(); }
+    size_t                              getNumChannels() const { return mGenerator.getNumChannels(); }
+    size_t                              getBlockSize() const { return mGenerator.getSettings().mBlockSize; }
+    bool                                isRealTime() const { return mGenerator.getSettings().mRealTime; }
+    // \brief e.g. "sweep, 48000 Hz, 2 ch, free-running", for the window title
+    std::string                         getDescription() const;
+    const std::string&                  getError() const { return mGenerator.getError(); }
+
+private:
+    void                                run();
+
+private:
+    dsp::SignalGenerator                mGenerator;
+    std::vector<float>                  mBlock;
+    std::shared_ptr<CaptureNode>        mSink;
+    std::thread                         mThread;
+    std::atomic<bool>                   mRunning;
+};
+
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_GENERATOR_SOURCE_H_
@@ -0,0 +1,100 @@
+#ifndef CIEQ_INCLUDE_SPSC_QUEUE_H_
+#define CIEQ_INCLUDE_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace cieq
+{
+
+/*!
+ * \class SpscQueue
+ * \brief a bounded, lock-free, single-producer / single-consumer queue.
+ * Slots are allocated once and handed out in place, so a producer that
+ * fills a slot's storage (e.g. a std::vector) and a consumer that swaps
+ * it out never allocate in steady state.
+ * \note exactly one thread may call beginWrite/commitWrite and exactly
+ * one (other) thread may call front/pop.
+ */
+template<typename T>
+class SpscQueue
+{
+public:
+	explicit SpscQueue(std::size_t capacity = 0)
+		: mSlots(capacity + 1)
+		, mHead(0)
+		, mTail(0)
+	{}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	// \brief drops all elements and resizes. Not thread safe, only call while idle.
+	void reset(std::size_t capacity)
+	{
+		mSlots.clear();
+		mSlots.resize(capacity + 1);
+		mHead.store(0, std::memory_order_relaxed);
+		mTail.store(0, std::memory_order_relaxed);
+	}
+
+	// \brief producer side. Returns the slot to fill, or nullptr if the queue is full.
+	T* beginWrite()
+	{
+		const auto tail = mTail.load(std::memory_order_relaxed);
+		if (next(tail) == mHead.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &mSlots[tail];
+	}
+
+	// \brief producer side. Publishes the slot returned by the last beginWrite().
+	void commitWrite()
+	{
+		const auto tail = mTail.load(std::memory_order_relaxed);
+		mTail.store(next(tail), std::memory_order_release);
+	}
+
+	// \brief consumer side. Returns the oldest element, or nullptr if the queue is empty.
+	T* front()
+	{
+		const auto head = mHead.load(std::memory_order_relaxed);
+		if (head == mTail.load(std::memory_order_acquire))
+			return nullptr;
+
+		return &mSlots[head];
+	}
+
+	// \brief consumer side. Releases the element returned by front() back to the producer.
+	void pop()
+	{
+		const auto head = mHead.load(std::memory_order_relaxed);
+		mHead.store(next(head), std::memory_order_release);
+	}
+
+	// \brief approximate number of queued elements, exact only when called from either end
+	std::size_t size() const
+	{
+		const auto head = mHead.load(std::memory_order_acquire);
+		const auto tail = mTail.load(std::memory_order_acquire);
+		return tail >= head ? tail - head : tail + mSlots.size() - head;
+	}
+
+	std::size_t capacity() const { return mSlots.size() - 1; }
+
+private:
+	std::size_t next(std::size_t index) const
+	{
+		return ++index == mSlots.size() ? 0 : index;
+	}
+
+private:
+	std::vector<T>				mSlots;
+	std::atomic<std::size_t>	mHead;
+	std::atomic<std::size_t>	mTail;
+};
+
+} //!cieq
+
+#endif //!CIEQ_INCLUDE_SPSC_QUEUE_H_
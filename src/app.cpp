@@ -1,8 +1,39 @@
 #include "app.h"
 #include "math.h"
 
+#include <cinder/Text.h>
+#include <cinder/Utilities.h>
+
+#include "dsp/fft_wisdom.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+
 namespace cieq
 {
+
+namespace
+{
+    //! longest spectrogram the duration param and ']' go to, 8 hours of history
+    const size_t kMaxSpecDurSeconds = 28800;
+    //! fastest spectrogram update rate the param and playback go to, in Hz
+    const size_t kMaxHopRate = 60;
+    //! a press that moves less than this many pixels is a click, not a selection
+    const float kSelectMinPixels = 4.0f;
+    //! rows and bins of a re-analysed region, the detail texture has to fit any GPU
+    const size_t kMaxDetailRows = 4096;
+    const size_t kMaxDetailBins = 4096;
+
+    //! h:mm:ss, recordings run for hours
+    std::string formatDuration(double seconds)
+    {
+        const long total = static_cast<long>(std::max(seconds, 0.0));
+        std::stringstream text;
+        text << total / 3600 << ":" << std::setw(2) << std::setfill('0') << (total / 60) % 60 << ":" << std::setw(2) << std::setfill('0') << total % 60;
+        return text.str();
+    }
+}
 InputAnalyzer::InputAnalyzer()
 	: mGlobals(mEventProcessor)
 	, mAudioNodes(mGlobals)
@@ -10,6 +41,13 @@ InputAnalyzer::InputAnalyzer()
     , mWaveformPlot(mAudioNodes)
     , mSpectrogramPlot(mAudioNodes)
     , mWaveformPlotShifted(mAudioNodes)
+    , mStatsTextTime(0.0)
+    , mLatencyLogTime(0.0)
+    , mScrubbing(false)
+    , mScrubPending(false)
+    , mScrubTime(0.0)
+    , mPlaybackGeneration(0)
+    , mSelecting(false)
 {}
 
 void InputAnalyzer::prepareSettings(Settings *settings)
@@ -43,6 +81,9 @@ void InputAnalyzer::setup()
     {
         mTimer.start();
     }
+    CIEQ_PROFILE_THREAD("main");
+    //Analysis runs on its own thread now, so let the render loop pace itself on vsync
+    ci::gl::enableVerticalSync();
     mParams = ci::params::InterfaceGl::create(cinder::app::getWindow(), "App parameters", ci::app::toPixels(ci::Vec2i(300, 100)));
     
     mEventProcessor.addKeyboardEvent([this](char c)
@@ -75,18 +116,35 @@ void InputAnalyzer::setup()
     fftSize = 131072;
     fftSizePrev = fftSize;
     linearDbMode = 0;
+    zoomFftMode = 0;
+    userPalette = static_cast<int>(dsp::Palette::JET);
+    userPalettePrev = userPalette;
     pauseDrawing = 0;
     shift = ((float)userWinSize / 1000) / 4;
     shiftLength = ((float)userWinSize / 1000) / 2;
     mParams->addParam("Window Size (ms)", &userWinSize).min(10).max(500).step(1);
-    mParams->addParam("Spectrogram Update Rate (Hz)", &userHopSize).min(10).max(60).step(1);
-    mParams->addParam("Spectrogram Duration (2-20s)", &userSpecDurSeconds).min(2).max(20).step(1);
+    mParams->addParam("Spectrogram Update Rate (Hz)", &userHopSize).min(10).max(kMaxHopRate).step(1);
+    //Beyond 20 s the plot zooms out over its history pyramid, '[' and ']' halve and double it
+    mParams->addParam("Spectrogram Duration (2s-8h)", &userSpecDurSeconds).min(2).max(kMaxSpecDurSeconds).step(1);
     mParams->addParam("Spectrogram Max Freq Display (100-20000Hz)", &userSpecMaxFreq).min(100).max(20000).step(1);
     mParams->addButton("Toggle Linear / dB Mode", std::bind(&InputAnalyzer::linearDBModeButton, this));
     mParams->addText("linearDBModeText", "label=`Linear Mode.`");
+    mParams->addButton("Toggle Full / Zoom FFT Mode", std::bind(&InputAnalyzer::zoomFftModeButton, this));
+    mParams->addText("zoomFftModeText", "label=`Full Band FFT.`");
     mParams->addParam("Spectrogram Max Magnitude Display (dB)", &userMaxMag).min(0).max(250).step(1);
+    std::vector<std::string> paletteNames;
+    for (std::size_t i = 0; i < dsp::kNumPalettes; i++)
+    {
+        paletteNames.push_back(dsp::getPaletteName(static_cast<dsp::Palette>(i)));
+    }
+    mParams->addParam("Spectrogram Colormap", paletteNames, &userPalette);
     mParams->addParam("Search Shift (s)", &shift).min(0.0f).max(0.5f).precision(3).step(0.001f);
     mParams->addParam("Search Length (s)", &shiftLength).min(0.01f).max(0.5f).precision(3).step(0.001f);
+    //A region dragged out of the paused spectrogram is analysed again from the raw input with these
+    userDetailWinSize = 1000;
+    userDetailHopMs = 5.0f;
+    mParams->addParam("Detail Window (ms)", &userDetailWinSize).min(10).max(4000).step(10);
+    mParams->addParam("Detail Hop (ms)", &userDetailHopMs).min(0.5f).max(100.0f).precision(1).step(0.5f);
 
     const auto window_size = ci::app::getWindowSize();
     const auto plot_size_width = 0.9f * window_size.x; // 90% of window width
@@ -101,15 +159,87 @@ void InputAnalyzer::setup()
     //    fftSize = static_cast<size_t>(pow(2, (nearestPow2 - 1.0)));
     //}
 
-    //Window size can be entered in ms now for the mAudioNodes.setup call:
-    mAudioNodes.setup(userHopSize, userWinSize, fftSize);
+    //"--offline <file>" analyses a recording instead of the input device, "--generate <spec>"
+    //a synthetic signal, e.g. "type=sweep,rate=48000,channels=2,clock=free"
+    //"--prewarm-fft 16384,65536,131072" plans those FFT sizes up front, so switching to them is instant
+    //"--playback <file.cspec>" reviews a recording made with the 'r' key, drag the timeline on top to scrub
+    //"--history-budget 256" MB of spectrogram history kept in memory, older tiles go to a temporary file
+    //"--pcm-history 5" minutes of raw live input kept for re-analysing a region of the paused view
+    std::vector<size_t> prewarmSizes;
+    //The history pyramid builds the levels the longest view at the fastest hop rate needs, no more
+    mSpectrogramPlot.setHistoryMaxRows(kMaxSpecDurSeconds * kMaxHopRate);
+    const auto& args = getArgs();
+    for (std::size_t i = 1; i + 1 < args.size(); i++)
+    {
+        if (args[i] == "--offline")
+        {
+            mAudioNodes.openFile(args[i + 1]);
+        }
+        else if (args[i] == "--generate")
+        {
+            mAudioNodes.openGenerator(args[i + 1]);
+        }
+        else if (args[i] == "--playback")
+        {
+            mAudioNodes.openPlayback(args[i + 1]);
+        }
+        else if (args[i] == "--history-budget")
+        {
+            mSpectrogramPlot.setHistoryBudget(static_cast<size_t>(std::strtoul(args[i + 1].c_str(), nullptr, 10)) << 20);
+        }
+        else if (args[i] == "--pcm-history")
+        {
+            mAudioNodes.setPcmHistorySeconds(60.0 * std::strtod(args[i + 1].c_str(), nullptr));
+        }
+        else if (args[i] == "--record-format")
+        {
+            //"8", "16", "8lz4" or "16lz4", what the 'r' key records with
+            mRecordingFormat.mBits = args[i + 1].compare(0, 1, "8") == 0 ? 8 : 16;
+            mRecordingFormat.mCompress = args[i + 1].find("lz4") != std::string::npos;
+        }
+        else if (args[i] == "--prewarm-fft")
+        {
+            std::stringstream sizes(args[i + 1]);
+            std::string size;
+            while (std::getline(sizes, size, ','))
+            {
+                prewarmSizes.push_back(static_cast<size_t>(std::strtoul(size.c_str(), nullptr, 10)));
+            }
+        }
+    }
+
+    //The fastest transform per geometry was measured on an earlier run, new ones get measured once
+    loadFftWisdom();
+
+    //Window size can be entered in ms now for the mAudioNodes.setup call. It allocates the PCM history,
+    //nothing may be analysing it then.
+    mRegionAnalyzer.cancel();
+    mAudioNodes.setup(userHopSize, userWinSize, fftSize, zoomFftMode ? userSpecMaxFreq : 0);
 
     fftSize = mAudioNodes.getFftSize();
     hSR = static_cast<float>(mAudioNodes.getHardwareSampleRate());
     numBins = static_cast<float>(mAudioNodes.getNumBins());
+    if (mAudioNodes.isPlayback())
+    {
+        //The view starts out showing every recorded bin at the rate the frames were recorded at
+        const dsp::SpectrogramPlayer& player = mAudioNodes.getPlayer();
+        const dsp::RecordingGeometry& geometry = player.getGeometry();
+        userHopSize = std::min(std::max(std::floor(player.getFrameRate() + 0.5), 1.0), static_cast<double>(kMaxHopRate));
+        userHopSizePrev = userHopSize;
+        userSpecDuration = static_cast<size_t>(userHopSize) * userSpecDurSeconds;
+        userSpecMaxFreq = static_cast<size_t>(std::ceil((geometry.mFirstBin + geometry.mNumBins) * hSR / static_cast<float>(fftSize)));
+        userSpecMaxFreq = std::min(std::max(userSpecMaxFreq, static_cast<size_t>(100)), static_cast<size_t>(20000));
+        userSpecMaxFreqPrev = userSpecMaxFreq;
+        mPlaybackGeneration = mAudioNodes.getGeneration();
+    }
     actualMaxFreq = static_cast<size_t>(plot_size_width * ((hSR / 2) / numBins));
 
     mEventProcessor.addKeyboardEvent([this](char c){ if (c == 's' || c == 'S') mAudioNodes.toggleInput(); });
+    mEventProcessor.addKeyboardEvent([this](char c){ if (c == 't' || c == 'T') writeProfileTrace(); });
+    mEventProcessor.addKeyboardEvent([this](char c){ if (c == 'c' || c == 'C') writeStatsCsv(); });
+    mEventProcessor.addKeyboardEvent([this](char c){ if (c == 'r' || c == 'R') toggleRecording(); });
+    mEventProcessor.addKeyboardEvent([this](char c){ if (c == '[') userSpecDurSeconds = std::max<size_t>(userSpecDurSeconds / 2, 2); });
+    mEventProcessor.addKeyboardEvent([this](char c){ if (c == ']') userSpecDurSeconds = std::min<size_t>(userSpecDurSeconds * 2, kMaxSpecDurSeconds); });
     mEventProcessor.addMouseEvent([this](float, float){ togglePauseDrawing(); });
 	mEventProcessor.addMouseEvent([this](float, float){ mAudioNodes.toggleInput(); });
 
@@ -117,7 +247,11 @@ void InputAnalyzer::setup()
     mSpectrogramPlot.setBounds(ci::Rectf(top_left, top_left + ci::Vec2f(plot_size_width, plot_size_height)));
 
     dispBins = (fftSize * userSpecMaxFreq) / static_cast<size_t>(hSR);
+    mAudioNodes.setDisplayedBins(dispBins);
+    mAudioNodes.prewarmFft(prewarmSizes, userHopSize, userWinSize, zoomFftMode ? userSpecMaxFreq : 0, userSpecMaxFreq);
+    saveFftWisdom();
     mSpectrogramPlot.setup(userSpecDuration, dispBins);
+    resetStats();
 	//mSpectrumPlot.setup();
     mWaveformPlotShifted.setup();
     mWaveformPlot.setup();
@@ -144,7 +278,6 @@ void InputAnalyzer::setup()
 
 void InputAnalyzer::resize()
 {
-    //timeSec1Enter = mTimer.getSeconds();
 	const auto window_size = ci::app::getWindowSize();
 	const auto plot_size_width = 0.9f * window_size.x; // 90% of window width
 	const auto plot_size_height = 0.8f * 1.0f * window_size.y; // half of 90% of window width; 0.5f
@@ -157,13 +290,54 @@ void InputAnalyzer::resize()
 
 	//top_left.y += 0.5f * window_size.y;
 	//mWaveformPlot.setBounds(ci::Rectf(top_left, top_left + ci::Vec2f(plot_size_width, plot_size_height)));
-    //timeSec1Exit = mTimer.getSeconds();
-    //timeSec1Process = timeSec1Exit - timeSec1Enter;
 }
 
 void InputAnalyzer::update()
 {
-    //timeSec1Enter = mTimer.getSeconds();
+    CIEQ_PROFILE_ZONE("update");
+    //update() runs after the previous draw() got swapped to the screen
+    mSpectrogramPlot.onFramePresented();
+    mStats.update(mAudioNodes, mSpectrogramPlot.getNumRowsDrawn(), mTimer.getSeconds());
+    logLatency();
+
+    //A region finished analysing, it stays over the paused view until drawing resumes. A failed one
+    //leaves the previous region up.
+    dsp::RegionResult detail;
+    if (mRegionAnalyzer.popResult(detail))
+    {
+        std::stringstream status;
+        if (detail.mError.empty())
+        {
+            status << std::fixed << std::setprecision(1) << "Detail: " << detail.mNumRows << " rows x " << detail.mNumBins << " bins, "
+                << 1000.0 * detail.mRequest.mWindowSize / detail.mRequest.mSampleRate << " ms window, "
+                << 1000.0 * detail.mRequest.mHopSize / detail.mRequest.mSampleRate << " ms hop, FFT " << detail.mFftSize;
+            mSpectrogramPlot.setDetail(std::move(detail));
+        }
+        else
+        {
+            status << "Detail: " << detail.mError;
+            ci::app::console() << "region analysis: " << detail.mError << std::endl;
+        }
+        mDetailStatus = status.str();
+    }
+
+    if (mAudioNodes.isPlayback())
+    {
+        //Only the newest drag position of the frame gets decoded
+        if (mScrubPending)
+        {
+            //At most 20 s of rows come back per jump, a longer view fills in as playback runs
+            mAudioNodes.seekPlayback(mScrubTime, std::min(userSpecDuration, static_cast<size_t>(userHopSize) * 20));
+            mScrubPending = false;
+        }
+        //The next frame is of another recorded geometry, the plot retunes as it arrives
+        if (mAudioNodes.getGeneration() != mPlaybackGeneration)
+        {
+            mPlaybackGeneration = mAudioNodes.getGeneration();
+            reconfigureAnalysis();
+        }
+    }
+
     if (userWinSize != userWinSizePrev)
     {
         userWinSizeMs = static_cast<double>(userWinSize) / 1000;
@@ -178,18 +352,11 @@ void InputAnalyzer::update()
         nearestFft = static_cast<size_t>(pow(2, nearestPow2));
         if (nearestFft > fftSize)
         {
-            fftSize = static_cast<size_t>(pow(2, (nearestPow2 - 1.0)));
+            //Zoom mode only transforms the displayed band, so it can afford to round up to the finer bin spacing
+            fftSize = zoomFftMode ? nearestFft : static_cast<size_t>(pow(2, (nearestPow2 - 1.0)));
         }
-        mAudioNodes.disableInput();
-        mAudioNodes.disconnectAll();
-        mAudioNodes.setup(userHopSize, userWinSize, fftSize);
-        mAudioNodes.enableInput();
-
-        fftSize = mAudioNodes.getFftSize();
-        dispBins = (fftSize * userSpecMaxFreq) / static_cast<size_t>(hSR);
-        mSpectrogramPlot.setup(userSpecDuration, dispBins);
+        reconfigureAnalysis();
         userWinSizePrev = userWinSize;
-        userSpecDurPrev = 0; //Make sure we resize the display height just in case;
     }
 
     if (userSpecMaxFreq != userSpecMaxFreqPrev)
@@ -210,120 +377,413 @@ void InputAnalyzer::update()
 		nearestFft = static_cast<size_t>(pow(2, nearestPow2));
 		if (nearestFft > fftSize)
 		{
-			fftSize = static_cast<size_t>(pow(2, (nearestPow2 - 1.0)));
+			//Zoom mode only transforms the displayed band, so it can afford to round up to the finer bin spacing
+			fftSize = zoomFftMode ? nearestFft : static_cast<size_t>(pow(2, (nearestPow2 - 1.0)));
 		}
         //if (fftSize != fftSizePrev)
         //{
-            mAudioNodes.disableInput();
-            mAudioNodes.disconnectAll();
-            mAudioNodes.setup(userHopSize, userWinSize, fftSize);
-            mAudioNodes.enableInput();
+            reconfigureAnalysis();
             fftSizePrev = fftSize;
         //}
-        fftSize = mAudioNodes.getFftSize();
-        dispBins = (fftSize * userSpecMaxFreq) / static_cast<size_t>(hSR);
-        mSpectrogramPlot.setup(userSpecDuration, dispBins);
         userSpecMaxFreqPrev = userSpecMaxFreq;
-        userSpecDurPrev = 0; //Make sure we resize the display height just in case;
     }
     if (userHopSize != userHopSizePrev)
     {
-        mAudioNodes.disableInput();
-        mAudioNodes.disconnectAll();
-        mAudioNodes.setup(userHopSize, userWinSize, fftSize);
-        mAudioNodes.enableInput();
-        fftSize = mAudioNodes.getFftSize();
-        dispBins = (fftSize * userSpecMaxFreq) / static_cast<size_t>(hSR);
-        mSpectrogramPlot.setup(userSpecDuration, dispBins);
+        reconfigureAnalysis();
         userHopSizePrev = userHopSize;
-        userSpecDurPrev = 0; //Make sure we resize the display height just in case;
+    }
+
+    if (userPalette != userPalettePrev)
+    {
+        //Only the palette texture changes, the history recolours on the next draw
+        mSpectrogramPlot.setPalette(static_cast<dsp::Palette>(userPalette));
+        userPalettePrev = userPalette;
     }
 
     if (userSpecDurSeconds != userSpecDurPrev)
     {
         userSpecDuration = static_cast<size_t>(userHopSize) * userSpecDurSeconds; 
-        mSpectrogramPlot.setup(userSpecDuration, dispBins);
+        mSpectrogramPlot.retune(userSpecDuration, dispBins, static_cast<float>(userHopSize), mAudioNodes.getGeneration());
         userSpecDurPrev = userSpecDurSeconds;
     }
-    //timeSec1Exit = mTimer.getSeconds();
-    //timeSec1Process = timeSec1Exit - timeSec1Enter;
 }
 
 void InputAnalyzer::draw()
 {
+    CIEQ_PROFILE_ZONE("draw");
+    mStats.onRenderFrame(mTimer.getSeconds(), 1.0 / getFrameRate());
     if (!pauseDrawing)
     {
         timeEnter = mTimer.getSeconds();
         timeReturn = timeEnter - timeEnterPrev;
         timeEnterPrev = timeEnter;
-        timeSec1Enter = mTimer.getSeconds();
+    }
+    {
+        CIEQ_PROFILE_ZONE("clear");
         //Set background color for main window
         ci::ColorA backgroundColor = ci::ColorA::gray(0.25f, 0);
         ci::gl::clear(backgroundColor);
         ci::gl::enableAlphaBlending();
-        timeSec1Exit = mTimer.getSeconds();
-        timeSec1Process = timeSec1Exit - timeSec1Enter;
+    }
 
-        timeSec2Enter = mTimer.getSeconds();
+    {
+        CIEQ_PROFILE_ZONE("spectrogram plot");
         //mSpectrumPlot.draw(0, 0, 0, 0);
         //mWaveformPlotShifted.draw(shift, shiftLength, userMaxMag, 0);
+        //Paused, the plot is frozen and only redrawn with the re-analysed region and the selection over it
         mSpectrogramPlot.draw(userWinSizeMs, static_cast<float>(userHopSize), userSpecMaxFreq, userMaxMag, linearDbMode);
         //mWaveformPlot.draw(0, 10, 0, 0);
-        timeSec2Exit = mTimer.getSeconds();
-        timeSec2Process = timeSec2Exit - timeSec2Enter;
-
-        // draw framerate in FPS
-        timeSec4Enter = mTimer.getSeconds();
-        drawFps();
-        timeSec4Exit = mTimer.getSeconds();
-        timeSec4Process = timeSec4Exit - timeSec4Enter;
     }
+    drawSelection();
+
+    // draw settings, pipeline counters and latency
+    drawStats();
+    drawPlaybackBar();
 
     //Draw parameter window:
-    timeSec3Enter = mTimer.getSeconds();
+    CIEQ_PROFILE_ZONE("params");
     mParams->draw();
-    timeSec3Exit = mTimer.getSeconds();
-    timeSec3Process = timeSec3Exit - timeSec3Enter;
 }
 
 void InputAnalyzer::shutdown()
 {
-    //NA
+    //Keep whatever got measured after a reconfigure
+    saveFftWisdom();
+    //A recording without its index would have to be recovered
+    if (mAudioNodes.isRecording())
+    {
+        mAudioNodes.stopRecording();
+    }
 }
 
 void InputAnalyzer::mouseDown(ci::app::MouseEvent event)
 {
+    //Paused, a press on the spectrogram may start selecting a region, mouseUp() tells whether it was a click
+    const ci::Vec2f position(static_cast<float>(event.getX()), static_cast<float>(event.getY()));
+    const ci::Rectf& plot = mSpectrogramPlot.getBounds();
+    if (pauseDrawing && mAudioNodes.hasPcmHistory() && position.x >= plot.x1 && position.x <= plot.x2 && position.y >= plot.y1 && position.y <= plot.y2)
+    {
+        mSelecting = true;
+        mSelectStart = position;
+        mSelectEnd = position;
+        return;
+    }
+    //A click on the timeline scrubs instead of pausing
+    const ci::Rectf bar = getPlaybackBarBounds();
+    if (mAudioNodes.isPlayback() && event.getY() <= bar.y2 + 4.0f && event.getX() >= bar.x1 && event.getX() <= bar.x2)
+    {
+        mScrubbing = true;
+        scrubPlayback(static_cast<float>(event.getX()));
+        return;
+    }
 	mEventProcessor.processMouseEvents(
 		static_cast<float>(event.getX()),
         static_cast<float>(event.getY()));
 }
 
+void InputAnalyzer::mouseDrag(ci::app::MouseEvent event)
+{
+    if (mScrubbing)
+    {
+        scrubPlayback(static_cast<float>(event.getX()));
+    }
+    if (mSelecting)
+    {
+        mSelectEnd = ci::Vec2f(static_cast<float>(event.getX()), static_cast<float>(event.getY()));
+    }
+}
+
+void InputAnalyzer::mouseUp(ci::app::MouseEvent event)
+{
+    mScrubbing = false;
+    if (!mSelecting)
+        return;
+
+    mSelecting = false;
+    mSelectEnd = ci::Vec2f(static_cast<float>(event.getX()), static_cast<float>(event.getY()));
+    if (std::abs(mSelectEnd.x - mSelectStart.x) < kSelectMinPixels && std::abs(mSelectEnd.y - mSelectStart.y) < kSelectMinPixels)
+    {
+        //Just a click, resumes like anywhere else
+        mEventProcessor.processMouseEvents(mSelectStart.x, mSelectStart.y);
+        return;
+    }
+    analyzeSelection();
+}
+
 void InputAnalyzer::keyDown(ci::app::KeyEvent event)
 {
     mEventProcessor.processKeybaordEvents(event.getChar());
 }
 
-void InputAnalyzer::drawFps()
-{
-    std::stringstream buf;
-    std::stringstream numBins;
-    std::stringstream numBinsDisp;
-    std::stringstream fftSize;
-    std::stringstream maxFreqDisp;
-    std::stringstream actualHopRate;
-    numDispParams = 6;
-    buf << "FPS: " << ci::app::getFrameRate();
-    ci::gl::drawString(buf.str(), ci::Vec2i((((0.9f * ci::app::getWindowSize().x) / numDispParams) * 0) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
-    numBins << "Number of Bins: " << mAudioNodes.getNumBins();
-    ci::gl::drawString(numBins.str(), ci::Vec2i(((((0.9f * ci::app::getWindowSize().x)) / numDispParams) * 1) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
-    fftSize << "FFT Size: " << mAudioNodes.getFftSize();
-    ci::gl::drawString(fftSize.str(), ci::Vec2i(((((0.9f * ci::app::getWindowSize().x)) / numDispParams) * 2) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
-    numBinsDisp << "Number of Bins Displayed: " << mSpectrogramPlot.getMaxDispBins();
-    ci::gl::drawString(numBinsDisp.str(), ci::Vec2i(((((0.9f * ci::app::getWindowSize().x)) / numDispParams) * 3) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
-    maxFreqDisp << "Max Freq Displayed: " << mAudioNodes.getMaxFreqDisp(mSpectrogramPlot.getMaxDispBins());
-    ci::gl::drawString(maxFreqDisp.str(), ci::Vec2i(((((0.9f * ci::app::getWindowSize().x)) / numDispParams) * 4) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
-    actualHopRate << "Hop Rate (Hz): " << mSpectrogramPlot.getActualHopRate();
-    ci::gl::drawString(actualHopRate.str(), ci::Vec2i(((((0.9f * ci::app::getWindowSize().x)) / numDispParams) * 5) + (0.05f * ci::app::getWindowSize().x), ci::app::getWindowHeight() - 10));
+void InputAnalyzer::drawStats()
+{
+    CIEQ_PROFILE_ZONE("stats text");
+    //Every string is rasterized into its own texture, so the block is only re-rendered a few times a second
+    const double now = mTimer.getSeconds();
+    if (!mStatsTexture || now - mStatsTextTime >= 0.25)
+    {
+        renderStats();
+        mStatsTextTime = now;
+    }
+
+    ci::gl::color(ci::Color::white());
+    ci::gl::draw(mStatsTexture, ci::Vec2f(0.05f * ci::app::getWindowWidth(), static_cast<float>(ci::app::getWindowHeight() - mStatsTexture.getHeight() - 2)));
+}
+
+ci::Rectf InputAnalyzer::getPlaybackBarBounds()
+{
+    const float width = static_cast<float>(ci::app::getWindowWidth());
+    return ci::Rectf(0.05f * width, 4.0f, 0.95f * width, 12.0f);
+}
+
+void InputAnalyzer::drawPlaybackBar()
+{
+    if (!mAudioNodes.isPlayback())
+        return;
+
+    const dsp::SpectrogramPlayer& player = mAudioNodes.getPlayer();
+    const double duration = player.getEndTime() - player.getStartTime();
+    const ci::Rectf bar = getPlaybackBarBounds();
+    const float played = duration > 0.0 ? static_cast<float>((player.getPosition() - player.getStartTime()) / duration) : 0.0f;
+    const float playhead = bar.x1 + played * bar.getWidth();
+
+    ci::gl::color(ci::Color::gray(0.4f));
+    ci::gl::drawSolidRect(bar);
+    ci::gl::color(ci::Color(0.3f, 0.6f, 1.0f));
+    ci::gl::drawSolidRect(ci::Rectf(bar.x1, bar.y1, playhead, bar.y2));
+    ci::gl::color(ci::Color::white());
+    ci::gl::drawSolidRect(ci::Rectf(playhead - 1.0f, bar.y1 - 2.0f, playhead + 1.0f, bar.y2 + 2.0f));
+}
+
+void InputAnalyzer::scrubPlayback(float x)
+{
+    const dsp::SpectrogramPlayer& player = mAudioNodes.getPlayer();
+    const ci::Rectf bar = getPlaybackBarBounds();
+    const double fraction = std::min(std::max((x - bar.x1) / bar.getWidth(), 0.0f), 1.0f);
+    mScrubTime = player.getStartTime() + fraction * (player.getEndTime() - player.getStartTime());
+    mScrubPending = true;
+}
+
+void InputAnalyzer::analyzeSelection()
+{
+    dsp::RegionRequest request;
+    if (!mSpectrogramPlot.getRegion(ci::Rectf(mSelectStart, mSelectEnd), request))
+        return;
+
+    //The FFT is at least as fine as the live one, and only the selected band gets transformed
+    const size_t sampleRate = mAudioNodes.getHardwareSampleRate();
+    request.mSampleRate = sampleRate;
+    request.mWindowSize = std::max<size_t>(static_cast<size_t>(userDetailWinSize * sampleRate / 1000), 2);
+    request.mHopSize = std::max<size_t>(static_cast<size_t>(userDetailHopMs * sampleRate / 1000.0f), 1);
+    request.mFftSize = dsp::StreamingStft::roundFftSize(mAudioNodes.getFftSize(), request.mWindowSize);
+
+    //Too many rows for one texture coarsen the hop, too many bins shrink the zero padding, then the band
+    const size_t span = static_cast<size_t>(request.mLastSample - request.mFirstSample);
+    if (span / request.mHopSize + 1 > kMaxDetailRows)
+    {
+        request.mHopSize = span / (kMaxDetailRows - 1) + 1;
+    }
+    const size_t minFftSize = dsp::StreamingStft::roundFftSize(1, request.mWindowSize);
+    while (request.mFftSize > minFftSize && (request.mMaxFreq - request.mMinFreq) * request.mFftSize / sampleRate > kMaxDetailBins)
+    {
+        request.mFftSize /= 2;
+    }
+    request.mMaxFreq = std::min(request.mMaxFreq, request.mMinFreq + static_cast<float>(kMaxDetailBins - 2) * sampleRate / request.mFftSize);
+
+    mRegionAnalyzer.analyze(mAudioNodes.getPcmHistory(), request);
+    mDetailStatus.clear();
+}
+
+void InputAnalyzer::drawSelection()
+{
+    if (!mSelecting)
+        return;
+    ci::gl::color(ci::Color::white());
+    ci::gl::drawStrokedRect(ci::Rectf(std::min(mSelectStart.x, mSelectEnd.x), std::min(mSelectStart.y, mSelectEnd.y),
+        std::max(mSelectStart.x, mSelectEnd.x), std::max(mSelectStart.y, mSelectEnd.y)));
+}
+
+void InputAnalyzer::renderStats()
+{
+    ci::TextLayout layout;
+    layout.clear(ci::ColorA(0.0f, 0.0f, 0.0f, 0.0f));
+
+    //Red first line whenever the current configuration can't keep up
+    if (mStats.isFallingBehind())
+    {
+        layout.setColor(ci::Color(1.0f, 0.25f, 0.25f));
+        layout.addLine("FALLING BEHIND: " + mStats.getAlert());
+    }
+    layout.setColor(ci::Color::white());
+
+    std::stringstream settings;
+    settings << "FPS: " << static_cast<int>(ci::app::getFrameRate() + 0.5f)
+        << "   Number of Bins: " << mAudioNodes.getNumBins()
+        << "   FFT Size: " << mAudioNodes.getFftSize();
+    if (mAudioNodes.getTransformSize() != mAudioNodes.getFftSize())
+    {
+        settings << " (zoom: " << mAudioNodes.getTransformSize() << ")";
+    }
+    settings << "   Number of Bins Displayed: " << mSpectrogramPlot.getMaxDispBins() << " (" << mAudioNodes.getBinRangeMethodName() << ")"
+        << "   Max Freq Displayed: " << mAudioNodes.getMaxFreqDisp(mSpectrogramPlot.getMaxDispBins())
+        << "   Hop Rate (Hz): " << std::fixed << std::setprecision(1) << mSpectrogramPlot.getActualHopRate();
+    if (mAudioNodes.isOffline())
+    {
+        settings << " (file: " << static_cast<int>(100.0 * mAudioNodes.getOfflineProgress()) << "%)";
+    }
+    if (mAudioNodes.isPlayback())
+    {
+        const dsp::SpectrogramPlayer& player = mAudioNodes.getPlayer();
+        settings << "   Playback: " << formatDuration(player.getPosition()) << " / " << formatDuration(player.getEndTime())
+            << (player.isPlaying() ? "" : " (paused)");
+    }
+    const dsp::SpectrogramPyramid& history = mSpectrogramPlot.getHistory();
+    if (history.isSetup())
+    {
+        settings << "   History: " << history.getResidentBytes() / 1.0e6 << " MB in memory, " << history.getSpilledBytes() / 1.0e6
+            << " MB on disk (level " << mSpectrogramPlot.getViewLevel() << ")";
+    }
+    if (mRegionAnalyzer.isBusy())
+    {
+        settings << "   Detail: analysing " << static_cast<int>(100.0f * mRegionAnalyzer.getProgress()) << "%";
+    }
+    else if (pauseDrawing && !mDetailStatus.empty())
+    {
+        settings << "   " << mDetailStatus;
+    }
+    layout.addLine(settings.str());
+
+    const PipelineCounters& counters = mStats.getCounters();
+    std::stringstream pipeline;
+    pipeline << std::fixed << std::setprecision(1)
+        << "Hops: " << counters.mHopsProduced << " / " << counters.mHopsExpected << " (" << 100.0 * mStats.getHopRatio() << "%)"
+        << "   Row interval: " << mStats.getRowIntervalMs() << " +/- " << mStats.getRowJitterMs() << " ms"
+        << "   Rows skipped: " << counters.mRowsSkipped
+        << "   Frames missed: " << counters.mRenderFramesMissed << " / " << counters.mRenderFrames
+        << "   Input overruns: " << counters.mInputOverruns << " (" << counters.mCaptureSamplesDropped << " samples lost)"
+        << "   Queue peak: " << counters.mFrameQueueHighWater << " / " << counters.mFrameQueueCapacity
+        << "   Ring peak: " << counters.mCaptureRingHighWater << " / " << counters.mCaptureRingSize;
+    if (mAudioNodes.isRecording())
+    {
+        const dsp::SpectrogramRecorder& recorder = mAudioNodes.getRecorder();
+        pipeline << "   REC: " << recorder.getNumFramesWritten() << " frames, " << recorder.getNumBytesWritten() / 1.0e6 << " MB";
+        if (recorder.getNumDroppedFrames() != 0)
+        {
+            pipeline << " (" << recorder.getNumDroppedFrames() << " dropped)";
+        }
+    }
+    layout.addLine(pipeline.str());
+
+    //Capture to screen latency
+    const dsp::LatencyHistogram& upload = mSpectrogramPlot.getUploadLatency();
+    const dsp::LatencyHistogram& present = mSpectrogramPlot.getPresentLatency();
+    std::stringstream latency;
+    latency << std::fixed << std::setprecision(1)
+        << "Latency p50/p95/p99 (ms) - upload: " << 1000.0 * upload.getPercentile(0.5) << " / " << 1000.0 * upload.getPercentile(0.95) << " / " << 1000.0 * upload.getPercentile(0.99)
+        << "  swap: " << 1000.0 * present.getPercentile(0.5) << " / " << 1000.0 * present.getPercentile(0.95) << " / " << 1000.0 * present.getPercentile(0.99)
+        << "  (last " << present.getCount() << " rows)";
+    layout.addLine(latency.str());
+
+    mStatsTexture = ci::gl::Texture(layout.render(true));
+}
+
+std::string InputAnalyzer::describeConfiguration()
+{
+    std::stringstream description;
+    description << "window " << userWinSize << " ms; hop " << userHopSize << " Hz; fft " << mAudioNodes.getFftSize()
+        << (zoomFftMode ? " zoom" : " full band") << "; " << dispBins << " bins";
+    if (mAudioNodes.isOffline())
+    {
+        description << "; offline";
+    }
+    else if (mAudioNodes.isGenerated())
+    {
+        description << "; generated";
+    }
+    else if (mAudioNodes.isPlayback())
+    {
+        description << "; playback";
+    }
+    return description.str();
+}
+
+void InputAnalyzer::resetStats()
+{
+    mStats.reset(describeConfiguration(), mTimer.getSeconds());
+}
+
+void InputAnalyzer::reconfigureAnalysis()
+{
+    //Nothing here waits on the analysis: the engine plans the new transform on its own thread
+    //and the plot resamples its history once the first row of it arrives
+    hSR = static_cast<float>(mAudioNodes.getHardwareSampleRate());
+    const std::uint32_t generation = mAudioNodes.reconfigure(userHopSize, userWinSize, fftSize, zoomFftMode ? userSpecMaxFreq : 0, userSpecMaxFreq);
+    fftSize = mAudioNodes.getFftSize();
+    dispBins = (fftSize * userSpecMaxFreq) / static_cast<size_t>(hSR);
+    userSpecDuration = static_cast<size_t>(userHopSize) * userSpecDurSeconds;
+    userSpecDurPrev = userSpecDurSeconds;
+    mSpectrogramPlot.retune(userSpecDuration, dispBins, static_cast<float>(userHopSize), generation);
+    resetStats();
+}
+
+void InputAnalyzer::writeStatsCsv()
+{
+    std::stringstream path;
+    path << "cieq_stats_" << ci::app::getElapsedFrames() << ".csv";
+    if (mStats.writeCsv(path.str()))
+        ci::app::console() << "statistics written to " << path.str() << std::endl;
+    else
+        ci::app::console() << "can't write " << path.str() << std::endl;
+}
+
+ci::fs::path InputAnalyzer::getFftWisdomPath()
+{
+    //Per user: %APPDATA% on Windows, $XDG_CONFIG_HOME or ~/.config elsewhere
+    ci::fs::path directory;
+    if (const char* appData = std::getenv("APPDATA"))
+        directory = ci::fs::path(appData);
+    else if (const char* configHome = std::getenv("XDG_CONFIG_HOME"))
+        directory = ci::fs::path(configHome);
+    else
+        directory = ci::getHomeDirectory() / ".config";
+    return directory / "FCS_AudioAnalyzer" / "fft_wisdom.txt";
+}
+
+void InputAnalyzer::loadFftWisdom()
+{
+    dsp::FftWisdom& wisdom = dsp::FftWisdom::get();
+    if (!wisdom.load(getFftWisdomPath().string()))
+        ci::app::console() << wisdom.getError() << ", measuring again" << std::endl;
+    wisdom.setMeasuring(true);
+}
+
+void InputAnalyzer::saveFftWisdom()
+{
+    dsp::FftWisdom& wisdom = dsp::FftWisdom::get();
+    if (!wisdom.isDirty())
+        return;
+
+    const ci::fs::path path = getFftWisdomPath();
+    boost::system::error_code error;
+    ci::fs::create_directories(path.parent_path(), error);
+    if (!wisdom.save(path.string()))
+        ci::app::console() << wisdom.getError() << std::endl;
+}
+
+void InputAnalyzer::toggleRecording()
+{
+    if (mAudioNodes.isRecording())
+    {
+        if (mAudioNodes.stopRecording())
+            ci::app::console() << "recording finished, " << mAudioNodes.getRecorder().getNumFramesWritten() << " frames" << std::endl;
+        return;
+    }
+
+    //One file per recording, next to wherever the app was started from
+    std::stringstream path;
+    path << "cieq_recording_" << ci::app::getElapsedFrames() << ".cspec";
+    if (mAudioNodes.startRecording(path.str(), mRecordingFormat))
+        ci::app::console() << "recording to " << path.str() << std::endl;
 }
 
 void InputAnalyzer::togglePauseDrawing()
@@ -335,7 +795,13 @@ void InputAnalyzer::togglePauseDrawing()
     else
     {
         pauseDrawing = 0;
+        //Back to live, a region of the paused view means nothing any more
+        mRegionAnalyzer.cancel();
+        mSpectrogramPlot.clearDetail();
+        mDetailStatus.clear();
     }
+    mSpectrogramPlot.setFrozen(pauseDrawing);
+    mStats.setPaused(pauseDrawing);
 }
 
 void InputAnalyzer::linearDBModeButton()
@@ -354,6 +820,50 @@ void InputAnalyzer::linearDBModeButton()
     }
 }
 
+void InputAnalyzer::zoomFftModeButton()
+{
+    if (!zoomFftMode)
+    {
+        zoomFftMode = 1; //Zoom FFT over 0..max display frequency
+        mParams->setOptions("zoomFftModeText", "label=`Zoom FFT`");
+    }
+    else
+    {
+        zoomFftMode = 0; //Full band FFT (default)
+        mParams->setOptions("zoomFftModeText", "label=`Full Band FFT`");
+    }
+    userSpecMaxFreqPrev = 0; //Recompute the FFT size and restart the analysis
+}
+
+void InputAnalyzer::logLatency()
+{
+    const double now = mTimer.getSeconds();
+    const dsp::LatencyHistogram& present = mSpectrogramPlot.getPresentLatency();
+    if (now - mLatencyLogTime < 5.0 || present.getCount() == 0)
+        return;
+    mLatencyLogTime = now;
+
+    const dsp::LatencyHistogram& upload = mSpectrogramPlot.getUploadLatency();
+    ci::app::console() << std::fixed << std::setprecision(2)
+        << "latency ms p50/p95/p99 upload " << 1000.0 * upload.getPercentile(0.5) << "/" << 1000.0 * upload.getPercentile(0.95) << "/" << 1000.0 * upload.getPercentile(0.99)
+        << " swap " << 1000.0 * present.getPercentile(0.5) << "/" << 1000.0 * present.getPercentile(0.95) << "/" << 1000.0 * present.getPercentile(0.99)
+        << " | window " << userWinSize << " ms, hop " << userHopSize << " Hz, fft " << mAudioNodes.getFftSize()
+        << (zoomFftMode ? " zoom" : " full band") << ", " << mSpectrogramPlot.getMaxDispBins() << " bins" << std::endl;
+}
+
+void InputAnalyzer::writeProfileTrace()
+{
+    //One file per press, next to wherever the app was started from
+    std::stringstream path;
+    path << "cieq_trace_" << ci::app::getElapsedFrames() << ".json";
+    if (dsp::Profiler::get().writeChromeTrace(path.str()))
+        ci::app::console() << "profile written to " << path.str() << " (open in chrome://tracing or ui.perfetto.dev)" << std::endl;
+    else
+        ci::app::console() << "can't write " << path.str() << std::endl;
+#if !CIEQ_ENABLE_PROFILING
+    ci::app::console() << "profiling zones are compiled out (CIEQ_ENABLE_PROFILING=0)" << std::endl;
+#endif
+}
 
 } //!namespace cieq
 
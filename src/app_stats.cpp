@@ -0,0 +1,203 @@
+#include "app_stats.h"
+#include "audio_nodes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <sstream>
+
+namespace cieq
+{
+
+namespace
+{
+    //! an hour of one second rows
+    const std::size_t kMaxHistoryRows = 3600;
+    //! keep an alert up this long after the last problem, so it can be read
+    const double kAlertHoldSeconds = 3.0;
+    //! hops the analysis may trail the input by within a period before it counts as missing
+    const double kHopTolerance = 0.05;
+}
+
+AppStats::AppStats()
+    : mPeriodStartTime(0.0)
+    , mConfigurationStartTime(0.0)
+    , mLastRenderTime(0.0)
+    , mLastRowTime(0.0)
+    , mLastRowsDrawn(0)
+    , mRowIntervalCount(0)
+    , mRowIntervalSum(0.0)
+    , mRowIntervalSumSquares(0.0)
+    , mRowIntervalMs(0.0)
+    , mRowJitterMs(0.0)
+    , mHopRatio(1.0)
+    , mAlertUntil(0.0)
+    , mFirstConfiguration(0)
+    , mPaused(false)
+{}
+
+void AppStats::reset(const std::string& configuration, double now)
+{
+    mCounters = PipelineCounters();
+    mPeriodStart = PipelineCounters();
+    mPeriodStartTime = now;
+    mConfigurationStartTime = now;
+    mLastRowTime = 0.0;
+    mRowIntervalCount = 0;
+    mRowIntervalSum = 0.0;
+    mRowIntervalSumSquares = 0.0;
+    mHopRatio = 1.0;
+    mAlert.clear();
+    mAlertUntil = 0.0;
+
+    //A configuration that never made it into a row is just replaced
+    const std::size_t current = mFirstConfiguration + mConfigurations.size() - 1;
+    if (!mConfigurations.empty() && (mHistory.empty() || mHistory.back().mConfiguration != current))
+        mConfigurations.back() = configuration;
+    else
+        mConfigurations.push_back(configuration);
+}
+
+void AppStats::onRenderFrame(double now, double targetInterval)
+{
+    mCounters.mRenderFrames++;
+    if (mPaused)
+    {
+        //Whatever the pause holds up isn't a missed refresh
+        mLastRenderTime = 0.0;
+        return;
+    }
+    //Anything past one and a half intervals skipped at least one refresh
+    if (mLastRenderTime > 0.0 && targetInterval > 0.0 && now - mLastRenderTime > 1.5 * targetInterval)
+    {
+        mCounters.mRenderFramesMissed += static_cast<std::uint64_t>(std::floor((now - mLastRenderTime) / targetInterval + 0.5)) - 1;
+    }
+    mLastRenderTime = now;
+}
+
+void AppStats::update(AudioNodes& nodes, std::uint64_t rowsDrawn, double now)
+{
+    nodes.readCounters(mCounters);
+    if (mPaused)
+    {
+        //Frames the paused plot lets pile up and the engine skips are the user's doing, the
+        //first period after the pause starts counting from here
+        mPeriodStart = mCounters;
+        mPeriodStartTime = now;
+        mLastRowTime = 0.0;
+        mLastRowsDrawn = rowsDrawn;
+        if (now >= mAlertUntil)
+            mAlert.clear();
+        return;
+    }
+
+    //Rows arrive a few per draw, spread the interval since the last batch over them
+    if (rowsDrawn > mLastRowsDrawn)
+    {
+        const std::uint64_t newRows = rowsDrawn - mLastRowsDrawn;
+        if (mLastRowTime > 0.0)
+        {
+            const double interval = (now - mLastRowTime) / static_cast<double>(newRows);
+            mRowIntervalCount += static_cast<std::size_t>(newRows);
+            mRowIntervalSum += interval * newRows;
+            mRowIntervalSumSquares += interval * interval * newRows;
+        }
+        mLastRowTime = now;
+        mLastRowsDrawn = rowsDrawn;
+        mCounters.mRowsDrawn += newRows;
+    }
+
+    if (now - mPeriodStartTime >= 1.0)
+    {
+        closePeriod(now);
+    }
+}
+
+void AppStats::closePeriod(double now)
+{
+    const std::uint64_t expected = mCounters.mHopsExpected - std::min(mCounters.mHopsExpected, mPeriodStart.mHopsExpected);
+    const std::uint64_t produced = mCounters.mHopsProduced - std::min(mCounters.mHopsProduced, mPeriodStart.mHopsProduced);
+    mHopRatio = expected ? static_cast<double>(produced) / static_cast<double>(expected) : 1.0;
+
+    if (mRowIntervalCount > 0)
+    {
+        const double mean = mRowIntervalSum / mRowIntervalCount;
+        mRowIntervalMs = 1000.0 * mean;
+        mRowJitterMs = 1000.0 * std::sqrt(std::max(0.0, mRowIntervalSumSquares / mRowIntervalCount - mean * mean));
+    }
+    mRowIntervalCount = 0;
+    mRowIntervalSum = 0.0;
+    mRowIntervalSumSquares = 0.0;
+
+    //Anything lost in this period raises the alert, the first reason found is shown
+    std::stringstream problem;
+    if (expected > 0 && produced + std::max(2.0, kHopTolerance * expected) < expected)
+        problem << "analysis can't keep up, " << static_cast<int>(100.0 * mHopRatio) << "% of hops produced";
+    else if (mCounters.mRowsSkipped > mPeriodStart.mRowsSkipped)
+        problem << (mCounters.mRowsSkipped - mPeriodStart.mRowsSkipped) << " rows skipped, drawing doesn't keep up";
+    else if (mCounters.mCaptureSamplesDropped > mPeriodStart.mCaptureSamplesDropped)
+        problem << (mCounters.mCaptureSamplesDropped - mPeriodStart.mCaptureSamplesDropped) << " input samples lost, capture ring full";
+    else if (mCounters.mInputOverruns > mPeriodStart.mInputOverruns)
+        problem << "audio input overrun";
+    if (!problem.str().empty())
+    {
+        mAlert = problem.str();
+        mAlertUntil = now + kAlertHoldSeconds;
+    }
+    else if (now >= mAlertUntil)
+    {
+        mAlert.clear();
+    }
+
+    HistoryRow row;
+    row.mTime = now;
+    row.mSecondsInConfiguration = now - mConfigurationStartTime;
+    row.mConfiguration = mFirstConfiguration + mConfigurations.size() - 1;
+    row.mCounters = mCounters;
+    row.mRowIntervalMs = mRowIntervalMs;
+    row.mRowJitterMs = mRowJitterMs;
+    row.mFallingBehind = !problem.str().empty();
+    mHistory.push_back(row);
+    if (mHistory.size() > kMaxHistoryRows)
+    {
+        mHistory.pop_front();
+        //Configurations no row refers to any more go with them
+        while (mConfigurations.size() > 1 && mHistory.front().mConfiguration > mFirstConfiguration)
+        {
+            mConfigurations.pop_front();
+            mFirstConfiguration++;
+        }
+    }
+
+    mPeriodStart = mCounters;
+    mPeriodStartTime = now;
+}
+
+bool AppStats::writeCsv(const std::string& path) const
+{
+    std::FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fputs("time_s,configuration,config_time_s,hops_expected,hops_produced,rows_skipped,rows_drawn,"
+        "render_frames,render_frames_missed,input_overruns,capture_samples_dropped,"
+        "frame_queue_high_water,frame_queue_capacity,capture_ring_high_water,capture_ring_size,"
+        "row_interval_ms,row_jitter_ms,falling_behind\n", file);
+    for (const auto& row : mHistory)
+    {
+        const PipelineCounters& c = row.mCounters;
+        std::fprintf(file, "%.3f,\"%s\",%.3f,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%zu,%zu,%zu,%zu,%.3f,%.3f,%d\n",
+            row.mTime, mConfigurations[row.mConfiguration - mFirstConfiguration].c_str(), row.mSecondsInConfiguration,
+            static_cast<unsigned long long>(c.mHopsExpected), static_cast<unsigned long long>(c.mHopsProduced),
+            static_cast<unsigned long long>(c.mRowsSkipped), static_cast<unsigned long long>(c.mRowsDrawn),
+            static_cast<unsigned long long>(c.mRenderFrames), static_cast<unsigned long long>(c.mRenderFramesMissed),
+            static_cast<unsigned long long>(c.mInputOverruns), static_cast<unsigned long long>(c.mCaptureSamplesDropped),
+            c.mFrameQueueHighWater, c.mFrameQueueCapacity, c.mCaptureRingHighWater, c.mCaptureRingSize,
+            row.mRowIntervalMs, row.mRowJitterMs, row.mFallingBehind ? 1 : 0);
+    }
+
+    const bool ok = !std::ferror(file);
+    return std::fclose(file) == 0 && ok;
+}
+
+} //!cieq
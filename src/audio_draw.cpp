@@ -14,64 +14,140 @@
 #include "cinder/gl/gl.h"
 #include "cinder/gl/Texture.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+
 namespace cieq
 {
 
     namespace 
     {
-        //! A Matlab "Jet" palleted color composition implementation, adapted to Cinder.
-        //! \note original work: http://paulbourke.net/texture_colour/colourspace/
-        //! \note taken from: http://stackoverflow.com/a/7811134/1055628
-        static inline ci::Color GetColor(float v, float vmin, float vmax)
-        {
-            ci::Color c{ ci::Color::white() }; // white
-            float dv;
-
-            if (v < vmin)
-                v = vmin;
-            if (v > vmax)
-                v = vmax;
-            dv = vmax - vmin;
-
-            if (v < (vmin + 0.25f * dv)) {
-                c.r = 0.0f;
-                c.g = 4.0f * (v - vmin) / dv;
-            }
-            else if (v < (vmin + 0.5f * dv)) {
-                c.r = 0.0f;
-                c.b = 1.0f + 4.0f * (vmin + 0.25f * dv - v) / dv;
-            }
-            else if (v < (vmin + 0.75f * dv)) {
-                c.r = 4.0f * (v - vmin - 0.5f * dv) / dv;
-                c.b = 0.0f;
-            }
-            else {
-                c.g = 1.0f + 4.0f * (vmin + 0.75f * dv - v) / dv;
-                c.b = 0.0f;
-            }
+        //! entries in the palette texture, plenty for 8 bit output
+        const std::size_t kPaletteSize = 256;
+
+        //! frames the engine dropped are padded with silent rows up to this many, a longer
+        //! gap starts the history over
+        const std::uint64_t kMaxGapRows = 4096;
+
+        //! fixed function pass-through, the ring is drawn as one textured quad
+        const char* kColormapVertexShader =
+            "#version 120\n"
+            "void main()\n"
+            "{\n"
+            "    gl_TexCoord[0] = gl_MultiTexCoord0;\n"
+            "    gl_Position = ftransform();\n"
+            "}\n";
+
+        //! linear gain or dB conversion (same curve as ci::audio::linearToDecibel), clamp, palette lookup
+        const char* kColormapFragmentShader =
+            "#version 120\n"
+            "uniform sampler2D uMagnitudes;\n"
+            "uniform sampler2D uPalette;\n"
+            "uniform float uPaletteSize;\n"
+            "uniform float uMaxMag;\n"
+            "uniform int uDbMode;\n"
+            "void main()\n"
+            "{\n"
+            "    float magnitude = texture2D(uMagnitudes, gl_TexCoord[0].st).r;\n"
+            "    float value = uMaxMag * magnitude;\n"
+            "    if (uDbMode != 0)\n"
+            "    {\n"
+            "        float db = magnitude < 1.0e-5 ? 0.0 : 20.0 * 0.30103 * log2(magnitude) + 100.0;\n"
+            "        value = db / uMaxMag;\n"
+            "    }\n"
+            "    value = clamp(value, 0.0, 1.0);\n"
+            "    float u = (value * (uPaletteSize - 1.0) + 0.5) / uPaletteSize;\n"
+            "    gl_FragColor = vec4(texture2D(uPalette, vec2(u, 0.5)).rgb, 1.0);\n"
+            "}\n";
 
-            return c;
+        //! time axis tick label, whole seconds once a view spans minutes
+        std::string formatSeconds(float seconds)
+        {
+            std::ostringstream out;
+            if (seconds >= 100.0f)
+                out << std::fixed << std::setprecision(0);
+            else
+                out << std::setprecision(2);
+            out << seconds;
+            return out.str();
         }
     }
 
 Plot::Plot()
     : mDrawBounds(true)
+    , mDrawLabels(true)
     , mBoundsColor(0.5f, 0.5f, 0.5f, 1)
+    , mOverlayDirty(true)
 {}
 
 void Plot::draw(double winSizeMs, float shift, float shiftLength, float userMaxMag, bool linearDbMode) //Added 'size_t shift' to hopefully allow for window shifting
 {
     drawLocal(winSizeMs, shift, shiftLength, userMaxMag, linearDbMode);
+    drawOverlay();
+}
 
-	if (mDrawBounds)
-	{
-		drawBounds();
-	}
+void Plot::drawOverlay()
+{
+    CIEQ_PROFILE_ZONE("overlay");
+    // Text rendering goes through a fresh texture per string, so bounds, titles and
+    // tick labels are drawn once into a window sized layer and blitted afterwards.
+    const ci::Vec2i windowSize = ci::app::getWindowSize();
+    if (!mOverlay || mOverlay.getWidth() != windowSize.x || mOverlay.getHeight() != windowSize.y)
+    {
+        ci::gl::Fbo::Format format;
+        format.enableDepthBuffer(false);
+        format.setColorInternalFormat(GL_RGBA8);
+        mOverlay = ci::gl::Fbo(windowSize.x, windowSize.y, format);
+        mOverlayDirty = true;
+    }
 
-	if (mDrawLabels)
-	{
-		drawLabels();
-	}
+    if (mOverlayDirty)
+    {
+        renderOverlay();
+        mOverlayDirty = false;
+    }
+
+    // The overlay holds premultiplied colors
+    ci::gl::enableAlphaBlending(true);
+    ci::gl::color(ci::ColorA::white());
+    ci::gl::draw(mOverlay.getTexture(), ci::Rectf(0.0f, 0.0f, static_cast<float>(windowSize.x), static_cast<float>(windowSize.y)));
+    ci::gl::disableAlphaBlending();
+}
+
+void Plot::renderOverlay()
+{
+    //The only place text gets rasterized, everything else blits the cached result
+    CIEQ_PROFILE_ZONE("text render");
+    ci::gl::SaveFramebufferBinding bindingSaver;
+    const ci::Area viewport = ci::gl::getViewport();
+
+    mOverlay.bindFramebuffer();
+    ci::gl::setViewport(mOverlay.getBounds());
+    ci::gl::pushMatrices();
+    ci::gl::setMatricesWindow(mOverlay.getSize(), false);
+    ci::gl::clear(ci::ColorA(0, 0, 0, 0));
+
+    // Straight alpha for color, accumulated coverage for alpha: the result is premultiplied
+    ci::gl::enableAlphaBlending();
+    glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (mDrawBounds)
+    {
+        drawBounds();
+    }
+
+    if (mDrawLabels)
+    {
+        drawLabels();
+    }
+
+    drawAxes();
+
+    ci::gl::disableAlphaBlending();
+    ci::gl::popMatrices();
+    mOverlay.unbindFramebuffer();
+    ci::gl::setViewport(viewport);
 }
 
 void Plot::drawBounds()
@@ -101,16 +177,19 @@ void Plot::drawLabels()
 void Plot::onHorzAxisTextChange()
 {
 	mHorzText = mHorzTitle + " (" + mHorzUnit +")";
+	invalidateOverlay();
 }
 
 void Plot::onVertAxisTextChange()
 {
 	mVertText = mVertTitle + " (" + mVertUnit + ")";
+	invalidateOverlay();
 }
 
 void Plot::setup()
 {
     mLabelFont = ci::Font(ci::app::loadResource(LABEL_FONT), 16);
+    invalidateOverlay();
 }
 
 SpectrumPlot::SpectrumPlot(AudioNodes& nodes)
@@ -125,8 +204,9 @@ SpectrumPlot::SpectrumPlot(AudioNodes& nodes)
 // original draw function is from Cinder examples _audio/common
 void SpectrumPlot::drawLocal(double winSizeMs, float shift, float shiftLength, float userMaxMag, bool linearDbMode) //Added 'size_t shift' to hopefully allow for window shifting
 {
-	auto& spectrum = mAudioNodes.getMonitorSpectralNode(1)->getMagSpectrum();
-	
+	mAudioNodes.copyLatestSpectrum(mSpectrum);
+	const auto& spectrum = mSpectrum;
+
 	if (spectrum.empty())
 		return;
 
@@ -187,6 +267,7 @@ void SpectrumPlot::enableDecibelsScale(bool on /*= true*/)
 WaveformPlot::WaveformPlot(AudioNodes& nodes)
 	: mGraphColor(0, 0.9f, 0, 1)
 	, mAudioNodes(nodes)
+	, mVertexBufferCapacity(0)
 {}
 
 void WaveformPlot::setGraphColor(const ci::ColorA& color)
@@ -197,10 +278,15 @@ void WaveformPlot::setGraphColor(const ci::ColorA& color)
 // original draw function is from Cinder examples _audio/common
 void WaveformPlot::drawLocal(double winSizeMs, float shift, float shiftLength, float userMaxMag, bool linearDbMode) //Added 'size_t shift' to hopefully allow for window shifting
 {
+    //Offline analysis has no monitor node, there is no live waveform to show
+    if (!mAudioNodes.getMonitorNode())
+        return;
+    CIEQ_PROFILE_ZONE("waveform");
+
     auto& buffer = mAudioNodes.getMonitorNode()->getBuffer();
     size_t hardwareSampleRate = 0;
     //Get current sample rate of audio hardware:
-    hardwareSampleRate = mAudioNodes.getInputDeviceNode()->getSampleRate();
+    hardwareSampleRate = mAudioNodes.getHardwareSampleRate();
     //Get total number of frames in raw audio buffer:
     size_t rawNumFrames = buffer.getNumFrames();
     //Create a variable to use for window size of shifted window in samples:
@@ -231,43 +317,378 @@ void WaveformPlot::drawLocal(double winSizeMs, float shift, float shiftLength, f
 	ci::gl::color(mGraphColor);
 
 	const float waveHeight = mBounds.getHeight() / (float)buffer.getNumChannels();
-    const float width = mBounds.getWidth();
-    //Changed denominator to rescale xScale based on shift window so shifted signal "zooms" to full graph width:
-    const float xScale = (mBounds.getWidth() / ((float)shiftEnd - shiftInt));
+    const std::size_t windowLength = shiftEnd - shiftInt;
 
+    //Vertex count is bounded by the plot width however long the window is
+    mVertices.clear();
+    mTraceStarts.clear();
 	float yOffset = mBounds.y1;
 	for (std::size_t ch = 0; ch < buffer.getNumChannels(); ch++) 
     {
-		ci::PolyLine2f waveform;
-		const float *channel = buffer.getChannel(ch);
-		float x = mBounds.x1;
-        //Added the 'shift' portions below to allow for window shifting:
-        for (std::size_t i = 0; i < (shiftEnd - shiftInt); i++) 
+        mPyramid.build(buffer.getChannel(ch), rawNumFrames);
+        mTraceStarts.push_back(mVertices.size() / 2);
+        appendTrace(shiftInt, windowLength, yOffset, waveHeight);
+		yOffset += waveHeight;
+	}
+    mTraceStarts.push_back(mVertices.size() / 2);
+
+    if (mVertices.empty())
+        return;
+
+    if (!mVertexBuffer)
+    {
+        mVertexBuffer = ci::gl::Vbo(GL_ARRAY_BUFFER);
+    }
+    mVertexBuffer.bind();
+    const std::size_t bytes = mVertices.size() * sizeof(GLfloat);
+    if (bytes > mVertexBufferCapacity)
+    {
+        mVertexBuffer.bufferData(bytes, mVertices.data(), GL_STREAM_DRAW);
+        mVertexBufferCapacity = bytes;
+    }
+    else
+    {
+        mVertexBuffer.bufferSubData(0, bytes, mVertices.data());
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, nullptr);
+    for (std::size_t ch = 0; ch + 1 < mTraceStarts.size(); ch++)
+    {
+        const std::size_t count = mTraceStarts[ch + 1] - mTraceStarts[ch];
+        if (count > 1)
+            glDrawArrays(GL_LINE_STRIP, static_cast<GLint>(mTraceStarts[ch]), static_cast<GLsizei>(count));
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+    mVertexBuffer.unbind();
+}
+
+void WaveformPlot::appendTrace(std::size_t first, std::size_t length, float yOffset, float waveHeight)
+{
+    if (length == 0)
+        return;
+
+    const float width = mBounds.getWidth();
+    const std::size_t numColumns = static_cast<std::size_t>(std::max(1.0f, std::ceil(width)));
+
+    if (length <= 2 * numColumns)
+    {
+        //Zoomed in, one column per sample reads level 0 and gives one vertex per sample
+        //at the same spacing the per-sample polyline used
+        mColumnMins.resize(length);
+        mColumnMaxs.resize(length);
+        mPyramid.envelope(first, length, length, mColumnMins.data(), mColumnMaxs.data());
+
+        const float xScale = width / static_cast<float>(length);
+        for (std::size_t i = 0; i < length; i++)
         {
-			x += xScale;
-            float y = (1 - (channel[i + shiftInt] * 0.5f + 0.5f)) * waveHeight + yOffset;
-            waveform.push_back(ci::Vec2f(x, y));
-		}
+            mVertices.push_back(mBounds.x1 + static_cast<float>(i + 1) * xScale);
+            mVertices.push_back((1 - (mColumnMins[i] * 0.5f + 0.5f)) * waveHeight + yOffset);
+        }
+        return;
+    }
 
-		if (!waveform.getPoints().empty())
-			ci::gl::draw(waveform);
+    //Zoomed out, a vertical min to max stroke per column, joined into one line strip
+    mColumnMins.resize(numColumns);
+    mColumnMaxs.resize(numColumns);
+    mPyramid.envelope(first, length, numColumns, mColumnMins.data(), mColumnMaxs.data());
 
-		yOffset += waveHeight;
-	}
+    const float xScale = width / static_cast<float>(numColumns);
+    for (std::size_t c = 0; c < numColumns; c++)
+    {
+        const float x = mBounds.x1 + (static_cast<float>(c) + 0.5f) * xScale;
+        mVertices.push_back(x);
+        mVertices.push_back((1 - (mColumnMins[c] * 0.5f + 0.5f)) * waveHeight + yOffset);
+        mVertices.push_back(x);
+        mVertices.push_back((1 - (mColumnMaxs[c] * 0.5f + 0.5f)) * waveHeight + yOffset);
+    }
 }
 
 void SpectrogramPlot::setup(int duration, size_t width)
 {
     Plot::setup();
-    mTexW = width; // mAudioNodes.getMonitorSpectralNode()->getNumBins(); //mBounds.x2 - mBounds.x1;
-    //swap out the texture every "duration" seconds
-    mTexH = static_cast<std::size_t>(duration);
+    //the ring holds "duration" rows, i.e. that many hops of history, pooled 2^level hops to a ring row
+    mViewLevel = chooseLevel(duration);
+    mViewBinPool = getLevelBinPooling(width, mViewLevel);
+    const std::size_t span = std::size_t(1) << mViewLevel;
+    mTexW = (width + mViewBinPool - 1) / mViewBinPool; // mAudioNodes.getMonitorSpectralNode()->getNumBins(); //mBounds.x2 - mBounds.x1;
+    mTexH = (static_cast<std::size_t>(std::max(duration, 0)) + span - 1) / span;
+    mFrameCounter = 0;
+    mRow.setup(mTexW);
 
-    mSpectrals[0] = Surface32f(mTexW, mTexH, false, SurfaceChannelOrder::RGBA);
-    mSpectrals[1] = Surface32f(mTexW, mTexH, false, SurfaceChannelOrder::RGBA);
-    mTexCache = gl::Texture(mSpectrals.back());
-    //gl::scale(mTexCache);  !!Need to check this out!!
-    nodeNumber = 1;
+    if (!mColormapShader && !mCpuColormap)
+    {
+        try
+        {
+            mColormapShader = gl::GlslProg(kColormapVertexShader, kColormapFragmentShader);
+        }
+        catch (const gl::GlslProgCompileExc&)
+        {
+            //No GLSL 1.20, colour rows on the CPU instead
+            mCpuColormap = true;
+        }
+    }
+    if (!mPaletteTexture)
+    {
+        gl::Texture::Format format;
+        format.setWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+        format.setMinFilter(GL_LINEAR);
+        format.setMagFilter(GL_LINEAR);
+        mPaletteTexture = gl::Texture(static_cast<int>(kPaletteSize), 1, format);
+        uploadPalette();
+    }
+
+    //Pending retunes stay queued: a resize while a reconfigure is still being planned must not
+    //lose the layout its rows bring. Whatever history there is refills the new ring, in the
+    //geometry it was computed with.
+    mRingBinHz = (mHistory.isSetup() && mHistoryBinHz > 0.0f ? mHistoryBinHz : getEngineBinHz()) * static_cast<float>(mViewBinPool);
+    mRingRowsPerSecond = 0.0f;
+    mViewRowsWritten = 0;
+    mRefillPending = mHistory.isSetup();
+    if (mTexW == 0 || mTexH == 0)
+    {
+        mRingFbo = gl::Fbo();
+        mRingTexture.reset();
+        return;
+    }
+
+    mRingFbo = createRing(mTexW, mTexH);
+    mRingTexture = mRingFbo.getTexture();
+}
+
+std::size_t SpectrogramPlot::chooseLevel(int duration) const
+{
+    const std::size_t rows = static_cast<std::size_t>(std::max(duration, 0));
+    std::size_t level = 0;
+    while (((rows + (std::size_t(1) << level) - 1) >> level) > kMaxRingRows && level + 1 < mHistorySettings.mNumLevels)
+        level++;
+    return level;
+}
+
+void SpectrogramPlot::setHistoryMaxRows(std::size_t rows)
+{
+    //Levels above the one the longest view is drawn from would only hold memory
+    std::size_t level = 0;
+    while (((rows + (std::size_t(1) << level) - 1) >> level) > kMaxRingRows)
+        level++;
+    mHistorySettings.mNumLevels = level + 1;
+}
+
+std::size_t SpectrogramPlot::getLevelBinPooling(std::size_t width, std::size_t level) const
+{
+    //Rows come out of the history, before it has any the pyramid rule tells what they will be
+    if (mHistory.isSetup() && level < mHistory.getNumLevels())
+        return mHistory.getBinPooling(level);
+    return dsp::SpectrogramPyramid::getBinPooling(std::max<std::size_t>(width, 1), level, mHistorySettings);
+}
+
+void SpectrogramPlot::resetHistory(const SpectralFrame& frame)
+{
+    const std::size_t numBins = frame.mMagnitudes.size();
+    CIEQ_PROFILE_ZONE("reset history");
+    if (numBins == 0)
+    {
+        mHistory.clear();
+        return;
+    }
+    //Without a spill file the history still works, it just isn't bounded
+    if (!mHistory.setup(numBins, mHistorySettings) && mHistory.isSetup())
+        ci::app::console() << "Spectrogram history: " << mHistory.getError() << std::endl;
+    mHistoryBinHz = getEngineBinHz();
+    //The engine's getters already describe the newest request, the frame knows its own
+    mHistoryHopSize = frame.mHopSize;
+    mHistoryWindowSize = frame.mWindowSize;
+    mHistoryIndexStep = frame.mIndexStep;
+    mViewRowsWritten = 0;
+    mViewAppends = 0;
+    mViewSampleIndex = 0;
+    //Stream samples start over with the history, a detail from before points nowhere now
+    clearDetail();
+}
+
+gl::Fbo SpectrogramPlot::createRing(std::size_t width, std::size_t height)
+{
+    //Rows repeat vertically so the draw can scroll past the wrap point with a single quad
+    gl::Fbo::Format format;
+    format.enableDepthBuffer(false);
+    format.setColorInternalFormat(mCpuColormap ? GL_RGBA8 : GL_R32F);
+    format.setWrap(GL_CLAMP_TO_EDGE, GL_REPEAT);
+    format.setMinFilter(GL_LINEAR);
+    format.setMagFilter(GL_LINEAR);
+    gl::Fbo ring(static_cast<int>(width), static_cast<int>(height), format);
+
+    //Rows not written yet have zero magnitude (are black), cleared on the GPU instead of uploaded
+    ci::gl::SaveFramebufferBinding bindingSaver;
+    ring.bindFramebuffer();
+    ci::gl::clear(ci::ColorA(0, 0, 0, 1));
+    ring.unbindFramebuffer();
+    return ring;
+}
+
+void SpectrogramPlot::retune(int duration, size_t width, float rowsPerSecond, std::uint32_t generation)
+{
+    RingRetune retune;
+    retune.mDuration = duration;
+    retune.mWidth = width;
+    retune.mRowsPerSecond = rowsPerSecond;
+    retune.mBinHz = getEngineBinHz();
+    retune.mGeneration = generation;
+    mRetunes.push_back(retune);
+
+    //Rows of that generation may be drawn already (e.g. only the duration changed)
+    if (generation <= mRowGeneration)
+        applyRetunes(mRowGeneration);
+}
+
+void SpectrogramPlot::applyRetunes(std::uint32_t generation)
+{
+    //Only the newest retune that is due matters, the ones before it never got a row
+    auto due = mRetunes.end();
+    for (auto it = mRetunes.begin(); it != mRetunes.end(); ++it)
+    {
+        if (it->mGeneration <= generation)
+            due = it;
+    }
+    if (due == mRetunes.end())
+        return;
+
+    const RingRetune retune = *due;
+    mRetunes.erase(mRetunes.begin(), due + 1);
+    resampleRing(retune);
+}
+
+void SpectrogramPlot::resampleRing(const RingRetune& retune)
+{
+    CIEQ_PROFILE_ZONE("resample ring");
+    //The new layout in ring rows and columns, a zoomed out level pools rows and bins
+    const std::size_t level = chooseLevel(retune.mDuration);
+    const std::size_t pool = getLevelBinPooling(retune.mWidth, level);
+    const std::size_t span = std::size_t(1) << level;
+    const std::size_t width = (retune.mWidth + pool - 1) / pool;
+    const std::size_t height = (static_cast<std::size_t>(std::max(retune.mDuration, 0)) + span - 1) / span;
+    const float binHz = retune.mBinHz * static_cast<float>(pool);
+    const float rowsPerSecond = retune.mRowsPerSecond / static_cast<float>(span);
+    //Rows of the same geometry are all in the history, the new ring is filled from it
+    //exactly instead of stretching what the old ring showed
+    const bool refill = mHistory.isSetup() && mViewAppends > 0 && mHistoryBinHz == retune.mBinHz;
+    if (!mRingTexture || width == 0 || height == 0 || mRingBinHz <= 0.0f || retune.mBinHz <= 0.0f || refill)
+    {
+        //Nothing to carry over, or the history brings all of it back
+        setup(retune.mDuration, retune.mWidth);
+        mRingBinHz = binHz;
+        mRingRowsPerSecond = rowsPerSecond;
+        return;
+    }
+
+    gl::Fbo ring = createRing(width, height);
+
+    //Column c shows c * bin spacing Hz in either ring, so the new one spans sEnd of the old
+    //one horizontally. Frequencies the old ring didn't have stay black.
+    float sEnd = (static_cast<float>(width) * binHz) / (static_cast<float>(mTexW) * mRingBinHz);
+    float xEnd = static_cast<float>(width);
+    if (sEnd > 1.0f)
+    {
+        xEnd /= sEnd;
+        sEnd = 1.0f;
+    }
+    //Same in time, once both hop rates are known. Rows are counted back from the newest one,
+    //which ends up on the top row of the new ring so writing restarts at row 0.
+    float timeSpan = 1.0f;
+    float yStart = 0.0f;
+    if (mRingRowsPerSecond > 0.0f && rowsPerSecond > 0.0f)
+    {
+        timeSpan = (static_cast<float>(height) / rowsPerSecond) / (static_cast<float>(mTexH) / mRingRowsPerSecond);
+        if (timeSpan > 1.0f)
+        {
+            yStart = static_cast<float>(height) * (1.0f - 1.0f / timeSpan);
+            timeSpan = 1.0f;
+        }
+    }
+    const float tTop = static_cast<float>(mFrameCounter) / static_cast<float>(mTexH);
+    const float tBottom = tTop - timeSpan;
+    const GLfloat vertices[8] = {
+        0.0f, yStart,
+        xEnd, yStart,
+        xEnd, static_cast<float>(height),
+        0.0f, static_cast<float>(height) };
+    const GLfloat texCoords[8] = {
+        0.0f, tBottom,
+        sEnd, tBottom,
+        sEnd, tTop,
+        0.0f, tTop };
+
+    {
+        //Plain fixed function texturing copies raw magnitudes and coloured pixels alike
+        ci::gl::SaveFramebufferBinding bindingSaver;
+        const ci::Area viewport = ci::gl::getViewport();
+        ring.bindFramebuffer();
+        ci::gl::setViewport(ring.getBounds());
+        ci::gl::pushMatrices();
+        ci::gl::setMatricesWindow(ring.getSize(), false);
+        ci::gl::color(ci::Color(1.0f, 1.0f, 1.0f));
+        mRingTexture.enableAndBind();
+
+        glEnableClientState(GL_VERTEX_ARRAY);
+        glVertexPointer(2, GL_FLOAT, 0, vertices);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+        glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+        glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glDisableClientState(GL_VERTEX_ARRAY);
+
+        mRingTexture.unbind();
+        mRingTexture.disable();
+        ci::gl::popMatrices();
+        ring.unbindFramebuffer();
+        ci::gl::setViewport(viewport);
+    }
+
+    mRingFbo = ring;
+    mRingTexture = mRingFbo.getTexture();
+    mTexW = width;
+    mTexH = height;
+    mViewLevel = level;
+    mViewBinPool = pool;
+    maxDispBins = mTexW * mViewBinPool;
+    mFrameCounter = 0;
+    mRow.setup(mTexW);
+    mRingBinHz = binHz;
+    mRingRowsPerSecond = rowsPerSecond;
+    //New rows of the level continue from here
+    mViewRowsWritten = getViewRows(mViewLevel);
+    mRefillPending = false;
+}
+
+std::size_t SpectrogramPlot::getRingFreq(std::size_t column) const
+{
+    return static_cast<std::size_t>(static_cast<float>(column) * mRingBinHz);
+}
+
+float SpectrogramPlot::getEngineBinHz()
+{
+    const std::size_t fftSize = mAudioNodes.getFftSize();
+    return fftSize ? static_cast<float>(mAudioNodes.getHardwareSampleRate()) / static_cast<float>(fftSize) : 0.0f;
+}
+
+void SpectrogramPlot::setPalette(dsp::Palette palette)
+{
+    if (palette == mPalette)
+        return;
+
+    mPalette = palette;
+    mColormapLut.setup(mPalette);
+    if (mPaletteTexture)
+        uploadPalette();
+}
+
+void SpectrogramPlot::uploadPalette()
+{
+    std::vector<float> rgb(3 * kPaletteSize);
+    dsp::generatePalette(mPalette, rgb.data(), kPaletteSize);
+
+    mPaletteTexture.bind();
+    glTexSubImage2D(mPaletteTexture.getTarget(), 0, 0, 0, static_cast<GLsizei>(kPaletteSize), 1, GL_RGB, GL_FLOAT, rgb.data());
+    mPaletteTexture.unbind();
 }
 
 SpectrogramPlot::SpectrogramPlot(AudioNodes& nodes)
@@ -275,8 +696,32 @@ SpectrogramPlot::SpectrogramPlot(AudioNodes& nodes)
 , mTexH(0)
 , mTexW(0)
 , mFrameCounter(0)
-, mActiveSurface(0)
-, mBackBufferSurface(1)
+, mRowsSinceRateUpdate(0)
+, mNumRowsDrawn(0)
+, mCpuColormap(false)
+, mPalette(dsp::Palette::JET)
+, mRowsPendingPresent(false)
+, mRingBinHz(0.0f)
+, mRingRowsPerSecond(0.0f)
+, mRowGeneration(0)
+, mHistoryBinHz(0.0f)
+, mHistorySampleIndex(0)
+, mViewLevel(0)
+, mViewBinPool(1)
+, mViewRowsWritten(0)
+, mRefillPending(false)
+, mHistoryHopSize(0)
+, mHistoryWindowSize(0)
+, mHistoryIndexStep(0)
+, mViewAppends(0)
+, mViewSampleIndex(0)
+, mFrozen(false)
+, mDetailMaxDB(0.0f)
+, mDetailDbMode(false)
+, mAxesMaxFreq(0)
+, mAxesShift(0.0f)
+, mAxesLevel(0)
+, actualHopRate(0)
 {
     setPlotTitle("Spectrogram");
     setHorzAxisTitle("Frequency").setHorzAxisUnit("Hz");
@@ -290,273 +735,413 @@ void SpectrogramPlot::drawLocal(double winSizeMs, float shift, float shiftLength
         timeEnter = 0;
         timeEnterPrev = 0;
         timeExit = 0;
+        mRowsSinceRateUpdate = 0;
         mTimer.start();
     }
 
     //Variables that can be initialized with constants:
-    pixelSpecMag = 0.0;
-    flag = 0;
     pixelsPerBin = 1;
     binSkipMult = 1;
 
-    hardwareSampleRate = mAudioNodes.getInputDeviceNode()->getSampleRate(); //Get current sample rate of audio hardware
-    //numBins = mAudioNodes.getMonitorSpectralNode(1)->getNumBins();
-    //maxDispBins = numBins;
-    maxDispBins = mTexW;
-    //fftSize = mAudioNodes.getMonitorSpectralNode(1)->getFftSize();
-
-    timeSec1Enter = mTimer.getSeconds();
-    cinder::audio::MonitorSpectralNode* const mMonitorSpectralNode = mAudioNodes.getMonitorSpectralNode(nodeNumber);
-    timeSec1Exit = mTimer.getSeconds();
-    timeSec1Process = timeSec1Exit - timeSec1Enter;
-    timeCurrentNodeStart = mAudioNodes.getTimeOfNode(nodeNumber);
-    timeCurrentNodeCall = mAudioNodes.getTimer()->getSeconds();
-    timeCurrentNodeRem = remainder(timeCurrentNodeCall - timeCurrentNodeStart, winSizeMs);
-    //timeCurrentNodeRem = remainder(0.249, winSizeMs);
-    //while (timeCurrentNodeRem > 0.003) //|| timeCurrentNodeRem < -0.001
-    //{
-    //    timeCurrentNodeCall = mAudioNodes.getTimer()->getSeconds();
-    //    timeCurrentNodeRem = remainder(timeCurrentNodeCall - timeCurrentNodeStart, winSizeMs);
-    //}
-    timeCurrentNodeCall = mAudioNodes.getTimer()->getSeconds();
-    timeCurrentNodeRem = remainder(timeCurrentNodeCall - timeCurrentNodeStart, winSizeMs);
-    timeSec2Enter = mTimer.getSeconds();
-    timeNode1Start = mAudioNodes.getTimeOfNode(1);
-    if (timeNode1Start != timeNode1StartPrev)
-    {
-        timeEnter = mAudioNodes.getTimer()->getSeconds();
-        timeReturn = timeEnter - timeNode1Start;
-        timeHop = timeReturn;
-        while (timeHop < winSizeMs)
-        {
-            timeHop = mAudioNodes.getTimer()->getSeconds() - timeNode1Start; //timeReturn + (mAudioNodes.getTimer()->getSeconds() - timeEnter)
-        }
-        timeNode1StartPrev = timeNode1Start;
-    }
-    else
-    {
-        timeEnter = mTimer.getSeconds();
-        timeReturn = timeEnter - timeEnterPrev;
-        timeHop = timeReturn;
-        while (timeHop < (double(1.0) / static_cast<double>(shift)))
-        {
-            timeHop = timeReturn + (mTimer.getSeconds() - timeEnter);
-        }
-        timeEnterPrev = mTimer.getSeconds();
-    }
-    spectrum = mMonitorSpectralNode->getMagSpectrum();//Might be able to free up some speed by initializing this somehow rather than letting it create a
-                                                      //new "auto" array every time it comes in here. Nope, it's getting the magSpectrum data that's slow.
-    timeHop = ceil((timeHop * pow(10, 3)) - 0.49) / pow(10, 3); //"Round" timeHop variable to nearest three decimal places.
-    actualHopRate = 1 / timeHop;
-    nodeNumber++;
-    size_t nodesToProcess = static_cast<size_t>(ceil(winSizeMs / (double(1.0) / static_cast<double>(shift))));
-    if (nodeNumber > nodesToProcess)
-    {
-        nodeNumber = 1;
-    }
-    timeSec2Exit = mTimer.getSeconds();
-    timeSec2Process = timeSec2Exit - timeSec2Enter;
-    if (actualHopRate < static_cast<double>(shift) - 1)
-    {
-        flag = 1;
-    }
+    hardwareSampleRate = mAudioNodes.getHardwareSampleRate(); //Sample rate of the audio hardware, or of the file being analysed
+    maxDispBins = mTexW * mViewBinPool;
     plotWidth = mBounds.x2 - mBounds.x1;
-    timeSec3Enter = mTimer.getSeconds();
-    //shiftLength = shiftLength + 0.1*shiftLength;
-    //if (shiftLength > 0)
-    //{
-    //    maxDispBins = shiftLength / ((static_cast<float>(hardwareSampleRate) / 2) / static_cast<float>(numBins));
-    //}
-	//maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
-	//if (maxFreqDisp > static_cast<size_t>(shiftLength))
-	//{
- //       maxDispBins = (shiftLength * fftSize) / hardwareSampleRate;
- //       maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
-	//	while (maxFreqDisp > static_cast<size_t>(shiftLength))
-	//	{
-	//		maxDispBins--;
-	//		maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
-	//	}
-	//	maxDispBins++;
-	//}
- //   if (maxDispBins <= plotWidth)
- //   {
- //       pixelsPerBin = ceil(static_cast<double>(plotWidth) / static_cast<double>(maxDispBins));
- //       maxDispBins = ceil(static_cast<double>(plotWidth) / static_cast<double>(pixelsPerBin));
- //       maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
- //       while (maxFreqDisp < shiftLength)
- //       {
- //           pixelsPerBin--;
-	//		if (pixelsPerBin < 1)
-	//		{
-	//			pixelsPerBin = 1;
-	//		}
- //           //pixelsPerBin = ceil(static_cast<double>(plotWidth) / static_cast<double>(maxDispBins));
- //           maxDispBins = ceil(static_cast<double>(plotWidth) / static_cast<double>(pixelsPerBin));
- //           maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
- //       }
- //   }
- //   else
- //   {
- //       binSkipMult = floor(static_cast<double>(maxDispBins) / static_cast<double>(plotWidth));
- //       maxDispBins = plotWidth * binSkipMult;
- //       maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
- //       while (maxFreqDisp < shiftLength)
- //       {
- //           binSkipMult++;
- //           maxDispBins = plotWidth * binSkipMult;
- //           maxFreqDisp = mAudioNodes.getMaxFreqDisp(maxDispBins);
- //       }
- //   }
-    timeSec3Exit = mTimer.getSeconds();
-    timeSec3Process = timeSec3Exit - timeSec3Enter;
-
-    if (spectrum.empty())
-        return;
 
-    Surface32f::Iter surface_iter = mSpectrals[mActiveSurface].getIter();
-    while (surface_iter.line())
-    {
-        if (surface_iter.mY != mFrameCounter) continue;
-        //Original code:
-        //while (surface_iter.pixel())
-        //{
-        //    //Original Code:
-        //    //const auto m = spectrum[surface_iter.mX] / 100;
-        //    //surface_iter.r() = 1.0f; // (surface_iter.mX + 1) * (1 / mTexW);
-        //    //surface_iter.g() = 0; // (surface_iter.mX + 1) * (1 / mTexW);
-        //    //surface_iter.b() = static_cast<float>((surface_iter.mX + 1000) * (1 / mTexW));
-        //    //surface_iter.a() = 1.0f;
-        //    pixelSpecMag = spectrum[surface_iter.mX];
-        //    //auto m = pixelSpecMag * userMaxMag; // ci::audio::linearToDecibel(pixelSpecMag) / userMaxMag; //pixelSpecMag
-        //    //surface_iter.r() = m; //Why is red disabled???!!!
-        //    //surface_iter.g() = m;
-        //    //surface_iter.b() = 1.0f - m;
-        //    auto m = userMaxMag * pixelSpecMag;
-        //    auto c = GetColor(m, 0.0f, 1.0f);
-        //    surface_iter.r() = c.r;
-        //    surface_iter.g() = c.g;
-        //    surface_iter.b() = c.b;
-        //}
-        //My modifications:
-        for (std::size_t i0 = 0; i0 < maxDispBins; i0++)
+    //Append one row per frame the STFT engine finished since the last draw to the history,
+    //and write the rows of the level on screen it completes. Frames are already spaced one
+    //hop apart in samples, so there is nothing to wait for here. A frozen plot keeps taking
+    //them into the history, so none pile up and get dropped, but leaves the ring alone.
+    {
+        CIEQ_PROFILE_ZONE("write rows");
+        while (mAudioNodes.popSpectralFrame(mFrame))
         {
-            //Draw x-axis tick labels:
-            if ((i0 * binSkipMult) == 0) //Tick label for origin tick
-            {
-                ci::gl::drawStringCentered(std::to_string(mAudioNodes.getMaxFreqDisp(i0)), Vec2f(mBounds.x1, mBounds.y2 + 10), ci::ColorA::white(), mLabelFont);
-            }
-            else if ((i0 * binSkipMult) == (maxDispBins / 2)) //Tick label for middle tick
-            {
-                ci::gl::drawStringCentered(std::to_string(mAudioNodes.getMaxFreqDisp(i0)), Vec2f(mBounds.x1 + ((mBounds.x2 - mBounds.x1) / 2), mBounds.y2 + 10), ci::ColorA::white(), mLabelFont);
-            }
-            else if ((i0 * binSkipMult) == maxDispBins - 1) //Tick label for end tick
+            //Rows of another geometry, or a playback jump back in time, start the history over.
+            //It goes first so a retune below already lays the ring out for the new history.
+            const std::size_t frameBins = mFrame.mMagnitudes.size();
+            if (mFrame.mGeneration != mRowGeneration || !mHistory.isSetup() || mHistory.getNumBins(0) != frameBins || mFrame.mSampleIndex <= mHistorySampleIndex)
+                resetHistory(mFrame);
+
+            //The first row of a reconfigured analysis brings the ring's new layout with it
+            if (mFrame.mGeneration != mRowGeneration)
             {
-                ci::gl::drawStringCentered(std::to_string(mAudioNodes.getMaxFreqDisp(i0 + 1)), Vec2f(mBounds.x2, mBounds.y2 + 10), ci::ColorA::white(), mLabelFont);
+                mRowGeneration = mFrame.mGeneration;
+                applyRetunes(mRowGeneration);
             }
-            for (std::size_t i1 = 0; i1 < pixelsPerBin; i1++)
+            //Rows are one index step apart in the history. Frames the engine dropped leave a
+            //gap, filled with silent rows so the time axis and getRegion() stay right.
+            if (mHistory.getNumRows(0) > 0 && mHistoryIndexStep > 0 && mFrame.mSampleIndex != mHistorySampleIndex + mHistoryIndexStep)
             {
-                if (surface_iter.pixel())
+                const std::uint64_t step = mFrame.mSampleIndex - mHistorySampleIndex;
+                if (step % mHistoryIndexStep != 0 || step / mHistoryIndexStep - 1 > kMaxGapRows)
                 {
-                    pixelSpecMag = spectrum[i0];
-                    if (linearDbMode == 0)
-                    {
-                        pixelDispMag = userMaxMag * pixelSpecMag;  // Linear Mode
-                    }
-                    else
-                    {
-                        pixelDispMag = ci::audio::linearToDecibel(pixelSpecMag) / userMaxMag; // dB Mode
-                    }
-                    ci::Color c = GetColor(pixelDispMag, 0.0f, 1.0f);
-                    surface_iter.r() = c.r;
-                    surface_iter.g() = c.g;
-                    surface_iter.b() = c.b;
-                    surface_iter.a() = 1.0f;
+                    resetHistory(mFrame);
                 }
                 else
                 {
-                    flag = 1;
-                    //maxDispBins = i0 * binSkipMult;
-                    maxDispBins = i0;
+                    mGapRow.assign(frameBins, 0.0f);
+                    for (std::uint64_t r = step / mHistoryIndexStep - 1; r > 0; r--)
+                        mHistory.append(mGapRow.data());
                 }
             }
+            mHistory.append(mFrame.mMagnitudes.data());
+            mHistorySampleIndex = mFrame.mSampleIndex;
+            if (mFrozen)
+                continue;
+
+            mViewAppends = mHistory.getNumRows(0);
+            mViewSampleIndex = mHistorySampleIndex;
+            if (!mRingTexture)
+                continue;
+
+            writeHistoryRows(userMaxMag, linearDbMode);
+            mRowsSinceRateUpdate++;
+            mNumRowsDrawn++;
+            mUploadLatency.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - mFrame.mCaptureTime).count());
+            mNewestRowCaptureTime = mFrame.mCaptureTime;
+            mRowsPendingPresent = true;
         }
+        //Rows taken while frozen go on screen once the view is live again
+        if (!mFrozen && mHistory.isSetup() && mViewAppends != mHistory.getNumRows(0))
+        {
+            mViewAppends = mHistory.getNumRows(0);
+            mViewSampleIndex = mHistorySampleIndex;
+            if (mRingTexture)
+                writeHistoryRows(userMaxMag, linearDbMode);
+        }
+        //A new layout shows the history even while no rows arrive (paused playback)
+        if (mRefillPending && mRingTexture)
+            writeHistoryRows(userMaxMag, linearDbMode);
     }
 
-    //mFrameCounter++;
+    //Measure the rate rows actually arrive at, averaged over about a second
+    timeEnter = mTimer.getSeconds();
+    timeReturn = timeEnter - timeEnterPrev;
+    if (timeReturn >= 1.0)
+    {
+        actualHopRate = static_cast<double>(mRowsSinceRateUpdate) / timeReturn;
+        mRowsSinceRateUpdate = 0;
+        timeEnterPrev = timeEnter;
+    }
+    ci::gl::color(ci::Color(1.0f, 1.0f, 1.0f));
+    drawRing(userMaxMag, linearDbMode);
+    drawDetail(userMaxMag, linearDbMode);
+    //The tick labels only change with the displayed range and the hop rate, anything
+    //else that moves them goes through the Plot setters. The range is the ring's, which
+    //only follows a reconfigured engine once its rows arrive.
+    const std::size_t axesMaxFreq = getRingFreq(mTexW);
+    if (axesMaxFreq != mAxesMaxFreq || shift != mAxesShift || mViewLevel != mAxesLevel)
+    {
+        mAxesMaxFreq = axesMaxFreq;
+        mAxesShift = shift;
+        mAxesLevel = mViewLevel;
+        invalidateOverlay();
+    }
 
-    const auto height_offset = (mFrameCounter) * (mBounds.getHeight() / mTexH);
-    const auto available_height = mBounds.getHeight() - height_offset;
+    timeExit = mTimer.getSeconds();
+}
 
-    ci::Area requested_area(0, mFrameCounter, mTexW, mTexH);//mTexW, mTexH
-    ci::Rectf requested_rect(mBounds.x1, mBounds.y1 + height_offset, mBounds.x2, mBounds.y2);
-    ci::gl::draw(mSpectrals[mActiveSurface], mBounds); // (mSpectrals[mActiveSurface], mBounds)
-    ci::gl::draw(mTexCache, requested_area, requested_rect); // (mTexCache, requested_area, requested_rect)
+void SpectrogramPlot::drawAxes()
+{
     ci::gl::color(ci::Color(1.0f, 1.0f, 1.0f));
     //Draw x-axis tick marks:
     ci::gl::drawLine(Vec2f(mBounds.x1, mBounds.y2), Vec2f(mBounds.x1, mBounds.y2 + 10)); //Origin tick mark
     ci::gl::drawLine(Vec2f(mBounds.x1 + ((mBounds.x2 - mBounds.x1) / 2), mBounds.y2), Vec2f(mBounds.x1 + ((mBounds.x2 - mBounds.x1) / 2), mBounds.y2 + 10)); //Center tick mark
     ci::gl::drawLine(Vec2f(mBounds.x2, mBounds.y2), Vec2f(mBounds.x2, mBounds.y2 + 10)); //End tick mark
+    //Draw x-axis tick labels:
+    ci::gl::drawStringCentered(std::to_string(getRingFreq(0)), Vec2f(mBounds.x1, mBounds.y2 + 10), ci::ColorA::white(), mLabelFont); //Tick label for origin tick
+    ci::gl::drawStringCentered(std::to_string(getRingFreq(mTexW / 2)), Vec2f(mBounds.x1 + ((mBounds.x2 - mBounds.x1) / 2), mBounds.y2 + 10), ci::ColorA::white(), mLabelFont); //Tick label for middle tick
+    ci::gl::drawStringCentered(std::to_string(getRingFreq(mTexW)), Vec2f(mBounds.x2, mBounds.y2 + 10), ci::ColorA::white(), mLabelFont); //Tick label for end tick
     //Draw y-axis tick marks:
     ci::gl::drawLine(Vec2f(mBounds.x1, mBounds.y1), Vec2f(mBounds.x1 - 10, mBounds.y1)); //Origin tick mark
     ci::gl::drawLine(Vec2f(mBounds.x1, mBounds.y1 + ((mBounds.y2 - mBounds.y1) / 2)), Vec2f(mBounds.x1 - 10, mBounds.y1 + ((mBounds.y2 - mBounds.y1) / 2))); //Center tick mark
     ci::gl::drawLine(Vec2f(mBounds.x1, mBounds.y2), Vec2f(mBounds.x1 - 10, mBounds.y2)); //End tick mark
-    //Draw y-axis tick labels:
-    std:ostringstream out;
-    if (mFrameCounter == 0) //Tick label for origin tick
-    {
-        tickLabelYOrigin = (static_cast<float>(mFrameCounter) / shift);
-        //tickLabelYOrigin = ceil((tickLabelYOrigin * pow(10, 2)) - 0.49) / pow(10, 2);
-        out << std::setprecision(2) << tickLabelYOrigin;
-        tickLabelYOriginString = out.str();
-    }
-    else if (mFrameCounter == mTexH / 2) //Tick label for center tick
-    {
-        tickLabelYCenter = (static_cast<float>(mFrameCounter) / shift);
-        //tickLabelYCenter = ceil((tickLabelYCenter * pow(10, 2)) - 0.49) / pow(10, 2);
-        out << std::setprecision(2) << tickLabelYCenter;
-        tickLabelYCenterString = out.str();
-    }
-     else if (mFrameCounter == mTexH - 1) //Tick label for end tick
-     {
-         tickLabelYEnd = (static_cast<float>(mFrameCounter + 1) / shift);
-         //tickLabelYEnd = ceil((tickLabelYEnd * pow(10, 2)) - 0.49) / pow(10, 2);
-         out << std::setprecision(2) << tickLabelYEnd;
-         tickLabelYEndString = out.str();
-     }
+    //Draw y-axis tick labels, one row is 2^level hops so mTexH rows span mTexH * 2^level / shift seconds:
+    const float rowHops = static_cast<float>(std::size_t(1) << mAxesLevel);
+    tickLabelYOrigin = 0.0f;
+    tickLabelYOriginString = formatSeconds(tickLabelYOrigin);
+    tickLabelYCenter = (static_cast<float>(mTexH / 2) * rowHops / mAxesShift);
+    tickLabelYCenterString = formatSeconds(tickLabelYCenter);
+    tickLabelYEnd = (static_cast<float>(mTexH) * rowHops / mAxesShift);
+    tickLabelYEndString = formatSeconds(tickLabelYEnd);
     ci::gl::drawStringRight(tickLabelYOriginString, Vec2f(mBounds.x1 - 10, mBounds.y1 - (mLabelFont.getSize() / 2)), ci::ColorA::white(), mLabelFont); //Draw tick label for Origin tick
     ci::gl::drawStringRight(tickLabelYCenterString, Vec2f(mBounds.x1 - 10, mBounds.y1 + ((mBounds.y2 - mBounds.y1) / 2) - (mLabelFont.getSize() / 2)), ci::ColorA::white(), mLabelFont); //Draw tick label for center tick
     ci::gl::drawStringRight(tickLabelYEndString, Vec2f(mBounds.x1 - 10, mBounds.y2 - (mLabelFont.getSize() / 2)), ci::ColorA::white(), mLabelFont); //Draw tick label for end tick
+}
+
+void SpectrogramPlot::writeHistoryRows(float userMaxMag, bool linearDbMode)
+{
+    if (!mHistory.isSetup() || mViewLevel >= mHistory.getNumLevels())
+        return;
+
+    //A zoomed out level only has a new row every 2^level appends, and the ring never
+    //needs more than its height of them
+    const std::uint64_t numRows = getViewRows(mViewLevel);
+    const std::uint64_t oldest = numRows > mTexH ? numRows - mTexH : 0;
+    const std::uint64_t first = mRefillPending ? oldest : std::max(mViewRowsWritten, oldest);
+    mRefillPending = false;
+    mViewRowsWritten = numRows;
+    if (first >= numRows)
+        return;
 
-    timeSec3Enter = mTimer.getSeconds();
-    //gl::scale(
-    //    static_cast<float>((mBounds.x2 - mBounds.x1) / mSpectrals[mActiveSurface].getWidth()),
-    //    static_cast<float>((mBounds.y2 - mBounds.y1) / mSpectrals[mActiveSurface].getHeight()));
-    //Playing around with scaling:
-    //ci::Area requested_area(0, mFrameCounter, mTexW, mTexH);//mTexW, mTexH
-    //ci::Rectf requested_rect(mBounds.x1, mBounds.y1 + height_offset, mBounds.x2, mBounds.y2);
-    //gl::pushMatrices();
-    //ci::gl::draw(mSpectrals[mActiveSurface], mBounds); // (mSpectrals[mActiveSurface], mBounds)
-    //ci::gl::draw(mTexCache, ci::Vec2f(mBounds.x1, mFrameCounter)); // (mTexCache, requested_area, requested_rect)
-    //gl::scale(
-    //    0.5,  // static_cast<float>((mBounds.x2 - mBounds.x1) / mTexCache.getWidth()),
-    //    1); // static_cast<float>((mBounds.y2 - mBounds.y1) / mTexCache.getHeight())
-    //gl::popMatrices();
-
-    mFrameCounter++;
-    //mFrameCounter = mFrameCounter + 2;
-
-    
-    if (mFrameCounter >= mTexH) //mTexH
-    {
-        mFrameCounter = 0;
-        std::swap(mActiveSurface, mBackBufferSurface);
-        mTexCache.update(mSpectrals[mBackBufferSurface]);
+    const std::size_t count = static_cast<std::size_t>(numRows - first);
+    const std::size_t numBins = mHistory.getNumBins(mViewLevel);
+    mViewRows.resize(count * numBins);
+    if (!mHistory.readRows(mViewLevel, first, count, mViewRows.data()))
+        return;
+
+    for (std::size_t r = 0; r < count; r++)
+    {
+        writeRow(mViewRows.data() + r * numBins, numBins, userMaxMag, linearDbMode);
+        mFrameCounter++;
+        if (mFrameCounter >= mTexH)
+        {
+            mFrameCounter = 0;
+        }
     }
-    timeExit = mTimer.getSeconds();
-    timeProcess = timeExit - timeEnterPrev;
-    timeExit = mTimer.getSeconds();
-    timeLine = mTimer.getSeconds();
+}
+
+void SpectrogramPlot::writeRow(const float* spectrum, std::size_t size, float userMaxMag, bool linearDbMode)
+{
+    const std::size_t numBins = std::min(size, mTexW);
+
+    //Only this row goes over the bus, the rest of the ring stays resident
+    mRingTexture.bind();
+    if (mCpuColormap)
+    {
+        const std::uint32_t* pixels;
+        {
+            CIEQ_PROFILE_ZONE("colormap");
+            pixels = mRow.stagePixels(mColormapLut, spectrum, numBins, userMaxMag, linearDbMode);
+        }
+        CIEQ_PROFILE_ZONE("upload");
+        glTexSubImage2D(mRingTexture.getTarget(), 0, 0, static_cast<GLint>(mFrameCounter), static_cast<GLsizei>(mTexW), 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+    else
+    {
+        //Raw magnitudes go up as they are, the shader does all the colour work
+        const float* magnitudes = mRow.stageMagnitudes(spectrum, numBins);
+        CIEQ_PROFILE_ZONE("upload");
+        glTexSubImage2D(mRingTexture.getTarget(), 0, 0, static_cast<GLint>(mFrameCounter), static_cast<GLsizei>(mTexW), 1, GL_RED, GL_FLOAT, magnitudes);
+    }
+    mRingTexture.unbind();
+}
+
+void SpectrogramPlot::drawRing(float userMaxMag, bool linearDbMode)
+{
+    if (!mRingTexture || (!mColormapShader && !mCpuColormap))
+        return;
+    CIEQ_PROFILE_ZONE("draw ring");
+
+    //Newest row at the top edge, older rows below it. The top edge sits right after the
+    //newest row (mFrameCounter - 1) and t runs backwards from there, past 0 it wraps
+    //around to the bottom rows of the texture thanks to GL_REPEAT.
+    const float tTop = static_cast<float>(mFrameCounter) / static_cast<float>(mTexH);
+    const float tBottom = tTop - 1.0f;
+    const GLfloat vertices[8] = {
+        mBounds.x1, mBounds.y1,
+        mBounds.x2, mBounds.y1,
+        mBounds.x2, mBounds.y2,
+        mBounds.x1, mBounds.y2 };
+    const GLfloat texCoords[8] = {
+        0.0f, tTop,
+        1.0f, tTop,
+        1.0f, tBottom,
+        0.0f, tBottom };
+
+    drawColormapped(mRingTexture, vertices, texCoords, userMaxMag, linearDbMode);
+}
+
+void SpectrogramPlot::drawColormapped(const gl::Texture& texture, const GLfloat* vertices, const GLfloat* texCoords, float userMaxMag, bool linearDbMode)
+{
+    if (mCpuColormap)
+    {
+        //Rows are already coloured, plain fixed function texturing
+        texture.enableAndBind();
+    }
+    else
+    {
+        texture.bind(0);
+        mPaletteTexture.bind(1);
+        mColormapShader.bind();
+        mColormapShader.uniform("uMagnitudes", 0);
+        mColormapShader.uniform("uPalette", 1);
+        mColormapShader.uniform("uPaletteSize", static_cast<float>(kPaletteSize));
+        mColormapShader.uniform("uMaxMag", userMaxMag);
+        mColormapShader.uniform("uDbMode", linearDbMode ? 1 : 0);
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glTexCoordPointer(2, GL_FLOAT, 0, texCoords);
+    glDrawArrays(GL_TRIANGLE_FAN, 0, 4);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (mCpuColormap)
+    {
+        texture.unbind();
+        texture.disable();
+    }
+    else
+    {
+        mColormapShader.unbind();
+        mPaletteTexture.unbind(1);
+        texture.unbind(0);
+    }
+}
+
+double SpectrogramPlot::getRowSamples() const
+{
+    return static_cast<double>(std::size_t(1) << mViewLevel) * static_cast<double>(mHistoryHopSize);
+}
+
+std::uint64_t SpectrogramPlot::getViewRows(std::size_t level) const
+{
+    if (!mHistory.isSetup() || level >= mHistory.getNumLevels())
+        return 0;
+    //Every level has a row for every second row of the one below
+    return std::min(mHistory.getNumRows(level), mViewAppends >> level);
+}
+
+double SpectrogramPlot::getNewestCentre() const
+{
+    //The newest ring row pools the last complete 2^level appends, the ones after it aren't
+    //on screen yet. Appends are one hop apart, gaps are padded, and the newest one the view
+    //is up to starts at mViewSampleIndex.
+    const double span = static_cast<double>(std::size_t(1) << mViewLevel);
+    const double numAppends = static_cast<double>(mViewAppends);
+    const double numPooled = static_cast<double>(getViewRows(mViewLevel)) * span;
+    const double newestAppend = numPooled - 0.5 * (span + 1.0);
+    return static_cast<double>(mViewSampleIndex) + 0.5 * static_cast<double>(mHistoryWindowSize)
+        - (numAppends - 1.0 - newestAppend) * static_cast<double>(mHistoryHopSize);
+}
+
+bool SpectrogramPlot::getRegion(const ci::Rectf& rect, dsp::RegionRequest& region) const
+{
+    if (!mRingTexture || getViewRows(mViewLevel) == 0 || mHistoryHopSize == 0)
+        return false;
+
+    const float x1 = std::max(std::min(rect.x1, rect.x2), mBounds.x1);
+    const float x2 = std::min(std::max(rect.x1, rect.x2), mBounds.x2);
+    const float y1 = std::max(std::min(rect.y1, rect.y2), mBounds.y1);
+    const float y2 = std::min(std::max(rect.y1, rect.y2), mBounds.y2);
+    if (x2 <= x1 || y2 <= y1)
+        return false;
+
+    //Ring column c is centred on c * mRingBinHz, ring row k (from the top) on the newest
+    //centre minus k rows of samples
+    const float width = mBounds.x2 - mBounds.x1;
+    const float height = mBounds.y2 - mBounds.y1;
+    region.mMinFreq = std::max(((x1 - mBounds.x1) / width * static_cast<float>(mTexW) - 0.5f) * mRingBinHz, 0.0f);
+    region.mMaxFreq = std::max(((x2 - mBounds.x1) / width * static_cast<float>(mTexW) - 0.5f) * mRingBinHz, 0.0f);
+
+    const double newest = getNewestCentre();
+    const double rowSamples = getRowSamples();
+    const double last = newest - (static_cast<double>((y1 - mBounds.y1) / height) * static_cast<double>(mTexH) - 0.5) * rowSamples;
+    const double first = newest - (static_cast<double>((y2 - mBounds.y1) / height) * static_cast<double>(mTexH) - 0.5) * rowSamples;
+    region.mFirstSample = static_cast<std::uint64_t>(std::max(first, 0.0));
+    region.mLastSample = static_cast<std::uint64_t>(std::max(last, 0.0));
+    return true;
+}
+
+void SpectrogramPlot::setDetail(dsp::RegionResult result)
+{
+    if (!result.mError.empty() || result.mNumRows == 0 || result.mNumBins == 0)
+    {
+        clearDetail();
+        return;
+    }
+    mDetail = std::move(result);
+
+    gl::Texture::Format format;
+    format.setInternalFormat(mCpuColormap ? GL_RGBA8 : GL_R32F);
+    format.setWrap(GL_CLAMP_TO_EDGE, GL_CLAMP_TO_EDGE);
+    format.setMinFilter(GL_LINEAR);
+    format.setMagFilter(GL_LINEAR);
+    mDetailTexture = gl::Texture(static_cast<int>(mDetail.mNumBins), static_cast<int>(mDetail.mNumRows), format);
+    if (mCpuColormap)
+    {
+        //Coloured with the first draw, and again whenever the scaling changes
+        mDetailMaxDB = -1.0f;
+        return;
+    }
+    mDetailTexture.bind();
+    glTexSubImage2D(mDetailTexture.getTarget(), 0, 0, 0, static_cast<GLsizei>(mDetail.mNumBins), static_cast<GLsizei>(mDetail.mNumRows), GL_RED, GL_FLOAT, mDetail.mMagnitudes.data());
+    mDetailTexture.unbind();
+}
+
+void SpectrogramPlot::clearDetail()
+{
+    mDetail = dsp::RegionResult();
+    mDetailTexture.reset();
+}
+
+void SpectrogramPlot::drawDetail(float userMaxMag, bool linearDbMode)
+{
+    if (!mDetailTexture || !mRingTexture || (!mColormapShader && !mCpuColormap) || mHistoryHopSize == 0 || mRingBinHz <= 0.0f)
+        return;
+    CIEQ_PROFILE_ZONE("draw detail");
+
+    const std::size_t numBins = mDetail.mNumBins;
+    const std::size_t numRows = mDetail.mNumRows;
+    if (mCpuColormap && (userMaxMag != mDetailMaxDB || linearDbMode != mDetailDbMode))
+    {
+        mDetailRow.setup(numBins);
+        mDetailTexture.bind();
+        for (std::size_t r = 0; r < numRows; r++)
+        {
+            const std::uint32_t* pixels = mDetailRow.stagePixels(mColormapLut, mDetail.mMagnitudes.data() + r * numBins, numBins, userMaxMag, linearDbMode);
+            glTexSubImage2D(mDetailTexture.getTarget(), 0, 0, static_cast<GLint>(r), static_cast<GLsizei>(numBins), 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+        mDetailTexture.unbind();
+        mDetailMaxDB = userMaxMag;
+        mDetailDbMode = linearDbMode;
+    }
+
+    //The texels' outer edges, mapped like getRegion() maps the other way. Row 0 is the
+    //oldest and ends up at the bottom, t = 1 at the top like the ring's newest row.
+    const dsp::RegionRequest& request = mDetail.mRequest;
+    const double binHz = static_cast<double>(request.mSampleRate) / static_cast<double>(mDetail.mFftSize);
+    const double halfHop = 0.5 * static_cast<double>(request.mHopSize);
+    const double newest = getNewestCentre();
+    const double rowSamples = getRowSamples();
+    const float width = mBounds.x2 - mBounds.x1;
+    const float height = mBounds.y2 - mBounds.y1;
+    auto freqX = [&](double freq) {
+        return mBounds.x1 + static_cast<float>((freq / mRingBinHz + 0.5) / static_cast<double>(mTexW)) * width;
+    };
+    auto sampleY = [&](double sample) {
+        return mBounds.y1 + static_cast<float>(((newest - sample) / rowSamples + 0.5) / static_cast<double>(mTexH)) * height;
+    };
+    const float left = freqX((static_cast<double>(mDetail.mFirstBin) - 0.5) * binHz);
+    const float right = freqX((static_cast<double>(mDetail.mFirstBin + numBins) - 0.5) * binHz);
+    const float top = sampleY(static_cast<double>(request.mFirstSample + (numRows - 1) * request.mHopSize) + halfHop);
+    const float bottom = sampleY(static_cast<double>(request.mFirstSample) - halfHop);
+    if (right <= left || bottom <= top)
+        return;
+
+    //Clipped to the plot, texture coordinates follow the clipped edges
+    const float x1 = std::max(left, mBounds.x1);
+    const float x2 = std::min(right, mBounds.x2);
+    const float y1 = std::max(top, mBounds.y1);
+    const float y2 = std::min(bottom, mBounds.y2);
+    if (x2 <= x1 || y2 <= y1)
+        return;
+    const float s1 = (x1 - left) / (right - left);
+    const float s2 = (x2 - left) / (right - left);
+    const float t1 = (bottom - y1) / (bottom - top);
+    const float t2 = (bottom - y2) / (bottom - top);
+    const GLfloat vertices[8] = {
+        x1, y1,
+        x2, y1,
+        x2, y2,
+        x1, y2 };
+    const GLfloat texCoords[8] = {
+        s1, t1,
+        s2, t1,
+        s2, t2,
+        s1, t2 };
+    drawColormapped(mDetailTexture, vertices, texCoords, userMaxMag, linearDbMode);
 }
 
 //Surface32f::Iter getSurfaceIter(Surface32f *surface)
@@ -570,6 +1155,15 @@ size_t SpectrogramPlot::getMaxDispBins()
     return maxDispBins;
 }
 
+void SpectrogramPlot::onFramePresented()
+{
+    //Frames without a new row would only measure the hop interval
+    if (!mRowsPendingPresent)
+        return;
+    mPresentLatency.add(std::chrono::duration<double>(std::chrono::steady_clock::now() - mNewestRowCaptureTime).count());
+    mRowsPendingPresent = false;
+}
+
 double SpectrogramPlot::getActualHopRate()
 {
     return actualHopRate;
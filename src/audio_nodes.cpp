@@ -6,17 +6,67 @@
 #include <cinder/app/App.h>
 #include <cinder/Timer.h>
 
+#include <algorithm>
+
 namespace cieq
 {
 
 AudioNodes::AudioNodes(AppGlobals& globals)
-    : mGlobals(globals)
+    : mNumPlayedFrames(0)
+    , mRecordedGeneration(0)
+    , mGlobals(globals)
     , mIsEnabled(false)
 {}
 
-void AudioNodes::setup(double userHopSize, size_t userWinSize, size_t fftSize, bool auto_enable /*= true*/)
+void AudioNodes::setup(double userHopSize, size_t userWinSize, size_t fftSize, size_t zoomMaxFreq /*= 0*/, bool auto_enable /*= true*/)
 {
     hardwareSampleRate = 0;
+    if (mPlayer)
+    {
+        //Nothing to analyse, the recording already holds the spectra
+        hardwareSampleRate = mPlayer->getGeometry().mSampleRate;
+        mNumPlayedFrames = 0;
+        if (auto_enable || mIsEnabled)
+        {
+            mIsEnabled = false;
+            enableInput();
+        }
+        return;
+    }
+
+    if (mOfflineFile)
+    {
+        //No audio graph at all, the engine reads the mapped file on its own thread
+        hardwareSampleRate = mOfflineFile->getSampleRate();
+        size_t winSizeSamples = floor((((float)userWinSize) / 1000) * hardwareSampleRate);
+        size_t hopSizeSamples = static_cast<size_t>(floor((static_cast<double>(hardwareSampleRate) / userHopSize) + 0.5));
+        mStftEngine.setup(fftSize, winSizeSamples, hopSizeSamples, hardwareSampleRate, static_cast<float>(zoomMaxFreq));
+        mStftEngine.startOffline(mOfflineFile);
+        return;
+    }
+
+    if (mGenerator)
+    {
+        //The generator writes into the capture node itself, no device and no running context
+        mGenerator->stop();
+        hardwareSampleRate = mGenerator->getSampleRate();
+        size_t winSizeSamples = floor((((float)userWinSize) / 1000) * hardwareSampleRate);
+        size_t hopSizeSamples = static_cast<size_t>(floor((static_cast<double>(hardwareSampleRate) / userHopSize) + 0.5));
+        mStftEngine.setup(fftSize, winSizeSamples, hopSizeSamples, hardwareSampleRate, static_cast<float>(zoomMaxFreq));
+
+        mCaptureNode = mGlobals.getAudioContext().makeNode(new CaptureNode(std::max(hardwareSampleRate, 4 * winSizeSamples)));
+        mCaptureNode->prepare(mGenerator->getBlockSize());
+        mStftEngine.start(mCaptureNode);
+
+        //A re-setup keeps generating if it was before
+        if (auto_enable || mIsEnabled)
+        {
+            mIsEnabled = false;
+            enableInput();
+        }
+        return;
+    }
+
     if (mInputDeviceNode == NULL)
     {
         mInputDeviceNode = mGlobals.getAudioContext().createInputDeviceNode();
@@ -30,216 +80,242 @@ void AudioNodes::setup(double userHopSize, size_t userWinSize, size_t fftSize, b
     auto monitorFormat = ci::audio::MonitorNode::Format().windowSize(userWinSizeSamples); // was originally windowSize(1024)
 	mMonitorNode = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorNode(monitorFormat));
 	
-    auto monitorSpectralFormat = ci::audio::MonitorSpectralNode::Format().fftSize(fftSize).windowSize(userWinSizeSamples); // was originally windowSize(1024), 
-    //I also changed fftSize to 131072 to ensure we get a minimum of 273 frequency bins at the minimum display frequency range setting of 0 - 100Hz
-
-    mMonitorSpectralNode = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode2 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode3 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode4 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode5 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode6 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode7 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode8 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode9 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode10 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    mMonitorSpectralNode11 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode12 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode13 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode14 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode15 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode16 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode17 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode18 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode19 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-    //mMonitorSpectralNode20 = mGlobals.getAudioContext().makeNode(new ci::audio::MonitorSpectralNode(monitorSpectralFormat));
-
-    double userHopSizeMs = (1 / userHopSize);
-    if (mTimer.isStopped())
-    {
-        mTimer.start();
-    }
+    //A single STFT engine replaces the staggered MonitorSpectralNodes. Overlap comes from
+    //the hop size in samples, so frames are exactly 1 / userHopSize seconds apart.
+    size_t hopSizeSamples = static_cast<size_t>(floor((static_cast<double>(hardwareSampleRate) / userHopSize) + 0.5));
+    mStftEngine.setup(fftSize, userWinSizeSamples, hopSizeSamples, hardwareSampleRate, static_cast<float>(zoomMaxFreq));
+
+    //Keep about a second of input around in case the analysis thread falls behind
+    mCaptureNode = mGlobals.getAudioContext().makeNode(new CaptureNode(std::max(hardwareSampleRate, 4 * userWinSizeSamples)));
+
 	mInputDeviceNode >> mMonitorNode;
-    mInputDeviceNode >> mMonitorSpectralNode;
-    //double time = 0.0;
-    //time = mTimer.getSeconds();
-    size_t i;
-    timeNode1 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
-    {
-        time = mTimer.getSeconds() - timeNode1;
-    }
-    mInputDeviceNode >> mMonitorSpectralNode2;
-    timeNode2 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
-    {
-        time = mTimer.getSeconds() - timeNode2;
-    }
-    mInputDeviceNode >> mMonitorSpectralNode3;
-    timeNode3 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
-    {
-        time = mTimer.getSeconds() - timeNode3;
-    }
-    mInputDeviceNode >> mMonitorSpectralNode4;
-    timeNode4 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
-    {
-        time = mTimer.getSeconds() - timeNode4;
-    }
-    mInputDeviceNode >> mMonitorSpectralNode5;
-    timeNode5 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
-    {
-        time = mTimer.getSeconds() - timeNode5;
-    }
-    mInputDeviceNode >> mMonitorSpectralNode6;
-    timeNode6 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
+    mInputDeviceNode >> mCaptureNode;
+
+    //FFT work runs on the engine's own analysis thread from here on
+    mStftEngine.start(mCaptureNode);
+
+	if (auto_enable)
+	{
+		enableInput();
+	}
+}
+
+std::uint32_t AudioNodes::reconfigure(double userHopSize, size_t userWinSize, size_t fftSize, size_t zoomMaxFreq, size_t displayMaxFreq)
+{
+    if (mPlayer)
     {
-        time = mTimer.getSeconds() - timeNode6;
+        //The recording's geometry is fixed, only the view can change
+        return getGeneration();
     }
-    mInputDeviceNode >> mMonitorSpectralNode7;
-    timeNode7 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
+
+    if (isOffline() || !mCaptureNode)
     {
-        time = mTimer.getSeconds() - timeNode7;
+        //A file is analysed from the start again anyway, and without a graph there is nothing to keep
+        disableInput();
+        disconnectAll();
+        setup(userHopSize, userWinSize, fftSize, zoomMaxFreq);
+        enableInput();
+        setDisplayedBins((mStftEngine.getFftSize() * displayMaxFreq) / hardwareSampleRate);
+        return mStftEngine.getGeneration();
     }
-    mInputDeviceNode >> mMonitorSpectralNode8;
-    timeNode8 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
+
+    //The input, monitor and capture nodes stay as they are, only the transform changes
+    size_t winSizeSamples = floor((((float)userWinSize) / 1000) * hardwareSampleRate);
+    size_t hopSizeSamples = static_cast<size_t>(floor((static_cast<double>(hardwareSampleRate) / userHopSize) + 0.5));
+    const size_t numBins = (dsp::StreamingStft::roundFftSize(fftSize, winSizeSamples) * displayMaxFreq) / hardwareSampleRate;
+    return mStftEngine.reconfigure(fftSize, winSizeSamples, hopSizeSamples, static_cast<float>(zoomMaxFreq), 0, numBins);
+}
+
+void AudioNodes::prewarmFft(const std::vector<size_t>& fftSizes, double userHopSize, size_t userWinSize, size_t zoomMaxFreq, size_t displayMaxFreq)
+{
+    if (hardwareSampleRate == 0 || mPlayer)
+        return;
+
+    size_t winSizeSamples = floor((((float)userWinSize) / 1000) * hardwareSampleRate);
+    size_t hopSizeSamples = static_cast<size_t>(floor((static_cast<double>(hardwareSampleRate) / userHopSize) + 0.5));
+    for (size_t size : fftSizes)
     {
-        time = mTimer.getSeconds() - timeNode8;
+        //A throwaway transform plans exactly what the engine would, the choices and tables stay cached
+        dsp::StreamingStft stft;
+        stft.setup(size, winSizeSamples, hopSizeSamples, hardwareSampleRate, static_cast<float>(zoomMaxFreq));
+        stft.setBinRange(0, (stft.getFftSize() * displayMaxFreq) / hardwareSampleRate);
     }
-    mInputDeviceNode >> mMonitorSpectralNode9;
-    timeNode9 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
+}
+
+cinder::audio::InputDeviceNode* const AudioNodes::getInputDeviceNode()
+{
+	return mInputDeviceNode.get();
+}
+
+cinder::audio::MonitorNode* const AudioNodes::getMonitorNode()
+{
+	return mMonitorNode.get();
+}
+
+bool AudioNodes::popSpectralFrame(SpectralFrame& frame)
+{
+    if (mPlayer ? !popPlayedFrame(frame) : !mStftEngine.popFrame(frame))
+        return false;
+
+    if (mRecorder.isOpen())
+        recordFrame(frame);
+    return true;
+}
+
+bool AudioNodes::popPlayedFrame(SpectralFrame& frame)
+{
+    //Called in a loop until nothing is due, the playhead moves with the first call of a draw
+    const auto now = std::chrono::steady_clock::now();
+    mPlayer->advance(std::chrono::duration<double>(now - mPlaybackClock).count());
+    mPlaybackClock = now;
+    if (!mPlayer->popFrame(mPlayedFrame))
+        return false;
+
+    //No capture behind a played frame, its latency starts when it's read. Played frames are
+    //indexed by frame and the recording keeps no window or hop, so they have no samples.
+    frame.mMagnitudes.swap(mPlayedFrame.mMagnitudes);
+    frame.mSampleIndex = mPlayedFrame.mIndex;
+    frame.mCaptureTime = now;
+    frame.mGeneration = mPlayedFrame.mGeneration;
+    frame.mWindowSize = 0;
+    frame.mHopSize = 0;
+    frame.mIndexStep = 1;
+    mNumPlayedFrames++;
+    return true;
+}
+
+void AudioNodes::seekPlayback(double time, size_t numHistory)
+{
+    if (mPlayer)
+        mPlayer->seek(time, numHistory);
+}
+
+bool AudioNodes::startRecording(const std::string& path, const dsp::RecordingFormat& format)
+{
+    if (!mRecorder.open(path, format))
     {
-        time = mTimer.getSeconds() - timeNode9;
+        ci::app::console() << "Recording: " << mRecorder.getError() << std::endl;
+        return false;
     }
-    mInputDeviceNode >> mMonitorSpectralNode10;
-    timeNode10 = mTimer.getSeconds();
-    for (i = 0; time < userHopSizeMs; i++)
+
+    mRecordStart = std::chrono::steady_clock::now();
+    mRecordedGeneration = getGeneration();
+    mRecordedGeometry = getRecordingGeometry();
+    return true;
+}
+
+bool AudioNodes::stopRecording()
+{
+    if (mRecorder.close())
+        return true;
+
+    ci::app::console() << "Recording: " << mRecorder.getError() << std::endl;
+    return false;
+}
+
+void AudioNodes::recordFrame(const SpectralFrame& frame)
+{
+    //The engine reports a reconfigured geometry right away, frames computed before it still
+    //drain out of the queue, so only a frame of the current generation moves the label on
+    if (frame.mGeneration != mRecordedGeneration && frame.mGeneration == getGeneration())
     {
-        time = mTimer.getSeconds() - timeNode10;
+        mRecordedGeneration = frame.mGeneration;
+        mRecordedGeometry = getRecordingGeometry();
     }
-    mInputDeviceNode >> mMonitorSpectralNode11;
-    timeNode11 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode11;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode12;
-    //timeNode12 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode12;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode13;
-    //timeNode13 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode13;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode14;
-    //timeNode14 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode14;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode15;
-    //timeNode15 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode15;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode16;
-    //timeNode16 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode16;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode17;
-    //timeNode17 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode17;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode18;
-    //timeNode18 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode18;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode19;
-    //timeNode19 = mTimer.getSeconds();
-    //for (i = 0; time < userHopSizeMs; i++)
-    //{
-    //    time = mTimer.getSeconds() - timeNode19;
-    //}
-    //mInputDeviceNode >> mMonitorSpectralNode20;
-    //timeNode20 = mTimer.getSeconds();
 
-	if (auto_enable)
-	{
-		enableInput();
-	}
+    //Timed by capture, which keeps counting through a reconfigure, unlike sample indices after a setup()
+    dsp::RecordingGeometry geometry = mRecordedGeometry;
+    geometry.mNumBins = static_cast<std::uint32_t>(frame.mMagnitudes.size());
+    const double time = std::chrono::duration<double>(frame.mCaptureTime - mRecordStart).count();
+    mRecorder.push(time, geometry, frame.mMagnitudes.data());
 }
 
-cinder::audio::InputDeviceNode* const AudioNodes::getInputDeviceNode()
+dsp::RecordingGeometry AudioNodes::getRecordingGeometry()
 {
-	return mInputDeviceNode.get();
+    if (mPlayer)
+        return mPlayer->getGeometry();
+
+    dsp::RecordingGeometry geometry;
+    geometry.mSampleRate = static_cast<std::uint32_t>(mStftEngine.getSampleRate());
+    geometry.mFftSize = static_cast<std::uint32_t>(mStftEngine.getFftSize());
+    geometry.mFirstBin = static_cast<std::uint32_t>(mStftEngine.getFirstBin());
+    geometry.mNumBins = static_cast<std::uint32_t>(mStftEngine.getNumOutputBins());
+    return geometry;
 }
 
-cinder::audio::MonitorNode* const AudioNodes::getMonitorNode()
+void AudioNodes::copyLatestSpectrum(std::vector<float>& dest)
 {
-	return mMonitorNode.get();
+    mStftEngine.copyLatestMagnitudes(dest);
+}
+
+bool AudioNodes::openFile(const std::string& path)
+{
+    auto file = std::make_shared<dsp::AudioFile>();
+    if (!file->open(path))
+    {
+        ci::app::console() << "Offline analysis: " << file->getError() << std::endl;
+        return false;
+    }
+
+    mOfflineFile = file;
+    ci::app::getWindow()->setTitle(ci::app::getWindow()->getTitle() + " (" + path + ")");
+    return true;
+}
+
+bool AudioNodes::openGenerator(const std::string& spec)
+{
+    dsp::GeneratorSettings settings;
+    std::string error;
+    std::unique_ptr<GeneratorSource> generator(new GeneratorSource());
+    if (!dsp::parseGeneratorSettings(spec, settings, error) || !generator->setup(settings))
+    {
+        ci::app::console() << "Generator: " << (error.empty() ? generator->getError() : error) << std::endl;
+        return false;
+    }
+
+    mGenerator = std::move(generator);
+    ci::app::getWindow()->setTitle(ci::app::getWindow()->getTitle() + " (" + mGenerator->getDescription() + ")");
+    return true;
 }
 
-cinder::audio::MonitorSpectralNode* const AudioNodes::getMonitorSpectralNode(size_t nodeNumber)
+bool AudioNodes::openPlayback(const std::string& path)
 {
-    //if (mTimer.isStopped())
-    //{
-    //    mTimer.start();
-    //}
-    //timeSec1Enter = mTimer.getSeconds();
-    //cinder::audio::MonitorSpectralNode* const getMonitorSpectralNodeTemp = mMonitorSpectralNode.get();
-    //timeSec1Exit = mTimer.getSeconds();
-    //timeSec1Process = timeSec1Exit - timeSec1Enter;
-    switch (nodeNumber)
+    std::unique_ptr<dsp::SpectrogramPlayer> player(new dsp::SpectrogramPlayer());
+    if (!player->open(path))
     {
-    case 1:
-        return mMonitorSpectralNode.get(); //mMonitorSpectralNode.get();
-    case 2:
-        return mMonitorSpectralNode2.get();
-    case 3:
-        return mMonitorSpectralNode3.get();
-    case 4:
-        return mMonitorSpectralNode4.get();
-    case 5:
-        return mMonitorSpectralNode5.get();
-    case 6:
-        return mMonitorSpectralNode6.get();
-    case 7:
-        return mMonitorSpectralNode7.get();
-    case 8:
-        return mMonitorSpectralNode8.get();
-    case 9:
-        return mMonitorSpectralNode9.get();
-    case 10:
-        return mMonitorSpectralNode10.get();
+        ci::app::console() << "Playback: " << player->getError() << std::endl;
+        return false;
     }
-    return mMonitorSpectralNode.get(); //mMonitorSpectralNode.get();
+
+    mPlayer = std::move(player);
+    ci::app::getWindow()->setTitle(ci::app::getWindow()->getTitle() + " (" + path + ")");
+    return true;
 }
 
-ci::Timer* const AudioNodes::getTimer()
+double AudioNodes::getOfflineProgress()
 {
-    return &mTimer;
+    return mStftEngine.getOfflineProgress();
 }
 
 void AudioNodes::enableInput()
 {
 	if (mIsEnabled) return;
+	if (mPlayer)
+	{
+		//The playhead starts moving from now, not from when it was paused
+		mPlaybackClock = std::chrono::steady_clock::now();
+		mPlayer->setPlaying(true);
+		mIsEnabled = true;
+		return;
+	}
+	if (mGenerator)
+	{
+		if (!mCaptureNode) return;
+		mGenerator->start(mCaptureNode);
+		mIsEnabled = true;
+		return;
+	}
+	if (!mInputDeviceNode) return;
 
 	mGlobals.getAudioContext().enable();
 	mInputDeviceNode->enable();
@@ -250,6 +326,18 @@ void AudioNodes::enableInput()
 void AudioNodes::disableInput()
 {
 	if (!mIsEnabled) return;
+	if (mPlayer)
+	{
+		mPlayer->setPlaying(false);
+		mIsEnabled = false;
+		return;
+	}
+	if (mGenerator)
+	{
+		mGenerator->stop();
+		mIsEnabled = false;
+		return;
+	}
 
 	mGlobals.getAudioContext().disable();
     mInputDeviceNode->disable();
@@ -271,68 +359,95 @@ void AudioNodes::toggleInput()
 
 void AudioNodes::disconnectAll()
 {
+    //The generator writes into the capture node, so it goes first. It restarts on the next setup().
+    if (mGenerator)
+        mGenerator->stop();
+    mStftEngine.stop();
+    if (isOffline() || isGenerated() || isPlayback())
+        return;
+
     mInputDeviceNode->disconnectAll();
     mMonitorNode->disconnectAll();
-    mMonitorSpectralNode->disconnectAll();
+    mCaptureNode->disconnectAll();
     mGlobals.getAudioContext().disconnectAllNodes();
     //delete &mMonitorNode;
     //delete &mMonitorSpectralNode;
     //delete &mInputDeviceNode;
 }
 
+void AudioNodes::setDisplayedBins(size_t numBins)
+{
+    //A recording holds the bins it was recorded with
+    if (mPlayer)
+        return;
+    mStftEngine.setBinRange(0, numBins);
+}
+
+std::uint32_t AudioNodes::getGeneration() const
+{
+    //A recording's generations number its geometries, the plot retunes when the next frame brings another one
+    return mPlayer ? mPlayer->getGeneration() : mStftEngine.getGeneration();
+}
+
 size_t AudioNodes::getNumBins()
 {
-    return mMonitorSpectralNode->getNumBins();
+    return mPlayer ? mPlayer->getGeometry().mFftSize / 2 : mStftEngine.getNumBins();
+}
+
+const char* AudioNodes::getBinRangeMethodName()
+{
+    return mPlayer ? "recorded" : mStftEngine.getBinRangeMethodName();
 }
 
 size_t AudioNodes::getFftSize()
 {
-    return mMonitorSpectralNode->getFftSize();
+    return mPlayer ? mPlayer->getGeometry().mFftSize : mStftEngine.getFftSize();
+}
+
+size_t AudioNodes::getTransformSize()
+{
+    return mPlayer ? mPlayer->getGeometry().mFftSize : mStftEngine.getTransformSize();
 }
 
 size_t AudioNodes::getMaxFreqDisp(size_t binNumber)
 {
-    return mMonitorSpectralNode->getFreqForBin(binNumber);//getNumBins() - 1);
+    return static_cast<size_t>(binNumber * getHardwareSampleRate() / static_cast<float>(getFftSize()));
 }
 
 size_t AudioNodes::getHardwareSampleRate()
 {
-    return hardwareSampleRate;
+    //A recording may switch sample rates along with the rest of its geometry
+    return mPlayer ? mPlayer->getGeometry().mSampleRate : hardwareSampleRate;
 }
 
-double AudioNodes::getTimeOfNode(size_t nodeNumber)
+void AudioNodes::readCounters(PipelineCounters& counters)
 {
-    //if (mTimer.isStopped())
-    //{
-    //    mTimer.start();
-    //}
-    //timeSec1Enter = mTimer.getSeconds();
-    switch (nodeNumber)
+    counters.mHopsProduced = mStftEngine.getNumProducedFrames();
+    counters.mRowsSkipped = mStftEngine.getNumDroppedFrames();
+    counters.mFrameQueueHighWater = mStftEngine.getFrameQueueHighWater();
+    counters.mFrameQueueCapacity = mStftEngine.getFrameQueueCapacity();
+
+    if (mPlayer)
     {
-    case 1:
-        return timeNode1;
-    case 2:
-        return timeNode2;
-    case 3:
-        return timeNode3;
-    case 4:
-        return timeNode4;
-    case 5:
-        return timeNode5;
-    case 6:
-        return timeNode6;
-    case 7:
-        return timeNode7;
-    case 8:
-        return timeNode8;
-    case 9:
-        return timeNode9;
-    case 10:
-        return timeNode10;
+        //Played frames are due when the playhead passes them, none can be late
+        counters.mHopsProduced = mNumPlayedFrames;
+        counters.mHopsExpected = mNumPlayedFrames;
+        return;
     }
-    return timeNode1;
-    //timeSec1Exit = mTimer.getSeconds();
-    //timeSec1Process = timeSec1Exit - timeSec1Enter;
+
+    if (isOffline() || !mCaptureNode)
+    {
+        //A file is analysed as fast as it goes, there is no rate to fall behind
+        counters.mHopsExpected = counters.mHopsProduced;
+        return;
+    }
+
+    counters.mHopsExpected = mStftEngine.getNumExpectedFrames(mCaptureNode->getNumReceivedSamples());
+    counters.mCaptureSamplesDropped = mCaptureNode->getNumDroppedSamples();
+    counters.mCaptureRingHighWater = mCaptureNode->getRingHighWater();
+    counters.mCaptureRingSize = mCaptureNode->getRingSize();
+    if (mInputDeviceNode && mInputDeviceNode->getLastOverrun() != 0)
+        counters.mInputOverruns++;
 }
 
 } //!cieq
\ No newline at end of file
@@ -0,0 +1,642 @@
+#include "audio_stft.h"
+#include "dsp/profiler.h"
+
+#include <cinder/audio/Buffer.h>
+#include <cinder/audio/dsp/Dsp.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace cieq
+{
+
+namespace
+{
+    //! seconds worth of frames the queue can hold before new ones get dropped (e.g. drawing is paused)
+    const double kQueuedSeconds = 2.0;
+    //! never let the analysis thread sleep longer than this, so stop() stays responsive
+    const double kMaxIdleSeconds = 0.05;
+    //! frames the offline analyzer computes per batch, big enough to keep every worker busy
+    const size_t kOfflineBlockFrames = 256;
+    //! capture blocks whose arrival time is remembered, several seconds of typical block sizes
+    const size_t kMaxCaptureStamps = 1024;
+    //! live input kept for re-analysis unless setPcmHistorySeconds() says otherwise
+    const double kDefaultPcmHistorySeconds = 120.0;
+}
+
+CaptureNode::CaptureNode(size_t ringSize, const Format& format /*= Format()*/)
+    : ci::audio::NodeAutoPullable(format)
+    , mStamps(kMaxCaptureStamps)
+    , mNumDroppedSamples(0)
+    , mNumWrittenSamples(0)
+    , mRingHighWater(0)
+    , mRingSize(ringSize)
+{}
+
+void CaptureNode::initialize()
+{
+    prepare(getFramesPerBlock());
+}
+
+void CaptureNode::prepare(size_t maxFramesPerBlock)
+{
+    mRingBuffer.resize(mRingSize);
+    mMixBuffer.resize(maxFramesPerBlock);
+}
+
+void CaptureNode::process(ci::audio::Buffer* buffer)
+{
+    CIEQ_PROFILE_THREAD("audio");
+    write(buffer->getData(), buffer->getNumChannels(), buffer->getNumFrames());
+}
+
+void CaptureNode::write(const float* channels, size_t numChannels, size_t numFrames)
+{
+    CIEQ_PROFILE_ZONE("capture");
+    const auto arrival = std::chrono::steady_clock::now();
+    if (numChannels <= 1)
+    {
+        writeMono(channels, numFrames, arrival);
+        return;
+    }
+
+    // average all channels, same as MonitorSpectralNode. A block longer than prepare() was
+    // told about is mixed a mix buffer at a time rather than lost.
+    const size_t chunkFrames = mMixBuffer.size();
+    if (chunkFrames == 0)
+    {
+        mNumDroppedSamples.fetch_add(numFrames, std::memory_order_relaxed);
+        return;
+    }
+    for (size_t offset = 0; offset < numFrames; offset += chunkFrames)
+    {
+        const size_t count = std::min(chunkFrames, numFrames - offset);
+        std::copy(channels + offset, channels + offset + count, mMixBuffer.begin());
+        for (size_t ch = 1; ch < numChannels; ch++)
+        {
+            ci::audio::dsp::add(mMixBuffer.data(), channels + ch * numFrames + offset, mMixBuffer.data(), count);
+        }
+        ci::audio::dsp::mul(mMixBuffer.data(), 1.0f / static_cast<float>(numChannels), mMixBuffer.data(), count);
+        writeMono(mMixBuffer.data(), count, arrival);
+    }
+}
+
+void CaptureNode::writeMono(const float* samples, size_t numFrames, std::chrono::steady_clock::time_point arrival)
+{
+    if (!mRingBuffer.write(samples, numFrames))
+    {
+        mNumDroppedSamples.fetch_add(numFrames, std::memory_order_relaxed);
+        return;
+    }
+
+    //Only this thread writes either counter
+    const std::uint64_t numWritten = mNumWrittenSamples.load(std::memory_order_relaxed) + numFrames;
+    mNumWrittenSamples.store(numWritten, std::memory_order_relaxed);
+    const size_t queued = mRingBuffer.getAvailableRead();
+    if (queued > mRingHighWater.load(std::memory_order_relaxed))
+        mRingHighWater.store(queued, std::memory_order_relaxed);
+
+    //Without room for the stamp the next one answers for these samples, a little late
+    CaptureStamp* stamp = mStamps.beginWrite();
+    if (stamp)
+    {
+        stamp->mEndSample = numWritten;
+        stamp->mTime = arrival;
+        mStamps.commitWrite();
+    }
+}
+
+size_t CaptureNode::read(float* dest, size_t count)
+{
+    count = std::min(count, mRingBuffer.getAvailableRead());
+    if (count == 0 || !mRingBuffer.read(dest, count))
+        return 0;
+
+    return count;
+}
+
+size_t CaptureNode::getAvailableSamples() const
+{
+    return mRingBuffer.getAvailableRead();
+}
+
+std::uint64_t CaptureNode::getNumDroppedSamples() const
+{
+    return mNumDroppedSamples.load(std::memory_order_relaxed);
+}
+
+std::uint64_t CaptureNode::getNumReceivedSamples() const
+{
+    return mNumWrittenSamples.load(std::memory_order_relaxed) + mNumDroppedSamples.load(std::memory_order_relaxed);
+}
+
+size_t CaptureNode::getRingHighWater() const
+{
+    return mRingHighWater.load(std::memory_order_relaxed);
+}
+
+std::chrono::steady_clock::time_point CaptureNode::getCaptureTime(std::uint64_t sampleIndex)
+{
+    //Blocks ending at or before the sample are done with
+    CaptureStamp* stamp = mStamps.front();
+    while (stamp && stamp->mEndSample <= sampleIndex)
+    {
+        mStamps.pop();
+        stamp = mStamps.front();
+    }
+
+    //The samples can be read before process() gets to push their stamp
+    return stamp ? stamp->mTime : std::chrono::steady_clock::now();
+}
+
+StftEngine::StftEngine()
+    : mStftGeneration(0)
+    , mStreamOffset(0)
+    , mRecentPos(0)
+    , mRecentFill(0)
+    , mPcmHistorySeconds(kDefaultPcmHistorySeconds)
+    , mOfflineNextFrame(0)
+    , mOfflineNumFrames(0)
+    , mRunning(false)
+    , mNumDroppedFrames(0)
+    , mNumProducedFrames(0)
+    , mFrameQueueHighWater(0)
+    , mGeneration(0)
+    , mPlannerRunning(false)
+    , mPlanRequested(false)
+    , mPlannedGeneration(0)
+    , mHasPlanned(false)
+{}
+
+StftEngine::~StftEngine()
+{
+    stop();
+    stopPlanner();
+}
+
+void StftEngine::setup(size_t fftSize, size_t windowSize, size_t hopSize, size_t sampleRate, float zoomMaxFreq /*= 0.0f*/)
+{
+    stop();
+    //Bumped first, a plan still in flight sees it's stale and gets dropped
+    mStftGeneration = ++mGeneration;
+    discardPlan();
+
+    mStft.setup(fftSize, windowSize, hopSize, sampleRate, zoomMaxFreq);
+    mStreamOffset = 0;
+    mRecent.assign(mStft.getSampleRate(), 0.0f);
+    mRecentPos = 0;
+    mRecentFill = 0;
+    //Stream indices start over, the storage only gets reallocated if its size changes
+    const size_t pcmCapacity = static_cast<size_t>(std::max(mPcmHistorySeconds, 0.0) * mStft.getSampleRate());
+    if (pcmCapacity != mPcmHistory.getCapacity())
+        mPcmHistory.setup(pcmCapacity);
+    else
+        mPcmHistory.restart();
+    {
+        std::lock_guard<std::mutex> lock(mGeometryMutex);
+        publishGeometry(mStft);
+        mGeometry.mExpectedBase = 0;
+        mGeometry.mFirstFrameEnd = mStft.getWindowSize();
+        mGeometry.mFrameSpacing = mStft.getHopSize();
+    }
+    mReadBuffer.resize(mStft.getHopSize());
+    {
+        std::lock_guard<std::mutex> lock(mLatestMutex);
+        mLatestMagnitudes.assign(mStft.getNumOutputBins(), 0.0f);
+    }
+    //Slots allocate their magnitude storage on first use, so a large capacity is cheap
+    const size_t hopsPerSecond = static_cast<size_t>(ceil(static_cast<double>(mStft.getSampleRate()) / mStft.getHopSize()));
+    mFrames.reset(std::max<size_t>(8, static_cast<size_t>(kQueuedSeconds * hopsPerSecond)));
+    mNumDroppedFrames = 0;
+    mNumProducedFrames = 0;
+    mFrameQueueHighWater = 0;
+
+    mOfflineNextFrame = 0;
+    mOfflineNumFrames = 0;
+}
+
+void StftEngine::setBinRange(size_t firstBin, size_t numBins)
+{
+    //The analysis thread owns the planned transform, so re-plan with it parked
+    const std::shared_ptr<CaptureNode> source = mSource;
+    const std::shared_ptr<dsp::AudioFile> offlineFile = mOfflineFile;
+    stop();
+    mStftGeneration = ++mGeneration;
+    discardPlan();
+
+    mStft.setBinRange(firstBin, numBins);
+    {
+        std::lock_guard<std::mutex> lock(mGeometryMutex);
+        publishGeometry(mStft);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLatestMutex);
+        mLatestMagnitudes.assign(mStft.getNumOutputBins(), 0.0f);
+    }
+
+    if (source)
+        start(source);
+    else if (offlineFile)
+        startOffline(offlineFile);
+}
+
+void StftEngine::process(CaptureNode& source)
+{
+    if (!mStft.isSetup())
+        return;
+
+    for (;;)
+    {
+        //Never read past the next hop boundary, that way every frame lands on an exact sample
+        const size_t wanted = std::min(mStft.getSamplesToNextFrame(), mReadBuffer.size());
+        const size_t numRead = source.read(mReadBuffer.data(), wanted);
+        if (numRead == 0)
+            break;
+
+        rememberSamples(mReadBuffer.data(), numRead);
+        mPcmHistory.write(mReadBuffer.data(), numRead);
+        mStft.write(mReadBuffer.data(), numRead);
+        if (mStft.isFrameReady())
+        {
+            computeFrame(source.getCaptureTime(mStreamOffset + mStft.getSamplesConsumed() - 1));
+            //A hop boundary, the only place a reconfigured transform takes over
+            swapPlanned();
+        }
+    }
+}
+
+std::uint32_t StftEngine::reconfigure(size_t fftSize, size_t windowSize, size_t hopSize, float zoomMaxFreq, size_t firstBin, size_t numBins)
+{
+    if (!mRunning || !mSource)
+    {
+        //Nothing running that could keep going, start() is up to the caller
+        const size_t sampleRate = mStft.getSampleRate();
+        setup(fftSize, windowSize, hopSize, sampleRate, zoomMaxFreq);
+        setBinRange(firstBin, numBins);
+        return mGeneration;
+    }
+
+    PlanRequest request;
+    request.mFftSize = fftSize;
+    request.mWindowSize = windowSize;
+    request.mHopSize = std::max<size_t>(hopSize, 1);
+    request.mZoomMaxFreq = zoomMaxFreq;
+    request.mFirstBin = firstBin;
+    request.mNumBins = numBins;
+    {
+        //The requested geometry right away, so the caller can size its display for it.
+        //Whether zooming works out is only known once the plan is made.
+        std::lock_guard<std::mutex> lock(mGeometryMutex);
+        request.mSampleRate = mGeometry.mSampleRate;
+        request.mGeneration = ++mGeneration;
+        mGeometry.mFftSize = dsp::StreamingStft::roundFftSize(fftSize, windowSize);
+        mGeometry.mTransformSize = mGeometry.mFftSize;
+        mGeometry.mNumBins = mGeometry.mFftSize / 2;
+        mGeometry.mFirstBin = std::min(firstBin, mGeometry.mNumBins);
+        mGeometry.mNumOutputBins = std::min(numBins, mGeometry.mNumBins - mGeometry.mFirstBin);
+        mGeometry.mWindowSize = windowSize;
+        mGeometry.mHopSize = request.mHopSize;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mPlanMutex);
+        mPlanRequest = request;
+        mPlanRequested = true;
+        if (!mPlannerRunning)
+        {
+            mPlannerRunning = true;
+            mPlanner = std::thread(&StftEngine::runPlanner, this);
+        }
+    }
+    mPlanCondition.notify_one();
+    return request.mGeneration;
+}
+
+void StftEngine::runPlanner()
+{
+    CIEQ_PROFILE_THREAD("stft planner");
+    std::unique_lock<std::mutex> lock(mPlanMutex);
+    for (;;)
+    {
+        mPlanCondition.wait(lock, [this] { return mPlanRequested || !mPlannerRunning; });
+        if (!mPlannerRunning)
+            return;
+
+        //A slider drag piles up requests faster than they get planned, only the latest one counts
+        const PlanRequest request = mPlanRequest;
+        mPlanRequested = false;
+        lock.unlock();
+
+        //FFT plans, window table, zoom filters and history: everything that would stall the analysis
+        std::unique_ptr<dsp::StreamingStft> planned(new dsp::StreamingStft());
+        {
+            CIEQ_PROFILE_ZONE("plan stft");
+            planned->setup(request.mFftSize, request.mWindowSize, request.mHopSize, request.mSampleRate, request.mZoomMaxFreq);
+            planned->setBinRange(request.mFirstBin, request.mNumBins);
+        }
+
+        lock.lock();
+        //A newer request or a setup() since then make this plan stale
+        if (request.mGeneration == mGeneration.load())
+        {
+            mPlanned = std::move(planned);
+            mPlannedGeneration = request.mGeneration;
+            mHasPlanned.store(true, std::memory_order_release);
+        }
+    }
+}
+
+void StftEngine::stopPlanner()
+{
+    {
+        std::lock_guard<std::mutex> lock(mPlanMutex);
+        mPlannerRunning = false;
+    }
+    mPlanCondition.notify_one();
+    if (mPlanner.joinable())
+    {
+        mPlanner.join();
+    }
+}
+
+void StftEngine::discardPlan()
+{
+    std::lock_guard<std::mutex> lock(mPlanMutex);
+    mPlanRequested = false;
+    mPlanned.reset();
+    mHasPlanned = false;
+}
+
+void StftEngine::swapPlanned()
+{
+    if (!mHasPlanned.load(std::memory_order_acquire))
+        return;
+
+    std::unique_ptr<dsp::StreamingStft> planned;
+    std::uint32_t generation = 0;
+    {
+        std::lock_guard<std::mutex> lock(mPlanMutex);
+        planned = std::move(mPlanned);
+        generation = mPlannedGeneration;
+        mHasPlanned = false;
+    }
+    if (!planned)
+        return;
+    CIEQ_PROFILE_ZONE("swap stft");
+
+    //Prime with the most recent input so the first new frame has a full window. Frames falling
+    //due meanwhile cover time the old transform already did, the last one included.
+    const size_t numPrimed = std::min(mRecentFill, planned->getSettleSamples());
+    size_t readPos = (mRecentPos + mRecent.size() - numPrimed) % mRecent.size();
+    size_t remaining = numPrimed;
+    while (remaining > 0)
+    {
+        const size_t taken = planned->write(mRecent.data() + readPos, std::min(remaining, mRecent.size() - readPos));
+        if (planned->isFrameReady())
+            planned->skipFrame();
+        readPos = (readPos + taken) % mRecent.size();
+        remaining -= taken;
+    }
+
+    //Frame sample indices keep counting over the whole stream
+    const std::uint64_t streamPosition = mStreamOffset + mStft.getSamplesConsumed();
+    mStreamOffset = streamPosition - planned->getSamplesConsumed();
+    mStft = std::move(*planned);
+    mStftGeneration = generation;
+    mReadBuffer.resize(mStft.getHopSize());
+    {
+        std::lock_guard<std::mutex> lock(mLatestMutex);
+        mLatestMagnitudes.assign(mStft.getNumOutputBins(), 0.0f);
+    }
+
+    std::lock_guard<std::mutex> lock(mGeometryMutex);
+    //Requested after this one was planned: the getters already describe the newer one
+    if (generation == mGeneration.load())
+        publishGeometry(mStft);
+    mGeometry.mExpectedBase = mNumProducedFrames.load(std::memory_order_relaxed);
+    mGeometry.mFirstFrameEnd = streamPosition + mStft.getSamplesToNextFrame();
+    mGeometry.mFrameSpacing = mStft.getHopSize();
+}
+
+void StftEngine::rememberSamples(const float* samples, size_t count)
+{
+    if (mRecent.empty())
+        return;
+    if (count > mRecent.size())
+    {
+        samples += count - mRecent.size();
+        count = mRecent.size();
+    }
+
+    const size_t first = std::min(count, mRecent.size() - mRecentPos);
+    std::copy(samples, samples + first, mRecent.begin() + mRecentPos);
+    std::copy(samples + first, samples + count, mRecent.begin());
+    mRecentPos = (mRecentPos + count) % mRecent.size();
+    mRecentFill = std::min(mRecent.size(), mRecentFill + count);
+}
+
+StftEngine::Geometry StftEngine::getGeometry() const
+{
+    std::lock_guard<std::mutex> lock(mGeometryMutex);
+    return mGeometry;
+}
+
+void StftEngine::publishGeometry(const dsp::StreamingStft& stft)
+{
+    mGeometry.mFftSize = stft.getFftSize();
+    mGeometry.mTransformSize = stft.getTransformSize();
+    mGeometry.mNumBins = stft.getNumBins();
+    mGeometry.mNumOutputBins = stft.getNumOutputBins();
+    mGeometry.mFirstBin = stft.getFirstBin();
+    mGeometry.mWindowSize = stft.getWindowSize();
+    mGeometry.mHopSize = stft.getHopSize();
+    mGeometry.mSampleRate = stft.getSampleRate();
+    mGeometry.mZoomed = stft.isZoomed();
+    mGeometry.mMethodName = stft.getBinRangeMethodName();
+}
+
+void StftEngine::start(const std::shared_ptr<CaptureNode>& source)
+{
+    stop();
+
+    mSource = source;
+    mRunning = true;
+    mThread = std::thread(&StftEngine::run, this);
+}
+
+void StftEngine::startOffline(const std::shared_ptr<dsp::AudioFile>& file)
+{
+    stop();
+
+    //Plan the analyzer from this engine so both produce the same frames. A restart
+    //(e.g. from setBinRange()) picks up at the first frame that wasn't queued yet.
+    mOffline.reset(new dsp::OfflineStft());
+    mOffline->setup(mStft.getFftSize(), mStft.getWindowSize(), mStft.getHopSize(), mStft.getSampleRate(), mStft.getZoomMaxFreq());
+    mOffline->setBinRange(mStft.getFirstBin(), mStft.getNumOutputBins());
+    mOfflineNumFrames = mOffline->getNumFrames(file->getNumFrames());
+
+    mOfflineFile = file;
+    mRunning = true;
+    mThread = std::thread(&StftEngine::runOffline, this);
+}
+
+void StftEngine::stop()
+{
+    mRunning = false;
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+    mSource.reset();
+    mOfflineFile.reset();
+}
+
+double StftEngine::getOfflineProgress() const
+{
+    return mOfflineNumFrames ? static_cast<double>(mOfflineNextFrame.load()) / static_cast<double>(mOfflineNumFrames) : 0.0;
+}
+
+void StftEngine::run()
+{
+    CIEQ_PROFILE_THREAD("stft");
+    while (mRunning)
+    {
+        process(*mSource);
+
+        //Sleep until the next hop boundary should have been captured instead of spinning
+        const size_t missing = mStft.getSamplesToNextFrame() - std::min(mSource->getAvailableSamples(), mStft.getSamplesToNextFrame());
+        const double idleSeconds = std::min(kMaxIdleSeconds, std::max(0.001, static_cast<double>(missing) / mStft.getSampleRate()));
+        std::this_thread::sleep_for(std::chrono::duration<double>(idleSeconds));
+    }
+}
+
+void StftEngine::runOffline()
+{
+    CIEQ_PROFILE_THREAD("stft offline");
+    const size_t numBins = mOffline->getNumOutputBins();
+    while (mRunning && mOfflineNextFrame < mOfflineNumFrames)
+    {
+        const size_t firstFrame = mOfflineNextFrame;
+        const size_t count = std::min(kOfflineBlockFrames, mOfflineNumFrames - firstFrame);
+        mOfflineBlock.resize(count * numBins);
+        mOffline->analyze(*mOfflineFile, firstFrame, count, mOfflineBlock.data());
+
+        for (size_t i = 0; i < count; i++)
+        {
+            //Nothing is lost by waiting here, unlike live input the file doesn't move on
+            SpectralFrame* frame = mFrames.beginWrite();
+            while (!frame)
+            {
+                if (!mRunning)
+                    return;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                frame = mFrames.beginWrite();
+            }
+
+            const float* row = mOfflineBlock.data() + i * numBins;
+            frame->mMagnitudes.assign(row, row + numBins);
+            frame->mSampleIndex = mOffline->getFrameSampleIndex(firstFrame + i);
+            frame->mCaptureTime = std::chrono::steady_clock::now();
+            frame->mGeneration = mStftGeneration;
+            frame->mWindowSize = mOffline->getWindowSize();
+            frame->mHopSize = mOffline->getHopSize();
+            frame->mIndexStep = mOffline->getHopSize();
+            {
+                std::lock_guard<std::mutex> lock(mLatestMutex);
+                mLatestMagnitudes.assign(row, row + numBins);
+            }
+            commitFrame();
+            mOfflineNextFrame = firstFrame + i + 1;
+        }
+    }
+}
+
+void StftEngine::computeFrame(std::chrono::steady_clock::time_point captureTime)
+{
+    CIEQ_PROFILE_ZONE(mStft.isZoomed() ? "zoom fft" : "fft");
+    SpectralFrame* frame = mFrames.beginWrite();
+    if (!frame)
+    {
+        //Nobody is draining the queue, drop the frame rather than block the analysis
+        mStft.skipFrame();
+        mNumDroppedFrames.fetch_add(1, std::memory_order_relaxed);
+        mNumProducedFrames.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    frame->mSampleIndex = mStreamOffset + mStft.getFrameSampleIndex();
+    frame->mCaptureTime = captureTime;
+    frame->mGeneration = mStftGeneration;
+    frame->mWindowSize = mStft.getWindowSize();
+    frame->mHopSize = mStft.getHopSize();
+    frame->mIndexStep = mStft.getHopSize();
+    frame->mMagnitudes.resize(mStft.getNumOutputBins());
+    mStft.computeFrame(frame->mMagnitudes.data());
+
+    {
+        std::lock_guard<std::mutex> lock(mLatestMutex);
+        mLatestMagnitudes.assign(frame->mMagnitudes.begin(), frame->mMagnitudes.end());
+    }
+
+    commitFrame();
+}
+
+bool StftEngine::popFrame(SpectralFrame& frame)
+{
+    SpectralFrame* front = mFrames.front();
+    if (!front)
+        return false;
+
+    //Hand the frame over and leave the caller's old storage in the slot for reuse
+    std::swap(frame.mMagnitudes, front->mMagnitudes);
+    frame.mSampleIndex = front->mSampleIndex;
+    frame.mCaptureTime = front->mCaptureTime;
+    frame.mGeneration = front->mGeneration;
+    frame.mWindowSize = front->mWindowSize;
+    frame.mHopSize = front->mHopSize;
+    frame.mIndexStep = front->mIndexStep;
+    mFrames.pop();
+    return true;
+}
+
+std::uint64_t StftEngine::getNumDroppedFrames() const
+{
+    return mNumDroppedFrames.load(std::memory_order_relaxed);
+}
+
+std::uint64_t StftEngine::getNumProducedFrames() const
+{
+    return mNumProducedFrames.load(std::memory_order_relaxed);
+}
+
+std::uint64_t StftEngine::getNumExpectedFrames(std::uint64_t numReceived) const
+{
+    //The first frame of a transform needs a full window, every hop after that one more
+    const Geometry geometry = getGeometry();
+    if (numReceived < geometry.mFirstFrameEnd || geometry.mFrameSpacing == 0)
+        return geometry.mExpectedBase;
+    return geometry.mExpectedBase + (numReceived - geometry.mFirstFrameEnd) / geometry.mFrameSpacing + 1;
+}
+
+size_t StftEngine::getFrameQueueHighWater() const
+{
+    return mFrameQueueHighWater.load(std::memory_order_relaxed);
+}
+
+void StftEngine::commitFrame()
+{
+    //Only the analysis thread produces, so a plain load / store keeps the maximum
+    mFrames.commitWrite();
+    mNumProducedFrames.fetch_add(1, std::memory_order_relaxed);
+    const size_t queued = mFrames.size();
+    if (queued > mFrameQueueHighWater.load(std::memory_order_relaxed))
+        mFrameQueueHighWater.store(queued, std::memory_order_relaxed);
+}
+
+void StftEngine::copyLatestMagnitudes(std::vector<float>& dest) const
+{
+    std::lock_guard<std::mutex> lock(mLatestMutex);
+    dest.assign(mLatestMagnitudes.begin(), mLatestMagnitudes.end());
+}
+
+} //!cieq
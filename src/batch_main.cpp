@@ -0,0 +1,344 @@
+// Headless batch analyzer: renders the spectrogram of every file in a list on all
+// cores, without Cinder, a window or a sound card. Built as its own executable from
+// this file and the dsp sources, e.g.
+//   g++ -O2 -std=c++14 -pthread -Iinclude src/batch_main.cpp src/dsp/*.cpp -o cieq_batch
+//
+//   cieq_batch [options] file... [--list paths.txt]
+//     --out <dir>          write outputs there instead of next to each input
+//     --format png|npy|both  spectrogram image, float32 magnitude matrix or both (png)
+//     --window-ms <ms>     analysis window (500)
+//     --hop-hz <hz>        frames per second (20)
+//     --fft <size>         FFT size, sets the bin spacing (131072)
+//     --max-freq <hz>      highest frequency kept (2000)
+//     --zoom               decimating zoom FFT instead of the pruned full-band one
+//     --palette jet|viridis|grayscale  (jet)
+//     --db                 dB instead of linear colour scale
+//     --max-mag <value>    colour scale maximum, as the app's "Max Magnitude Display" (65)
+//     --threads <n>        worker threads, 0 for one per hardware thread (0)
+//     --trace <file.json>  write the profiling zones of the run as a Chrome trace
+//
+// Rows are frames, oldest first, columns are bins from 0 Hz up, the same values the
+// app's spectrogram shows for that file.
+
+#include "dsp/audio_file.h"
+#include "dsp/colormap.h"
+#include "dsp/offline_stft.h"
+#include "dsp/profiler.h"
+#include "dsp/spectrogram_io.h"
+#include "dsp/work_stealing_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cieq
+{
+
+namespace
+{
+	//! frames analysed and written per step, bounds the memory each file needs
+	const std::size_t kFramesPerChunk = 256;
+
+	struct BatchSettings
+	{
+		std::string			mOutDir;
+		std::string			mTracePath;
+		bool				mWritePng = true;
+		bool				mWriteNpy = false;
+		std::size_t			mWindowMs = 500;
+		double				mHopHz = 20.0;
+		std::size_t			mFftSize = 131072;
+		std::size_t			mMaxFreq = 2000;
+		bool				mZoom = false;
+		dsp::Palette		mPalette = dsp::Palette::JET;
+		bool				mDbMode = false;
+		float				mMaxMag = 65.0f;
+		std::size_t			mNumThreads = 0;
+	};
+
+	struct BatchJob
+	{
+		std::string			mPath;
+		std::uint64_t		mSize = 0;
+	};
+
+	//! what the workers share: settings, one analyzer per worker and the totals
+	struct BatchState
+	{
+		BatchSettings		mSettings;
+		std::vector<std::unique_ptr<dsp::OfflineStft>>	mAnalyzers;
+		std::mutex			mOutputMutex;
+		std::atomic<std::size_t>	mNumFailed;
+		std::atomic<std::uint64_t>	mMilliSecondsAnalyzed;
+
+		BatchState() : mNumFailed(0), mMilliSecondsAnalyzed(0) {}
+	};
+
+	void printUsage()
+	{
+		std::fprintf(stderr,
+			"usage: cieq_batch [options] file... [--list paths.txt]\n"
+			"  --out <dir>  --format png|npy|both  --window-ms <ms>  --hop-hz <hz>\n"
+			"  --fft <size>  --max-freq <hz>  --zoom  --palette jet|viridis|grayscale\n"
+			"  --db  --max-mag <value>  --threads <n>  --trace <file.json>\n");
+	}
+
+	//! path without directory and extension
+	std::string stem(const std::string& path)
+	{
+		const std::size_t slash = path.find_last_of("/\\");
+		std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+		const std::size_t dot = name.find_last_of('.');
+		return dot == std::string::npos ? name : name.substr(0, dot);
+	}
+
+	//! path without extension, outputs go next to their input by default
+	std::string outputBase(const std::string& path, const std::string& outDir)
+	{
+		if (outDir.empty())
+		{
+			const std::size_t slash = path.find_last_of("/\\");
+			const std::size_t dot = path.find_last_of('.');
+			return (dot == std::string::npos || (slash != std::string::npos && dot < slash)) ? path : path.substr(0, dot);
+		}
+		const char last = outDir[outDir.size() - 1];
+		return outDir + ((last == '/' || last == '\\') ? "" : "/") + stem(path);
+	}
+
+	std::uint64_t fileSize(const std::string& path)
+	{
+		std::ifstream file(path.c_str(), std::ios::binary | std::ios::ate);
+		return file ? static_cast<std::uint64_t>(file.tellg()) : 0;
+	}
+
+	void reportFailure(BatchState& state, const std::string& path, const std::string& reason)
+	{
+		state.mNumFailed++;
+		std::lock_guard<std::mutex> lock(state.mOutputMutex);
+		std::fprintf(stderr, "FAILED %s: %s\n", path.c_str(), reason.c_str());
+	}
+
+	//! one file start to finish on the calling worker, streamed kFramesPerChunk frames at a time
+	void analyzeFile(BatchState& state, std::size_t worker, const std::string& path)
+	{
+		CIEQ_PROFILE_THREAD("batch worker");
+		CIEQ_PROFILE_ZONE("file");
+		const auto start = std::chrono::steady_clock::now();
+		const BatchSettings& settings = state.mSettings;
+
+		dsp::AudioFile file;
+		if (!file.open(path))
+		{
+			reportFailure(state, path, file.getError());
+			return;
+		}
+
+		//Plans are expensive for large FFTs, keep the worker's one while the sample rate matches
+		const std::size_t sampleRate = file.getSampleRate();
+		std::unique_ptr<dsp::OfflineStft>& analyzer = state.mAnalyzers[worker];
+		if (!analyzer || analyzer->getSampleRate() != sampleRate)
+		{
+			//Same conversions AudioNodes::setup() makes from the app's parameters
+			const std::size_t windowSize = static_cast<std::size_t>(settings.mWindowMs / 1000.0 * sampleRate);
+			const std::size_t hopSize = static_cast<std::size_t>(sampleRate / settings.mHopHz + 0.5);
+			analyzer.reset(new dsp::OfflineStft());
+			analyzer->setNumThreads(1);
+			analyzer->setup(settings.mFftSize, windowSize, hopSize, sampleRate, settings.mZoom ? static_cast<float>(settings.mMaxFreq) : 0.0f);
+			analyzer->setBinRange(0, analyzer->getFftSize() * settings.mMaxFreq / sampleRate);
+		}
+
+		const std::size_t numFrames = analyzer->getNumFrames(file.getNumFrames());
+		const std::size_t numBins = analyzer->getNumOutputBins();
+		if (numFrames == 0 || numBins == 0)
+		{
+			reportFailure(state, path, "shorter than one analysis window");
+			return;
+		}
+
+		const std::string base = outputBase(path, settings.mOutDir);
+		dsp::PngWriter png;
+		dsp::NpyWriter npy;
+		if (settings.mWritePng && !png.open(base + ".png", numBins, numFrames))
+		{
+			reportFailure(state, path, "can't create " + base + ".png");
+			return;
+		}
+		if (settings.mWriteNpy && !npy.open(base + ".npy", numFrames, numBins))
+		{
+			reportFailure(state, path, "can't create " + base + ".npy");
+			return;
+		}
+
+		dsp::ColormapLut colormap;
+		if (settings.mWritePng)
+			colormap.setup(settings.mPalette);
+
+		std::vector<float> magnitudes(kFramesPerChunk * numBins);
+		std::vector<std::uint32_t> pixels(settings.mWritePng ? kFramesPerChunk * numBins : 0);
+		for (std::size_t firstFrame = 0; firstFrame < numFrames; firstFrame += kFramesPerChunk)
+		{
+			const std::size_t count = std::min(kFramesPerChunk, numFrames - firstFrame);
+			analyzer->analyze(file, firstFrame, count, magnitudes.data());
+
+			if (settings.mWriteNpy)
+			{
+				CIEQ_PROFILE_ZONE("npy write");
+				npy.appendRows(magnitudes.data(), count);
+			}
+			if (settings.mWritePng)
+			{
+				CIEQ_PROFILE_ZONE("png encode");
+				for (std::size_t row = 0; row < count; row++)
+					colormap.mapRow(magnitudes.data() + row * numBins, numBins, settings.mMaxMag, settings.mDbMode, pixels.data() + row * numBins);
+				png.appendRows(pixels.data(), count);
+			}
+		}
+
+		if ((settings.mWritePng && !png.close()) || (settings.mWriteNpy && !npy.close()))
+		{
+			reportFailure(state, path, "write error under " + base);
+			return;
+		}
+
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		state.mMilliSecondsAnalyzed += static_cast<std::uint64_t>(file.getDurationSeconds() * 1000.0);
+		std::lock_guard<std::mutex> lock(state.mOutputMutex);
+		std::printf("%s: %zu frames x %zu bins, %.1f s of audio in %.2f s\n", path.c_str(), numFrames, numBins, file.getDurationSeconds(), seconds);
+	}
+
+	bool parsePalette(const std::string& name, dsp::Palette& palette)
+	{
+		for (std::size_t i = 0; i < dsp::kNumPalettes; i++)
+		{
+			std::string candidate = dsp::getPaletteName(static_cast<dsp::Palette>(i));
+			std::transform(candidate.begin(), candidate.end(), candidate.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+			if (candidate == name)
+			{
+				palette = static_cast<dsp::Palette>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//! fills settings and jobs from the command line, false on anything it doesn't understand
+	bool parseArguments(int argc, char** argv, BatchSettings& settings, std::vector<BatchJob>& jobs)
+	{
+		for (int i = 1; i < argc; i++)
+		{
+			const std::string arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+			if (arg == "--zoom")
+				settings.mZoom = true;
+			else if (arg == "--db")
+				settings.mDbMode = true;
+			else if (arg.compare(0, 2, "--") != 0)
+				jobs.push_back(BatchJob{ arg, 0 });
+			else if (!hasValue)
+				return false;
+			else
+			{
+				const std::string value = argv[++i];
+				if (arg == "--list")
+				{
+					std::ifstream list(value.c_str());
+					if (!list)
+					{
+						std::fprintf(stderr, "can't read %s\n", value.c_str());
+						return false;
+					}
+					std::string line;
+					while (std::getline(list, line))
+					{
+						line.erase(line.find_last_not_of(" \t\r\n") + 1);
+						if (!line.empty())
+							jobs.push_back(BatchJob{ line, 0 });
+					}
+				}
+				else if (arg == "--out")
+					settings.mOutDir = value;
+				else if (arg == "--format")
+				{
+					settings.mWritePng = value == "png" || value == "both";
+					settings.mWriteNpy = value == "npy" || value == "both";
+					if (!settings.mWritePng && !settings.mWriteNpy)
+						return false;
+				}
+				else if (arg == "--window-ms")
+					settings.mWindowMs = std::strtoul(value.c_str(), nullptr, 10);
+				else if (arg == "--hop-hz")
+					settings.mHopHz = std::strtod(value.c_str(), nullptr);
+				else if (arg == "--fft")
+					settings.mFftSize = std::strtoul(value.c_str(), nullptr, 10);
+				else if (arg == "--max-freq")
+					settings.mMaxFreq = std::strtoul(value.c_str(), nullptr, 10);
+				else if (arg == "--palette")
+				{
+					if (!parsePalette(value, settings.mPalette))
+						return false;
+				}
+				else if (arg == "--max-mag")
+					settings.mMaxMag = static_cast<float>(std::strtod(value.c_str(), nullptr));
+				else if (arg == "--threads")
+					settings.mNumThreads = std::strtoul(value.c_str(), nullptr, 10);
+				else if (arg == "--trace")
+					settings.mTracePath = value;
+				else
+					return false;
+			}
+		}
+		return !jobs.empty() && settings.mWindowMs > 0 && settings.mHopHz > 0.0 && settings.mFftSize > 0 && settings.mMaxFreq > 0;
+	}
+}
+
+} //!cieq
+
+int main(int argc, char** argv)
+{
+	using namespace cieq;
+
+	BatchState state;
+	std::vector<BatchJob> jobs;
+	if (!parseArguments(argc, argv, state.mSettings, jobs))
+	{
+		printUsage();
+		return 2;
+	}
+
+	//Longest first, so the last files to finish are short ones and no core idles at the end
+	for (auto& job : jobs)
+	{
+		job.mSize = fileSize(job.mPath);
+	}
+	std::stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b) { return a.mSize > b.mSize; });
+
+	const auto start = std::chrono::steady_clock::now();
+	{
+		dsp::WorkStealingPool pool(state.mSettings.mNumThreads);
+		state.mAnalyzers.resize(pool.getNumThreads());
+		for (const auto& job : jobs)
+		{
+			const std::string path = job.mPath;
+			pool.submit([&state, &pool, path] { analyzeFile(state, pool.getCurrentWorker(), path); });
+		}
+		pool.wait();
+		std::printf("%zu threads: ", pool.getNumThreads());
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	const double audioSeconds = state.mMilliSecondsAnalyzed / 1000.0;
+
+	std::printf("%zu of %zu files, %.1f s of audio in %.2f s (%.1fx real time)\n",
+		jobs.size() - state.mNumFailed, jobs.size(), audioSeconds, seconds, seconds > 0.0 ? audioSeconds / seconds : 0.0);
+	if (!state.mSettings.mTracePath.empty() && !dsp::Profiler::get().writeChromeTrace(state.mSettings.mTracePath))
+		std::fprintf(stderr, "can't write %s\n", state.mSettings.mTracePath.c_str());
+	return state.mNumFailed == 0 ? 0 : 1;
+}
@@ -0,0 +1,507 @@
+#include "dsp/audio_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	std::uint32_t readLe32(const std::uint8_t* p)
+	{
+		return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) | (std::uint32_t(p[3]) << 24);
+	}
+
+	std::uint16_t readLe16(const std::uint8_t* p)
+	{
+		return static_cast<std::uint16_t>(p[0] | (p[1] << 8));
+	}
+
+	std::uint32_t readBe32(const std::uint8_t* p)
+	{
+		return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) | std::uint32_t(p[3]);
+	}
+
+	std::uint16_t readBe16(const std::uint8_t* p)
+	{
+		return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+	}
+
+	bool matches(const std::uint8_t* p, const char* id)
+	{
+		return std::memcmp(p, id, 4) == 0;
+	}
+
+	//AIFF stores the sample rate as an 80 bit IEEE extended float
+	double readExtended(const std::uint8_t* p)
+	{
+		const int exponent = ((p[0] & 0x7f) << 8) | p[1];
+		std::uint64_t mantissa = 0;
+		for (int i = 0; i < 8; i++)
+			mantissa = (mantissa << 8) | p[2 + i];
+		if (exponent == 0 && mantissa == 0)
+			return 0.0;
+		const double value = std::ldexp(static_cast<double>(mantissa), exponent - 16383 - 63);
+		return (p[0] & 0x80) ? -value : value;
+	}
+
+	std::size_t bytesPerSample(SampleFormat format)
+	{
+		switch (format)
+		{
+		case SampleFormat::UINT8:
+		case SampleFormat::INT8:	return 1;
+		case SampleFormat::INT16:	return 2;
+		case SampleFormat::INT24:	return 3;
+		case SampleFormat::INT32:
+		case SampleFormat::FLOAT32:	return 4;
+		case SampleFormat::FLOAT64:	return 8;
+		}
+		return 0;
+	}
+
+	//Integer formats are scaled by 2^-(bits - 1), full scale negative maps to exactly -1
+	template<SampleFormat Format, bool BigEndian>
+	struct Decoder;
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::UINT8, BigEndian>
+	{
+		static float get(const std::uint8_t* p) { return (static_cast<float>(p[0]) - 128.0f) * (1.0f / 128.0f); }
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::INT8, BigEndian>
+	{
+		static float get(const std::uint8_t* p) { return static_cast<float>(static_cast<std::int8_t>(p[0])) * (1.0f / 128.0f); }
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::INT16, BigEndian>
+	{
+		static float get(const std::uint8_t* p)
+		{
+			const std::uint16_t bits = BigEndian ? readBe16(p) : readLe16(p);
+			return static_cast<float>(static_cast<std::int16_t>(bits)) * (1.0f / 32768.0f);
+		}
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::INT24, BigEndian>
+	{
+		static float get(const std::uint8_t* p)
+		{
+			const std::uint32_t bits = BigEndian
+				? (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8)
+				: (std::uint32_t(p[2]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[0]) << 8);
+			return static_cast<float>(static_cast<std::int32_t>(bits) >> 8) * (1.0f / 8388608.0f);
+		}
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::INT32, BigEndian>
+	{
+		static float get(const std::uint8_t* p)
+		{
+			const std::uint32_t bits = BigEndian ? readBe32(p) : readLe32(p);
+			return static_cast<float>(static_cast<double>(static_cast<std::int32_t>(bits)) * (1.0 / 2147483648.0));
+		}
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::FLOAT32, BigEndian>
+	{
+		static float get(const std::uint8_t* p)
+		{
+			const std::uint32_t bits = BigEndian ? readBe32(p) : readLe32(p);
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	};
+
+	template<bool BigEndian>
+	struct Decoder<SampleFormat::FLOAT64, BigEndian>
+	{
+		static float get(const std::uint8_t* p)
+		{
+			const std::uint64_t high = BigEndian ? readBe32(p) : readLe32(p + 4);
+			const std::uint64_t low = BigEndian ? readBe32(p + 4) : readLe32(p);
+			const std::uint64_t bits = (high << 32) | low;
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return static_cast<float>(value);
+		}
+	};
+
+	//Channel 0 is stored, the others added one at a time and the sum scaled once,
+	//the same order of operations CaptureNode uses on live input
+	template<SampleFormat Format, bool BigEndian>
+	void mixDown(const std::uint8_t* frames, std::size_t count, std::size_t numChannels, std::size_t sampleBytes, float* dest)
+	{
+		const std::size_t frameBytes = numChannels * sampleBytes;
+		for (std::size_t i = 0; i < count; i++)
+			dest[i] = Decoder<Format, BigEndian>::get(frames + i * frameBytes);
+
+		if (numChannels == 1)
+			return;
+
+		for (std::size_t ch = 1; ch < numChannels; ch++)
+		{
+			const std::uint8_t* channel = frames + ch * sampleBytes;
+			for (std::size_t i = 0; i < count; i++)
+				dest[i] += Decoder<Format, BigEndian>::get(channel + i * frameBytes);
+		}
+		const float scale = 1.0f / static_cast<float>(numChannels);
+		for (std::size_t i = 0; i < count; i++)
+			dest[i] *= scale;
+	}
+
+	template<bool BigEndian>
+	void mixDown(SampleFormat format, const std::uint8_t* frames, std::size_t count, std::size_t numChannels, std::size_t sampleBytes, float* dest)
+	{
+		switch (format)
+		{
+		case SampleFormat::UINT8:	mixDown<SampleFormat::UINT8, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::INT8:	mixDown<SampleFormat::INT8, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::INT16:	mixDown<SampleFormat::INT16, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::INT24:	mixDown<SampleFormat::INT24, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::INT32:	mixDown<SampleFormat::INT32, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::FLOAT32:	mixDown<SampleFormat::FLOAT32, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		case SampleFormat::FLOAT64:	mixDown<SampleFormat::FLOAT64, BigEndian>(frames, count, numChannels, sampleBytes, dest); break;
+		}
+	}
+}
+
+MappedFile::MappedFile()
+	: mData(nullptr)
+	, mSize(0)
+#if defined(_WIN32)
+	, mFileHandle(INVALID_HANDLE_VALUE)
+	, mMappingHandle(nullptr)
+#endif
+{}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#if defined(_WIN32)
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	mFileHandle = file;
+	mMappingHandle = mapping;
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = static_cast<std::size_t>(size.QuadPart);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		UnmapViewOfFile(mData);
+	if (mMappingHandle)
+		CloseHandle(mMappingHandle);
+	if (mFileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(mFileHandle);
+
+	mData = nullptr;
+	mSize = 0;
+	mMappingHandle = nullptr;
+	mFileHandle = INVALID_HANDLE_VALUE;
+}
+#else
+bool MappedFile::open(const std::string& path)
+{
+	close();
+
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, static_cast<std::size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	//The mapping keeps the file alive on its own
+	::close(fd);
+	if (view == MAP_FAILED)
+		return false;
+
+	//Analysis walks the file front to back
+	madvise(view, static_cast<std::size_t>(info.st_size), MADV_SEQUENTIAL);
+
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = static_cast<std::size_t>(info.st_size);
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (mData)
+		munmap(const_cast<std::uint8_t*>(mData), mSize);
+
+	mData = nullptr;
+	mSize = 0;
+}
+#endif
+
+AudioFile::AudioFile()
+	: mSamples(nullptr)
+	, mBytesPerSample(0)
+	, mNumFrames(0)
+{}
+
+bool AudioFile::open(const std::string& path)
+{
+	mSamples = nullptr;
+	mNumFrames = 0;
+	if (!mFile.open(path))
+		return fail("can't open " + path);
+
+	const std::uint8_t* data = mFile.getData();
+	if (mFile.getSize() >= 12 && matches(data, "RIFF") && matches(data + 8, "WAVE"))
+		return parseWav();
+	if (mFile.getSize() >= 12 && matches(data, "FORM") && (matches(data + 8, "AIFF") || matches(data + 8, "AIFC")))
+		return parseAiff();
+
+	return fail(path + " is neither WAV nor AIFF, use openRaw() for headerless PCM");
+}
+
+bool AudioFile::openRaw(const std::string& path, const RawFormat& format)
+{
+	mSamples = nullptr;
+	mNumFrames = 0;
+	if (!mFile.open(path))
+		return fail("can't open " + path);
+	if (format.mNumChannels == 0 || format.mSampleRate == 0)
+		return fail("raw format needs at least one channel and a sample rate");
+	if (format.mHeaderBytes >= mFile.getSize())
+		return fail("raw header is longer than the file");
+
+	mFormat = format;
+	mBytesPerSample = bytesPerSample(format.mSampleFormat);
+	mSamples = mFile.getData() + format.mHeaderBytes;
+	mNumFrames = (mFile.getSize() - format.mHeaderBytes) / (mBytesPerSample * format.mNumChannels);
+	mError.clear();
+	return true;
+}
+
+bool AudioFile::parseWav()
+{
+	const std::uint8_t* data = mFile.getData();
+	const std::size_t size = mFile.getSize();
+
+	bool haveFormat = false;
+	std::size_t pos = 12;
+	while (pos + 8 <= size)
+	{
+		const std::uint8_t* chunk = data + pos;
+		const std::size_t chunkSize = readLe32(chunk + 4);
+		const std::uint8_t* body = chunk + 8;
+
+		if (matches(chunk, "fmt ") && chunkSize >= 16 && pos + 8 + 16 <= size)
+		{
+			std::uint16_t tag = readLe16(body);
+			const std::size_t bits = readLe16(body + 14);
+			//WAVE_FORMAT_EXTENSIBLE keeps the real tag at the start of the sub format GUID
+			if (tag == 0xfffe && chunkSize >= 40 && pos + 8 + 40 <= size)
+				tag = readLe16(body + 24);
+
+			mFormat = RawFormat();
+			mFormat.mNumChannels = readLe16(body + 2);
+			mFormat.mSampleRate = readLe32(body + 4);
+			if (tag == 1 && bits == 8)
+				mFormat.mSampleFormat = SampleFormat::UINT8;
+			else if (tag == 1 && bits == 16)
+				mFormat.mSampleFormat = SampleFormat::INT16;
+			else if (tag == 1 && bits == 24)
+				mFormat.mSampleFormat = SampleFormat::INT24;
+			else if (tag == 1 && bits == 32)
+				mFormat.mSampleFormat = SampleFormat::INT32;
+			else if (tag == 3 && bits == 32)
+				mFormat.mSampleFormat = SampleFormat::FLOAT32;
+			else if (tag == 3 && bits == 64)
+				mFormat.mSampleFormat = SampleFormat::FLOAT64;
+			else
+				return fail("unsupported WAV encoding");
+			haveFormat = true;
+		}
+		else if (matches(chunk, "data"))
+		{
+			if (!haveFormat)
+				return fail("WAV data chunk before its fmt chunk");
+			if (mFormat.mNumChannels == 0 || mFormat.mSampleRate == 0)
+				return fail("WAV header has no channels or no sample rate");
+
+			//Recorders that were killed leave the size at 0 or 0xffffffff, take what is there
+			const std::size_t available = size - (pos + 8);
+			const std::size_t dataSize = (chunkSize == 0 || chunkSize > available) ? available : chunkSize;
+			mBytesPerSample = bytesPerSample(mFormat.mSampleFormat);
+			mSamples = body;
+			mNumFrames = dataSize / (mBytesPerSample * mFormat.mNumChannels);
+			mError.clear();
+			return true;
+		}
+
+		//Chunks are padded to an even size
+		pos += 8 + chunkSize + (chunkSize & 1);
+	}
+
+	return fail("WAV file has no data chunk");
+}
+
+bool AudioFile::parseAiff()
+{
+	const std::uint8_t* data = mFile.getData();
+	const std::size_t size = mFile.getSize();
+	const bool compressed = matches(data + 8, "AIFC");
+
+	//COMM may legally come after the sound data, so find both chunks first
+	std::size_t commPos = 0;
+	std::size_t ssndPos = 0;
+	for (std::size_t pos = 12; pos + 8 <= size;)
+	{
+		const std::size_t chunkSize = readBe32(data + pos + 4);
+		if (matches(data + pos, "COMM"))
+			commPos = pos;
+		else if (matches(data + pos, "SSND"))
+			ssndPos = pos;
+		pos += 8 + chunkSize + (chunkSize & 1);
+	}
+
+	if (commPos == 0 || commPos + 8 + 18 > size || readBe32(data + commPos + 4) < 18)
+		return fail("AIFF file has no COMM chunk");
+	if (ssndPos == 0 || ssndPos + 16 > size)
+		return fail("AIFF file has no SSND chunk");
+
+	const std::uint8_t* comm = data + commPos + 8;
+	mFormat = RawFormat();
+	mFormat.mNumChannels = readBe16(comm);
+	mFormat.mSampleRate = static_cast<std::size_t>(readExtended(comm + 8) + 0.5);
+	mFormat.mBigEndian = true;
+	if (mFormat.mNumChannels == 0 || mFormat.mSampleRate == 0)
+		return fail("AIFF header has no channels or no sample rate");
+
+	const std::size_t bits = readBe16(comm + 6);
+	const char* compression = "NONE";
+	if (compressed && readBe32(data + commPos + 4) >= 22 && commPos + 8 + 22 <= size)
+		compression = reinterpret_cast<const char*>(comm + 18);
+
+	if (std::memcmp(compression, "NONE", 4) == 0 || std::memcmp(compression, "twos", 4) == 0 || std::memcmp(compression, "sowt", 4) == 0)
+	{
+		mFormat.mBigEndian = std::memcmp(compression, "sowt", 4) != 0;
+		if (bits == 8)
+			mFormat.mSampleFormat = SampleFormat::INT8;
+		else if (bits == 16)
+			mFormat.mSampleFormat = SampleFormat::INT16;
+		else if (bits == 24)
+			mFormat.mSampleFormat = SampleFormat::INT24;
+		else if (bits == 32)
+			mFormat.mSampleFormat = SampleFormat::INT32;
+		else
+			return fail("unsupported AIFF sample size");
+	}
+	else if (std::memcmp(compression, "fl32", 4) == 0 || std::memcmp(compression, "FL32", 4) == 0)
+		mFormat.mSampleFormat = SampleFormat::FLOAT32;
+	else if (std::memcmp(compression, "fl64", 4) == 0 || std::memcmp(compression, "FL64", 4) == 0)
+		mFormat.mSampleFormat = SampleFormat::FLOAT64;
+	else
+		return fail("unsupported AIFF-C compression");
+
+	//SSND starts with an offset to the first sample and a block size nobody uses
+	const std::size_t chunkSize = readBe32(data + ssndPos + 4);
+	const std::size_t offset = readBe32(data + ssndPos + 8);
+	const std::size_t start = ssndPos + 16 + offset;
+	if (start > size)
+		return fail("AIFF sound data starts past the end of the file");
+
+	const std::size_t available = size - start;
+	const std::size_t dataSize = (chunkSize < 8 + offset) ? 0 : std::min(chunkSize - 8 - offset, available);
+	mBytesPerSample = bytesPerSample(mFormat.mSampleFormat);
+	mSamples = data + start;
+	mNumFrames = dataSize / (mBytesPerSample * mFormat.mNumChannels);
+	mError.clear();
+	return true;
+}
+
+bool AudioFile::fail(const std::string& error)
+{
+	mSamples = nullptr;
+	mNumFrames = 0;
+	mError = error;
+	return false;
+}
+
+std::size_t AudioFile::readMono(std::size_t firstFrame, std::size_t count, float* dest) const
+{
+	const std::size_t available = firstFrame < mNumFrames ? std::min(count, mNumFrames - firstFrame) : 0;
+	if (available > 0)
+	{
+		const std::size_t frameBytes = mBytesPerSample * mFormat.mNumChannels;
+		const std::uint8_t* frames = mSamples + firstFrame * frameBytes;
+		if (mFormat.mBigEndian)
+			mixDown<true>(mFormat.mSampleFormat, frames, available, mFormat.mNumChannels, mBytesPerSample, dest);
+		else
+			mixDown<false>(mFormat.mSampleFormat, frames, available, mFormat.mNumChannels, mBytesPerSample, dest);
+	}
+	std::fill(dest + available, dest + count, 0.0f);
+	return available;
+}
+
+double AudioFile::getDurationSeconds() const
+{
+	return mFormat.mSampleRate ? static_cast<double>(mNumFrames) / static_cast<double>(mFormat.mSampleRate) : 0.0;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,267 @@
+#include "dsp/bin_range_spectrum.h"
+#include "dsp/fft_wisdom.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	const double kPi = 3.14159265358979323846264338327950288;
+
+	//Methods estimated more than this many times the cheapest one aren't worth timing
+	const std::size_t kMeasureRange = 4;
+	const std::size_t kMeasureRuns = 3;
+
+	//Best of a few runs on a noise frame, after one run to fault in the buffers
+	double timeMethod(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method method)
+	{
+		BinRangeSpectrum spectrum;
+		spectrum.setup(fftSize, windowSize, firstBin, numBins, method);
+		std::vector<float> frame(windowSize);
+		std::mt19937 noise(1);
+		std::uniform_real_distribution<float> amplitude(-1.0f, 1.0f);
+		for (float& sample : frame)
+			sample = amplitude(noise);
+		std::vector<float> magnitudes(spectrum.getNumBins());
+
+		spectrum.computeMagnitudes(frame.data(), magnitudes.data());
+		double best = std::numeric_limits<double>::max();
+		for (std::size_t run = 0; run < kMeasureRuns; run++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			spectrum.computeMagnitudes(frame.data(), magnitudes.data());
+			best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		return best;
+	}
+
+	inline Complex mul(const Complex& a, const Complex& b)
+	{
+		return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+}
+
+BinRangeSpectrum::BinRangeSpectrum()
+	: mMethod(Method::PRUNED_FFT)
+	, mFftSize(0)
+	, mWindowSize(0)
+	, mFirstBin(0)
+	, mNumBins(0)
+	, mChirpSize(0)
+{}
+
+void BinRangeSpectrum::setup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins)
+{
+	setup(fftSize, windowSize, firstBin, numBins, Method::PRUNED_FFT);
+	if (mNumBins == 0 || mWindowSize == 0)
+		return;
+
+	//A method measured fastest on this machine before beats any estimate, and saves planning the others
+	FftWisdom& wisdom = FftWisdom::get();
+	Method method = Method::PRUNED_FFT;
+	if (wisdom.lookup(mFftSize, mWindowSize, mFirstBin, mNumBins, method))
+	{
+		if (method != Method::PRUNED_FFT)
+			setup(fftSize, windowSize, firstBin, numBins, method);
+		return;
+	}
+
+	//Plan the other two as well and keep whichever is expected to be cheapest
+	const std::size_t prunedCost = mRealFft->estimateCost(mWindowSize);
+	setupChirpZ();
+	const std::size_t chirpCost = estimateChirpZCost();
+	const std::size_t goertzelCost = estimateGoertzelCost();
+
+	if (goertzelCost <= prunedCost && goertzelCost <= chirpCost)
+		method = Method::GOERTZEL;
+	else if (chirpCost < prunedCost)
+		method = Method::CHIRP_Z;
+
+	if (wisdom.isMeasuring())
+	{
+		//Estimates ignore caches and vectorization, so time every method they put within reach
+		const std::size_t bestCost = std::min(prunedCost, std::min(chirpCost, goertzelCost));
+		const std::size_t costs[] = { prunedCost, chirpCost, goertzelCost };
+		const Method methods[] = { Method::PRUNED_FFT, Method::CHIRP_Z, Method::GOERTZEL };
+		double fastest = std::numeric_limits<double>::max();
+		for (std::size_t i = 0; i < 3; i++)
+		{
+			if (costs[i] > kMeasureRange * bestCost)
+				continue;
+
+			const double seconds = timeMethod(mFftSize, mWindowSize, mFirstBin, mNumBins, methods[i]);
+			if (seconds < fastest)
+			{
+				fastest = seconds;
+				method = methods[i];
+			}
+		}
+		wisdom.record(mFftSize, mWindowSize, mFirstBin, mNumBins, method);
+	}
+
+	setup(fftSize, windowSize, firstBin, numBins, method);
+}
+
+void BinRangeSpectrum::setup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, Method method)
+{
+	mFftSize = fftSize;
+	mWindowSize = std::min(windowSize, fftSize);
+	mFirstBin = std::min(firstBin, fftSize / 2);
+	mNumBins = std::min(numBins, fftSize / 2 - mFirstBin);
+	mMethod = method;
+
+	mRealFft.reset();
+	mSpectrum.clear();
+	mChirpForward.reset();
+	mChirpInverse.reset();
+	mChirpKernel.reset();
+	mChirpBuffer.clear();
+	mChirpSize = 0;
+	mCoefficients.clear();
+
+	switch (mMethod)
+	{
+	case Method::PRUNED_FFT:	setupPrunedFft(); break;
+	case Method::CHIRP_Z:		setupChirpZ(); break;
+	case Method::GOERTZEL:		setupGoertzel(); break;
+	}
+}
+
+void BinRangeSpectrum::computeMagnitudes(const float* windowed, float* magnitudes)
+{
+	switch (mMethod)
+	{
+	case Method::PRUNED_FFT:	computePrunedFft(windowed, magnitudes); break;
+	case Method::CHIRP_Z:		computeChirpZ(windowed, magnitudes); break;
+	case Method::GOERTZEL:		computeGoertzel(windowed, magnitudes); break;
+	}
+}
+
+const char* BinRangeSpectrum::getMethodName(Method method)
+{
+	switch (method)
+	{
+	case Method::PRUNED_FFT:	return "pruned FFT";
+	case Method::CHIRP_Z:		return "chirp-z";
+	case Method::GOERTZEL:		return "Goertzel";
+	}
+	return "";
+}
+
+void BinRangeSpectrum::setupPrunedFft()
+{
+	mRealFft.reset(new RealFft(mFftSize));
+	mRealFft->setOutputBins(mFirstBin, mNumBins);
+	mSpectrum.assign(mNumBins, Complex(0.0f, 0.0f));
+}
+
+void BinRangeSpectrum::setupChirpZ()
+{
+	//The chirps depend on the geometry only, so analyzers of the same one share them
+	mChirpKernel = PlanCache::get().getChirpZKernel(mFftSize, mWindowSize, mFirstBin, mNumBins);
+	mChirpSize = mChirpKernel->mChirpSize;
+
+	//Both sides of the product stay in bit-reversed order, only the result gets reordered
+	mChirpForward.reset(new ComplexFft(mChirpSize));
+
+	mChirpInverse.reset(new ComplexFft(mChirpSize));
+	std::vector<std::uint8_t> needed(mChirpSize, 0);
+	std::fill(needed.begin(), needed.begin() + mNumBins, 1);
+	mChirpInverse->setOutputMask(needed);
+
+	mChirpBuffer.assign(mChirpSize, Complex(0.0f, 0.0f));
+}
+
+void BinRangeSpectrum::setupGoertzel()
+{
+	mCoefficients.resize(mNumBins);
+	for (std::size_t i = 0; i < mNumBins; i++)
+		mCoefficients[i] = 2.0 * std::cos(2.0 * kPi * static_cast<double>(mFirstBin + i) / static_cast<double>(mFftSize));
+}
+
+std::size_t BinRangeSpectrum::estimateChirpZCost() const
+{
+	//Pre-chirp, both transforms, the spectral product and its reordering
+	const std::size_t transforms = mChirpForward->countOperations(mWindowSize) + mChirpInverse->countOperations(mChirpSize);
+	return 6 * mWindowSize + 6 * transforms + 8 * mChirpSize + 4 * mNumBins;
+}
+
+std::size_t BinRangeSpectrum::estimateGoertzelCost() const
+{
+	//The recursion is serial and in double precision, so each step costs about its latency
+	//rather than its 3 flops. Timed against the FFT based methods (bin_range_bench) a step
+	//comes out at about 12 of their estimated operations.
+	return 12 * mWindowSize * mNumBins + 8 * mNumBins;
+}
+
+void BinRangeSpectrum::computePrunedFft(const float* windowed, float* magnitudes)
+{
+	//RealFft only reads the first mWindowSize samples, the zero padding is implicit
+	mRealFft->forward(windowed, mWindowSize, mSpectrum.data());
+
+	const float magScale = 1.0f / static_cast<float>(mFftSize);
+	for (std::size_t i = 0; i < mNumBins; i++)
+	{
+		const float re = mSpectrum[i].real();
+		const float im = mSpectrum[i].imag();
+		magnitudes[i] = std::sqrt(re * re + im * im) * magScale;
+	}
+}
+
+void BinRangeSpectrum::computeChirpZ(const float* windowed, float* magnitudes)
+{
+	const Complex* preChirp = mChirpKernel->mPreChirp.data();
+	const Complex* response = mChirpKernel->mResponse.data();
+	for (std::size_t n = 0; n < mWindowSize; n++)
+		mChirpBuffer[n] = preChirp[n] * windowed[n];
+	std::fill(mChirpBuffer.begin() + mWindowSize, mChirpBuffer.end(), Complex(0.0f, 0.0f));
+
+	//The inverse transform is conj(FFT(conj(Y))), conjugating commutes with the reordering
+	mChirpForward->forwardBitReversed(mChirpBuffer.data(), mWindowSize);
+	for (std::size_t i = 0; i < mChirpSize; i++)
+		mChirpBuffer[i] = std::conj(mul(mChirpBuffer[i], response[i]));
+	for (std::size_t i = 0; i < mChirpSize; i++)
+	{
+		const std::size_t j = mChirpForward->getBitReverse(i);
+		if (i < j)
+			std::swap(mChirpBuffer[i], mChirpBuffer[j]);
+	}
+	mChirpInverse->forwardBitReversed(mChirpBuffer.data());
+
+	//1 / chirp size undoes the inverse transform, 1 / fftSize matches the full spectrum
+	const float magScale = 1.0f / (static_cast<float>(mChirpSize) * static_cast<float>(mFftSize));
+	for (std::size_t m = 0; m < mNumBins; m++)
+		magnitudes[m] = std::abs(mChirpBuffer[mChirpInverse->getBitReverse(m)]) * magScale;
+}
+
+void BinRangeSpectrum::computeGoertzel(const float* windowed, float* magnitudes)
+{
+	//Double precision, a float recursion drifts noticeably over a 500 ms window
+	const double magScale = 1.0 / static_cast<double>(mFftSize);
+	for (std::size_t i = 0; i < mNumBins; i++)
+	{
+		const double coefficient = mCoefficients[i];
+		double s1 = 0.0;
+		double s2 = 0.0;
+		for (std::size_t n = 0; n < mWindowSize; n++)
+		{
+			const double s = windowed[n] + coefficient * s1 - s2;
+			s2 = s1;
+			s1 = s;
+		}
+		const double power = s1 * s1 + s2 * s2 - coefficient * s1 * s2;
+		magnitudes[i] = static_cast<float>(std::sqrt(std::max(0.0, power)) * magScale);
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,358 @@
+#include "dsp/colormap.h"
+
+#include <algorithm>
+#include <cstring>
+
+//The SIMD paths are only built for 64 bit x86, where SSE2 is always there. AVX2
+//is compiled per function and picked at run time, no global compiler flags needed.
+#if defined(_MSC_VER) && defined(_M_X64)
+#	define CIEQ_COLORMAP_X86_64 1
+#	define CIEQ_TARGET_AVX2
+#	include <intrin.h>
+#	include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#	define CIEQ_COLORMAP_X86_64 1
+#	define CIEQ_TARGET_AVX2 __attribute__((target("avx2")))
+#	include <immintrin.h>
+#endif
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! matplotlib's viridis sampled at v = 0, 0.1, ..., 1, linearly interpolated in between
+	const float kViridis[11][3] = {
+		{ 0.267f, 0.005f, 0.329f },
+		{ 0.283f, 0.141f, 0.458f },
+		{ 0.254f, 0.265f, 0.530f },
+		{ 0.207f, 0.372f, 0.553f },
+		{ 0.164f, 0.471f, 0.558f },
+		{ 0.128f, 0.567f, 0.551f },
+		{ 0.135f, 0.659f, 0.518f },
+		{ 0.267f, 0.749f, 0.441f },
+		{ 0.478f, 0.821f, 0.318f },
+		{ 0.741f, 0.873f, 0.150f },
+		{ 0.993f, 0.906f, 0.144f }
+	};
+
+	//! A Matlab "Jet" palleted color composition, the same ramps SpectrogramPlot used to compute per pixel.
+	//! \note original work: http://paulbourke.net/texture_colour/colourspace/
+	//! \note taken from: http://stackoverflow.com/a/7811134/1055628
+	void jet(float v, float* rgb)
+	{
+		rgb[0] = rgb[1] = rgb[2] = 1.0f;
+		if (v < 0.25f) {
+			rgb[0] = 0.0f;
+			rgb[1] = 4.0f * v;
+		}
+		else if (v < 0.5f) {
+			rgb[0] = 0.0f;
+			rgb[2] = 1.0f + 4.0f * (0.25f - v);
+		}
+		else if (v < 0.75f) {
+			rgb[0] = 4.0f * (v - 0.5f);
+			rgb[2] = 0.0f;
+		}
+		else {
+			rgb[1] = 1.0f + 4.0f * (0.75f - v);
+			rgb[2] = 0.0f;
+		}
+	}
+
+	void viridis(float v, float* rgb)
+	{
+		const float position = v * 10.0f;
+		const std::size_t index = std::min(static_cast<std::size_t>(position), std::size_t(9));
+		const float frac = position - static_cast<float>(index);
+		for (int c = 0; c < 3; c++)
+			rgb[c] = kViridis[index][c] + frac * (kViridis[index + 1][c] - kViridis[index][c]);
+	}
+}
+
+void paletteColor(Palette palette, float v, float* rgb)
+{
+	v = std::min(std::max(v, 0.0f), 1.0f);
+	switch (palette)
+	{
+	case Palette::JET:
+		jet(v, rgb);
+		break;
+	case Palette::VIRIDIS:
+		viridis(v, rgb);
+		break;
+	case Palette::GRAYSCALE:
+	default:
+		rgb[0] = rgb[1] = rgb[2] = v;
+		break;
+	}
+}
+
+void generatePalette(Palette palette, float* rgb, std::size_t numEntries)
+{
+	const float step = numEntries > 1 ? 1.0f / static_cast<float>(numEntries - 1) : 0.0f;
+	for (std::size_t i = 0; i < numEntries; i++)
+		paletteColor(palette, static_cast<float>(i) * step, rgb + 3 * i);
+}
+
+const char* getPaletteName(Palette palette)
+{
+	switch (palette)
+	{
+	case Palette::JET:			return "Jet";
+	case Palette::VIRIDIS:		return "Viridis";
+	case Palette::GRAYSCALE:	return "Grayscale";
+	}
+	return "";
+}
+
+namespace
+{
+	//! magnitudes below this are 0 dB, like ci::audio::linearToDecibel
+	const float kMinDecibelMagnitude = 1.0e-5f;
+	//! 20 log10(x) = kDecibelsPerOctave * log2(x)
+	const float kDecibelsPerOctave = 6.0205999f;
+	const float kDecibelOffset = 100.0f;
+	//! log2(1 + t) ~ t * (c1 + t * (c2 + t * (c3 + t * c4))) on [0, 1), exact at both ends
+	const float kLog2C1 = 1.4380732f;
+	const float kLog2C2 = -0.6747667f;
+	const float kLog2C3 = 0.3170007f;
+	const float kLog2C4 = -0.0803073f;
+
+	//! how a row is scaled, shared by all code paths
+	struct RowScale
+	{
+		bool	mDecibels;
+		float	mGain;		// maxMag in linear mode, 1 / maxMag in dB mode
+		float	mIndexScale;	// number of entries - 1
+	};
+
+	std::uint32_t packRgba8(const float* rgb)
+	{
+		std::uint32_t packed = 0xff000000u;
+		for (int c = 0; c < 3; c++)
+			packed |= static_cast<std::uint32_t>(std::min(std::max(rgb[c], 0.0f), 1.0f) * 255.0f + 0.5f) << (8 * c);
+		return packed;
+	}
+
+	inline float fastLog2(float x)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &x, sizeof(bits));
+		const float exponent = static_cast<float>(static_cast<int>((bits >> 23) & 0xff) - 127);
+		bits = (bits & 0x007fffffu) | 0x3f800000u;
+		float mantissa;
+		std::memcpy(&mantissa, &bits, sizeof(mantissa));
+		const float t = mantissa - 1.0f;
+		return exponent + t * (kLog2C1 + t * (kLog2C2 + t * (kLog2C3 + t * kLog2C4)));
+	}
+
+	inline std::uint32_t mapScalar(const std::uint32_t* lut, const RowScale& scale, float magnitude)
+	{
+		float value;
+		if (scale.mDecibels)
+		{
+			const float decibels = kDecibelsPerOctave * fastLog2(std::max(magnitude, kMinDecibelMagnitude)) + kDecibelOffset;
+			value = (magnitude >= kMinDecibelMagnitude ? decibels : 0.0f) * scale.mGain;
+		}
+		else
+		{
+			value = magnitude * scale.mGain;
+		}
+		//Zero first, so a NaN ends up at 0 like with the SIMD max/min
+		value = std::min(std::max(0.0f, value), 1.0f);
+		return lut[static_cast<int>(value * scale.mIndexScale + 0.5f)];
+	}
+
+	void mapRowScalar(const std::uint32_t* lut, const RowScale& scale, const float* magnitudes, std::size_t count, std::uint32_t* rgba)
+	{
+		for (std::size_t i = 0; i < count; i++)
+			rgba[i] = mapScalar(lut, scale, magnitudes[i]);
+	}
+
+#if defined(CIEQ_COLORMAP_X86_64)
+	bool cpuHasAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 1);
+		//AVX state has to be enabled by the OS as well (OSXSAVE, then XCR0 bits 1 and 2)
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+
+	void mapRowSse2(const std::uint32_t* lut, const RowScale& scale, const float* magnitudes, std::size_t count, std::uint32_t* rgba)
+	{
+		const __m128 gain = _mm_set1_ps(scale.mGain);
+		const __m128 indexScale = _mm_set1_ps(scale.mIndexScale);
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 minMagnitude = _mm_set1_ps(kMinDecibelMagnitude);
+		const __m128i exponentMask = _mm_set1_epi32(0xff);
+		const __m128i exponentBias = _mm_set1_epi32(127);
+		const __m128i mantissaMask = _mm_set1_epi32(0x007fffff);
+		const __m128i oneBits = _mm_set1_epi32(0x3f800000);
+
+		std::size_t i = 0;
+		alignas(16) std::int32_t indices[4];
+		for (; i + 4 <= count; i += 4)
+		{
+			const __m128 magnitude = _mm_loadu_ps(magnitudes + i);
+			__m128 value;
+			if (scale.mDecibels)
+			{
+				const __m128i bits = _mm_castps_si128(_mm_max_ps(magnitude, minMagnitude));
+				const __m128 exponent = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_and_si128(_mm_srli_epi32(bits, 23), exponentMask), exponentBias));
+				const __m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, mantissaMask), oneBits)), one);
+				__m128 poly = _mm_add_ps(_mm_set1_ps(kLog2C3), _mm_mul_ps(t, _mm_set1_ps(kLog2C4)));
+				poly = _mm_add_ps(_mm_set1_ps(kLog2C2), _mm_mul_ps(t, poly));
+				poly = _mm_add_ps(_mm_set1_ps(kLog2C1), _mm_mul_ps(t, poly));
+				const __m128 log2 = _mm_add_ps(exponent, _mm_mul_ps(t, poly));
+				const __m128 decibels = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(kDecibelsPerOctave), log2), _mm_set1_ps(kDecibelOffset));
+				//Below the floor the dB value is 0, blend without a branch
+				const __m128 audible = _mm_cmpge_ps(magnitude, minMagnitude);
+				value = _mm_mul_ps(_mm_and_ps(audible, decibels), gain);
+			}
+			else
+			{
+				value = _mm_mul_ps(magnitude, gain);
+			}
+			value = _mm_min_ps(_mm_max_ps(value, zero), one);
+			_mm_store_si128(reinterpret_cast<__m128i*>(indices), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, indexScale), half)));
+
+			//No gather before AVX2
+			rgba[i] = lut[indices[0]];
+			rgba[i + 1] = lut[indices[1]];
+			rgba[i + 2] = lut[indices[2]];
+			rgba[i + 3] = lut[indices[3]];
+		}
+		mapRowScalar(lut, scale, magnitudes + i, count - i, rgba + i);
+	}
+
+	CIEQ_TARGET_AVX2 void mapRowAvx2(const std::uint32_t* lut, const RowScale& scale, const float* magnitudes, std::size_t count, std::uint32_t* rgba)
+	{
+		const __m256 gain = _mm256_set1_ps(scale.mGain);
+		const __m256 indexScale = _mm256_set1_ps(scale.mIndexScale);
+		const __m256 half = _mm256_set1_ps(0.5f);
+		const __m256 zero = _mm256_setzero_ps();
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 minMagnitude = _mm256_set1_ps(kMinDecibelMagnitude);
+		const __m256i exponentMask = _mm256_set1_epi32(0xff);
+		const __m256i exponentBias = _mm256_set1_epi32(127);
+		const __m256i mantissaMask = _mm256_set1_epi32(0x007fffff);
+		const __m256i oneBits = _mm256_set1_epi32(0x3f800000);
+		const int* table = reinterpret_cast<const int*>(lut);
+
+		std::size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const __m256 magnitude = _mm256_loadu_ps(magnitudes + i);
+			__m256 value;
+			if (scale.mDecibels)
+			{
+				//Same operations in the same order as the SSE2 path (no FMA), so both agree bit for bit
+				const __m256i bits = _mm256_castps_si256(_mm256_max_ps(magnitude, minMagnitude));
+				const __m256 exponent = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_and_si256(_mm256_srli_epi32(bits, 23), exponentMask), exponentBias));
+				const __m256 t = _mm256_sub_ps(_mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, mantissaMask), oneBits)), one);
+				__m256 poly = _mm256_add_ps(_mm256_set1_ps(kLog2C3), _mm256_mul_ps(t, _mm256_set1_ps(kLog2C4)));
+				poly = _mm256_add_ps(_mm256_set1_ps(kLog2C2), _mm256_mul_ps(t, poly));
+				poly = _mm256_add_ps(_mm256_set1_ps(kLog2C1), _mm256_mul_ps(t, poly));
+				const __m256 log2 = _mm256_add_ps(exponent, _mm256_mul_ps(t, poly));
+				const __m256 decibels = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(kDecibelsPerOctave), log2), _mm256_set1_ps(kDecibelOffset));
+				const __m256 audible = _mm256_cmp_ps(magnitude, minMagnitude, _CMP_GE_OQ);
+				value = _mm256_mul_ps(_mm256_and_ps(audible, decibels), gain);
+			}
+			else
+			{
+				value = _mm256_mul_ps(magnitude, gain);
+			}
+			value = _mm256_min_ps(_mm256_max_ps(value, zero), one);
+			const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(value, indexScale), half));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(rgba + i), _mm256_i32gather_epi32(table, index, 4));
+		}
+		mapRowScalar(lut, scale, magnitudes + i, count - i, rgba + i);
+	}
+#endif
+}
+
+SimdLevel getSupportedSimdLevel()
+{
+#if defined(CIEQ_COLORMAP_X86_64)
+	static const SimdLevel level = cpuHasAvx2() ? SimdLevel::AVX2 : SimdLevel::SSE2;
+	return level;
+#else
+	return SimdLevel::SCALAR;
+#endif
+}
+
+const char* getSimdLevelName(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::SCALAR:	return "scalar";
+	case SimdLevel::SSE2:	return "SSE2";
+	case SimdLevel::AVX2:	return "AVX2";
+	}
+	return "";
+}
+
+ColormapLut::ColormapLut()
+	: mPalette(Palette::JET)
+	, mSimdLevel(getSupportedSimdLevel())
+{
+	setup(mPalette);
+}
+
+void ColormapLut::setup(Palette palette, std::size_t numEntries /*= kDefaultSize*/)
+{
+	mPalette = palette;
+	numEntries = std::max<std::size_t>(numEntries, 2);
+
+	std::vector<float> rgb(3 * numEntries);
+	generatePalette(palette, rgb.data(), numEntries);
+	mEntries.resize(numEntries);
+	for (std::size_t i = 0; i < numEntries; i++)
+		mEntries[i] = packRgba8(&rgb[3 * i]);
+}
+
+void ColormapLut::setSimdLevel(SimdLevel level)
+{
+	mSimdLevel = std::min(level, getSupportedSimdLevel());
+}
+
+void ColormapLut::mapRow(const float* magnitudes, std::size_t count, float maxMag, bool dbMode, std::uint32_t* rgba) const
+{
+	RowScale scale;
+	scale.mDecibels = dbMode;
+	scale.mGain = dbMode ? 1.0f / maxMag : maxMag;
+	scale.mIndexScale = static_cast<float>(mEntries.size() - 1);
+
+	switch (mSimdLevel)
+	{
+#if defined(CIEQ_COLORMAP_X86_64)
+	case SimdLevel::AVX2:
+		mapRowAvx2(mEntries.data(), scale, magnitudes, count, rgba);
+		return;
+	case SimdLevel::SSE2:
+		mapRowSse2(mEntries.data(), scale, magnitudes, count, rgba);
+		return;
+#endif
+	default:
+		mapRowScalar(mEntries.data(), scale, magnitudes, count, rgba);
+		return;
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,172 @@
+#include "dsp/fft.h"
+#include "dsp/plan_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//Spelled out, std::complex operator* does inf/nan recovery we don't need
+	inline Complex mul(const Complex& a, const Complex& b)
+	{
+		return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+}
+
+ComplexFft::ComplexFft(std::size_t size)
+	: mSize(size)
+	, mTwiddles(PlanCache::get().getTwiddles(size))
+	, mBitReverse(PlanCache::get().getBitReverse(size))
+{}
+
+void ComplexFft::forward(Complex* data, std::size_t numNonZero) const
+{
+	forwardBitReversed(data, numNonZero);
+
+	const std::size_t* bitReverse = mBitReverse->data();
+	for (std::size_t i = 0; i < mSize; i++)
+	{
+		const std::size_t j = bitReverse[i];
+		if (i < j)
+			std::swap(data[i], data[j]);
+	}
+}
+
+void ComplexFft::forwardBitReversed(Complex* data, std::size_t numNonZero) const
+{
+	//Decimation in frequency: natural order in, bit-reversed order out. While a
+	//block's non-zero prefix fits in its first half, the second half of every
+	//butterfly is zero, so a = a and b = a * w, and nothing past the prefix is touched.
+	//With an output mask, a block half that feeds no needed output is never written.
+	const bool pruneOutput = !mNeeded.empty();
+	const Complex* twiddles = mTwiddles->data();
+	std::size_t prefix = std::min(numNonZero, mSize);
+	for (std::size_t half = mSize >> 1; half >= 1; half >>= 1)
+	{
+		const std::size_t twiddleStride = mSize / (half << 1);
+		const std::size_t level = mSize / half;
+		for (std::size_t start = 0, block = 0; start < mSize; start += (half << 1), block++)
+		{
+			const bool needA = !pruneOutput || mNeeded[level + 2 * block];
+			const bool needB = !pruneOutput || mNeeded[level + 2 * block + 1];
+			if (!needA && !needB)
+				continue;
+
+			Complex* a = data + start;
+			Complex* b = a + half;
+			if (prefix <= half)
+			{
+				if (!needB)
+					continue;
+				for (std::size_t k = 0; k < prefix; k++)
+				{
+					b[k] = mul(a[k], twiddles[k * twiddleStride]);
+				}
+			}
+			else if (half == 1)
+			{
+				//Last stage, the only twiddle is 1
+				const Complex sum = a[0] + b[0];
+				b[0] = a[0] - b[0];
+				a[0] = sum;
+			}
+			else if (half == 2)
+			{
+				//Twiddles are 1 and -j, no multiplies needed
+				const Complex sum0 = a[0] + b[0];
+				const Complex sum1 = a[1] + b[1];
+				const Complex diff1 = a[1] - b[1];
+				b[0] = a[0] - b[0];
+				b[1] = Complex(diff1.imag(), -diff1.real());
+				a[0] = sum0;
+				a[1] = sum1;
+			}
+			else if (needA && needB)
+			{
+				for (std::size_t k = 0; k < half; k++)
+				{
+					const Complex sum = a[k] + b[k];
+					b[k] = mul(a[k] - b[k], twiddles[k * twiddleStride]);
+					a[k] = sum;
+				}
+			}
+			else if (needA)
+			{
+				for (std::size_t k = 0; k < half; k++)
+					a[k] += b[k];
+			}
+			else
+			{
+				for (std::size_t k = 0; k < half; k++)
+					b[k] = mul(a[k] - b[k], twiddles[k * twiddleStride]);
+			}
+		}
+		prefix = std::min(prefix, half);
+	}
+}
+
+void ComplexFft::setOutputMask(const std::vector<std::uint8_t>& neededBins)
+{
+	if (neededBins.empty())
+	{
+		mNeeded.clear();
+		return;
+	}
+
+	//Leaves are output positions, which hold bin getBitReverse(position) after the last stage
+	mNeeded.assign(2 * mSize, 0);
+	for (std::size_t position = 0; position < mSize; position++)
+	{
+		const std::size_t bin = (*mBitReverse)[position];
+		mNeeded[mSize + position] = (bin < neededBins.size() && neededBins[bin]) ? 1 : 0;
+	}
+	for (std::size_t node = mSize - 1; node >= 1; node--)
+	{
+		mNeeded[node] = mNeeded[2 * node] | mNeeded[2 * node + 1];
+	}
+}
+
+std::size_t ComplexFft::countOperations(std::size_t numNonZero) const
+{
+	//Same walk as forwardBitReversed(), counting the points it writes
+	const bool pruneOutput = !mNeeded.empty();
+	std::size_t prefix = std::min(numNonZero, mSize);
+	std::size_t count = 0;
+	for (std::size_t half = mSize >> 1; half >= 1; half >>= 1)
+	{
+		const std::size_t level = mSize / half;
+		for (std::size_t block = 0; block < mSize / (half << 1); block++)
+		{
+			const bool needA = !pruneOutput || mNeeded[level + 2 * block];
+			const bool needB = !pruneOutput || mNeeded[level + 2 * block + 1];
+			if (prefix <= half)
+				count += needB ? prefix : 0;
+			else
+				count += (needA ? half : 0) + (needB ? half : 0);
+		}
+		prefix = std::min(prefix, half);
+	}
+	return count;
+}
+
+bool isPowerOf2(std::size_t value)
+{
+	return value != 0 && (value & (value - 1)) == 0;
+}
+
+std::size_t nextPowerOf2(std::size_t value)
+{
+	std::size_t result = 1;
+	while (result < value)
+		result <<= 1;
+	return result;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,169 @@
+#include "dsp/fft_wisdom.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//Bump whenever a change to the transforms could change which one is fastest
+	const char* const kHeader = "# cieq fft wisdom 1\n";
+
+	const char* getMethodToken(BinRangeSpectrum::Method method)
+	{
+		switch (method)
+		{
+		case BinRangeSpectrum::Method::PRUNED_FFT:	return "pruned";
+		case BinRangeSpectrum::Method::CHIRP_Z:		return "chirp-z";
+		case BinRangeSpectrum::Method::GOERTZEL:	return "goertzel";
+		}
+		return "";
+	}
+}
+
+FftWisdom& FftWisdom::get()
+{
+	static FftWisdom wisdom;
+	return wisdom;
+}
+
+FftWisdom::FftWisdom()
+	: mMeasuring(false)
+	, mDirty(false)
+{}
+
+bool FftWisdom::load(const std::string& path)
+{
+	std::FILE* file = std::fopen(path.c_str(), "r");
+	if (!file)
+		return true;
+
+	std::map<Key, BinRangeSpectrum::Method> entries;
+	char line[256];
+	const bool current = std::fgets(line, sizeof(line), file) && std::strcmp(line, kHeader) == 0;
+	bool valid = true;
+	while (current && std::fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#' || line[0] == '\n')
+			continue;
+
+		unsigned long long fftSize = 0, windowSize = 0, firstBin = 0, numBins = 0;
+		char token[32];
+		if (std::sscanf(line, "%llu %llu %llu %llu %31s", &fftSize, &windowSize, &firstBin, &numBins, token) != 5)
+		{
+			valid = false;
+			break;
+		}
+
+		bool known = false;
+		for (BinRangeSpectrum::Method method : { BinRangeSpectrum::Method::PRUNED_FFT, BinRangeSpectrum::Method::CHIRP_Z, BinRangeSpectrum::Method::GOERTZEL })
+		{
+			if (std::strcmp(token, getMethodToken(method)) == 0)
+			{
+				entries[Key(fftSize, windowSize, firstBin, numBins)] = method;
+				known = true;
+			}
+		}
+		if (!known)
+		{
+			valid = false;
+			break;
+		}
+	}
+	std::fclose(file);
+
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!valid)
+	{
+		mError = "malformed wisdom file " + path;
+		return false;
+	}
+
+	//An older format is dropped, its geometries get measured again
+	for (const auto& entry : entries)
+		mEntries[entry.first] = entry.second;
+	mDirty = mDirty || !current;
+	return true;
+}
+
+bool FftWisdom::save(const std::string& path)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (!file)
+	{
+		mError = "can't write " + path;
+		return false;
+	}
+
+	std::fputs(kHeader, file);
+	std::fputs("# fftSize windowSize firstBin numBins method\n", file);
+	for (const auto& entry : mEntries)
+	{
+		std::fprintf(file, "%llu %llu %llu %llu %s\n",
+			static_cast<unsigned long long>(std::get<0>(entry.first)), static_cast<unsigned long long>(std::get<1>(entry.first)),
+			static_cast<unsigned long long>(std::get<2>(entry.first)), static_cast<unsigned long long>(std::get<3>(entry.first)),
+			getMethodToken(entry.second));
+	}
+
+	const bool written = std::fclose(file) == 0;
+	if (!written)
+		mError = "can't write " + path;
+	mDirty = mDirty && !written;
+	return written;
+}
+
+std::string FftWisdom::getError() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mError;
+}
+
+bool FftWisdom::lookup(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method& method) const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto found = mEntries.find(Key(fftSize, windowSize, firstBin, numBins));
+	if (found == mEntries.end())
+		return false;
+
+	method = found->second;
+	return true;
+}
+
+void FftWisdom::record(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins, BinRangeSpectrum::Method method)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries[Key(fftSize, windowSize, firstBin, numBins)] = method;
+	mDirty = true;
+}
+
+void FftWisdom::setMeasuring(bool measuring)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mMeasuring = measuring;
+}
+
+bool FftWisdom::isMeasuring() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mMeasuring;
+}
+
+bool FftWisdom::isDirty() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mDirty;
+}
+
+std::size_t FftWisdom::getNumEntries() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mEntries.size();
+}
+
+} //!dsp
+} //!cieq
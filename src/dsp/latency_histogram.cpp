@@ -0,0 +1,81 @@
+#include "dsp/latency_histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! bucket 0 holds everything below this, bucket i > 0 starts at kMinSeconds * 10^((i - 1) / kBucketsPerDecade)
+	const double kMinSeconds = 1.0e-5;
+	const std::size_t kNumDecades = 7;
+	const std::size_t kNumBuckets = 1 + kNumDecades * LatencyHistogram::kBucketsPerDecade;
+}
+
+LatencyHistogram::LatencyHistogram(std::size_t window /*= 512*/)
+	: mCounts(kNumBuckets, 0)
+	, mHistory(std::max<std::size_t>(1, window), 0)
+	, mNext(0)
+	, mCount(0)
+{}
+
+void LatencyHistogram::add(double seconds)
+{
+	if (mCount == mHistory.size())
+		mCounts[mHistory[mNext]]--;
+	else
+		mCount++;
+
+	const std::size_t bucket = getBucket(seconds);
+	mCounts[bucket]++;
+	mHistory[mNext] = static_cast<std::uint16_t>(bucket);
+	if (++mNext == mHistory.size())
+		mNext = 0;
+}
+
+void LatencyHistogram::clear()
+{
+	std::fill(mCounts.begin(), mCounts.end(), 0);
+	mNext = 0;
+	mCount = 0;
+}
+
+double LatencyHistogram::getPercentile(double p) const
+{
+	if (mCount == 0)
+		return 0.0;
+
+	//Smallest bucket with at least ceil(p * count) latencies at or below it
+	const std::size_t rank = std::max<std::size_t>(1, static_cast<std::size_t>(std::ceil(std::min(1.0, std::max(0.0, p)) * mCount)));
+	std::size_t seen = 0;
+	for (std::size_t i = 0; i < kNumBuckets; i++)
+	{
+		seen += mCounts[i];
+		if (seen >= rank)
+			return getBucketValue(i);
+	}
+	return getBucketValue(kNumBuckets - 1);
+}
+
+std::size_t LatencyHistogram::getBucket(double seconds)
+{
+	if (!(seconds > kMinSeconds))
+		return 0;
+	const double position = std::log10(seconds / kMinSeconds) * kBucketsPerDecade;
+	return std::min(kNumBuckets - 1, 1 + static_cast<std::size_t>(position));
+}
+
+double LatencyHistogram::getBucketValue(std::size_t bucket)
+{
+	//Geometric centre, the error is at most half a bucket either way
+	if (bucket == 0)
+		return kMinSeconds;
+	return kMinSeconds * std::pow(10.0, (static_cast<double>(bucket) - 0.5) / kBucketsPerDecade);
+}
+
+} //!dsp
+} //!cieq
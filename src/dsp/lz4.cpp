@@ -0,0 +1,140 @@
+#include "dsp/lz4.h"
+
+#include <cstring>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	const std::size_t kMinMatch = 4;
+	//The format wants the last 5 bytes as literals and no match starting in the last 12
+	const std::size_t kLastLiterals = 5;
+	const std::size_t kMatchLimit = 12;
+	const std::size_t kMaxOffset = 65535;
+	const std::size_t kHashBits = 12;
+
+	inline std::uint32_t read32(const std::uint8_t* data)
+	{
+		std::uint32_t value;
+		std::memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	inline std::size_t hash(std::uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - kHashBits);
+	}
+
+	//Lengths of 15 and more continue in 255-valued bytes after the token
+	void putLength(std::vector<std::uint8_t>& dest, std::size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			dest.push_back(255);
+		dest.push_back(static_cast<std::uint8_t>(length));
+	}
+
+	bool getLength(const std::uint8_t* source, std::size_t sourceSize, std::size_t& pos, std::size_t& length)
+	{
+		std::uint8_t byte = 255;
+		while (byte == 255)
+		{
+			if (pos >= sourceSize)
+				return false;
+			byte = source[pos++];
+			length += byte;
+		}
+		return true;
+	}
+
+	void putLiterals(std::vector<std::uint8_t>& dest, const std::uint8_t* literals, std::size_t count, std::size_t matchCode)
+	{
+		dest.push_back(static_cast<std::uint8_t>((count < 15 ? count : 15) << 4 | matchCode));
+		if (count >= 15)
+			putLength(dest, count - 15);
+		dest.insert(dest.end(), literals, literals + count);
+	}
+}
+
+void lz4Compress(const std::uint8_t* source, std::size_t size, std::vector<std::uint8_t>& dest)
+{
+	dest.clear();
+	dest.reserve(size + size / 255 + 16);
+	std::vector<std::int64_t> table(std::size_t(1) << kHashBits, -1);
+
+	std::size_t anchor = 0;
+	std::size_t pos = 0;
+	while (size >= kMatchLimit && pos <= size - kMatchLimit)
+	{
+		const std::uint32_t sequence = read32(source + pos);
+		const std::size_t slot = hash(sequence);
+		const std::int64_t candidate = table[slot];
+		table[slot] = static_cast<std::int64_t>(pos);
+		if (candidate < 0 || pos - static_cast<std::size_t>(candidate) > kMaxOffset || read32(source + candidate) != sequence)
+		{
+			pos++;
+			continue;
+		}
+
+		std::size_t matchLength = kMinMatch;
+		while (pos + matchLength < size - kLastLiterals && source[candidate + matchLength] == source[pos + matchLength])
+			matchLength++;
+
+		const std::size_t matchCode = matchLength - kMinMatch;
+		putLiterals(dest, source + anchor, pos - anchor, matchCode < 15 ? matchCode : 15);
+		const std::size_t offset = pos - static_cast<std::size_t>(candidate);
+		dest.push_back(static_cast<std::uint8_t>(offset & 0xff));
+		dest.push_back(static_cast<std::uint8_t>(offset >> 8));
+		if (matchCode >= 15)
+			putLength(dest, matchCode - 15);
+
+		pos += matchLength;
+		anchor = pos;
+	}
+	putLiterals(dest, source + anchor, size - anchor, 0);
+}
+
+bool lz4Decompress(const std::uint8_t* source, std::size_t sourceSize, std::uint8_t* dest, std::size_t destSize)
+{
+	std::size_t in = 0;
+	std::size_t out = 0;
+	while (in < sourceSize)
+	{
+		const std::uint8_t token = source[in++];
+		std::size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !getLength(source, sourceSize, in, numLiterals))
+			return false;
+		if (numLiterals > sourceSize - in || numLiterals > destSize - out)
+			return false;
+		std::memcpy(dest + out, source + in, numLiterals);
+		in += numLiterals;
+		out += numLiterals;
+
+		//The last sequence is literals only
+		if (in == sourceSize)
+			break;
+
+		if (sourceSize - in < 2)
+			return false;
+		const std::size_t offset = source[in] | (static_cast<std::size_t>(source[in + 1]) << 8);
+		in += 2;
+		std::size_t matchLength = token & 15;
+		if (matchLength == 15 && !getLength(source, sourceSize, in, matchLength))
+			return false;
+		matchLength += kMinMatch;
+		if (offset == 0 || offset > out || matchLength > destSize - out)
+			return false;
+
+		//Byte by byte, a match may overlap the bytes it produces
+		const std::uint8_t* match = dest + out - offset;
+		for (std::size_t i = 0; i < matchLength; i++)
+			dest[out + i] = match[i];
+		out += matchLength;
+	}
+	return out == destSize;
+}
+
+} //!dsp
+} //!cieq
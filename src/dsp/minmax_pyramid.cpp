@@ -0,0 +1,121 @@
+#include "dsp/minmax_pyramid.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace cieq
+{
+namespace dsp
+{
+
+MinMaxPyramid::MinMaxPyramid()
+	: mSize(0)
+{}
+
+void MinMaxPyramid::build(const float* samples, std::size_t count)
+{
+	if (count != mSize || mLevelOffsets.empty())
+	{
+		mSize = count;
+		mLevelOffsets.clear();
+		std::size_t total = 0;
+		std::size_t levelSize = count;
+		while (levelSize > 0)
+		{
+			mLevelOffsets.push_back(total);
+			total += levelSize;
+			if (levelSize == 1)
+				break;
+			levelSize = (levelSize + 1) / 2;
+		}
+		mMins.resize(total);
+		mMaxs.resize(total);
+	}
+
+	if (count == 0)
+		return;
+
+	//Level 0, a single sample is its own min and max
+	std::copy(samples, samples + count, mMins.begin());
+	std::copy(samples, samples + count, mMaxs.begin());
+
+	std::size_t levelSize = count;
+	for (std::size_t level = 1; level < mLevelOffsets.size(); level++)
+	{
+		const float* srcMin = mMins.data() + mLevelOffsets[level - 1];
+		const float* srcMax = mMaxs.data() + mLevelOffsets[level - 1];
+		float* dstMin = mMins.data() + mLevelOffsets[level];
+		float* dstMax = mMaxs.data() + mLevelOffsets[level];
+
+		const std::size_t pairs = levelSize / 2;
+		for (std::size_t i = 0; i < pairs; i++)
+		{
+			dstMin[i] = std::min(srcMin[2 * i], srcMin[2 * i + 1]);
+			dstMax[i] = std::max(srcMax[2 * i], srcMax[2 * i + 1]);
+		}
+		//An odd block at the end has no partner
+		if (levelSize & 1)
+		{
+			dstMin[pairs] = srcMin[levelSize - 1];
+			dstMax[pairs] = srcMax[levelSize - 1];
+		}
+		levelSize = (levelSize + 1) / 2;
+	}
+}
+
+std::size_t MinMaxPyramid::selectLevel(std::size_t length, std::size_t numColumns) const
+{
+	if (numColumns == 0 || mLevelOffsets.empty())
+		return 0;
+
+	const std::size_t samplesPerColumn = length / numColumns;
+	std::size_t level = 0;
+	while (level + 1 < mLevelOffsets.size() && (std::size_t(2) << level) <= samplesPerColumn)
+		level++;
+	return level;
+}
+
+std::size_t MinMaxPyramid::envelope(std::size_t first, std::size_t length, std::size_t numColumns, float* mins, float* maxs) const
+{
+	if (numColumns == 0)
+		return 0;
+
+	first = std::min(first, mSize);
+	length = std::min(length, mSize - first);
+	if (length == 0)
+	{
+		std::fill(mins, mins + numColumns, 0.0f);
+		std::fill(maxs, maxs + numColumns, 0.0f);
+		return 0;
+	}
+
+	//Blocks are at most a column long, so a column spans at most three of them. The
+	//blocks at either end may reach a little into the neighbouring columns, that only
+	//ever widens the envelope by less than a column.
+	const std::size_t level = selectLevel(length, numColumns);
+	const float* levelMin = mMins.data() + mLevelOffsets[level];
+	const float* levelMax = mMaxs.data() + mLevelOffsets[level];
+
+	for (std::size_t c = 0; c < numColumns; c++)
+	{
+		const std::size_t begin = first + static_cast<std::size_t>(static_cast<std::uint64_t>(c) * length / numColumns);
+		std::size_t end = first + static_cast<std::size_t>(static_cast<std::uint64_t>(c + 1) * length / numColumns);
+		//Zoomed in past one sample per column, columns repeat the sample under them
+		end = std::max(end, begin + 1);
+
+		const std::size_t lastBlock = (end - 1) >> level;
+		float lo = levelMin[begin >> level];
+		float hi = levelMax[begin >> level];
+		for (std::size_t block = (begin >> level) + 1; block <= lastBlock; block++)
+		{
+			lo = std::min(lo, levelMin[block]);
+			hi = std::max(hi, levelMax[block]);
+		}
+		mins[c] = lo;
+		maxs[c] = hi;
+	}
+	return level;
+}
+
+} //!dsp
+} //!cieq
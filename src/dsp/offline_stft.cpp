@@ -0,0 +1,210 @@
+#include "dsp/offline_stft.h"
+#include "dsp/profiler.h"
+#include "dsp/plan_cache.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! zoom mode feeds the decimator at most this many samples at a time
+	const std::size_t kZoomChunkSize = 16384;
+	//! below this many frames per thread, starting threads costs more than it saves
+	const std::size_t kMinFramesPerThread = 16;
+}
+
+OfflineStft::OfflineStft()
+	: mZoomSamplesConsumed(0)
+	, mZoomNextFrame(0)
+	, mZoomMaxFreq(0.0f)
+	, mFftSize(0)
+	, mWindowSize(0)
+	, mHopSize(0)
+	, mSampleRate(0)
+	, mFirstBin(0)
+	, mNumOutputBins(0)
+	, mNumThreads(std::max<std::size_t>(1, std::thread::hardware_concurrency()))
+{}
+
+void OfflineStft::setup(std::size_t fftSize, std::size_t windowSize, std::size_t hopSize, std::size_t sampleRate, float zoomMaxFreq /*= 0.0f*/)
+{
+	//Same rules as StftEngine::setup(), the FFT can't be shorter than the window
+	if (fftSize < windowSize)
+		fftSize = windowSize;
+	if (!isPowerOf2(fftSize))
+		fftSize = nextPowerOf2(fftSize);
+
+	mFftSize = fftSize;
+	mWindowSize = windowSize;
+	mHopSize = std::max<std::size_t>(hopSize, 1);
+	mSampleRate = sampleRate;
+	mZoomMaxFreq = zoomMaxFreq;
+
+	mZoom.reset();
+	mWindow.reset();
+	if (zoomMaxFreq > 0.0f)
+	{
+		resetZoom();
+	}
+
+	if (!mZoom)
+	{
+		mWindow = PlanCache::get().getWindow(WindowType::BLACKMAN, mWindowSize);
+	}
+
+	mFirstBin = 0;
+	mNumOutputBins = getNumBins();
+	planWorkers();
+}
+
+void OfflineStft::setBinRange(std::size_t firstBin, std::size_t numBins)
+{
+	mFirstBin = std::min(firstBin, getNumBins());
+	mNumOutputBins = std::min(numBins, getNumBins() - mFirstBin);
+	planWorkers();
+}
+
+void OfflineStft::setNumThreads(std::size_t numThreads)
+{
+	mNumThreads = numThreads ? numThreads : std::max<std::size_t>(1, std::thread::hardware_concurrency());
+	planWorkers();
+}
+
+void OfflineStft::planWorkers()
+{
+	mWorkers.clear();
+	if (mZoom || mWindowSize == 0)
+		return;
+
+	//Every worker makes the same (deterministic) choice of method for the range
+	mWorkers.resize(mNumThreads);
+	for (auto& worker : mWorkers)
+	{
+		worker.mBinRange.reset(new BinRangeSpectrum());
+		worker.mBinRange->setup(mFftSize, mWindowSize, mFirstBin, mNumOutputBins);
+		worker.mInput.assign(mWindowSize, 0.0f);
+	}
+}
+
+void OfflineStft::resetZoom()
+{
+	mZoom.reset(new ZoomFft());
+	if (!mZoom->setup(mSampleRate, mFftSize, mWindowSize, mZoomMaxFreq))
+	{
+		mZoom.reset();
+		return;
+	}
+	mZoomInput.resize(kZoomChunkSize);
+	mZoomMagnitudes.resize(mZoom->getNumBins());
+	mZoomSamplesConsumed = 0;
+	mZoomNextFrame = 0;
+}
+
+std::size_t OfflineStft::getNumFrames(std::size_t numSamples) const
+{
+	if (mWindowSize == 0 || numSamples < mWindowSize)
+		return 0;
+	return (numSamples - mWindowSize) / mHopSize + 1;
+}
+
+std::uint64_t OfflineStft::getFrameSampleIndex(std::size_t frame) const
+{
+	const std::uint64_t frameStart = static_cast<std::uint64_t>(frame) * mHopSize;
+	if (!mZoom)
+		return frameStart;
+
+	//Same correction StftEngine applies for the decimation filter delay
+	const std::uint64_t frameEnd = frameStart + mWindowSize;
+	const std::uint64_t delayedEnd = frameEnd - std::min<std::uint64_t>(mZoom->getLatencySamples(), frameEnd);
+	return delayedEnd - std::min<std::uint64_t>(mWindowSize, delayedEnd);
+}
+
+void OfflineStft::analyze(const AudioFile& file, std::size_t firstFrame, std::size_t numFrames, float* magnitudes)
+{
+	if (numFrames == 0 || mNumOutputBins == 0)
+		return;
+
+	if (mZoom)
+	{
+		analyzeZoom(file, firstFrame, numFrames, magnitudes);
+		return;
+	}
+	if (mWorkers.empty())
+		return;
+
+	//Contiguous slices, one per worker. The calling thread takes the first one.
+	const std::size_t numWorkers = std::max<std::size_t>(1, std::min(mWorkers.size(), numFrames / kMinFramesPerThread));
+	std::vector<std::thread> threads;
+	threads.reserve(numWorkers - 1);
+	for (std::size_t w = 1; w < numWorkers; w++)
+	{
+		const std::size_t begin = numFrames * w / numWorkers;
+		const std::size_t end = numFrames * (w + 1) / numWorkers;
+		threads.emplace_back(&OfflineStft::analyzeFullBand, this, std::cref(file), w, firstFrame + begin, end - begin, magnitudes + begin * mNumOutputBins);
+	}
+	analyzeFullBand(file, 0, firstFrame, numFrames / numWorkers, magnitudes);
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+void OfflineStft::analyzeFullBand(const AudioFile& file, std::size_t worker, std::size_t firstFrame, std::size_t numFrames, float* magnitudes)
+{
+	CIEQ_PROFILE_ZONE("offline fft");
+	Worker& state = mWorkers[worker];
+	float* input = state.mInput.data();
+	const float* window = mWindow->data();
+	for (std::size_t f = 0; f < numFrames; f++)
+	{
+		//Decoded straight from the mapping, the window lies inside the file by construction
+		const std::size_t frameStart = (firstFrame + f) * mHopSize;
+		file.readMono(frameStart, mWindowSize, input);
+		for (std::size_t i = 0; i < mWindowSize; i++)
+			input[i] *= window[i];
+
+		state.mBinRange->computeMagnitudes(input, magnitudes + f * mNumOutputBins);
+	}
+}
+
+void OfflineStft::analyzeZoom(const AudioFile& file, std::size_t firstFrame, std::size_t numFrames, float* magnitudes)
+{
+	CIEQ_PROFILE_ZONE("offline zoom fft");
+	if (firstFrame < mZoomNextFrame)
+		resetZoom();
+	if (!mZoom)
+		return;
+
+	const std::size_t endFrame = firstFrame + numFrames;
+	while (mZoomNextFrame < endFrame)
+	{
+		//Feed the decimator up to the end of the next frame, exactly like StftEngine::process()
+		const std::uint64_t frameEnd = static_cast<std::uint64_t>(mZoomNextFrame) * mHopSize + mWindowSize;
+		while (mZoomSamplesConsumed < frameEnd)
+		{
+			const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(frameEnd - mZoomSamplesConsumed, kZoomChunkSize));
+			file.readMono(static_cast<std::size_t>(mZoomSamplesConsumed), count, mZoomInput.data());
+			mZoom->process(mZoomInput.data(), count);
+			mZoomSamplesConsumed += count;
+		}
+
+		//Frames before the requested range still have to run through the decimator, but
+		//their transforms are skipped
+		if (mZoomNextFrame >= firstFrame)
+		{
+			mZoom->computeMagnitudes(mZoomMagnitudes.data());
+			std::copy(mZoomMagnitudes.begin() + mFirstBin, mZoomMagnitudes.begin() + mFirstBin + mNumOutputBins,
+				magnitudes + (mZoomNextFrame - firstFrame) * mNumOutputBins);
+		}
+		mZoomNextFrame++;
+	}
+}
+
+} //!dsp
+} //!cieq
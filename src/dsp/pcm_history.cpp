@@ -0,0 +1,92 @@
+#include "dsp/pcm_history.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cieq
+{
+namespace dsp
+{
+
+PcmHistory::PcmHistory()
+	: mWritten(0)
+	, mReserved(0)
+	, mBase(0)
+{}
+
+void PcmHistory::setup(std::size_t capacity)
+{
+	mSamples.assign(capacity, 0.0f);
+	mWritten.store(0, std::memory_order_relaxed);
+	mReserved.store(0, std::memory_order_relaxed);
+	mBase.store(0, std::memory_order_relaxed);
+}
+
+void PcmHistory::restart()
+{
+	mBase.store(mWritten.load(std::memory_order_relaxed), std::memory_order_release);
+}
+
+void PcmHistory::write(const float* samples, std::size_t count)
+{
+	const std::size_t capacity = mSamples.size();
+	if (capacity == 0 || count == 0)
+		return;
+
+	//Samples that would be overwritten within this very call are skipped, not copied
+	std::uint64_t written = mWritten.load(std::memory_order_relaxed);
+	if (count > capacity)
+	{
+		written += count - capacity;
+		samples += count - capacity;
+		count = capacity;
+	}
+
+	//Announce the overwrite before doing it, a reader checks this after copying (a seqlock)
+	mReserved.store(written + count, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	const std::size_t pos = static_cast<std::size_t>(written % capacity);
+	const std::size_t first = std::min(count, capacity - pos);
+	std::memcpy(mSamples.data() + pos, samples, first * sizeof(float));
+	std::memcpy(mSamples.data(), samples + first, (count - first) * sizeof(float));
+	mWritten.store(written + count, std::memory_order_release);
+}
+
+bool PcmHistory::read(std::uint64_t first, std::size_t count, float* dest) const
+{
+	const std::size_t capacity = mSamples.size();
+	if (count > capacity)
+		return false;
+
+	const std::uint64_t start = mBase.load(std::memory_order_acquire) + first;
+	const std::uint64_t written = mWritten.load(std::memory_order_acquire);
+	if (start + count > written || start + capacity < written)
+		return false;
+
+	const std::size_t pos = static_cast<std::size_t>(start % capacity);
+	const std::size_t part = std::min(count, capacity - pos);
+	std::memcpy(dest, mSamples.data() + pos, part * sizeof(float));
+	std::memcpy(dest + part, mSamples.data(), (count - part) * sizeof(float));
+
+	//Whatever the writer started overwriting meanwhile is in mReserved by now
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return start + capacity >= mReserved.load(std::memory_order_relaxed);
+}
+
+std::uint64_t PcmHistory::getBegin() const
+{
+	const std::uint64_t base = mBase.load(std::memory_order_acquire);
+	const std::uint64_t written = mWritten.load(std::memory_order_acquire);
+	const std::uint64_t oldest = written > mSamples.size() ? written - mSamples.size() : 0;
+	return std::max(oldest, base) - base;
+}
+
+std::uint64_t PcmHistory::getEnd() const
+{
+	const std::uint64_t base = mBase.load(std::memory_order_acquire);
+	return mWritten.load(std::memory_order_acquire) - base;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,237 @@
+#include "dsp/plan_cache.h"
+
+#include <cmath>
+#include <tuple>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	const double kPi = 3.14159265358979323846264338327950288;
+
+	//e^(sign j pi exponent / fftSize), exponent taken modulo 2 fftSize first so
+	//the quadratic chirp phases don't lose precision for large n
+	Complex chirp(std::uint64_t exponent, std::size_t fftSize, double sign)
+	{
+		const std::uint64_t wrapped = exponent % (2 * static_cast<std::uint64_t>(fftSize));
+		const double phase = sign * kPi * static_cast<double>(wrapped) / static_cast<double>(fftSize);
+		return Complex(static_cast<float>(std::cos(phase)), static_cast<float>(std::sin(phase)));
+	}
+}
+
+PlanCache::Key::Key(TableType table)
+	: mTable(table)
+	, mSize(0)
+	, mLength(0)
+	, mFirstBin(0)
+	, mNumBins(0)
+	, mWindow(WindowType::RECT)
+{}
+
+bool PlanCache::Key::operator<(const Key& other) const
+{
+	return std::tie(mTable, mSize, mLength, mFirstBin, mNumBins, mWindow)
+		< std::tie(other.mTable, other.mSize, other.mLength, other.mFirstBin, other.mNumBins, other.mWindow);
+}
+
+PlanCache& PlanCache::get()
+{
+	static PlanCache cache;
+	return cache;
+}
+
+PlanCache::PlanCache()
+	: mBudget(kDefaultBudget)
+	, mNumBytes(0)
+	, mNumHits(0)
+	, mNumMisses(0)
+{}
+
+template <typename Table>
+std::shared_ptr<const Table> PlanCache::find(const Key& key)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	auto found = mEntries.find(key);
+	if (found == mEntries.end())
+		return nullptr;
+
+	mRecent.splice(mRecent.begin(), mRecent, found->second.mRecent);
+	mNumHits++;
+	return std::static_pointer_cast<const Table>(found->second.mTable);
+}
+
+template <typename Table>
+std::shared_ptr<const Table> PlanCache::insert(const Key& key, const std::shared_ptr<const Table>& table, std::size_t numBytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	//Two threads missed on the same table, the first one to get here wins
+	auto found = mEntries.find(key);
+	if (found != mEntries.end())
+	{
+		mRecent.splice(mRecent.begin(), mRecent, found->second.mRecent);
+		return std::static_pointer_cast<const Table>(found->second.mTable);
+	}
+
+	mNumMisses++;
+	mRecent.push_front(key);
+	Entry& entry = mEntries[key];
+	entry.mTable = table;
+	entry.mNumBytes = numBytes;
+	entry.mRecent = mRecent.begin();
+	mNumBytes += numBytes;
+
+	//The caller holds the new table, so it can't be the one evicted
+	evict();
+	return table;
+}
+
+std::shared_ptr<const std::vector<Complex>> PlanCache::getTwiddles(std::size_t size)
+{
+	Key key(TableType::TWIDDLES);
+	key.mSize = size;
+	if (std::shared_ptr<const std::vector<Complex>> cached = find<std::vector<Complex>>(key))
+		return cached;
+
+	std::shared_ptr<std::vector<Complex>> twiddles = std::make_shared<std::vector<Complex>>(size / 2);
+	for (std::size_t k = 0; k < twiddles->size(); k++)
+	{
+		const double phase = -2.0 * kPi * static_cast<double>(k) / static_cast<double>(size);
+		(*twiddles)[k] = Complex(static_cast<float>(std::cos(phase)), static_cast<float>(std::sin(phase)));
+	}
+	return insert<std::vector<Complex>>(key, twiddles, twiddles->size() * sizeof(Complex));
+}
+
+std::shared_ptr<const std::vector<std::size_t>> PlanCache::getBitReverse(std::size_t size)
+{
+	Key key(TableType::BIT_REVERSE);
+	key.mSize = size;
+	if (std::shared_ptr<const std::vector<std::size_t>> cached = find<std::vector<std::size_t>>(key))
+		return cached;
+
+	std::size_t numBits = 0;
+	while ((std::size_t(1) << numBits) < size)
+		numBits++;
+
+	std::shared_ptr<std::vector<std::size_t>> bitReverse = std::make_shared<std::vector<std::size_t>>(size);
+	for (std::size_t i = 0; i < size; i++)
+	{
+		std::size_t reversed = 0;
+		for (std::size_t b = 0; b < numBits; b++)
+		{
+			if (i & (std::size_t(1) << b))
+				reversed |= std::size_t(1) << (numBits - 1 - b);
+		}
+		(*bitReverse)[i] = reversed;
+	}
+	return insert<std::vector<std::size_t>>(key, bitReverse, bitReverse->size() * sizeof(std::size_t));
+}
+
+std::shared_ptr<const std::vector<float>> PlanCache::getWindow(WindowType type, std::size_t length)
+{
+	Key key(TableType::WINDOW);
+	key.mLength = length;
+	key.mWindow = type;
+	if (std::shared_ptr<const std::vector<float>> cached = find<std::vector<float>>(key))
+		return cached;
+
+	std::shared_ptr<std::vector<float>> window = std::make_shared<std::vector<float>>(length);
+	generateWindow(type, window->data(), length);
+	return insert<std::vector<float>>(key, window, window->size() * sizeof(float));
+}
+
+std::shared_ptr<const ChirpZKernel> PlanCache::getChirpZKernel(std::size_t fftSize, std::size_t windowSize, std::size_t firstBin, std::size_t numBins)
+{
+	Key key(TableType::CHIRP_Z);
+	key.mSize = fftSize;
+	key.mLength = windowSize;
+	key.mFirstBin = firstBin;
+	key.mNumBins = numBins;
+	if (std::shared_ptr<const ChirpZKernel> cached = find<ChirpZKernel>(key))
+		return cached;
+
+	//X[k0 + m] = sum x[n] W^((k0 + m) n), W = e^(-j 2 pi / N). With mn = (m^2 + n^2 - (m - n)^2) / 2
+	//that is W^(m^2 / 2) times the convolution of x[n] W^(k0 n + n^2 / 2) with W^(-j^2 / 2).
+	//The leading factor has unit magnitude, so it is never applied.
+	std::shared_ptr<ChirpZKernel> kernel = std::make_shared<ChirpZKernel>();
+	kernel->mChirpSize = nextPowerOf2(windowSize + numBins - 1);
+
+	kernel->mPreChirp.resize(windowSize);
+	for (std::size_t n = 0; n < windowSize; n++)
+	{
+		const std::uint64_t n64 = n;
+		kernel->mPreChirp[n] = chirp(2 * firstBin * n64 + n64 * n64, fftSize, -1.0);
+	}
+
+	//Impulse response W^(-j^2 / 2) for j in (-windowSize, numBins), negative lags wrap around
+	kernel->mResponse.assign(kernel->mChirpSize, Complex(0.0f, 0.0f));
+	for (std::size_t j = 0; j < numBins; j++)
+		kernel->mResponse[j] = chirp(static_cast<std::uint64_t>(j) * j, fftSize, 1.0);
+	for (std::size_t j = 1; j < windowSize; j++)
+		kernel->mResponse[kernel->mChirpSize - j] = chirp(static_cast<std::uint64_t>(j) * j, fftSize, 1.0);
+	ComplexFft(kernel->mChirpSize).forwardBitReversed(kernel->mResponse.data());
+
+	const std::size_t numBytes = (kernel->mPreChirp.size() + kernel->mResponse.size()) * sizeof(Complex);
+	return insert<ChirpZKernel>(key, kernel, numBytes);
+}
+
+void PlanCache::setBudget(std::size_t numBytes)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBudget = numBytes;
+	evict();
+}
+
+std::size_t PlanCache::getBudget() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mBudget;
+}
+
+std::size_t PlanCache::getNumBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumBytes;
+}
+
+std::uint64_t PlanCache::getNumHits() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumHits;
+}
+
+std::uint64_t PlanCache::getNumMisses() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumMisses;
+}
+
+void PlanCache::clear()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	mEntries.clear();
+	mRecent.clear();
+	mNumBytes = 0;
+}
+
+void PlanCache::evict()
+{
+	auto it = mRecent.end();
+	while (mNumBytes > mBudget && it != mRecent.begin())
+	{
+		--it;
+		auto entry = mEntries.find(*it);
+		//The cache's own reference is the only one left once every user let go
+		if (entry->second.mTable.use_count() > 1)
+			continue;
+
+		mNumBytes -= entry->second.mNumBytes;
+		mEntries.erase(entry);
+		it = mRecent.erase(it);
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,151 @@
+#include "dsp/profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <limits>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	void writeJsonString(std::FILE* file, const char* text)
+	{
+		std::fputc('"', file);
+		for (const char* c = text; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				std::fputc('\\', file);
+			if (static_cast<unsigned char>(*c) >= 0x20)
+				std::fputc(*c, file);
+		}
+		std::fputc('"', file);
+	}
+}
+
+thread_local Profiler::ThreadBuffer* Profiler::sThreadBuffer = nullptr;
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+std::uint64_t Profiler::now()
+{
+	return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+	if (!sThreadBuffer)
+	{
+		std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer());
+		buffer->mEvents.reset(new Event[kEventsPerThread]);
+		buffer->mHead.store(0, std::memory_order_relaxed);
+		buffer->mName.store(nullptr, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		buffer->mId = mBuffers.size() + 1;
+		sThreadBuffer = buffer.get();
+		mBuffers.push_back(std::move(buffer));
+	}
+	return *sThreadBuffer;
+}
+
+void Profiler::record(const char* name, std::uint64_t start, std::uint64_t end)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+	const std::uint64_t index = buffer.mHead.load(std::memory_order_relaxed);
+	Event& event = buffer.mEvents[index % kEventsPerThread];
+	event.mName.store(name, std::memory_order_relaxed);
+	event.mStart.store(start, std::memory_order_relaxed);
+	event.mDuration.store(end - start, std::memory_order_relaxed);
+	//Publishes the slot to writeChromeTrace()
+	buffer.mHead.store(index + 1, std::memory_order_release);
+}
+
+void Profiler::setThreadName(const char* name)
+{
+	ThreadBuffer& buffer = getThreadBuffer();
+	if (buffer.mName.load(std::memory_order_relaxed) != name)
+		buffer.mName.store(name, std::memory_order_relaxed);
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) const
+{
+	struct Zone
+	{
+		const char*		mName;
+		std::uint64_t	mStart;
+		std::uint64_t	mDuration;
+		std::size_t		mThread;
+	};
+
+	//Copy first, the threads keep recording while the file is written
+	std::vector<Zone> zones;
+	std::vector<std::pair<std::size_t, const char*>> threads;
+	{
+		std::lock_guard<std::mutex> lock(mBuffersMutex);
+		for (const auto& buffer : mBuffers)
+		{
+			const std::uint64_t head = buffer->mHead.load(std::memory_order_acquire);
+			const std::uint64_t first = head > kEventsPerThread ? head - kEventsPerThread : 0;
+			const std::size_t begin = zones.size();
+			for (std::uint64_t i = first; i < head; i++)
+			{
+				const Event& event = buffer->mEvents[i % kEventsPerThread];
+				zones.push_back(Zone{ event.mName.load(std::memory_order_relaxed), event.mStart.load(std::memory_order_relaxed), event.mDuration.load(std::memory_order_relaxed), buffer->mId });
+			}
+
+			//Slots the thread started overwriting while they were copied are dropped
+			const std::uint64_t headAfter = buffer->mHead.load(std::memory_order_acquire);
+			const std::uint64_t firstValid = headAfter >= kEventsPerThread ? headAfter - kEventsPerThread + 1 : 0;
+			if (firstValid > first)
+				zones.erase(zones.begin() + begin, zones.begin() + begin + static_cast<std::size_t>(std::min(firstValid, head) - first));
+
+			const char* name = buffer->mName.load(std::memory_order_relaxed);
+			threads.emplace_back(buffer->mId, name);
+		}
+	}
+
+	std::FILE* file = std::fopen(path.c_str(), "w");
+	if (!file)
+		return false;
+
+	std::uint64_t origin = std::numeric_limits<std::uint64_t>::max();
+	for (const auto& zone : zones)
+	{
+		origin = std::min(origin, zone.mStart);
+	}
+
+	std::fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+	bool first = true;
+	for (const auto& thread : threads)
+	{
+		char fallback[32];
+		std::snprintf(fallback, sizeof(fallback), "thread %zu", thread.first);
+		std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", first ? "" : ",\n", thread.first);
+		writeJsonString(file, thread.second ? thread.second : fallback);
+		std::fputs("}}", file);
+		first = false;
+	}
+	for (const auto& zone : zones)
+	{
+		std::fputs(first ? "{\"name\":" : ",\n{\"name\":", file);
+		writeJsonString(file, zone.mName);
+		std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,\"dur\":%.3f}",
+			zone.mThread, (zone.mStart - origin) / 1000.0, zone.mDuration / 1000.0);
+		first = false;
+	}
+	std::fputs("\n]}\n", file);
+
+	const bool ok = !std::ferror(file);
+	return std::fclose(file) == 0 && ok;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,96 @@
+#include "dsp/real_fft.h"
+#include "dsp/plan_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	inline Complex mul(const Complex& a, const Complex& b)
+	{
+		return Complex(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+	}
+}
+
+RealFft::RealFft(std::size_t size)
+	: mSize(size)
+	, mHalfSize(size / 2)
+	, mFirstBin(0)
+	, mNumOutputBins(size / 2)
+	, mTwiddles(PlanCache::get().getTwiddles(size))
+	, mPacked(size / 2)
+	, mFft(new ComplexFft(size / 2))
+{}
+
+void RealFft::forward(const float* input, std::size_t numNonZero, Complex* spectrum)
+{
+	numNonZero = std::min(numNonZero, mSize);
+
+	//Pack even samples into the real part and odd ones into the imaginary part
+	const std::size_t numPacked = (numNonZero + 1) / 2;
+	for (std::size_t m = 0; m < numPacked; m++)
+	{
+		const float odd = (2 * m + 1 < numNonZero) ? input[2 * m + 1] : 0.0f;
+		mPacked[m] = Complex(input[2 * m], odd);
+	}
+
+	std::fill(mPacked.begin() + numPacked, mPacked.end(), Complex(0.0f, 0.0f));
+	mFft->forwardBitReversed(mPacked.data(), numPacked);
+
+	//Split the half-size spectrum Z back into the spectrum X of the real input:
+	//X[k] = (Z[k] + conj(Z[H - k])) / 2 - j W^k (Z[k] - conj(Z[H - k])) / 2
+	//Z is still in bit-reversed order, gathering through the table saves a reordering pass.
+	const Complex* twiddles = mTwiddles->data();
+	const std::size_t endBin = mFirstBin + mNumOutputBins;
+	for (std::size_t k = mFirstBin; k < endBin; k++)
+	{
+		if (k == 0)
+		{
+			const Complex z0 = mPacked[0];
+			spectrum[0] = Complex(z0.real() + z0.imag(), 0.0f);
+			continue;
+		}
+		const Complex a = mPacked[mFft->getBitReverse(k)];
+		const Complex b = std::conj(mPacked[mFft->getBitReverse(mHalfSize - k)]);
+		const Complex even = 0.5f * (a + b);
+		const Complex diff = 0.5f * (a - b);
+		const Complex odd(diff.imag(), -diff.real());
+		spectrum[k - mFirstBin] = even + mul(twiddles[k], odd);
+	}
+}
+
+void RealFft::setOutputBins(std::size_t firstBin, std::size_t numBins)
+{
+	mFirstBin = std::min(firstBin, mHalfSize);
+	mNumOutputBins = std::min(numBins, mHalfSize - mFirstBin);
+
+	if (mFirstBin == 0 && mNumOutputBins == mHalfSize)
+	{
+		mFft->setOutputMask(std::vector<std::uint8_t>());
+		return;
+	}
+
+	//X[k] is built from Z[k] and Z[H - k]
+	std::vector<std::uint8_t> needed(mHalfSize, 0);
+	for (std::size_t k = mFirstBin; k < mFirstBin + mNumOutputBins; k++)
+	{
+		needed[k] = 1;
+		needed[(mHalfSize - k) % mHalfSize] = 1;
+	}
+	mFft->setOutputMask(needed);
+}
+
+std::size_t RealFft::estimateCost(std::size_t numNonZero) const
+{
+	//~6 flops per complex multiply-add in the butterflies, ~16 per split bin plus packing
+	const std::size_t numPacked = (std::min(numNonZero, mSize) + 1) / 2;
+	return 6 * mFft->countOperations(numPacked) + 16 * mNumOutputBins + 2 * mHalfSize;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,210 @@
+#include "dsp/region_analysis.h"
+#include "dsp/profiler.h"
+#include "dsp/streaming_stft.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//Samples copied out of the history at a time, a cancel is noticed within a few of them
+	const std::size_t kReadSamples = 65536;
+}
+
+RegionAnalyzer::RegionAnalyzer()
+	: mWorkerRunning(false)
+	, mRequested(false)
+	, mComputing(false)
+	, mHasResult(false)
+	, mHistory(nullptr)
+	, mRequestId(0)
+	, mNextId(0)
+	, mCancelled(false)
+	, mProgress(0.0f)
+{}
+
+RegionAnalyzer::~RegionAnalyzer()
+{
+	stopWorker();
+}
+
+std::uint32_t RegionAnalyzer::analyze(const PcmHistory& history, const RegionRequest& request)
+{
+	std::uint32_t id = 0;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		id = ++mNextId;
+		mHistory = &history;
+		mRequest = request;
+		mRequestId = id;
+		mRequested = true;
+		mHasResult = false;
+		//The running one is stale now, the worker clears this when it takes the new one
+		mCancelled = true;
+		if (!mWorkerRunning)
+		{
+			mWorkerRunning = true;
+			mWorker = std::thread(&RegionAnalyzer::run, this);
+		}
+	}
+	mCondition.notify_all();
+	return id;
+}
+
+void RegionAnalyzer::cancel()
+{
+	std::unique_lock<std::mutex> lock(mMutex);
+	mRequested = false;
+	mHasResult = false;
+	mCancelled = true;
+	mCondition.wait(lock, [this] { return !mComputing; });
+}
+
+bool RegionAnalyzer::popResult(RegionResult& result)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	if (!mHasResult)
+		return false;
+
+	result = std::move(mResult);
+	mHasResult = false;
+	return true;
+}
+
+bool RegionAnalyzer::isBusy() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mRequested || mComputing;
+}
+
+void RegionAnalyzer::run()
+{
+	CIEQ_PROFILE_THREAD("region analysis");
+	std::unique_lock<std::mutex> lock(mMutex);
+	for (;;)
+	{
+		mCondition.wait(lock, [this] { return mRequested || !mWorkerRunning; });
+		if (!mWorkerRunning)
+			return;
+
+		const PcmHistory* history = mHistory;
+		const RegionRequest request = mRequest;
+		RegionResult result;
+		result.mId = mRequestId;
+		mRequested = false;
+		mComputing = true;
+		mCancelled = false;
+		mProgress.store(0.0f, std::memory_order_relaxed);
+		lock.unlock();
+
+		compute(*history, request, result);
+
+		lock.lock();
+		mComputing = false;
+		//A newer request or a cancel() since then make this result stale, a failed one still tells why
+		if (!mCancelled)
+		{
+			mResult = std::move(result);
+			mHasResult = true;
+		}
+		mCondition.notify_all();
+	}
+}
+
+bool RegionAnalyzer::compute(const PcmHistory& history, const RegionRequest& request, RegionResult& result)
+{
+	CIEQ_PROFILE_ZONE("analyse region");
+	result.mRequest = request;
+	if (request.mSampleRate == 0 || request.mWindowSize == 0 || request.mHopSize == 0
+		|| request.mLastSample < request.mFirstSample || request.mMaxFreq <= request.mMinFreq)
+	{
+		result.mError = "empty region";
+		return false;
+	}
+
+	//Rows are centred on their samples, the first window starts half a window before the region
+	const std::size_t halfWindow = request.mWindowSize / 2;
+	const std::size_t numRows = static_cast<std::size_t>((request.mLastSample - request.mFirstSample) / request.mHopSize) + 1;
+	const std::uint64_t numSamples = static_cast<std::uint64_t>(numRows - 1) * request.mHopSize + request.mWindowSize;
+	if (request.mFirstSample < halfWindow || request.mFirstSample - halfWindow < history.getBegin()
+		|| request.mFirstSample - halfWindow + numSamples > history.getEnd())
+	{
+		result.mError = "the region is no longer in the PCM history";
+		return false;
+	}
+
+	//Only the bins of the band get transformed, whatever the FFT size
+	StreamingStft stft;
+	stft.setup(request.mFftSize, request.mWindowSize, request.mHopSize, request.mSampleRate);
+	const float binHz = static_cast<float>(request.mSampleRate) / static_cast<float>(stft.getFftSize());
+	const std::size_t firstBin = std::min(static_cast<std::size_t>(std::floor(request.mMinFreq / binHz)), stft.getNumBins());
+	const std::size_t endBin = std::min(static_cast<std::size_t>(std::ceil(request.mMaxFreq / binHz)) + 1, stft.getNumBins());
+	stft.setBinRange(firstBin, endBin - firstBin);
+	result.mFftSize = stft.getFftSize();
+	result.mFirstBin = stft.getFirstBin();
+	result.mNumBins = stft.getNumOutputBins();
+	if (result.mNumBins == 0 || numRows * result.mNumBins > kMaxResultValues)
+	{
+		result.mError = "region too detailed, select less or use a longer hop";
+		return false;
+	}
+	result.mMagnitudes.resize(numRows * result.mNumBins);
+
+	const std::uint64_t end = request.mFirstSample - halfWindow + numSamples;
+	std::uint64_t next = request.mFirstSample - halfWindow;
+	std::size_t row = 0;
+	mSamples.resize(static_cast<std::size_t>(std::min<std::uint64_t>(kReadSamples, numSamples)));
+	while (row < numRows)
+	{
+		if (mCancelled.load(std::memory_order_relaxed))
+		{
+			result.mError = "cancelled";
+			return false;
+		}
+
+		//Live input keeps overwriting the oldest samples, a region at the edge may lose the race
+		const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(mSamples.size(), end - next));
+		if (!history.read(next, count, mSamples.data()))
+		{
+			result.mError = "the region got overwritten while being analysed";
+			return false;
+		}
+		next += count;
+
+		std::size_t offset = 0;
+		while (offset < count && row < numRows)
+		{
+			offset += stft.write(mSamples.data() + offset, count - offset);
+			if (stft.isFrameReady())
+			{
+				stft.computeFrame(result.mMagnitudes.data() + row * result.mNumBins);
+				row++;
+				mProgress.store(static_cast<float>(row) / static_cast<float>(numRows), std::memory_order_relaxed);
+			}
+		}
+	}
+	result.mNumRows = numRows;
+	return true;
+}
+
+void RegionAnalyzer::stopWorker()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mWorkerRunning = false;
+		mCancelled = true;
+	}
+	mCondition.notify_all();
+	if (mWorker.joinable())
+	{
+		mWorker.join();
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,263 @@
+#include "dsp/signal_generator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	const double kTwoPi = 6.283185307179586476925286766559;
+	const std::size_t kMaxChannels = 32;
+
+	bool parseNumber(const std::string& text, double& value)
+	{
+		char* end = nullptr;
+		value = std::strtod(text.c_str(), &end);
+		return !text.empty() && end && *end == '\0';
+	}
+}
+
+const char* getGeneratorTypeName(GeneratorType type)
+{
+	switch (type)
+	{
+	case GeneratorType::TONE: return "tone";
+	case GeneratorType::MULTI_TONE: return "multitone";
+	case GeneratorType::SWEEP: return "sweep";
+	case GeneratorType::NOISE: return "noise";
+	case GeneratorType::FILE_LOOP: return "file";
+	}
+	return "";
+}
+
+bool parseGeneratorSettings(const std::string& spec, GeneratorSettings& settings, std::string& error)
+{
+	std::stringstream fields(spec);
+	std::string field;
+	while (std::getline(fields, field, ','))
+	{
+		const std::size_t equals = field.find('=');
+		const std::string key = field.substr(0, equals);
+		const std::string value = equals == std::string::npos ? std::string() : field.substr(equals + 1);
+		double number = 0.0;
+
+		if (key == "type")
+		{
+			bool found = false;
+			for (GeneratorType type : { GeneratorType::TONE, GeneratorType::MULTI_TONE, GeneratorType::SWEEP, GeneratorType::NOISE, GeneratorType::FILE_LOOP })
+			{
+				if (value == getGeneratorTypeName(type))
+				{
+					settings.mType = type;
+					found = true;
+				}
+			}
+			if (!found)
+			{
+				error = "unknown generator type " + value;
+				return false;
+			}
+		}
+		else if (key == "freq")
+		{
+			settings.mFrequencies.clear();
+			std::stringstream frequencies(value);
+			std::string frequency;
+			while (std::getline(frequencies, frequency, '+'))
+			{
+				if (!parseNumber(frequency, number) || number <= 0.0)
+				{
+					error = "bad frequency " + frequency;
+					return false;
+				}
+				settings.mFrequencies.push_back(static_cast<float>(number));
+			}
+		}
+		else if (key == "path")
+		{
+			settings.mPath = value;
+		}
+		else if (key == "clock")
+		{
+			if (value != "realtime" && value != "free")
+			{
+				error = "clock is realtime or free, not " + value;
+				return false;
+			}
+			settings.mRealTime = value == "realtime";
+		}
+		else if (!parseNumber(value, number) || number < 0.0)
+		{
+			error = "bad value for " + key + ": " + value;
+			return false;
+		}
+		else if (key == "rate")
+			settings.mSampleRate = static_cast<std::size_t>(number);
+		else if (key == "channels")
+			settings.mNumChannels = static_cast<std::size_t>(number);
+		else if (key == "block")
+			settings.mBlockSize = static_cast<std::size_t>(number);
+		else if (key == "amp")
+			settings.mAmplitude = static_cast<float>(number);
+		else if (key == "from")
+			settings.mSweepStart = static_cast<float>(number);
+		else if (key == "to")
+			settings.mSweepEnd = static_cast<float>(number);
+		else if (key == "seconds")
+			settings.mSweepSeconds = number;
+		else if (key == "seed")
+			settings.mSeed = static_cast<std::uint32_t>(number);
+		else
+		{
+			error = "unknown generator setting " + key;
+			return false;
+		}
+	}
+	return true;
+}
+
+SignalGenerator::SignalGenerator()
+	: mSweepPosition(0)
+	, mFilePosition(0)
+{}
+
+bool SignalGenerator::setup(const GeneratorSettings& settings)
+{
+	mSettings = settings;
+	mError.clear();
+	if (mSettings.mNumChannels == 0 || mSettings.mNumChannels > kMaxChannels || mSettings.mBlockSize == 0)
+	{
+		mError = "channel count or block size out of range";
+		return false;
+	}
+
+	if (mSettings.mType == GeneratorType::FILE_LOOP)
+	{
+		if (!mFile.open(mSettings.mPath))
+		{
+			mError = mFile.getError();
+			return false;
+		}
+		if (mFile.getNumFrames() == 0)
+		{
+			mError = "empty file " + mSettings.mPath;
+			return false;
+		}
+		mSettings.mSampleRate = mFile.getSampleRate();
+	}
+	if (mSettings.mSampleRate == 0)
+	{
+		mError = "sample rate out of range";
+		return false;
+	}
+
+	const std::size_t numTones = mSettings.mType == GeneratorType::MULTI_TONE ? mSettings.mFrequencies.size() : 1;
+	if ((mSettings.mType == GeneratorType::TONE || mSettings.mType == GeneratorType::MULTI_TONE) && mSettings.mFrequencies.empty())
+	{
+		mError = "no tone frequency given";
+		return false;
+	}
+	if (mSettings.mType == GeneratorType::SWEEP && (mSettings.mSweepStart <= 0.0f || mSettings.mSweepEnd <= 0.0f || mSettings.mSweepSeconds <= 0.0))
+	{
+		mError = "sweep range out of range";
+		return false;
+	}
+
+	mPhases.assign(numTones, 0.0);
+	mSweepPosition = 0;
+	mFilePosition = 0;
+	mNoise.clear();
+	for (std::size_t c = 0; c < mSettings.mNumChannels; c++)
+		mNoise.emplace_back(mSettings.mSeed + static_cast<std::uint32_t>(c));
+	return true;
+}
+
+void SignalGenerator::render(float* channels, std::size_t numFrames)
+{
+	if (mSettings.mType == GeneratorType::NOISE)
+	{
+		//Independent per channel, otherwise the down mix would just be the same noise again
+		std::uniform_real_distribution<float> noise(-mSettings.mAmplitude, mSettings.mAmplitude);
+		for (std::size_t c = 0; c < mSettings.mNumChannels; c++)
+		{
+			float* dest = channels + c * numFrames;
+			for (std::size_t i = 0; i < numFrames; i++)
+				dest[i] = noise(mNoise[c]);
+		}
+		return;
+	}
+
+	renderMono(channels, numFrames);
+	for (std::size_t c = 1; c < mSettings.mNumChannels; c++)
+		std::copy(channels, channels + numFrames, channels + c * numFrames);
+}
+
+void SignalGenerator::renderMono(float* dest, std::size_t numFrames)
+{
+	const double sampleRate = static_cast<double>(mSettings.mSampleRate);
+	switch (mSettings.mType)
+	{
+	case GeneratorType::TONE:
+	case GeneratorType::MULTI_TONE:
+	{
+		std::fill(dest, dest + numFrames, 0.0f);
+		const double amplitude = mSettings.mAmplitude / static_cast<double>(mPhases.size());
+		for (std::size_t t = 0; t < mPhases.size(); t++)
+		{
+			//Phase in cycles and wrapped, so it stays exact however long the generator runs
+			const double step = mSettings.mFrequencies[t] / sampleRate;
+			double phase = mPhases[t];
+			for (std::size_t i = 0; i < numFrames; i++)
+			{
+				dest[i] += static_cast<float>(amplitude * std::sin(kTwoPi * phase));
+				phase += step;
+				phase -= std::floor(phase);
+			}
+			mPhases[t] = phase;
+		}
+		break;
+	}
+	case GeneratorType::SWEEP:
+	{
+		const std::uint64_t sweepLength = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(mSettings.mSweepSeconds * sampleRate));
+		const double ratio = std::log(static_cast<double>(mSettings.mSweepEnd) / mSettings.mSweepStart);
+		double phase = mPhases[0];
+		for (std::size_t i = 0; i < numFrames; i++)
+		{
+			const double position = static_cast<double>(mSweepPosition) / static_cast<double>(sweepLength);
+			dest[i] = static_cast<float>(mSettings.mAmplitude * std::sin(kTwoPi * phase));
+			phase += mSettings.mSweepStart * std::exp(ratio * position) / sampleRate;
+			phase -= std::floor(phase);
+			if (++mSweepPosition == sweepLength)
+				mSweepPosition = 0;
+		}
+		mPhases[0] = phase;
+		break;
+	}
+	case GeneratorType::FILE_LOOP:
+	{
+		std::size_t done = 0;
+		while (done < numFrames)
+		{
+			const std::size_t count = std::min(numFrames - done, mFile.getNumFrames() - mFilePosition);
+			mFile.readMono(mFilePosition, count, dest + done);
+			done += count;
+			mFilePosition += count;
+			if (mFilePosition == mFile.getNumFrames())
+				mFilePosition = 0;
+		}
+		break;
+	}
+	case GeneratorType::NOISE:
+		break;
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,405 @@
+#include "dsp/spectrogram_io.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! IDAT chunks are flushed once they reach this size
+	const std::size_t kIdatSize = 65536;
+	//! deflate can only point this far back
+	const std::size_t kWindowSize = 32768;
+	const std::size_t kMinMatch = 3;
+	const std::size_t kMaxMatch = 258;
+	const std::size_t kHashBits = 15;
+
+	const std::uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+	const std::uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+	const std::uint16_t kDistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+	const std::uint8_t kDistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+	std::array<std::uint32_t, 256> makeCrcTable()
+	{
+		std::array<std::uint32_t, 256> table;
+		for (std::uint32_t n = 0; n < 256; n++)
+		{
+			std::uint32_t c = n;
+			for (int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[n] = c;
+		}
+		return table;
+	}
+
+	std::uint32_t crc32(std::uint32_t crc, const std::uint8_t* data, std::size_t size)
+	{
+		//Function statics are initialised once even with several writers on different threads
+		static const std::array<std::uint32_t, 256> table = makeCrcTable();
+
+		crc = ~crc;
+		for (std::size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void putBe32(std::uint8_t* p, std::uint32_t value)
+	{
+		p[0] = static_cast<std::uint8_t>(value >> 24);
+		p[1] = static_cast<std::uint8_t>(value >> 16);
+		p[2] = static_cast<std::uint8_t>(value >> 8);
+		p[3] = static_cast<std::uint8_t>(value);
+	}
+
+	std::uint32_t hash3(const std::uint8_t* p)
+	{
+		const std::uint32_t value = std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16);
+		return (value * 2654435761u) >> (32 - kHashBits);
+	}
+}
+
+PngWriter::PngWriter()
+	: mFile(nullptr)
+	, mWidth(0)
+	, mHeight(0)
+	, mRowsWritten(0)
+	, mFailed(false)
+	, mBitBuffer(0)
+	, mBitCount(0)
+	, mAdlerA(1)
+	, mAdlerB(0)
+{}
+
+PngWriter::~PngWriter()
+{
+	close();
+}
+
+bool PngWriter::open(const std::string& path, std::size_t width, std::size_t height)
+{
+	close();
+
+	mFile = std::fopen(path.c_str(), "wb");
+	if (!mFile)
+		return false;
+
+	mWidth = width;
+	mHeight = height;
+	mRowsWritten = 0;
+	mFailed = false;
+	mPreviousRow.assign(4 * width, 0);
+	mHashHeads.assign(std::size_t(1) << kHashBits, -1);
+	mIdat.clear();
+	mBitBuffer = 0;
+	mBitCount = 0;
+	mAdlerA = 1;
+	mAdlerB = 0;
+
+	static const std::uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	mFailed = std::fwrite(signature, 1, sizeof(signature), mFile) != sizeof(signature);
+
+	//8 bit RGBA, no interlacing
+	std::uint8_t header[13];
+	putBe32(header, static_cast<std::uint32_t>(width));
+	putBe32(header + 4, static_cast<std::uint32_t>(height));
+	header[8] = 8;
+	header[9] = 6;
+	header[10] = 0;
+	header[11] = 0;
+	header[12] = 0;
+	writeChunk("IHDR", header, sizeof(header));
+
+	//zlib stream header: deflate, 32K window, no dictionary
+	mIdat.push_back(0x78);
+	mIdat.push_back(0x01);
+	return !mFailed;
+}
+
+bool PngWriter::appendRows(const std::uint32_t* rgba, std::size_t numRows)
+{
+	if (!mFile)
+		return false;
+	numRows = std::min(numRows, mHeight - mRowsWritten);
+	if (numRows == 0)
+		return !mFailed;
+
+	//Filter type 2 (Up): each byte minus the one above it, the first row sees zeros above
+	const std::size_t rowBytes = 4 * mWidth;
+	mFiltered.resize(numRows * (rowBytes + 1));
+	std::uint8_t* out = mFiltered.data();
+	for (std::size_t row = 0; row < numRows; row++)
+	{
+		*out++ = 2;
+		const std::uint32_t* pixels = rgba + row * mWidth;
+		for (std::size_t x = 0; x < mWidth; x++)
+		{
+			const std::uint8_t bytes[4] = {
+				static_cast<std::uint8_t>(pixels[x]),
+				static_cast<std::uint8_t>(pixels[x] >> 8),
+				static_cast<std::uint8_t>(pixels[x] >> 16),
+				static_cast<std::uint8_t>(pixels[x] >> 24) };
+			for (int c = 0; c < 4; c++)
+			{
+				*out++ = static_cast<std::uint8_t>(bytes[c] - mPreviousRow[4 * x + c]);
+				mPreviousRow[4 * x + c] = bytes[c];
+			}
+		}
+	}
+
+	//Adler-32 of the uncompressed stream, with the modulo deferred as long as it can't overflow
+	for (std::size_t pos = 0; pos < mFiltered.size();)
+	{
+		const std::size_t end = std::min(mFiltered.size(), pos + 5552);
+		for (; pos < end; pos++)
+		{
+			mAdlerA += mFiltered[pos];
+			mAdlerB += mAdlerA;
+		}
+		mAdlerA %= 65521;
+		mAdlerB %= 65521;
+	}
+
+	deflate(mFiltered.data(), mFiltered.size(), false);
+	mRowsWritten += numRows;
+	return !mFailed;
+}
+
+bool PngWriter::close()
+{
+	if (!mFile)
+		return false;
+
+	if (mRowsWritten < mHeight)
+	{
+		const std::vector<std::uint32_t> black(mWidth, 0xff000000u);
+		while (mRowsWritten < mHeight)
+			appendRows(black.data(), 1);
+	}
+
+	//An empty final block, then the Adler-32 on a byte boundary
+	putBits(1, 1);
+	putBits(1, 2);
+	putHuffman(0, 7);
+	if (mBitCount > 0)
+		putBits(0, 8 - mBitCount);
+	std::uint8_t adler[4];
+	putBe32(adler, (mAdlerB << 16) | mAdlerA);
+	mIdat.insert(mIdat.end(), adler, adler + 4);
+	flushIdat();
+	writeChunk("IEND", nullptr, 0);
+
+	const bool ok = !mFailed && std::fclose(mFile) == 0;
+	mFile = nullptr;
+	return ok;
+}
+
+void PngWriter::putBits(std::uint32_t bits, std::size_t count)
+{
+	//Deflate packs bits starting at the least significant one
+	mBitBuffer |= bits << mBitCount;
+	mBitCount += count;
+	while (mBitCount >= 8)
+	{
+		mIdat.push_back(static_cast<std::uint8_t>(mBitBuffer));
+		mBitBuffer >>= 8;
+		mBitCount -= 8;
+	}
+	if (mIdat.size() >= kIdatSize)
+		flushIdat();
+}
+
+void PngWriter::putHuffman(std::uint32_t code, std::size_t length)
+{
+	//Huffman codes go out most significant bit first
+	std::uint32_t reversed = 0;
+	for (std::size_t i = 0; i < length; i++)
+		reversed |= ((code >> i) & 1) << (length - 1 - i);
+	putBits(reversed, length);
+}
+
+void PngWriter::putLiteral(std::uint8_t value)
+{
+	if (value < 144)
+		putHuffman(0x30 + value, 8);
+	else
+		putHuffman(0x190 + (value - 144), 9);
+}
+
+void PngWriter::putMatch(std::size_t length, std::size_t distance)
+{
+	std::size_t code = 0;
+	while (code + 1 < 29 && kLengthBase[code + 1] <= length)
+		code++;
+	const std::uint32_t symbol = static_cast<std::uint32_t>(257 + code);
+	if (symbol < 280)
+		putHuffman(symbol - 256, 7);
+	else
+		putHuffman(0xc0 + (symbol - 280), 8);
+	putBits(static_cast<std::uint32_t>(length - kLengthBase[code]), kLengthExtra[code]);
+
+	std::size_t distanceCode = 0;
+	while (distanceCode + 1 < 30 && kDistanceBase[distanceCode + 1] <= distance)
+		distanceCode++;
+	putHuffman(static_cast<std::uint32_t>(distanceCode), 5);
+	putBits(static_cast<std::uint32_t>(distance - kDistanceBase[distanceCode]), kDistanceExtra[distanceCode]);
+}
+
+void PngWriter::deflate(const std::uint8_t* data, std::size_t size, bool last)
+{
+	//One fixed Huffman block, matches only reach back inside this block
+	putBits(last ? 1 : 0, 1);
+	putBits(1, 2);
+	std::fill(mHashHeads.begin(), mHashHeads.end(), -1);
+
+	std::size_t pos = 0;
+	while (pos < size)
+	{
+		std::size_t matchLength = 0;
+		std::size_t matchDistance = 0;
+		if (pos + kMinMatch <= size)
+		{
+			const std::uint32_t h = hash3(data + pos);
+			const std::int32_t candidate = mHashHeads[h];
+			mHashHeads[h] = static_cast<std::int32_t>(pos);
+			if (candidate >= 0 && pos - candidate <= kWindowSize)
+			{
+				const std::size_t limit = std::min(kMaxMatch, size - pos);
+				const std::uint8_t* a = data + candidate;
+				const std::uint8_t* b = data + pos;
+				std::size_t length = 0;
+				while (length < limit && a[length] == b[length])
+					length++;
+				if (length >= kMinMatch)
+				{
+					matchLength = length;
+					matchDistance = pos - candidate;
+				}
+			}
+		}
+
+		if (matchLength == 0)
+		{
+			putLiteral(data[pos]);
+			pos++;
+			continue;
+		}
+
+		putMatch(matchLength, matchDistance);
+		//Index the positions the match skipped so later runs can refer to them
+		const std::size_t end = pos + matchLength;
+		for (pos++; pos < end; pos++)
+		{
+			if (pos + kMinMatch <= size)
+				mHashHeads[hash3(data + pos)] = static_cast<std::int32_t>(pos);
+		}
+	}
+
+	//End of block
+	putHuffman(0, 7);
+}
+
+void PngWriter::flushIdat()
+{
+	if (mIdat.empty())
+		return;
+	writeChunk("IDAT", mIdat.data(), mIdat.size());
+	mIdat.clear();
+}
+
+void PngWriter::writeChunk(const char* type, const std::uint8_t* data, std::size_t size)
+{
+	std::uint8_t header[8];
+	putBe32(header, static_cast<std::uint32_t>(size));
+	std::memcpy(header + 4, type, 4);
+
+	std::uint32_t crc = crc32(0, header + 4, 4);
+	if (size > 0)
+		crc = crc32(crc, data, size);
+	std::uint8_t trailer[4];
+	putBe32(trailer, crc);
+
+	bool ok = std::fwrite(header, 1, 8, mFile) == 8;
+	if (size > 0)
+		ok = ok && std::fwrite(data, 1, size, mFile) == size;
+	ok = ok && std::fwrite(trailer, 1, 4, mFile) == 4;
+	mFailed = mFailed || !ok;
+}
+
+NpyWriter::NpyWriter()
+	: mFile(nullptr)
+	, mRows(0)
+	, mColumns(0)
+	, mRowsWritten(0)
+	, mFailed(false)
+{}
+
+NpyWriter::~NpyWriter()
+{
+	close();
+}
+
+bool NpyWriter::open(const std::string& path, std::size_t rows, std::size_t columns)
+{
+	close();
+
+	mFile = std::fopen(path.c_str(), "wb");
+	if (!mFile)
+		return false;
+
+	mRows = rows;
+	mColumns = columns;
+	mRowsWritten = 0;
+
+	//Data is written in host byte order, tell numpy which one that is
+	const std::uint16_t probe = 1;
+	std::uint8_t firstByte;
+	std::memcpy(&firstByte, &probe, 1);
+	std::string header = std::string("{'descr': '") + (firstByte ? "<" : ">") + "f4', 'fortran_order': False, 'shape': ("
+		+ std::to_string(rows) + ", " + std::to_string(columns) + "), }";
+	//Magic, version and length take 10 bytes, the whole preamble is padded to 64
+	const std::size_t total = (10 + header.size() + 1 + 63) / 64 * 64;
+	header.append(total - 10 - header.size() - 1, ' ');
+	header += '\n';
+
+	const std::uint8_t preamble[10] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0,
+		static_cast<std::uint8_t>(header.size() & 0xff), static_cast<std::uint8_t>(header.size() >> 8) };
+	mFailed = std::fwrite(preamble, 1, sizeof(preamble), mFile) != sizeof(preamble)
+		|| std::fwrite(header.data(), 1, header.size(), mFile) != header.size();
+	return !mFailed;
+}
+
+bool NpyWriter::appendRows(const float* data, std::size_t numRows)
+{
+	if (!mFile)
+		return false;
+	numRows = std::min(numRows, mRows - mRowsWritten);
+	const std::size_t count = numRows * mColumns;
+	mFailed = mFailed || std::fwrite(data, sizeof(float), count, mFile) != count;
+	mRowsWritten += numRows;
+	return !mFailed;
+}
+
+bool NpyWriter::close()
+{
+	if (!mFile)
+		return false;
+
+	if (mRowsWritten < mRows)
+	{
+		const std::vector<float> zeros(mColumns, 0.0f);
+		while (mRowsWritten < mRows)
+			appendRows(zeros.data(), 1);
+	}
+
+	const bool ok = !mFailed && std::fclose(mFile) == 0;
+	mFile = nullptr;
+	return ok;
+}
+
+} //!dsp
+} //!cieq
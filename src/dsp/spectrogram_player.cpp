@@ -0,0 +1,204 @@
+#include "dsp/spectrogram_player.h"
+#include "dsp/profiler.h"
+
+#include <algorithm>
+
+namespace cieq
+{
+namespace dsp
+{
+
+SpectrogramPlayer::SpectrogramPlayer()
+	: mUseCounter(0)
+	, mNumCacheMisses(0)
+	, mPosition(0.0)
+	, mNextFrame(0)
+	, mNextGeneration(0)
+	, mPlaying(false)
+{}
+
+bool SpectrogramPlayer::open(const std::string& path)
+{
+	close();
+	if (!mRecording.open(path))
+	{
+		mError = mRecording.getError();
+		return false;
+	}
+	if (mRecording.getNumFrames() == 0)
+	{
+		mRecording.close();
+		mError = path + " holds no frames";
+		return false;
+	}
+
+	mCache.resize(kNumCachedChunks);
+	mPosition = mRecording.getStartTime();
+	locateNextFrame();
+	return true;
+}
+
+void SpectrogramPlayer::close()
+{
+	mRecording.close();
+	mCache.clear();
+	mGeometries.clear();
+	mUseCounter = 0;
+	mNumCacheMisses = 0;
+	mPosition = 0.0;
+	mNextFrame = 0;
+	mNextGeometry = RecordingGeometry();
+	mNextGeneration = 0;
+	mPlaying = false;
+}
+
+void SpectrogramPlayer::setPlaying(bool playing)
+{
+	//Playing from the end starts over
+	if (playing && !mPlaying && mNextFrame >= mRecording.getNumFrames())
+		seek(mRecording.getStartTime(), 0);
+	mPlaying = playing && isOpen();
+}
+
+void SpectrogramPlayer::advance(double seconds)
+{
+	if (!mPlaying)
+		return;
+
+	mPosition += seconds;
+	if (mPosition >= mRecording.getEndTime())
+	{
+		mPosition = mRecording.getEndTime();
+		//The last frames still get popped, the playhead just doesn't move on
+		mPlaying = false;
+	}
+}
+
+void SpectrogramPlayer::seek(double time, std::size_t numHistory)
+{
+	CIEQ_PROFILE_ZONE("seek recording");
+	if (!isOpen())
+		return;
+
+	mPosition = std::min(std::max(time, mRecording.getStartTime()), mRecording.getEndTime());
+	const std::uint64_t target = countFramesUntil(mPosition);
+
+	//A small step forward plays the frames in between like normal playback would,
+	//anything else starts over numHistory frames before the playhead
+	if (target >= mNextFrame && target - mNextFrame <= numHistory)
+		return;
+
+	mNextFrame = target > numHistory ? target - numHistory : 0;
+	locateNextFrame();
+}
+
+bool SpectrogramPlayer::popFrame(PlayedFrame& frame)
+{
+	if (mNextFrame >= mRecording.getNumFrames())
+		return false;
+
+	const std::size_t index = findChunkOfFrame(mNextFrame);
+	const DecodedChunk* chunk = getChunk(index);
+	if (!chunk)
+		return false;
+
+	const std::size_t row = static_cast<std::size_t>(mNextFrame - mRecording.getChunk(index).mFirstFrame);
+	if (row >= chunk->mTimes.size() || chunk->mTimes[row] > mPosition)
+		return false;
+
+	const std::size_t numBins = chunk->mGeometry.mNumBins;
+	frame.mIndex = mNextFrame;
+	frame.mTime = chunk->mTimes[row];
+	frame.mGeometry = chunk->mGeometry;
+	frame.mGeneration = getGeometryGeneration(chunk->mGeometry);
+	frame.mMagnitudes.assign(chunk->mMagnitudes.begin() + row * numBins, chunk->mMagnitudes.begin() + (row + 1) * numBins);
+
+	mNextFrame++;
+	//Geometry only changes between chunks
+	if (mNextFrame < mRecording.getNumFrames() && row + 1 == chunk->mTimes.size())
+		locateNextFrame();
+	return true;
+}
+
+double SpectrogramPlayer::getFrameRate() const
+{
+	const double duration = mRecording.getEndTime() - mRecording.getStartTime();
+	return duration > 0.0 ? static_cast<double>(mRecording.getNumFrames() - 1) / duration : 0.0;
+}
+
+const DecodedChunk* SpectrogramPlayer::getChunk(std::size_t index)
+{
+	mUseCounter++;
+	CachedChunk* oldest = &mCache.front();
+	for (CachedChunk& cached : mCache)
+	{
+		if (cached.mValid && cached.mChunk.mIndex == index)
+		{
+			cached.mLastUse = mUseCounter;
+			return &cached.mChunk;
+		}
+		if (!cached.mValid || (oldest->mValid && cached.mLastUse < oldest->mLastUse))
+			oldest = &cached;
+	}
+
+	//The least recently used chunk makes room, its buffers keep their capacity
+	mNumCacheMisses++;
+	oldest->mValid = mRecording.decodeChunk(index, oldest->mChunk);
+	if (!oldest->mValid)
+	{
+		mError = mRecording.getError();
+		return nullptr;
+	}
+	oldest->mLastUse = mUseCounter;
+	return &oldest->mChunk;
+}
+
+std::size_t SpectrogramPlayer::findChunkOfFrame(std::uint64_t frame) const
+{
+	//Last chunk starting at or before frame
+	std::size_t first = 0;
+	std::size_t last = mRecording.getNumChunks();
+	while (last - first > 1)
+	{
+		const std::size_t middle = first + (last - first) / 2;
+		if (mRecording.getChunk(middle).mFirstFrame <= frame)
+			first = middle;
+		else
+			last = middle;
+	}
+	return first;
+}
+
+std::uint64_t SpectrogramPlayer::countFramesUntil(double time)
+{
+	const std::size_t index = mRecording.findChunk(time);
+	const DecodedChunk* chunk = getChunk(index);
+	if (!chunk)
+		return mNextFrame;
+
+	const std::size_t rows = static_cast<std::size_t>(std::upper_bound(chunk->mTimes.begin(), chunk->mTimes.end(), time) - chunk->mTimes.begin());
+	return mRecording.getChunk(index).mFirstFrame + rows;
+}
+
+void SpectrogramPlayer::locateNextFrame()
+{
+	const std::uint64_t frame = std::min(mNextFrame, mRecording.getNumFrames() - 1);
+	const DecodedChunk* chunk = getChunk(findChunkOfFrame(frame));
+	if (!chunk)
+		return;
+
+	mNextGeometry = chunk->mGeometry;
+	mNextGeneration = getGeometryGeneration(chunk->mGeometry);
+}
+
+std::uint32_t SpectrogramPlayer::getGeometryGeneration(const RecordingGeometry& geometry)
+{
+	//A recording switches geometry a handful of times at most
+	auto known = std::find(mGeometries.begin(), mGeometries.end(), geometry);
+	if (known == mGeometries.end())
+		known = mGeometries.insert(mGeometries.end(), geometry);
+	return static_cast<std::uint32_t>(known - mGeometries.begin());
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,336 @@
+#include "dsp/spectrogram_pyramid.h"
+#include "dsp/profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//Tiles one call may write to disk, the rest of a completed tile row follows with the next rows
+	const std::size_t kMaxSpillsPerCall = 1;
+
+	//The spill file outgrows 2 GB within hours, so offsets are 64 bit everywhere
+	bool seekFile(std::FILE* file, std::uint64_t offset)
+	{
+#ifdef _WIN32
+		return _fseeki64(file, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+		return fseeko(file, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+	}
+}
+
+SpectrogramPyramid::SpectrogramPyramid()
+	: mTileBytes(0)
+	, mResidentBytes(0)
+	, mSpillFile(nullptr)
+	, mSpillSize(0)
+	, mNumTileLoads(0)
+{}
+
+SpectrogramPyramid::~SpectrogramPyramid()
+{
+	clear();
+}
+
+bool SpectrogramPyramid::setup(std::size_t numBins, const PyramidSettings& settings)
+{
+	clear();
+	if (numBins == 0 || settings.mTileRows == 0 || settings.mTileBins == 0 || settings.mNumLevels == 0)
+		return fail("empty pyramid");
+
+	mSettings = settings;
+	mTileBytes = mSettings.mTileRows * mSettings.mTileBins * sizeof(float);
+	mLevels.resize(mSettings.mNumLevels);
+	for (std::size_t l = 0; l < mLevels.size(); l++)
+	{
+		Level& level = mLevels[l];
+		level.mBinPooling = getBinPooling(numBins, l, mSettings);
+		level.mBinPool = l == 0 ? 1 : level.mBinPooling / mLevels[l - 1].mBinPooling;
+		level.mNumBins = (numBins + level.mBinPooling - 1) / level.mBinPooling;
+		level.mNumColumns = (level.mNumBins + mSettings.mTileBins - 1) / mSettings.mTileBins;
+		level.mNumRows = 0;
+		level.mHalf.resize(level.mNumBins);
+		level.mHasHalf = false;
+		level.mRow.resize(level.mNumBins);
+	}
+
+	//No spill file only costs the memory bound, the history itself still works
+	mSpillFile = mSettings.mSpillPath.empty() ? std::tmpfile() : std::fopen(mSettings.mSpillPath.c_str(), "w+b");
+	if (!mSpillFile)
+		return fail("can't create a spill file, the history stays in memory");
+	return true;
+}
+
+void SpectrogramPyramid::clear()
+{
+	mLevels.clear();
+	mTiles.clear();
+	mRecent.clear();
+	mResidentBytes = 0;
+	mSpillSize = 0;
+	mNumTileLoads = 0;
+	mError.clear();
+	if (mSpillFile)
+	{
+		std::fclose(mSpillFile);
+		mSpillFile = nullptr;
+		if (!mSettings.mSpillPath.empty())
+			std::remove(mSettings.mSpillPath.c_str());
+	}
+}
+
+std::size_t SpectrogramPyramid::getBinPooling(std::size_t numBins, std::size_t level, const PyramidSettings& settings)
+{
+	std::size_t pooling = 1;
+	std::size_t bins = numBins;
+	for (std::size_t l = 0; l < level; l++)
+	{
+		if ((bins + 1) / 2 < settings.mMinLevelBins)
+			break;
+		bins = (bins + 1) / 2;
+		pooling *= 2;
+	}
+	return pooling;
+}
+
+void SpectrogramPyramid::append(const float* magnitudes)
+{
+	CIEQ_PROFILE_ZONE("append history");
+	if (mLevels.empty())
+		return;
+
+	//Every level above gets a row for every second row of the one below, so a row costs
+	//at most about twice its own copy however many levels there are
+	const float* row = magnitudes;
+	for (std::size_t l = 0; l < mLevels.size(); l++)
+	{
+		writeRow(l, row);
+		if (l + 1 == mLevels.size())
+			break;
+
+		Level& level = mLevels[l];
+		Level& next = mLevels[l + 1];
+		if (!next.mHasHalf)
+		{
+			poolBins(row, level.mNumBins, next.mBinPool, next.mHalf.data());
+			next.mHasHalf = true;
+			break;
+		}
+
+		poolBins(row, level.mNumBins, next.mBinPool, next.mRow.data());
+		if (mSettings.mPooling == PyramidPooling::MAX)
+		{
+			for (std::size_t i = 0; i < next.mNumBins; i++)
+				next.mRow[i] = std::max(next.mRow[i], next.mHalf[i]);
+		}
+		else
+		{
+			for (std::size_t i = 0; i < next.mNumBins; i++)
+				next.mRow[i] = 0.5f * (next.mRow[i] + next.mHalf[i]);
+		}
+		next.mHasHalf = false;
+		row = next.mRow.data();
+	}
+	//A completed tile row spills a few tiles at once, spread over the next rows instead
+	enforceBudget(kMaxSpillsPerCall);
+}
+
+bool SpectrogramPyramid::readRows(std::size_t level, std::uint64_t firstRow, std::size_t numRows, float* dest)
+{
+	CIEQ_PROFILE_ZONE("read history");
+	if (level >= mLevels.size() || firstRow + numRows > mLevels[level].mNumRows)
+		return fail("rows not in the history");
+
+	const Level& current = mLevels[level];
+	const std::size_t tileRows = mSettings.mTileRows;
+	const std::size_t tileBins = mSettings.mTileBins;
+	std::uint64_t row = firstRow;
+	while (row < firstRow + numRows)
+	{
+		//One tile row at a time, every column of it
+		const std::uint64_t tileRow = row / tileRows;
+		const std::size_t first = static_cast<std::size_t>(row % tileRows);
+		const std::size_t count = static_cast<std::size_t>(std::min<std::uint64_t>(tileRows - first, firstRow + numRows - row));
+		for (std::size_t c = 0; c < current.mNumColumns; c++)
+		{
+			const Tile* tile = getResidentTile(current.mTileIndices[static_cast<std::size_t>(tileRow) * current.mNumColumns + c]);
+			if (!tile)
+				return false;
+
+			const std::size_t width = std::min(tileBins, current.mNumBins - c * tileBins);
+			for (std::size_t r = 0; r < count; r++)
+			{
+				float* out = dest + static_cast<std::size_t>(row - firstRow + r) * current.mNumBins + c * tileBins;
+				std::memcpy(out, tile->mData.data() + (first + r) * tileBins, width * sizeof(float));
+			}
+		}
+		row += count;
+	}
+	//Tiles read back are on disk already, making room for them costs no writes
+	enforceBudget(kMaxSpillsPerCall);
+	return true;
+}
+
+void SpectrogramPyramid::writeRow(std::size_t l, const float* row)
+{
+	Level& level = mLevels[l];
+	const std::size_t tileRows = mSettings.mTileRows;
+	const std::size_t tileBins = mSettings.mTileBins;
+	const std::size_t rowInTile = static_cast<std::size_t>(level.mNumRows % tileRows);
+	if (rowInTile == 0)
+	{
+		for (std::size_t c = 0; c < level.mNumColumns; c++)
+			level.mTileIndices.push_back(createTile());
+	}
+
+	//The tiles being written are incomplete, so they are never spilled and always in memory.
+	//They grow with their rows, an upper level that gets a row every few minutes costs
+	//little until its tiles fill up.
+	const std::size_t firstTile = level.mTileIndices.size() - level.mNumColumns;
+	for (std::size_t c = 0; c < level.mNumColumns; c++)
+	{
+		Tile& tile = mTiles[level.mTileIndices[firstTile + c]];
+		if (tile.mData.size() < (rowInTile + 1) * tileBins)
+			growTile(tile, (rowInTile + 1) * tileBins);
+		const std::size_t width = std::min(tileBins, level.mNumBins - c * tileBins);
+		std::memcpy(tile.mData.data() + rowInTile * tileBins, row + c * tileBins, width * sizeof(float));
+		tile.mComplete = rowInTile + 1 == tileRows;
+		mRecent.splice(mRecent.begin(), mRecent, tile.mRecent);
+	}
+	level.mNumRows++;
+}
+
+void SpectrogramPyramid::poolBins(const float* source, std::size_t numBins, std::size_t pool, float* dest) const
+{
+	if (pool == 1)
+	{
+		std::memcpy(dest, source, numBins * sizeof(float));
+		return;
+	}
+
+	const std::size_t numPairs = numBins / 2;
+	if (mSettings.mPooling == PyramidPooling::MAX)
+	{
+		for (std::size_t i = 0; i < numPairs; i++)
+			dest[i] = std::max(source[2 * i], source[2 * i + 1]);
+	}
+	else
+	{
+		for (std::size_t i = 0; i < numPairs; i++)
+			dest[i] = 0.5f * (source[2 * i] + source[2 * i + 1]);
+	}
+	//An odd bin out pools on its own
+	if (numBins % 2)
+		dest[numPairs] = source[numBins - 1];
+}
+
+std::size_t SpectrogramPyramid::createTile()
+{
+	const std::size_t index = mTiles.size();
+	mTiles.emplace_back();
+	Tile& tile = mTiles.back();
+	mRecent.push_front(index);
+	tile.mRecent = mRecent.begin();
+	return index;
+}
+
+void SpectrogramPyramid::growTile(Tile& tile, std::size_t size)
+{
+	//Doubling, capped at the full tile so a complete one holds exactly mTileBytes
+	const std::size_t full = mSettings.mTileRows * mSettings.mTileBins;
+	const std::size_t before = tile.mData.capacity();
+	if (size > before)
+		tile.mData.reserve(std::min(std::max(size, 2 * before), full));
+	tile.mData.resize(size);
+	mResidentBytes += (tile.mData.capacity() - before) * sizeof(float);
+}
+
+SpectrogramPyramid::Tile* SpectrogramPyramid::getResidentTile(std::size_t index)
+{
+	Tile& tile = mTiles[index];
+	if (!tile.mData.empty())
+	{
+		mRecent.splice(mRecent.begin(), mRecent, tile.mRecent);
+		return &tile;
+	}
+
+	CIEQ_PROFILE_ZONE("load tile");
+	if (!mSpillFile)
+	{
+		fail("the spill file is gone, spilled tiles can't be read back");
+		return nullptr;
+	}
+	tile.mData.resize(mSettings.mTileRows * mSettings.mTileBins);
+	if (!seekFile(mSpillFile, tile.mSpillOffset) || std::fread(tile.mData.data(), mTileBytes, 1, mSpillFile) != 1)
+	{
+		std::vector<float>().swap(tile.mData);
+		fail("can't read a spilled tile back");
+		return nullptr;
+	}
+	mRecent.push_front(index);
+	tile.mRecent = mRecent.begin();
+	mResidentBytes += mTileBytes;
+	mNumTileLoads++;
+	return &tile;
+}
+
+void SpectrogramPyramid::enforceBudget(std::size_t maxSpills)
+{
+	//Oldest first, skipping the tiles still being written
+	auto recent = mRecent.end();
+	while (mResidentBytes > mSettings.mMemoryBudget && recent != mRecent.begin())
+	{
+		--recent;
+		Tile& tile = mTiles[*recent];
+		if (!tile.mComplete)
+			continue;
+		if (!tile.mSpilled)
+		{
+			//Out of writes for now, tiles already on disk further up can still go
+			if (maxSpills == 0)
+				continue;
+			if (!spill(tile))
+				return;
+			maxSpills--;
+		}
+
+		//A complete tile never changes, once on disk its memory can go at any time
+		std::vector<float>().swap(tile.mData);
+		mResidentBytes -= mTileBytes;
+		recent = mRecent.erase(recent);
+	}
+}
+
+bool SpectrogramPyramid::spill(Tile& tile)
+{
+	if (!mSpillFile)
+		return false;
+
+	CIEQ_PROFILE_ZONE("spill tile");
+	if (!seekFile(mSpillFile, mSpillSize) || std::fwrite(tile.mData.data(), mTileBytes, 1, mSpillFile) != 1)
+	{
+		//Disk full, the history keeps growing in memory instead
+		std::fclose(mSpillFile);
+		mSpillFile = nullptr;
+		return fail("can't write the spill file, the history stays in memory");
+	}
+	tile.mSpillOffset = mSpillSize;
+	tile.mSpilled = true;
+	mSpillSize += mTileBytes;
+	return true;
+}
+
+bool SpectrogramPyramid::fail(const std::string& error)
+{
+	mError = error;
+	return false;
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,645 @@
+#include "dsp/spectrogram_recording.h"
+#include "dsp/lz4.h"
+#include "dsp/profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//Everything on disk is little endian, doubles as their IEEE 754 bit pattern
+	const char kFileMagic[8] = { 'C', 'I', 'E', 'Q', 'S', 'P', 'E', 'C' };
+	const char kIndexMagic[8] = { 'C', 'I', 'E', 'Q', 'I', 'D', 'X', '1' };
+	const std::uint32_t kVersion = 1;
+	const std::uint32_t kChunkMagic = 0x4b4e4843; // "CHNK"
+	const std::uint32_t kFlagCompressed = 1;
+
+	// magic, version, bits, flags, min dB, max dB, frames per chunk
+	const std::size_t kFileHeaderSize = 32;
+	// magic, frames, sample rate, fft size, first bin, bins, first time, last time, stored size, raw size
+	const std::size_t kChunkHeaderSize = 48;
+	// offset, first frame, first time, last time, frames, reserved
+	const std::size_t kIndexEntrySize = 40;
+	// index offset, chunks, reserved, magic
+	const std::size_t kFooterSize = 24;
+
+	//Same floor as the colormap's dB mode, ci::audio::linearToDecibel
+	const float kMinMagnitude = 1.0e-5f;
+	const float kDecibelOffset = 100.0f;
+
+	void putU32(std::uint8_t* dest, std::uint32_t value)
+	{
+		for (std::size_t i = 0; i < 4; i++)
+			dest[i] = static_cast<std::uint8_t>(value >> (8 * i));
+	}
+
+	void putU64(std::uint8_t* dest, std::uint64_t value)
+	{
+		for (std::size_t i = 0; i < 8; i++)
+			dest[i] = static_cast<std::uint8_t>(value >> (8 * i));
+	}
+
+	void putF64(std::uint8_t* dest, double value)
+	{
+		std::uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		putU64(dest, bits);
+	}
+
+	void putF32(std::uint8_t* dest, float value)
+	{
+		std::uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		putU32(dest, bits);
+	}
+
+	std::uint32_t getU32(const std::uint8_t* source)
+	{
+		std::uint32_t value = 0;
+		for (std::size_t i = 0; i < 4; i++)
+			value |= static_cast<std::uint32_t>(source[i]) << (8 * i);
+		return value;
+	}
+
+	std::uint64_t getU64(const std::uint8_t* source)
+	{
+		std::uint64_t value = 0;
+		for (std::size_t i = 0; i < 8; i++)
+			value |= static_cast<std::uint64_t>(source[i]) << (8 * i);
+		return value;
+	}
+
+	double getF64(const std::uint8_t* source)
+	{
+		const std::uint64_t bits = getU64(source);
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	float getF32(const std::uint8_t* source)
+	{
+		const std::uint32_t bits = getU32(source);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	struct ChunkHeader
+	{
+		std::uint32_t		mNumFrames;
+		RecordingGeometry	mGeometry;
+		double				mFirstTime;
+		double				mLastTime;
+		std::uint32_t		mStoredSize;
+		std::uint32_t		mRawSize;
+	};
+
+	bool parseChunkHeader(const std::uint8_t* source, std::size_t bytesPerValue, ChunkHeader& header)
+	{
+		if (getU32(source) != kChunkMagic)
+			return false;
+
+		header.mNumFrames = getU32(source + 4);
+		header.mGeometry.mSampleRate = getU32(source + 8);
+		header.mGeometry.mFftSize = getU32(source + 12);
+		header.mGeometry.mFirstBin = getU32(source + 16);
+		header.mGeometry.mNumBins = getU32(source + 20);
+		header.mFirstTime = getF64(source + 24);
+		header.mLastTime = getF64(source + 32);
+		header.mStoredSize = getU32(source + 40);
+		header.mRawSize = getU32(source + 44);
+
+		const std::uint64_t rawSize = header.mNumFrames * (8 + static_cast<std::uint64_t>(header.mGeometry.mNumBins) * bytesPerValue);
+		return header.mNumFrames > 0 && rawSize == header.mRawSize && header.mStoredSize <= header.mRawSize;
+	}
+}
+
+bool RecordingGeometry::operator==(const RecordingGeometry& other) const
+{
+	return mSampleRate == other.mSampleRate && mFftSize == other.mFftSize && mFirstBin == other.mFirstBin && mNumBins == other.mNumBins;
+}
+
+SpectrogramRecorder::SpectrogramRecorder()
+	: mFile(nullptr)
+	, mNumPending(0)
+	, mClosing(false)
+	, mNumDropped(0)
+	, mNumWritten(0)
+	, mNumBytes(0)
+	, mOffset(0)
+	, mNumChunkedFrames(0)
+	, mLastTime(0.0)
+	, mFailed(false)
+{}
+
+SpectrogramRecorder::~SpectrogramRecorder()
+{
+	close();
+}
+
+bool SpectrogramRecorder::open(const std::string& path, const RecordingFormat& format)
+{
+	//The writer isn't running, nothing else touches the members until it starts
+	close();
+	mError.clear();
+	if ((format.mBits != 8 && format.mBits != 16) || !(format.mMaxDb > format.mMinDb) || format.mFramesPerChunk == 0 || format.mMaxPendingFrames == 0)
+	{
+		mError = "unsupported recording format";
+		return false;
+	}
+
+	mFile = std::fopen(path.c_str(), "wb");
+	if (!mFile)
+	{
+		mError = "can't create " + path;
+		return false;
+	}
+
+	mFormat = format;
+	mNumPending = 0;
+	mClosing = false;
+	mNumDropped = 0;
+	mNumWritten = 0;
+	mNumBytes = 0;
+	mChunkTimes.clear();
+	mChunkRows.clear();
+	mIndex.clear();
+	mOffset = 0;
+	mNumChunkedFrames = 0;
+	mLastTime = 0.0;
+	mFailed = false;
+
+	std::uint8_t header[kFileHeaderSize] = {};
+	std::memcpy(header, kFileMagic, sizeof(kFileMagic));
+	putU32(header + 8, kVersion);
+	putU32(header + 12, static_cast<std::uint32_t>(mFormat.mBits));
+	putU32(header + 16, mFormat.mCompress ? kFlagCompressed : 0);
+	putF32(header + 20, mFormat.mMinDb);
+	putF32(header + 24, mFormat.mMaxDb);
+	putU32(header + 28, static_cast<std::uint32_t>(mFormat.mFramesPerChunk));
+	write(header, sizeof(header));
+	mNumBytes = mOffset;
+
+	mThread = std::thread(&SpectrogramRecorder::run, this);
+	return true;
+}
+
+bool SpectrogramRecorder::push(double time, const RecordingGeometry& geometry, const float* magnitudes)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (!mFile || mClosing)
+			return false;
+
+		if (mNumPending == mPending.size())
+		{
+			if (mPending.size() >= mFormat.mMaxPendingFrames)
+			{
+				mNumDropped++;
+				return false;
+			}
+			mPending.emplace_back();
+		}
+
+		PendingFrame& slot = mPending[mNumPending++];
+		slot.mTime = time;
+		slot.mGeometry = geometry;
+		slot.mMagnitudes.assign(magnitudes, magnitudes + geometry.mNumBins);
+	}
+	mWake.notify_one();
+	return true;
+}
+
+bool SpectrogramRecorder::close()
+{
+	if (!mThread.joinable())
+		return true;
+
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mClosing = true;
+	}
+	mWake.notify_one();
+	mThread.join();
+
+	const bool closed = std::fclose(mFile) == 0;
+	std::lock_guard<std::mutex> lock(mMutex);
+	mFile = nullptr;
+	if (!closed && mError.empty())
+		mError = "can't finish the recording";
+	return closed && !mFailed;
+}
+
+std::uint64_t SpectrogramRecorder::getNumFramesWritten() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumWritten;
+}
+
+std::uint64_t SpectrogramRecorder::getNumDroppedFrames() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumDropped;
+}
+
+std::uint64_t SpectrogramRecorder::getNumBytesWritten() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mNumBytes;
+}
+
+std::string SpectrogramRecorder::getError() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mError;
+}
+
+void SpectrogramRecorder::run()
+{
+	CIEQ_PROFILE_THREAD("recorder");
+	bool closing = false;
+	while (!closing)
+	{
+		std::size_t count = 0;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this]{ return mNumPending > 0 || mClosing; });
+			//The producer carries on in the other set of slots
+			std::swap(mPending, mWriting);
+			count = mNumPending;
+			mNumPending = 0;
+			closing = mClosing;
+		}
+
+		{
+			CIEQ_PROFILE_ZONE("record frames");
+			for (std::size_t i = 0; i < count; i++)
+				appendFrame(mWriting[i]);
+		}
+
+		if (closing)
+		{
+			flushChunk();
+			writeIndex();
+		}
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mNumWritten += count;
+		mNumBytes = mOffset;
+	}
+}
+
+void SpectrogramRecorder::appendFrame(const PendingFrame& frame)
+{
+	if (!mChunkTimes.empty() && (frame.mGeometry != mChunkGeometry || mChunkTimes.size() >= mFormat.mFramesPerChunk))
+		flushChunk();
+
+	const std::size_t numBins = frame.mGeometry.mNumBins;
+	if (mChunkTimes.empty())
+	{
+		mChunkGeometry = frame.mGeometry;
+		mPreviousRow.assign(numBins, 0);
+	}
+
+	//The index is searched by time, so it must never go backwards
+	mLastTime = std::max(mLastTime, frame.mTime);
+	mChunkTimes.push_back(mLastTime);
+
+	//Rows change slowly from one frame to the next, storing the difference to the
+	//previous row (PNG's "Up" filter) leaves LZ4 mostly runs of small values
+	const std::size_t bytesPerValue = mFormat.mBits / 8;
+	const std::uint32_t maxCode = (std::uint32_t(1) << mFormat.mBits) - 1;
+	const float scale = static_cast<float>(maxCode) / (mFormat.mMaxDb - mFormat.mMinDb);
+	const std::size_t rowStart = mChunkRows.size();
+	mChunkRows.resize(rowStart + numBins * bytesPerValue);
+	std::uint8_t* row = mChunkRows.data() + rowStart;
+	for (std::size_t i = 0; i < numBins; i++)
+	{
+		const float decibels = 20.0f * std::log10(std::max(frame.mMagnitudes[i], kMinMagnitude)) + kDecibelOffset;
+		const float level = std::min(std::max((decibels - mFormat.mMinDb) * scale, 0.0f), static_cast<float>(maxCode));
+		const std::uint16_t code = static_cast<std::uint16_t>(level + 0.5f);
+		const std::uint16_t delta = static_cast<std::uint16_t>(code - mPreviousRow[i]);
+		mPreviousRow[i] = code;
+
+		row[i * bytesPerValue] = static_cast<std::uint8_t>(delta & 0xff);
+		if (bytesPerValue == 2)
+			row[i * bytesPerValue + 1] = static_cast<std::uint8_t>(delta >> 8);
+	}
+}
+
+void SpectrogramRecorder::flushChunk()
+{
+	if (mChunkTimes.empty())
+		return;
+
+	//Raw payload: one time per frame, then the filtered rows
+	const std::size_t numFrames = mChunkTimes.size();
+	mRaw.resize(numFrames * 8 + mChunkRows.size());
+	for (std::size_t i = 0; i < numFrames; i++)
+		putF64(mRaw.data() + 8 * i, mChunkTimes[i]);
+	std::copy(mChunkRows.begin(), mChunkRows.end(), mRaw.begin() + numFrames * 8);
+
+	//Stored raw whenever compressing doesn't pay, a reader tells by the sizes
+	const std::uint8_t* payload = mRaw.data();
+	std::size_t payloadSize = mRaw.size();
+	if (mFormat.mCompress)
+	{
+		lz4Compress(mRaw.data(), mRaw.size(), mCompressed);
+		if (mCompressed.size() < mRaw.size())
+		{
+			payload = mCompressed.data();
+			payloadSize = mCompressed.size();
+		}
+	}
+
+	std::uint8_t header[kChunkHeaderSize];
+	putU32(header, kChunkMagic);
+	putU32(header + 4, static_cast<std::uint32_t>(numFrames));
+	putU32(header + 8, mChunkGeometry.mSampleRate);
+	putU32(header + 12, mChunkGeometry.mFftSize);
+	putU32(header + 16, mChunkGeometry.mFirstBin);
+	putU32(header + 20, mChunkGeometry.mNumBins);
+	putF64(header + 24, mChunkTimes.front());
+	putF64(header + 32, mChunkTimes.back());
+	putU32(header + 40, static_cast<std::uint32_t>(payloadSize));
+	putU32(header + 44, static_cast<std::uint32_t>(mRaw.size()));
+
+	mIndex.push_back(RecordedChunk{ mOffset, mNumChunkedFrames, mChunkTimes.front(), mChunkTimes.back(), static_cast<std::uint32_t>(numFrames) });
+	write(header, sizeof(header));
+	write(payload, payloadSize);
+
+	mNumChunkedFrames += numFrames;
+	mChunkTimes.clear();
+	mChunkRows.clear();
+}
+
+void SpectrogramRecorder::writeIndex()
+{
+	const std::uint64_t indexOffset = mOffset;
+	std::vector<std::uint8_t> index(mIndex.size() * kIndexEntrySize + kFooterSize, 0);
+	std::uint8_t* entry = index.data();
+	for (const RecordedChunk& chunk : mIndex)
+	{
+		putU64(entry, chunk.mOffset);
+		putU64(entry + 8, chunk.mFirstFrame);
+		putF64(entry + 16, chunk.mFirstTime);
+		putF64(entry + 24, chunk.mLastTime);
+		putU32(entry + 32, chunk.mNumFrames);
+		entry += kIndexEntrySize;
+	}
+	putU64(entry, indexOffset);
+	putU32(entry + 8, static_cast<std::uint32_t>(mIndex.size()));
+	std::memcpy(entry + 16, kIndexMagic, sizeof(kIndexMagic));
+	write(index.data(), index.size());
+}
+
+void SpectrogramRecorder::write(const std::uint8_t* data, std::size_t size)
+{
+	if (mFailed)
+		return;
+
+	if (std::fwrite(data, 1, size, mFile) != size)
+	{
+		mFailed = true;
+		std::lock_guard<std::mutex> lock(mMutex);
+		mError = "write failed, disk full?";
+		return;
+	}
+	mOffset += size;
+}
+
+SpectrogramRecording::SpectrogramRecording()
+	: mNumFrames(0)
+	, mRecovered(false)
+{}
+
+SpectrogramRecording::~SpectrogramRecording()
+{
+	close();
+}
+
+bool SpectrogramRecording::open(const std::string& path)
+{
+	close();
+	if (!mFile.open(path))
+		return failOpen("can't open " + path);
+
+	const std::uint8_t* data = mFile.getData();
+	if (mFile.getSize() < kFileHeaderSize || std::memcmp(data, kFileMagic, sizeof(kFileMagic)) != 0)
+		return failOpen(path + " is not a spectrogram recording");
+	if (getU32(data + 8) != kVersion)
+		return failOpen(path + " was written by another version");
+
+	mFormat.mBits = getU32(data + 12);
+	mFormat.mCompress = (getU32(data + 16) & kFlagCompressed) != 0;
+	mFormat.mMinDb = getF32(data + 20);
+	mFormat.mMaxDb = getF32(data + 24);
+	mFormat.mFramesPerChunk = getU32(data + 28);
+	if ((mFormat.mBits != 8 && mFormat.mBits != 16) || !(mFormat.mMaxDb > mFormat.mMinDb))
+		return failOpen(path + " has an unsupported format");
+
+	//No trailer means the recorder never got to close the file, the chunks are still there
+	mRecovered = !readIndex();
+	if (mRecovered)
+		rebuildIndex();
+
+	//Every code decodes to one magnitude, a table beats a pow() per bin when scrubbing
+	//Codes are evenly spaced in dB, so consecutive magnitudes differ by a constant ratio
+	const std::size_t numCodes = std::size_t(1) << mFormat.mBits;
+	const double step = (static_cast<double>(mFormat.mMaxDb) - mFormat.mMinDb) / static_cast<double>(numCodes - 1);
+	const double ratio = std::pow(10.0, step / 20.0);
+	double magnitude = std::pow(10.0, (mFormat.mMinDb - kDecibelOffset) / 20.0);
+	mMagnitudes.resize(numCodes);
+	for (std::size_t code = 0; code < numCodes; code++, magnitude *= ratio)
+		mMagnitudes[code] = static_cast<float>(magnitude);
+
+	mNumFrames = mIndex.empty() ? 0 : mIndex.back().mFirstFrame + mIndex.back().mNumFrames;
+	return true;
+}
+
+void SpectrogramRecording::close()
+{
+	mFile.close();
+	mIndex.clear();
+	mNumFrames = 0;
+	mRecovered = false;
+}
+
+bool SpectrogramRecording::readIndex()
+{
+	const std::size_t size = mFile.getSize();
+	const std::uint8_t* data = mFile.getData();
+	if (size < kFileHeaderSize + kFooterSize)
+		return false;
+
+	const std::uint8_t* footer = data + size - kFooterSize;
+	if (std::memcmp(footer + 16, kIndexMagic, sizeof(kIndexMagic)) != 0)
+		return false;
+
+	const std::uint64_t indexOffset = getU64(footer);
+	const std::uint64_t numChunks = getU32(footer + 8);
+	if (indexOffset < kFileHeaderSize || indexOffset + numChunks * kIndexEntrySize != size - kFooterSize)
+		return false;
+
+	mIndex.resize(static_cast<std::size_t>(numChunks));
+	const std::uint8_t* entry = data + indexOffset;
+	for (RecordedChunk& chunk : mIndex)
+	{
+		chunk.mOffset = getU64(entry);
+		chunk.mFirstFrame = getU64(entry + 8);
+		chunk.mFirstTime = getF64(entry + 16);
+		chunk.mLastTime = getF64(entry + 24);
+		chunk.mNumFrames = getU32(entry + 32);
+		entry += kIndexEntrySize;
+		if (chunk.mOffset + kChunkHeaderSize > indexOffset)
+		{
+			mIndex.clear();
+			return false;
+		}
+	}
+	return true;
+}
+
+void SpectrogramRecording::rebuildIndex()
+{
+	//Headers only, the payloads are skipped by their stored size. A chunk cut short by the crash ends the walk.
+	const std::size_t size = mFile.getSize();
+	const std::size_t bytesPerValue = mFormat.mBits / 8;
+	std::uint64_t offset = kFileHeaderSize;
+	std::uint64_t numFrames = 0;
+	ChunkHeader header;
+	while (offset + kChunkHeaderSize <= size && parseChunkHeader(mFile.getData() + offset, bytesPerValue, header))
+	{
+		const std::uint64_t end = offset + kChunkHeaderSize + header.mStoredSize;
+		if (end > size)
+			break;
+
+		mIndex.push_back(RecordedChunk{ offset, numFrames, header.mFirstTime, header.mLastTime, header.mNumFrames });
+		numFrames += header.mNumFrames;
+		offset = end;
+	}
+}
+
+double SpectrogramRecording::getStartTime() const
+{
+	return mIndex.empty() ? 0.0 : mIndex.front().mFirstTime;
+}
+
+double SpectrogramRecording::getEndTime() const
+{
+	return mIndex.empty() ? 0.0 : mIndex.back().mLastTime;
+}
+
+bool SpectrogramRecording::readRange(double begin, double end, std::vector<RecordedFrame>& frames)
+{
+	//First chunk that doesn't end before the range starts, then every one starting inside it
+	auto chunk = std::lower_bound(mIndex.begin(), mIndex.end(), begin,
+		[](const RecordedChunk& entry, double time){ return entry.mLastTime < time; });
+	for (; chunk != mIndex.end() && chunk->mFirstTime < end; ++chunk)
+	{
+		if (!decodeRange(static_cast<std::size_t>(chunk - mIndex.begin()), begin, end, mDecoded))
+			return false;
+
+		const std::size_t numBins = mDecoded.mGeometry.mNumBins;
+		for (std::size_t f = 0; f < mDecoded.mTimes.size(); f++)
+		{
+			frames.emplace_back();
+			RecordedFrame& frame = frames.back();
+			frame.mTime = mDecoded.mTimes[f];
+			frame.mGeometry = mDecoded.mGeometry;
+			frame.mMagnitudes.assign(mDecoded.mMagnitudes.begin() + f * numBins, mDecoded.mMagnitudes.begin() + (f + 1) * numBins);
+		}
+	}
+	return true;
+}
+
+bool SpectrogramRecording::decodeChunk(std::size_t index, DecodedChunk& chunk)
+{
+	return decodeRange(index, -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), chunk);
+}
+
+std::size_t SpectrogramRecording::findChunk(double time) const
+{
+	auto chunk = std::upper_bound(mIndex.begin(), mIndex.end(), time,
+		[](double value, const RecordedChunk& entry){ return value < entry.mFirstTime; });
+	return chunk == mIndex.begin() ? 0 : static_cast<std::size_t>(chunk - mIndex.begin()) - 1;
+}
+
+bool SpectrogramRecording::decodeRange(std::size_t index, double begin, double end, DecodedChunk& decoded)
+{
+	CIEQ_PROFILE_ZONE("read chunk");
+	if (index >= mIndex.size())
+		return fail("no such chunk");
+
+	const RecordedChunk& chunk = mIndex[index];
+	const std::size_t bytesPerValue = mFormat.mBits / 8;
+	ChunkHeader header;
+	if (chunk.mOffset + kChunkHeaderSize > mFile.getSize() || !parseChunkHeader(mFile.getData() + chunk.mOffset, bytesPerValue, header)
+		|| chunk.mOffset + kChunkHeaderSize + header.mStoredSize > mFile.getSize())
+		return fail("corrupt chunk header");
+
+	const std::uint8_t* payload = mFile.getData() + chunk.mOffset + kChunkHeaderSize;
+	if (header.mStoredSize < header.mRawSize)
+	{
+		mRaw.resize(header.mRawSize);
+		if (!lz4Decompress(payload, header.mStoredSize, mRaw.data(), mRaw.size()))
+			return fail("corrupt chunk data");
+		payload = mRaw.data();
+	}
+
+	decoded.mIndex = index;
+	decoded.mGeometry = header.mGeometry;
+	decoded.mTimes.clear();
+	decoded.mMagnitudes.clear();
+
+	//Every row is a difference to the one before, so the chunk is decoded from its first row on
+	const std::size_t numBins = header.mGeometry.mNumBins;
+	const std::uint32_t maxCode = (std::uint32_t(1) << mFormat.mBits) - 1;
+	mCodes.assign(numBins, 0);
+	const std::uint8_t* rows = payload + 8 * static_cast<std::size_t>(header.mNumFrames);
+	for (std::size_t f = 0; f < header.mNumFrames; f++)
+	{
+		const std::uint8_t* row = rows + f * numBins * bytesPerValue;
+		for (std::size_t i = 0; i < numBins; i++)
+		{
+			std::uint16_t delta = row[i * bytesPerValue];
+			if (bytesPerValue == 2)
+				delta |= static_cast<std::uint16_t>(row[i * bytesPerValue + 1] << 8);
+			mCodes[i] = static_cast<std::uint16_t>((mCodes[i] + delta) & maxCode);
+		}
+
+		const double time = getF64(payload + 8 * f);
+		if (time < begin || time >= end)
+			continue;
+
+		decoded.mTimes.push_back(time);
+		const std::size_t offset = decoded.mMagnitudes.size();
+		decoded.mMagnitudes.resize(offset + numBins);
+		for (std::size_t i = 0; i < numBins; i++)
+			decoded.mMagnitudes[offset + i] = mMagnitudes[mCodes[i]];
+	}
+	return true;
+}
+
+bool SpectrogramRecording::fail(const std::string& error)
+{
+	mError = error;
+	return false;
+}
+
+bool SpectrogramRecording::failOpen(const std::string& error)
+{
+	close();
+	return fail(error);
+}
+
+} //!dsp
+} //!cieq
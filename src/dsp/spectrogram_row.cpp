@@ -0,0 +1,43 @@
+#include "dsp/spectrogram_row.h"
+
+#include <algorithm>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! opaque black, 0xAABBGGRR
+	const std::uint32_t kBlackPixel = 0xff000000u;
+}
+
+SpectrogramRow::SpectrogramRow()
+{}
+
+void SpectrogramRow::setup(std::size_t width)
+{
+	mMagnitudes.assign(width, 0.0f);
+	mPixels.assign(width, kBlackPixel);
+}
+
+const float* SpectrogramRow::stageMagnitudes(const float* magnitudes, std::size_t count)
+{
+	count = std::min(count, mMagnitudes.size());
+	std::copy(magnitudes, magnitudes + count, mMagnitudes.begin());
+	//Bins the engine didn't deliver stay black
+	std::fill(mMagnitudes.begin() + count, mMagnitudes.end(), 0.0f);
+	return mMagnitudes.data();
+}
+
+const std::uint32_t* SpectrogramRow::stagePixels(const ColormapLut& colormap, const float* magnitudes, std::size_t count, float maxMag, bool dbMode)
+{
+	count = std::min(count, mPixels.size());
+	colormap.mapRow(magnitudes, count, maxMag, dbMode, mPixels.data());
+	std::fill(mPixels.begin() + count, mPixels.end(), kBlackPixel);
+	return mPixels.data();
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,180 @@
+#include "dsp/streaming_stft.h"
+#include "dsp/plan_cache.h"
+
+#include <algorithm>
+
+namespace cieq
+{
+namespace dsp
+{
+
+StreamingStft::StreamingStft()
+	: mHistoryPos(0)
+	, mSamplesConsumed(0)
+	, mNextFrameEnd(0)
+	, mZoomMaxFreq(0.0f)
+	, mFftSize(0)
+	, mWindowSize(0)
+	, mHopSize(0)
+	, mSampleRate(0)
+	, mFirstBin(0)
+	, mNumOutputBins(0)
+{}
+
+void StreamingStft::setup(std::size_t fftSize, std::size_t windowSize, std::size_t hopSize, std::size_t sampleRate, float zoomMaxFreq /*= 0.0f*/)
+{
+	mFftSize = roundFftSize(fftSize, windowSize);
+	mWindowSize = windowSize;
+	mHopSize = std::max<std::size_t>(hopSize, 1);
+	mSampleRate = sampleRate;
+
+	mBinRange.reset();
+	mFftInput.clear();
+	mZoom.reset();
+	mWindow.reset();
+	mHistory.clear();
+
+	//Zoom mode keeps its own decimated history and a much smaller complex FFT,
+	//the full-band buffers are only allocated if zooming isn't possible.
+	if (zoomMaxFreq > 0.0f)
+	{
+		mZoom.reset(new ZoomFft());
+		if (!mZoom->setup(mSampleRate, mFftSize, mWindowSize, zoomMaxFreq))
+			mZoom.reset();
+	}
+	mZoomMaxFreq = mZoom ? zoomMaxFreq : 0.0f;
+
+	if (mZoom)
+	{
+		mZoomMagnitudes.assign(mZoom->getNumBins(), 0.0f);
+	}
+	else
+	{
+		mBinRange.reset(new BinRangeSpectrum());
+		mBinRange->setup(mFftSize, mWindowSize, 0, mFftSize / 2);
+		mFftInput.assign(mWindowSize, 0.0f);
+
+		mWindow = PlanCache::get().getWindow(WindowType::BLACKMAN, mWindowSize);
+
+		mHistory.assign(mWindowSize, 0.0f);
+	}
+	mFirstBin = 0;
+	mNumOutputBins = getNumBins();
+
+	mHistoryPos = 0;
+	mSamplesConsumed = 0;
+	mNextFrameEnd = mWindowSize;
+}
+
+void StreamingStft::setBinRange(std::size_t firstBin, std::size_t numBins)
+{
+	mFirstBin = std::min(firstBin, getNumBins());
+	mNumOutputBins = std::min(numBins, getNumBins() - mFirstBin);
+	if (mBinRange)
+		mBinRange->setup(mFftSize, mWindowSize, mFirstBin, mNumOutputBins);
+}
+
+std::size_t StreamingStft::roundFftSize(std::size_t fftSize, std::size_t windowSize)
+{
+	//Same rules MonitorSpectralNode applies, the FFT can't be shorter than the window
+	if (fftSize < windowSize)
+		fftSize = windowSize;
+	if (!isPowerOf2(fftSize))
+		fftSize = nextPowerOf2(fftSize);
+	return fftSize;
+}
+
+std::size_t StreamingStft::getSettleSamples() const
+{
+	return mWindowSize + (mZoom ? mZoom->getLatencySamples() : 0);
+}
+
+const char* StreamingStft::getBinRangeMethodName() const
+{
+	if (mZoom)
+		return "zoom FFT";
+	return mBinRange ? BinRangeSpectrum::getMethodName(mBinRange->getMethod()) : "";
+}
+
+std::size_t StreamingStft::write(const float* samples, std::size_t count)
+{
+	if (!isSetup())
+		return 0;
+
+	count = std::min(count, getSamplesToNextFrame());
+	if (mZoom)
+	{
+		mZoom->process(samples, count);
+	}
+	else
+	{
+		//At most two runs, up to the end of the history and from its start
+		std::size_t done = 0;
+		while (done < count)
+		{
+			const std::size_t run = std::min(count - done, mWindowSize - mHistoryPos);
+			std::copy(samples + done, samples + done + run, mHistory.begin() + mHistoryPos);
+			mHistoryPos += run;
+			if (mHistoryPos == mWindowSize)
+				mHistoryPos = 0;
+			done += run;
+		}
+	}
+	mSamplesConsumed += count;
+	return count;
+}
+
+std::size_t StreamingStft::getSamplesToNextFrame() const
+{
+	return static_cast<std::size_t>(mNextFrameEnd - mSamplesConsumed);
+}
+
+bool StreamingStft::isFrameReady() const
+{
+	return isSetup() && mSamplesConsumed == mNextFrameEnd;
+}
+
+void StreamingStft::computeFrame(float* magnitudes)
+{
+	if (mZoom)
+	{
+		//The zoom band is already narrow, just keep the requested part of it
+		mZoom->computeMagnitudes(mZoomMagnitudes.data());
+		std::copy(mZoomMagnitudes.begin() + mFirstBin, mZoomMagnitudes.begin() + mFirstBin + mNumOutputBins, magnitudes);
+	}
+	else
+	{
+		//Unroll the circular history (oldest sample first) and apply the window.
+		//The zero padding is never written, the pruned FFT skips it.
+		float* fftIn = mFftInput.data();
+		const std::size_t tail = mWindowSize - mHistoryPos;
+		std::copy(mHistory.begin() + mHistoryPos, mHistory.end(), fftIn);
+		std::copy(mHistory.begin(), mHistory.begin() + mHistoryPos, fftIn + tail);
+		const float* window = mWindow->data();
+		for (std::size_t i = 0; i < mWindowSize; i++)
+			fftIn[i] *= window[i];
+
+		//Only the requested bins get transformed, scaled and copied
+		mBinRange->computeMagnitudes(fftIn, magnitudes);
+	}
+	skipFrame();
+}
+
+void StreamingStft::skipFrame()
+{
+	mNextFrameEnd += mHopSize;
+}
+
+std::uint64_t StreamingStft::getFrameSampleIndex() const
+{
+	const std::uint64_t frameEnd = mNextFrameEnd;
+	if (!mZoom)
+		return frameEnd - std::min<std::uint64_t>(mWindowSize, frameEnd);
+
+	//The decimation filter delays the history a little behind the newest sample
+	const std::uint64_t delayedEnd = frameEnd - std::min<std::uint64_t>(mZoom->getLatencySamples(), frameEnd);
+	return delayedEnd - std::min<std::uint64_t>(mWindowSize, delayedEnd);
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,35 @@
+#include "dsp/window.h"
+
+#include <cmath>
+
+namespace cieq
+{
+namespace dsp
+{
+
+void generateWindow(WindowType type, float* window, std::size_t length)
+{
+	const double twoPi = 6.283185307179586476925286766559;
+	const double oneOverN = 1.0 / static_cast<double>(length);
+
+	for (std::size_t i = 0; i < length; i++)
+	{
+		const double x = static_cast<double>(i) * oneOverN;
+		switch (type)
+		{
+		case WindowType::BLACKMAN:
+			window[i] = static_cast<float>(0.42 - 0.5 * std::cos(twoPi * x) + 0.08 * std::cos(2.0 * twoPi * x));
+			break;
+		case WindowType::HANN:
+			window[i] = static_cast<float>(0.5 * (1.0 - std::cos(twoPi * x)));
+			break;
+		case WindowType::RECT:
+		default:
+			window[i] = 1.0f;
+			break;
+		}
+	}
+}
+
+} //!dsp
+} //!cieq
@@ -0,0 +1,142 @@
+#include "dsp/work_stealing_pool.h"
+
+#include <algorithm>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! which pool the current thread works for, and as which worker
+	thread_local const WorkStealingPool* tPool = nullptr;
+	thread_local std::size_t tWorker = 0;
+}
+
+WorkStealingPool::WorkStealingPool(std::size_t numThreads /*= 0*/)
+	: mNextQueue(0)
+	, mQueued(0)
+	, mUnfinished(0)
+	, mStopping(false)
+{
+	if (numThreads == 0)
+		numThreads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+
+	for (std::size_t i = 0; i < numThreads; i++)
+		mQueues.emplace_back(new Queue());
+	for (std::size_t i = 0; i < numThreads; i++)
+		mThreads.emplace_back(&WorkStealingPool::run, this, i);
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	wait();
+	{
+		std::lock_guard<std::mutex> lock(mStateMutex);
+		mStopping = true;
+	}
+	mWorkAvailable.notify_all();
+	for (auto& thread : mThreads)
+	{
+		thread.join();
+	}
+}
+
+std::size_t WorkStealingPool::getCurrentWorker() const
+{
+	return tPool == this ? tWorker : mThreads.size();
+}
+
+void WorkStealingPool::submit(Task task)
+{
+	const std::size_t current = getCurrentWorker();
+	const std::size_t target = current < mQueues.size() ? current : mNextQueue.fetch_add(1) % mQueues.size();
+	//Counted before it is visible, so a worker can never take it and count it down first
+	{
+		std::lock_guard<std::mutex> lock(mStateMutex);
+		mQueued++;
+		mUnfinished++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mQueues[target]->mMutex);
+		mQueues[target]->mTasks.push_back(std::move(task));
+	}
+	mWorkAvailable.notify_one();
+}
+
+void WorkStealingPool::wait()
+{
+	std::unique_lock<std::mutex> lock(mStateMutex);
+	mAllDone.wait(lock, [this] { return mUnfinished == 0; });
+}
+
+bool WorkStealingPool::take(std::size_t worker, Task& task)
+{
+	//Own queue from the front, in the order tasks were dealt
+	{
+		Queue& own = *mQueues[worker];
+		std::lock_guard<std::mutex> lock(own.mMutex);
+		if (!own.mTasks.empty())
+		{
+			task = std::move(own.mTasks.front());
+			own.mTasks.pop_front();
+			return true;
+		}
+	}
+
+	//Everyone else's from the back, starting with the next worker so thieves spread out
+	for (std::size_t i = 1; i < mQueues.size(); i++)
+	{
+		Queue& victim = *mQueues[(worker + i) % mQueues.size()];
+		std::lock_guard<std::mutex> lock(victim.mMutex);
+		if (!victim.mTasks.empty())
+		{
+			task = std::move(victim.mTasks.back());
+			victim.mTasks.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void WorkStealingPool::run(std::size_t worker)
+{
+	tPool = this;
+	tWorker = worker;
+
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mStateMutex);
+			mWorkAvailable.wait(lock, [this] { return mQueued > 0 || mStopping; });
+			if (mQueued == 0 && mStopping)
+				return;
+		}
+
+		//Another worker may have taken it in the meantime, or it isn't pushed yet
+		Task task;
+		if (!take(worker, task))
+		{
+			std::this_thread::yield();
+			continue;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mStateMutex);
+			mQueued--;
+		}
+
+		task();
+
+		bool allDone = false;
+		{
+			std::lock_guard<std::mutex> lock(mStateMutex);
+			allDone = --mUnfinished == 0;
+		}
+		if (allDone)
+			mAllDone.notify_all();
+	}
+}
+
+} //!dsp
+} //!cieq
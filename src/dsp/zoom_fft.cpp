@@ -0,0 +1,185 @@
+#include "dsp/zoom_fft.h"
+#include "dsp/plan_cache.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace cieq
+{
+namespace dsp
+{
+
+namespace
+{
+	//! the decimated rate must cover the band plus this much room for the filter's transition
+	const double kDecimationGuard = 1.25;
+	//! don't decimate so far that the window shrinks below this many samples
+	const std::size_t kMinDecimatedWindow = 32;
+	//! renormalize the recursive oscillator this often to stop its magnitude drifting
+	const std::size_t kRenormInterval = 1024;
+	const std::size_t kMaxTaps = 2047;
+	const double kPi = 3.14159265358979323846264338327950288;
+}
+
+ZoomFft::ZoomFft()
+	: mOscRe(1.0), mOscIm(0.0)
+	, mStepRe(1.0), mStepIm(0.0)
+	, mRenormCounter(0)
+	, mDelayPos(0)
+	, mDecimationPhase(0)
+	, mHistoryPos(0)
+	, mDecimation(1)
+	, mTransformSize(0)
+	, mNumBins(0)
+	, mCentreBin(0)
+{}
+
+bool ZoomFft::setup(std::size_t sampleRate, std::size_t fftSize, std::size_t windowSize, float maxFreq)
+{
+	mFft.reset();
+
+	//Largest power of two that still leaves room for 0..maxFreq around DC
+	std::size_t decimation = 1;
+	while (static_cast<double>(sampleRate) / (decimation * 2) >= kDecimationGuard * maxFreq
+		&& windowSize / (decimation * 2) >= kMinDecimatedWindow
+		&& fftSize / (decimation * 2) >= kMinDecimatedWindow)
+	{
+		decimation *= 2;
+	}
+	if (decimation < 2)
+		return false;
+
+	mDecimation = decimation;
+	mTransformSize = fftSize / mDecimation;
+
+	//Centre the band on a bin, that way bin i maps onto an integer FFT index
+	const double binWidth = static_cast<double>(sampleRate) / fftSize;
+	mCentreBin = static_cast<std::size_t>(std::floor(maxFreq / (2.0 * binWidth) + 0.5));
+	mNumBins = std::min(static_cast<std::size_t>(std::ceil(maxFreq / binWidth)) + 1, mCentreBin + mTransformSize / 2);
+
+	const double centreFreq = mCentreBin * binWidth;
+	const double phaseStep = -2.0 * kPi * centreFreq / sampleRate;
+	mStepRe = std::cos(phaseStep);
+	mStepIm = std::sin(phaseStep);
+	mOscRe = 1.0;
+	mOscIm = 0.0;
+	mRenormCounter = 0;
+
+	//Blackman windowed-sinc low-pass, passband up to half the band, stopband where
+	//the decimated spectrum would fold back onto the band edge.
+	const double decimatedRate = static_cast<double>(sampleRate) / mDecimation;
+	const double passEdge = 0.5 * maxFreq;
+	const double stopEdge = decimatedRate - passEdge;
+	const double transition = (stopEdge - passEdge) / sampleRate;
+	const double cutoff = 0.5 * (passEdge + stopEdge) / sampleRate;
+	std::size_t numTaps = static_cast<std::size_t>(std::ceil(5.5 / transition)) | 1;
+	numTaps = std::min(numTaps, kMaxTaps);
+
+	mTaps.resize(numTaps);
+	const double middle = 0.5 * (numTaps - 1);
+	double sum = 0.0;
+	for (std::size_t i = 0; i < numTaps; i++)
+	{
+		const double t = static_cast<double>(i) - middle;
+		const double sinc = (t == 0.0) ? 2.0 * cutoff : std::sin(2.0 * kPi * cutoff * t) / (kPi * t);
+		const double x = static_cast<double>(i) / (numTaps - 1);
+		const double window = 0.42 - 0.5 * std::cos(2.0 * kPi * x) + 0.08 * std::cos(4.0 * kPi * x);
+		const double tap = sinc * window;
+		mTaps[i] = static_cast<float>(tap);
+		sum += tap;
+	}
+	for (auto& tap : mTaps)
+		tap = static_cast<float>(tap / sum);
+
+	mDelayLine.assign(2 * numTaps, Complex(0.0f, 0.0f));
+	mDelayPos = 0;
+	mDecimationPhase = 0;
+
+	const std::size_t decimatedWindow = windowSize / mDecimation;
+	mHistory.assign(decimatedWindow, Complex(0.0f, 0.0f));
+	mHistoryPos = 0;
+	mWindow = PlanCache::get().getWindow(WindowType::BLACKMAN, decimatedWindow);
+
+	mFftBuffer.assign(mTransformSize, Complex(0.0f, 0.0f));
+	mFft.reset(new ComplexFft(mTransformSize));
+	return true;
+}
+
+void ZoomFft::process(const float* samples, std::size_t count)
+{
+	const std::size_t numTaps = mTaps.size();
+
+	for (std::size_t n = 0; n < count; n++)
+	{
+		//Mix down, the band centre ends up on DC
+		const Complex mixed(static_cast<float>(samples[n] * mOscRe), static_cast<float>(samples[n] * mOscIm));
+		const double re = mOscRe * mStepRe - mOscIm * mStepIm;
+		mOscIm = mOscRe * mStepIm + mOscIm * mStepRe;
+		mOscRe = re;
+		if (++mRenormCounter == kRenormInterval)
+		{
+			const double norm = 1.0 / std::sqrt(mOscRe * mOscRe + mOscIm * mOscIm);
+			mOscRe *= norm;
+			mOscIm *= norm;
+			mRenormCounter = 0;
+		}
+
+		mDelayLine[mDelayPos] = mixed;
+		mDelayLine[mDelayPos + numTaps] = mixed;
+		if (++mDelayPos == numTaps)
+			mDelayPos = 0;
+
+		//Polyphase decimation: only every mDecimation-th filter output is ever computed
+		if (++mDecimationPhase < mDecimation)
+			continue;
+		mDecimationPhase = 0;
+
+		//The taps are symmetric, so the oldest-first delay line can be dotted directly
+		const Complex* delay = mDelayLine.data() + mDelayPos;
+		float accRe = 0.0f;
+		float accIm = 0.0f;
+		for (std::size_t k = 0; k < numTaps; k++)
+		{
+			accRe += mTaps[k] * delay[k].real();
+			accIm += mTaps[k] * delay[k].imag();
+		}
+
+		mHistory[mHistoryPos] = Complex(accRe, accIm);
+		if (++mHistoryPos == mHistory.size())
+			mHistoryPos = 0;
+	}
+}
+
+void ZoomFft::computeMagnitudes(float* magnitudes)
+{
+	//Oldest decimated sample first, windowed, zero padded up to the transform size
+	const std::size_t length = mHistory.size();
+	const float* window = mWindow->data();
+	for (std::size_t i = 0; i < length; i++)
+	{
+		std::size_t src = mHistoryPos + i;
+		if (src >= length)
+			src -= length;
+		mFftBuffer[i] = mHistory[src] * window[i];
+	}
+	std::fill(mFftBuffer.begin() + length, mFftBuffer.end(), Complex(0.0f, 0.0f));
+
+	mFft->forward(mFftBuffer.data(), length);
+
+	//Bin i sits at i - mCentreBin relative to DC, negative offsets wrap around.
+	//1 / transform size matches the 1 / fftSize scaling of the full-band real FFT.
+	const float magScale = 1.0f / static_cast<float>(mTransformSize);
+	for (std::size_t i = 0; i < mNumBins; i++)
+	{
+		const std::size_t index = (i + mTransformSize - mCentreBin) % mTransformSize;
+		magnitudes[i] = std::abs(mFftBuffer[index]) * magScale;
+	}
+}
+
+std::size_t ZoomFft::getLatencySamples() const
+{
+	return (mTaps.size() - 1) / 2 + mDecimationPhase;
+}
+
+} //!dsp
+} //!cieq
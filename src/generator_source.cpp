@@ -0,0 +1,99 @@
+#include "generator_source.h"
+#include "audio_stft.h"
+#include "dsp/profiler.h"
+
+#include <chrono>
+#include <sstream>
+
+namespace cieq
+{
+
+namespace
+{
+    //! a real-time generator this far behind its clock (e.g. after a debugger break) starts over instead of catching up
+    const double kMaxLagSeconds = 0.5;
+}
+
+GeneratorSource::GeneratorSource()
+    : mRunning(false)
+{}
+
+GeneratorSource::~GeneratorSource()
+{
+    stop();
+}
+
+bool GeneratorSource::setup(const dsp::GeneratorSettings& settings)
+{
+    stop();
+    if (!mGenerator.setup(settings))
+        return false;
+
+    mBlock.assign(mGenerator.getNumChannels() * getBlockSize(), 0.0f);
+    return true;
+}
+
+void GeneratorSource::start(const std::shared_ptr<CaptureNode>& sink)
+{
+    stop();
+
+    mSink = sink;
+    mRunning = true;
+    mThread = std::thread(&GeneratorSource::run, this);
+}
+
+void GeneratorSource::stop()
+{
+    mRunning = false;
+    if (mThread.joinable())
+    {
+        mThread.join();
+    }
+    mSink.reset();
+}
+
+std::string GeneratorSource::getDescription() const
+{
+    std::stringstream description;
+    description << dsp::getGeneratorTypeName(mGenerator.getSettings().mType) << ", " << getSampleRate() << " Hz, "
+        << getNumChannels() << " ch, " << (isRealTime() ? "real time" : "free-running");
+    return description.str();
+}
+
+void GeneratorSource::run()
+{
+    CIEQ_PROFILE_THREAD("generator");
+    using clock = std::chrono::steady_clock;
+    const size_t blockSize = getBlockSize();
+    const auto blockDuration = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(static_cast<double>(blockSize) / getSampleRate()));
+    auto deadline = clock::now();
+
+    while (mRunning)
+    {
+        if (isRealTime())
+        {
+            //Paced against an absolute clock, so sleep jitter doesn't add up to drift
+            const auto now = clock::now();
+            if (now < deadline)
+            {
+                std::this_thread::sleep_until(deadline);
+            }
+            else if (now - deadline > std::chrono::duration<double>(kMaxLagSeconds))
+            {
+                deadline = now;
+            }
+            deadline += blockDuration;
+        }
+        else if (mSink->getRingSize() - mSink->getAvailableSamples() < blockSize)
+        {
+            //Free-running waits for the analysis instead of dropping what it can't take
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+
+        mGenerator.render(mBlock.data(), blockSize);
+        mSink->write(mBlock.data(), getNumChannels(), blockSize);
+    }
+}
+
+} //!cieq